@@ -0,0 +1,105 @@
+#ifndef __COMPAT_COMMAND_LINE_H__
+#define __COMPAT_COMMAND_LINE_H__
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/*
+* Subset of the jetson-utils command line parser, used when building without jetson-utils.
+* Arguments are --name=value or --flag, anything else is a positional argument.
+*/
+class commandLine
+{
+public:
+    commandLine(const int argc, char** argv, const char* extraFlag=NULL) : argc(argc), argv(argv)
+    {
+        (void)extraFlag;  // only used by the jetson-utils display
+        parseLogLevel();
+    }
+
+    bool GetFlag(const char* name) const
+    {
+        const char* value = find(name);
+        if(!value)
+            return false;
+        if(*value == '\0')
+            return true;  // --flag
+        return strcasecmp(value, "false") != 0 && strcmp(value, "0") != 0;
+    }
+
+    float GetFloat(const char* name, float defaultValue=0.0f) const
+    {
+        const char* value = find(name);
+        return (value && *value != '\0') ? strtof(value, NULL) : defaultValue;
+    }
+
+    int GetInt(const char* name, int defaultValue=0) const
+    {
+        const char* value = find(name);
+        return (value && *value != '\0') ? atoi(value) : defaultValue;
+    }
+
+    unsigned int GetUnsignedInt(const char* name, unsigned int defaultValue=0) const
+    {
+        const int value = GetInt(name, defaultValue);
+        return value < 0 ? defaultValue : value;
+    }
+
+    const char* GetString(const char* name, const char* defaultValue=NULL) const
+    {
+        const char* value = find(name);
+        return (value && *value != '\0') ? value : defaultValue;
+    }
+
+    // Positional argument at `index`, NULL if there is none
+    const char* GetPosition(unsigned int index) const
+    {
+        unsigned int position = 0;
+        for(int i = 1; i < argc; i++)
+        {
+            if(strncmp(argv[i], "--", 2) == 0)
+                continue;
+            if(position++ == index)
+                return argv[i];
+        }
+        return NULL;
+    }
+
+    int argc;
+    char** argv;
+
+private:
+    // Value of --name=value, "" for --name, NULL if the argument is missing
+    const char* find(const char* name) const
+    {
+        const size_t size = strlen(name);
+
+        for(int i = 1; i < argc; i++)
+        {
+            const char* arg = argv[i];
+            if(strncmp(arg, "--", 2) != 0)
+                continue;
+            arg += 2;
+
+            if(strncmp(arg, name, size) != 0)
+                continue;
+            if(arg[size] == '\0')
+                return arg + size;
+            if(arg[size] == '=')
+                return arg + size + 1;
+        }
+        return NULL;
+    }
+
+    void parseLogLevel() const;
+};
+
+#include "logging.h"
+
+inline void commandLine::parseLogLevel() const
+{
+    Log::ParseCmdLine(*this);
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef __COMPAT_IMAGE_FORMAT_H__
+#define __COMPAT_IMAGE_FORMAT_H__
+
+#include <stddef.h>
+
+/*
+* Subset of the jetson-utils image formats, used when building without jetson-utils.
+* The pixel types are the CUDA vector types.
+*/
+struct uchar3 { unsigned char x, y, z; };
+struct uchar4 { unsigned char x, y, z, w; };
+struct float3 { float x, y, z; };
+struct float4 { float x, y, z, w; };
+
+enum imageFormat
+{
+    IMAGE_RGB8 = 0,
+    IMAGE_RGBA8,
+    IMAGE_RGB32F,
+    IMAGE_RGBA32F,
+    IMAGE_UNKNOWN = 999
+};
+
+inline const char* imageFormatToStr(imageFormat format)
+{
+    switch(format)
+    {
+        case IMAGE_RGB8:    return "rgb8";
+        case IMAGE_RGBA8:   return "rgba8";
+        case IMAGE_RGB32F:  return "rgb32f";
+        case IMAGE_RGBA32F: return "rgba32f";
+        default:            return "unknown";
+    }
+}
+
+// Size of a pixel in bytes
+inline size_t imageFormatSize(imageFormat format)
+{
+    switch(format)
+    {
+        case IMAGE_RGB8:    return sizeof(uchar3);
+        case IMAGE_RGBA8:   return sizeof(uchar4);
+        case IMAGE_RGB32F:  return sizeof(float3);
+        case IMAGE_RGBA32F: return sizeof(float4);
+        default:            return 0;
+    }
+}
+
+template<typename T> inline imageFormat imageFormatFromType() { return IMAGE_UNKNOWN; }
+template<> inline imageFormat imageFormatFromType<uchar3>()   { return IMAGE_RGB8; }
+template<> inline imageFormat imageFormatFromType<uchar4>()   { return IMAGE_RGBA8; }
+template<> inline imageFormat imageFormatFromType<float3>()   { return IMAGE_RGB32F; }
+template<> inline imageFormat imageFormatFromType<float4>()   { return IMAGE_RGBA32F; }
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef __COMPAT_LOAD_IMAGE_H__
+#define __COMPAT_LOAD_IMAGE_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <profiling/config.h>
+
+#ifdef WITH_JPEG
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
+
+#include "imageFormat.h"
+#include "logging.h"
+
+/*
+* Subset of the jetson-utils image loader, used when building without jetson-utils.
+* Decodes jpeg images (when libjpeg was found) and binary ppm images in host memory.
+* The images must be released with free().
+*/
+
+// Decode a binary ppm (P6) image to RGB8
+inline unsigned char* loadImagePPM(FILE* file, int* width, int* height)
+{
+    int maxValue = 0;
+    if(fscanf(file, "P6 %d %d %d", width, height, &maxValue) != 3 || *width <= 0 || *height <= 0 || maxValue != 255)
+        return NULL;
+    fgetc(file);  // single whitespace before the pixels
+
+    const size_t size = (size_t)*width * *height * 3;
+    unsigned char* pixels = (unsigned char*)malloc(size);
+
+    if(pixels && fread(pixels, 1, size, file) != size)
+    {
+        free(pixels);
+        return NULL;
+    }
+    return pixels;
+}
+
+#ifdef WITH_JPEG
+// libjpeg exits on errors by default, jump back to the decoder instead
+struct JpegError
+{
+    jpeg_error_mgr manager;
+    jmp_buf jump;
+};
+
+inline void onJpegError(j_common_ptr info)
+{
+    char message[JMSG_LENGTH_MAX];
+    info->err->format_message(info, message);
+    LogError("loadImage() -- %s\n", message);
+    longjmp(((JpegError*)info->err)->jump, 1);
+}
+
+// Decode a jpeg image to RGB8
+inline unsigned char* loadImageJPEG(FILE* file, int* width, int* height)
+{
+    jpeg_decompress_struct info;
+    JpegError error;
+    unsigned char* volatile pixels = NULL;
+
+    info.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = onJpegError;
+
+    if(setjmp(error.jump))
+    {
+        jpeg_destroy_decompress(&info);
+        free(pixels);
+        return NULL;
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_stdio_src(&info, file);
+
+    if(jpeg_read_header(&info, TRUE) != JPEG_HEADER_OK)
+    {
+        jpeg_destroy_decompress(&info);
+        return NULL;
+    }
+
+    info.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&info);
+
+    *width = info.output_width;
+    *height = info.output_height;
+    const size_t stride = (size_t)info.output_width * 3;
+    pixels = (unsigned char*)malloc(stride * info.output_height);
+
+    while(pixels && info.output_scanline < info.output_height)
+    {
+        JSAMPROW row = pixels + info.output_scanline * stride;
+        jpeg_read_scanlines(&info, &row, 1);
+    }
+
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+    return pixels;
+}
+#endif
+
+inline bool loadImage(const char* filename, void** output, int* width, int* height, imageFormat format)
+{
+    if(!filename || !output || !width || !height || imageFormatSize(format) == 0)
+    {
+        LogError("loadImage() -- invalid parameters\n");
+        return false;
+    }
+
+    FILE* file = fopen(filename, "rb");
+    if(!file)
+    {
+        LogError("failed to open image '%s'\n", filename);
+        return false;
+    }
+
+    const char* extension = strrchr(filename, '.');
+    unsigned char* rgb = NULL;
+
+#ifdef WITH_JPEG
+    if(extension && (strcasecmp(extension, ".jpg") == 0 || strcasecmp(extension, ".jpeg") == 0))
+        rgb = loadImageJPEG(file, width, height);
+    else
+#endif
+    if(extension && strcasecmp(extension, ".ppm") == 0)
+        rgb = loadImagePPM(file, width, height);
+    else
+        LogError("unsupported image format '%s'\n", filename);
+
+    fclose(file);
+
+    if(!rgb)
+    {
+        LogError("failed to load image '%s'\n", filename);
+        return false;
+    }
+
+    if(format == IMAGE_RGB8)
+    {
+        *output = rgb;
+        return true;
+    }
+
+    // convert to the requested format
+    const size_t pixels = (size_t)*width * *height;
+    const size_t channels = (format == IMAGE_RGBA8 || format == IMAGE_RGBA32F) ? 4 : 3;
+    const bool isFloat = (format == IMAGE_RGB32F || format == IMAGE_RGBA32F);
+    void* converted = malloc(pixels * imageFormatSize(format));
+
+    for(size_t n = 0; converted && n < pixels * channels; n++)
+    {
+        const size_t pixel = n / channels;
+        const size_t channel = n % channels;
+        const unsigned char value = (channel < 3) ? rgb[pixel * 3 + channel] : 255;
+
+        if(isFloat)
+            ((float*)converted)[n] = value;
+        else
+            ((unsigned char*)converted)[n] = value;
+    }
+
+    free(rgb);
+    *output = converted;
+    return converted != NULL;
+}
+
+template<typename T> inline bool loadImage(const char* filename, T** ptr, int* width, int* height)
+{
+    return loadImage(filename, (void**)ptr, width, height, imageFormatFromType<T>());
+}
+
+#endif
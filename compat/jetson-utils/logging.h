@@ -0,0 +1,87 @@
+#ifndef __COMPAT_LOGGING_H__
+#define __COMPAT_LOGGING_H__
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+class commandLine;
+
+/*
+* Subset of the jetson-utils logger, used when building without jetson-utils.
+* Messages are written to stdout, errors and warnings to stderr.
+*/
+class Log
+{
+public:
+    enum Level
+    {
+        SILENT = 0,
+        ERROR,
+        WARNING,
+        SUCCESS,
+        INFO,
+        VERBOSE,
+        DEBUG,
+        DEFAULT = INFO
+    };
+
+    static inline Level GetLevel() { return level(); }
+    static inline void SetLevel(Level value) { level() = value; }
+
+    static inline Level LevelFromStr(const char* str)
+    {
+        static const char* names[] = { "silent", "error", "warning", "success", "info", "verbose", "debug" };
+
+        for(int n = SILENT; n <= DEBUG; n++)
+        {
+            if(str && strcasecmp(str, names[n]) == 0)
+                return (Level)n;
+        }
+        return DEFAULT;
+    }
+
+    // Parse --log-level=LEVEL, --verbose and --debug
+    static void ParseCmdLine(const commandLine& cmdLine);
+
+    static inline const char* Usage()
+    {
+        return "logging arguments:\n"
+               "  --log-level=LEVEL  message output threshold, one of the following:\n"
+               "                     * silent, error, warning, success, info (default), verbose, debug\n"
+               "  --verbose          same as --log-level=verbose\n"
+               "  --debug            same as --log-level=debug\n\n";
+    }
+
+private:
+    static inline Level& level()
+    {
+        static Level current = DEFAULT;
+        return current;
+    }
+};
+
+#define LOG_PRINT(lvl, stream, format, args...) \
+    do { if((int)Log::GetLevel() >= lvl) fprintf(stream, format, ##args); } while(0)
+
+// levels are numbers, profiling/logger.h defines ERROR, WARNING, INFO and DEBUG
+#define LogError(format, args...)    LOG_PRINT(1, stderr, format, ##args)
+#define LogWarning(format, args...)  LOG_PRINT(2, stderr, format, ##args)
+#define LogSuccess(format, args...)  LOG_PRINT(3, stdout, format, ##args)
+#define LogInfo(format, args...)     LOG_PRINT(4, stdout, format, ##args)
+#define LogVerbose(format, args...)  LOG_PRINT(5, stdout, format, ##args)
+#define LogDebug(format, args...)    LOG_PRINT(6, stdout, format, ##args)
+
+#include "commandLine.h"
+
+inline void Log::ParseCmdLine(const commandLine& cmdLine)
+{
+    if(cmdLine.GetFlag("debug"))
+        SetLevel(DEBUG);
+    else if(cmdLine.GetFlag("verbose"))
+        SetLevel(VERBOSE);
+    else if(cmdLine.GetString("log-level"))
+        SetLevel(LevelFromStr(cmdLine.GetString("log-level")));
+}
+
+#endif
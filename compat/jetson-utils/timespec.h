@@ -0,0 +1,61 @@
+#ifndef __COMPAT_TIMESPEC_H__
+#define __COMPAT_TIMESPEC_H__
+
+#include <time.h>
+#include <stdint.h>
+
+/*
+* Subset of the jetson-utils time helpers, used when building without jetson-utils.
+*/
+
+// Current realtime clock
+inline void timestamp(timespec* timestampOut)
+{
+    clock_gettime(CLOCK_REALTIME, timestampOut);
+}
+
+inline timespec timestamp()
+{
+    timespec t;
+    timestamp(&t);
+    return t;
+}
+
+// Difference end - start
+inline void timeDiff(const timespec& start, const timespec& end, timespec* result)
+{
+    result->tv_sec = end.tv_sec - start.tv_sec;
+    result->tv_nsec = end.tv_nsec - start.tv_nsec;
+
+    if(result->tv_nsec < 0)
+    {
+        result->tv_sec--;
+        result->tv_nsec += 1000000000;
+    }
+}
+
+inline timespec timeDiff(const timespec& start, const timespec& end)
+{
+    timespec result;
+    timeDiff(start, end, &result);
+    return result;
+}
+
+// Time in milliseconds
+inline double timeDouble(const timespec& a)
+{
+    return a.tv_sec * 1000.0 + a.tv_nsec * 0.000001;
+}
+
+inline float timeFloat(const timespec& a)
+{
+    return a.tv_sec * 1000.0f + a.tv_nsec * 0.000001f;
+}
+
+// Time in nanoseconds
+inline uint64_t timeNano(const timespec& a)
+{
+    return (uint64_t)a.tv_sec * 1000000000ULL + a.tv_nsec;
+}
+
+#endif
@@ -41,7 +41,6 @@ void sigint_handler(int sig)
 FILE* output_fp = NULL;
 timespec time_s, time_e, ellapsed; // time variables
 int status = 0; // variable for error handling
-static bool log_values = false; // Print values in console?
 
 // rails for file reading
 rail rail0 = { "", 0, 0, 0, NULL, NULL, NULL};
@@ -72,27 +71,26 @@ int main(int argc, char** argv)
     // bind signal listener
     if (signal(SIGINT, sigint_handler) == SIG_ERR)
     {
-        printf(ERROR" Signal SIGINT error\n");
+        log_error("Signal SIGINT error\n");
         exit(1);
     }
 
+    // print the values in the console?
     value = get_option_value(&cmd, "log");
-    if(value)
-        log_values = true;
+    log_set_level(value ? LOG_LEVEL_VALUES : LOG_LEVEL_DEBUG);
     
     value = get_option_value(&cmd, "output");
     if(!value)
     {
         output_path = "profiling_output.csv";
-        printf(WARNING COLOR_WHITE "Output file is empty. Using default %s.\n" COLOR_NONE, output_path);
+        log_warning(COLOR_WHITE "Output file is empty. Using default %s.\n" COLOR_NONE, output_path);
     }
     else
         output_path = (char*)value;
 
     // print some info
-    puts("\n" INFO);
-    printf(COLOR_WHITE "Watching sensor: %s\n" COLOR_NONE, "ALL");
-    printf(COLOR_WHITE "Output file: %s\n" COLOR_NONE, output_path);
+    log_info(COLOR_WHITE "Watching sensor: %s\n" COLOR_NONE, "ALL");
+    log_info(COLOR_WHITE "Output file: %s\n" COLOR_NONE, output_path);
     
 
     // file pointer
@@ -139,7 +137,7 @@ int main(int argc, char** argv)
         open_file(RAIL2_POWER_PATH,   "r+", &rail2.pow_fp)  != 0
     )
     {
-        puts(ERROR "Unable to open a rail file.");
+        log_error("Unable to open a rail file.\n");
         goto cleaning_up;
     }
 
@@ -150,12 +148,12 @@ int main(int argc, char** argv)
         read_rail_data(&rail2) != 0
     )
     {
-        puts(ERROR "Failed reading a rail data.");
+        log_error("Failed reading a rail data.\n");
         goto cleaning_up;
     }
 
     // start profiling
-    puts("\n" INFO COLOR_WHITE "Startted Recording ...\n" COLOR_NONE);
+    log_info(COLOR_WHITE "Startted Recording ...\n\n" COLOR_NONE);
     while(true)
     {
         // Get starting time
@@ -169,7 +167,7 @@ int main(int argc, char** argv)
             read_rail_data(&rail2) != 0
         )
         {
-            puts(ERROR "Failed reading a rail data.");
+            log_error("Failed reading a rail data.\n");
             goto cleaning_up;
         }
         log_rail(&rail0);
@@ -196,7 +194,7 @@ int main(int argc, char** argv)
     }
 
     cleaning_up:
-    puts(INFO COLOR_WHITE "Cleaning up...\n" COLOR_NONE);
+    log_info(COLOR_WHITE "Cleaning up...\n\n" COLOR_NONE);
     fclose(output_fp);
     
     // free rail
@@ -264,7 +262,7 @@ int read_rail(char* file_path, char* value)
 { 
     FILE *fp = fopen(file_path, "r");
     if(fp == NULL) {
-        printf(ERROR "Unable to open file %s\n", file_path);
+        log_error("Unable to open file %s\n", file_path);
         return -1;
     }
     fscanf(fp, "%s", value);
@@ -276,7 +274,7 @@ int open_file(char* file_path, char* mode, FILE* *fp)
 {
     *fp = fopen(file_path, mode);
     if(*fp == NULL) {
-        printf(ERROR "Unable to open file %s\n", file_path);
+        log_error("Unable to open file %s\n", file_path);
         return -1;
     }
     return 0;
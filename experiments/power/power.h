@@ -15,6 +15,10 @@ extern "C"
 #include <sys/mman.h>
 #include <sys/stat.h>
 
+// the values are compiled in, --log turns them on at runtime
+#define LOG_MIN_LEVEL LOG_LEVEL_VALUES
+#include <profiling/logger.h>
+
 #define BUFF_SIZE 100
 // sysfs i2c INA base path
 #define I2C_BASE_PATH "/sys/bus/i2c/drivers/ina3221x/6-0040/iio:device0/"
@@ -24,22 +28,7 @@ extern "C"
 #define RAIL_VOLTAGE_PATH_F  I2C_BASE_PATH "in_voltage%d_input"
 #define RAIL_POWER_PATH_F    I2C_BASE_PATH "in_power%d_input"
 
-// colors used to style th console outputs
-
-#define COLOR_BLUE      "\033[0;34m"
-#define COLOR_GREEN     "\033[0;32m"
-#define COLOR_WHITE     "\033[1;37m"
-#define COLOR_RED       "\033[0;31m"
-#define COLOR_YELLOW    "\033[0;33m"
-#define COLOR_NONE      "\033[0m"
-
-#define WARNING     COLOR_YELLOW"[Warn] "COLOR_NONE
-#define ERROR       COLOR_RED"[Error] "COLOR_NONE
-#define INFO        COLOR_BLUE"[Info] "COLOR_NONE
-#define DEBUG       COLOR_WHITE"[Debug] "COLOR_NONE
-
 #define usage() printf(POWER_USAGE_STRING)
-#define log(format, args...) if(log_values == 1) printf(format, ##args)
 
 #define POWER_USAGE_STRING  "Usage of power profiler: \n"\
                             "./power [--output=OUTPUT] [--delay=DELAY] [--log] [--help]\n"\
@@ -51,8 +40,6 @@ extern "C"
 #define rail_new() {-1, NULL, NULL, NULL, NULL, NULL, NULL, NULL}
 
 
-static bool_t log_values;
-
 typedef struct timespec timespec;
 
 typedef struct 
@@ -81,7 +68,7 @@ void rail_set_name(rail_t* rail, char* path)
     char tmp[15] = "";
     FILE *fp = fopen(path, "r");
     if(fp == NULL) {
-        printf(ERROR "Unable to open file %s\n", path);
+        log_error("Unable to open file %s\n", path);
         sprintf(tmp, "rail%d", rail->id);
         rail->name = (char*) calloc(7, sizeof(char));
         strncpy(rail->name, tmp, 7);
@@ -117,7 +104,7 @@ int rail_set_value(file_t* *file, char* *value, char* path)
 int rail_init(rail_t* rail, int id) 
 {
     if( id < 0 || id > 2)
-        printf(ERROR "Invalid rail id %d. Should be 0, 1 or 2.\n", id);
+        log_error("Invalid rail id %d. Should be 0, 1 or 2.\n", id);
     rail->id = id; //  set the id
 
     // get the name
@@ -240,7 +227,7 @@ void drop_eol(char* string)
         fscanf(p_rail->pow_fp,  "%d", &p_rail->power)   == 0
     )
     {
-        puts(ERROR "Inside read_rail_data function.");
+        log_error("Inside read_rail_data function.\n");
         return -1;
     }
     return 0;
@@ -248,7 +235,7 @@ void drop_eol(char* string)
 
 void rail_log(rail_t* rail)
 {
-    puts("OK3-");
+    log_debug("OK3-\n");
     log(COLOR_WHITE "[%-11s] " COLOR_NONE "Current: %4s mA -- Voltage: %4s mV -- Power: %4s mW\n", 
     rail->name, rail->c_value, rail->v_value, rail->p_value);
 }
@@ -314,10 +301,10 @@ void test_file(void)
 
     /* Create a private, read-only memory mapping */
     char *mmap_addr = (char*) mmap(NULL, file_info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    printf("Mapped value %s\n", mmap_addr);
+    log_info("Mapped value %s\n", mmap_addr);
     assert (mmap_addr != MAP_FAILED);
 
-    printf("Mapped value %s\n", mmap_addr);
+    log_info("Mapped value %s\n", mmap_addr);
 
     /* Unmap the file and close it */
     munmap (mmap_addr, file_info.st_size);
@@ -0,0 +1,67 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+#include <profiling/control.h>
+
+#define CONTROL_USAGE_STRING  "Usage of power profiler control: \n"\
+                              "./power_ctl [--socket=PATH] COMMAND [ARGUMENT]\n"\
+                              "Commands: \n"\
+                              "start FILE               Start a capture in FILE. Returns once the first sample is written.\n"\
+                              "stop                     Stop the current capture.\n"\
+                              "mark LABEL               Write a timestamped mark in FILE.marks.\n"\
+                              "status                   Print the state of the profiler.\n"\
+                              "Arguments: \n"\
+                              "--socket                 The control socket of power_profiler. Defaults to $POWER_PROFILER_SOCKET\n"\
+                              "                         or " POWER_CONTROL_SOCKET ".\n"\
+                              "--help                   Show the help message.\n\n"
+
+#define usage() printf(CONTROL_USAGE_STRING)
+
+int main(int argc, char** argv)
+{
+  const char* socketPath = getenv("POWER_PROFILER_SOCKET");
+  if(!socketPath)
+    socketPath = POWER_CONTROL_SOCKET;
+
+  std::string command;
+  for(int i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0)
+    {
+      usage();
+      return EXIT_SUCCESS;
+    }
+    else if(strncmp(argv[i], "--socket=", 9) == 0)
+      socketPath = argv[i] + 9;
+    else
+    {
+      if(!command.empty())
+        command.push_back(' ');
+      command.append(argv[i]);
+    }
+  }
+
+  if(command.empty())
+  {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  // the daemon doesn't share our working directory
+  if(command.compare(0, 6, "start ") == 0 && command[6] != '/')
+  {
+    char cwd[4096];
+    if(getcwd(cwd, sizeof(cwd)))
+      command = "start " + std::string(cwd) + "/" + command.substr(6);
+  }
+
+  std::string reply;
+  if(!profiling::sendControlCommand(socketPath, command, reply))
+    return EXIT_FAILURE;
+
+  puts(reply.c_str());
+  return reply.compare(0, 2, "OK") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,256 @@
+#ifndef __DOWNSAMPLE_H__
+#define __DOWNSAMPLE_H__
+
+#include <stdint.h>
+#include <math.h>
+#include <functional>
+#include <vector>
+
+struct Point
+{
+  double time;   // seconds
+  double value;
+};
+
+// Receives the points kept by a downsampler, in time order
+typedef std::function<void(const Point&)> PointWriter;
+
+/*
+* Base of the streaming downsamplers.
+* The time range is known beforehand and split in buckets of equal duration,
+* so the points can be processed in a single pass with constant memory.
+*/
+class Downsampler
+{
+public:
+  Downsampler(double start, double end, uint32_t buckets, const PointWriter& writer)
+    : mStart(start), mWidth(end > start && buckets > 0 ? (end - start) / buckets : 0), mBuckets(buckets), mWriter(writer)
+  {}
+  virtual ~Downsampler() {}
+
+  virtual void add(const Point& point) = 0;
+  virtual void finish() = 0;
+
+protected:
+  // Bucket of a time, in [0, buckets)
+  inline int64_t bucketOf(double time, uint32_t buckets) const
+  {
+    if(mWidth <= 0)
+      return 0;
+    int64_t bucket = (int64_t)floor((time - mStart) / mWidth * buckets / mBuckets);
+    return bucket < 0 ? 0 : (bucket >= buckets ? buckets - 1 : bucket);
+  }
+
+  double mStart;
+  double mWidth;
+  uint32_t mBuckets;
+  PointWriter mWriter;
+};
+
+/*
+* Keeps the minimum and the maximum of each bucket.
+* Writes up to two points per bucket, so every spike stays visible.
+*/
+class MinMaxDownsampler : public Downsampler
+{
+public:
+  MinMaxDownsampler(double start, double end, uint32_t points, const PointWriter& writer)
+    : Downsampler(start, end, points / 2 > 0 ? points / 2 : 1, writer), mBucket(-1)
+  {}
+
+  void add(const Point& point)
+  {
+    const int64_t bucket = bucketOf(point.time, mBuckets);
+    if(bucket != mBucket)
+    {
+      flush();
+      mBucket = bucket;
+      mMin = mMax = point;
+      return;
+    }
+    if(point.value < mMin.value) mMin = point;
+    if(point.value > mMax.value) mMax = point;
+  }
+
+  void finish()
+  {
+    flush();
+    mBucket = -1;
+  }
+
+private:
+  void flush()
+  {
+    if(mBucket < 0)
+      return;
+
+    if(mMin.time == mMax.time)
+      mWriter(mMin);
+    else if(mMin.time < mMax.time)
+    {
+      mWriter(mMin);
+      mWriter(mMax);
+    }
+    else
+    {
+      mWriter(mMax);
+      mWriter(mMin);
+    }
+  }
+
+  int64_t mBucket;
+  Point mMin;
+  Point mMax;
+};
+
+/*
+* Largest-Triangle-Three-Buckets on a stream (MinMaxLTTB).
+* Each bucket is split in `ratio` sub buckets whose min and max are the candidates,
+* then LTTB keeps the candidate forming the largest triangle with the previously
+* kept point and the average of the next bucket. A bucket is decided once the
+* next one is complete, so only two buckets of candidates are held.
+*/
+class LttbDownsampler : public Downsampler
+{
+public:
+  LttbDownsampler(double start, double end, uint32_t points, uint32_t ratio, const PointWriter& writer)
+    : Downsampler(start, end, points > 2 ? points - 2 : 1, writer), mRatio(ratio > 0 ? ratio : 1),
+      mHasFirst(false), mCurrentBucket(-1), mCurrentSub(-1), mSum(), mCount(0)
+  {
+    mPending.reserve(2 * mRatio);
+    mCurrent.reserve(2 * mRatio);
+  }
+
+  void add(const Point& point)
+  {
+    // the first point is always kept
+    if(!mHasFirst)
+    {
+      mHasFirst = true;
+      mSelected = point;
+      mFirst = point;
+      mLast = point;
+      mWriter(point);
+      return;
+    }
+    mLast = point;
+
+    const int64_t sub = bucketOf(point.time, mBuckets * mRatio);
+    const int64_t bucket = sub / mRatio;
+
+    if(bucket != mCurrentBucket)
+    {
+      closeBucket();
+      mCurrent.clear();
+      mSum.time = mSum.value = 0;
+      mCount = 0;
+      mCurrentBucket = bucket;
+      mCurrentSub = -1;
+    }
+
+    if(sub != mCurrentSub)
+    {
+      closeSubBucket();
+      mCurrentSub = sub;
+      mMin = mMax = point;
+    }
+    else
+    {
+      if(point.value < mMin.value) mMin = point;
+      if(point.value > mMax.value) mMax = point;
+    }
+
+    mSum.time += point.time;
+    mSum.value += point.value;
+    mCount++;
+  }
+
+  void finish()
+  {
+    if(!mHasFirst)
+      return;
+
+    // the last bucket is decided with the last point, which is always kept
+    closeBucket();
+    select(mLast);
+
+    if(mLast.time != mFirst.time)
+      mWriter(mLast);
+    mHasFirst = false;
+  }
+
+private:
+  // Decide the pending bucket with the average of the current one, which becomes pending
+  void closeBucket()
+  {
+    closeSubBucket();
+    if(mCount == 0)
+      return;
+
+    Point average = { mSum.time / mCount, mSum.value / mCount };
+    select(average);
+    mPending.swap(mCurrent);
+  }
+
+  // Add the min and max of the sub bucket to the candidates
+  void closeSubBucket()
+  {
+    if(mCurrentSub < 0)
+      return;
+
+    if(mMin.time <= mMax.time)
+    {
+      mCurrent.push_back(mMin);
+      if(mMax.time != mMin.time) mCurrent.push_back(mMax);
+    }
+    else
+    {
+      mCurrent.push_back(mMax);
+      mCurrent.push_back(mMin);
+    }
+    mCurrentSub = -1;
+  }
+
+  // Keep the pending candidate forming the largest triangle with the selected point and `next`
+  void select(const Point& next)
+  {
+    if(mPending.empty())
+      return;
+
+    double maxArea = -1;
+    size_t index = 0;
+    for(size_t i = 0; i < mPending.size(); i++)
+    {
+      const Point& point = mPending[i];
+      const double area = fabs((mSelected.time - next.time) * (point.value - mSelected.value) -
+                               (mSelected.time - point.time) * (next.value - mSelected.value));
+      if(area > maxArea)
+      {
+        maxArea = area;
+        index = i;
+      }
+    }
+
+    mSelected = mPending[index];
+    mPending.clear();
+    if(mSelected.time != mLast.time)  // written by finish()
+      mWriter(mSelected);
+  }
+
+  const uint32_t mRatio;
+  bool mHasFirst;
+  Point mSelected;  // last point kept
+  Point mFirst;
+  Point mLast;      // last point read
+
+  std::vector<Point> mPending;  // candidates of the bucket to decide
+  std::vector<Point> mCurrent;  // candidates of the bucket being read
+  int64_t mCurrentBucket;
+  int64_t mCurrentSub;
+  Point mMin;
+  Point mMax;
+  Point mSum;
+  uint64_t mCount;
+};
+
+#endif
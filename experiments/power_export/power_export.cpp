@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <profiling/argparse.h>
+#include <profiling/captureParser.h>
+#include <profiling/mappedFile.h>
+#include "downsample.h"
+#include <profiling/logger.h>
+
+#define EXPORT_USAGE_STRING "Usage of power export: \n"\
+                            "./power_export --input=INPUT [--output=OUTPUT] [--points=POINTS] [--mode=MODE] [--column=COLUMN]\n"\
+                            "               [--ratio=RATIO] [--help]\n"\
+                            "Downsamples a power_profiler capture in a single pass to plot it.\n"\
+                            "Arguments: \n"\
+                            "--input  | -i            The capture written by power_profiler.\n"\
+                            "--output | -o            The downsampled series (time;value). Defaults to stdout.\n"\
+                            "--points | -p            Target number of points. Defaults to 2000.\n"\
+                            "--mode   | -m            MINMAX keeps the min and max of each bucket, LTTB the most significant point.\n"\
+                            "                         Defaults to LTTB.\n"\
+                            "--column | -c            One of POWER, CURRENT or VOLTAGE. Defaults to POWER.\n"\
+                            "--ratio  | -r            LTTB candidates are the min and max of RATIO sub buckets. Defaults to 4.\n"\
+                            "--help   | -h            Show the help message.\n\n"
+
+#define usage() printf(EXPORT_USAGE_STRING)
+
+#define TAIL_SIZE   4096
+
+// columns of the capture after the timestamp
+enum CaptureColumns
+{
+  CURRENT_COLUMN = 0,
+  VOLTAGE_COLUMN,
+  POWER_COLUMN
+};
+
+int getColumnId(const char* column)
+{
+  if(!column || strcasecmp(column, "power") == 0)
+    return POWER_COLUMN;
+  if(strcasecmp(column, "current") == 0)
+    return CURRENT_COLUMN;
+  if(strcasecmp(column, "voltage") == 0)
+    return VOLTAGE_COLUMN;
+  return -1;
+}
+
+// Value of the column of a sample. Returns false if the column is not watched.
+bool getPoint(const profiling::CaptureSample& sample, int column, Point& point)
+{
+  const int32_t values[] = { sample.current, sample.voltage, sample.power };
+  if(values[column] < 0)
+    return false;
+
+  point.time = sample.time * 1e-9;
+  point.value = values[column];
+  return true;
+}
+
+// Read the time of the first and the last samples without reading the whole file
+bool readTimeRange(const profiling::MappedFile& file, int column, double& start, double& end)
+{
+  const char* data = file.getData();
+  const char* last = data + file.getSize();
+
+  profiling::CaptureReader reader(data, last);
+  profiling::CaptureSample sample;
+  Point point;
+  bool found = false;
+
+  while(!found && reader.next(sample))
+    found = getPoint(sample, column, point);
+  if(!found)
+    return false;
+  start = end = point.time;
+
+  // last complete line with a sample
+  const char* tail = last - data > TAIL_SIZE ? last - TAIL_SIZE : data;
+  if(tail > data)
+  {
+    const char* newLine = (const char*)memchr(tail, '\n', last - tail);
+    tail = newLine ? newLine + 1 : last;
+  }
+
+  reader = profiling::CaptureReader(tail, last);
+  while(reader.next(sample))
+  {
+    if(getPoint(sample, column, point))
+      end = point.time;
+  }
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  arg_option options[] = {
+    OPT_BOOLEAN('h', "help",   NULL),
+    OPT_STRING ('i', "input",  NULL),
+    OPT_STRING ('o', "output", NULL),
+    OPT_INTEGER('p', "points", NULL),
+    OPT_STRING ('m', "mode",   NULL),
+    OPT_STRING ('c', "column", NULL),
+    OPT_INTEGER('r', "ratio",  NULL),
+  };
+
+  command_line cmd = { options, 7 };
+  parse_command_line(&cmd, argc, argv);
+
+  const char* inputPath = (const char*) get_option_value(&cmd, "input");
+  if(get_option_value(&cmd, "help") || !inputPath)
+  {
+    free_command_line(&cmd);
+    usage();
+    exit(inputPath ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  int* value = (int*) get_option_value(&cmd, "points");
+  const uint32_t points = (value && *value > 2) ? *value : 2000;
+  value = (int*) get_option_value(&cmd, "ratio");
+  const uint32_t ratio = (value && *value > 0) ? *value : 4;
+
+  const char* mode = (const char*) get_option_value(&cmd, "mode");
+  const bool minMax = mode && strcasecmp(mode, "minmax") == 0;
+  if(mode && !minMax && strcasecmp(mode, "lttb") != 0)
+  {
+    printf(ERROR "Unexpected mode %s. Use MINMAX or LTTB.\n", mode);
+    free_command_line(&cmd);
+    exit(EXIT_FAILURE);
+  }
+
+  const int column = getColumnId((const char*) get_option_value(&cmd, "column"));
+  if(column < 0)
+  {
+    printf(ERROR "Unexpected column. Use POWER, CURRENT or VOLTAGE.\n");
+    free_command_line(&cmd);
+    exit(EXIT_FAILURE);
+  }
+
+  profiling::MappedFile input;
+  if(!input.open(inputPath))
+  {
+    free_command_line(&cmd);
+    exit(EXIT_FAILURE);
+  }
+
+  double start = 0, end = 0;
+  if(!readTimeRange(input, column, start, end))
+  {
+    printf(ERROR "No sample found in %s.\n", inputPath);
+    free_command_line(&cmd);
+    exit(EXIT_FAILURE);
+  }
+
+  const char* outputPath = (const char*) get_option_value(&cmd, "output");
+  FILE* output = outputPath ? fopen(outputPath, "w") : stdout;
+  if(!output)
+  {
+    printf(ERROR "Unable to open file %s.\n", outputPath);
+    free_command_line(&cmd);
+    exit(EXIT_FAILURE);
+  }
+
+  uint64_t written = 0;
+  PointWriter writer = [output, &written](const Point& point) {
+    fprintf(output, "%.9f;%g\n", point.time, point.value);
+    written++;
+  };
+
+  Downsampler* downsampler = NULL;
+  if(minMax)
+    downsampler = new MinMaxDownsampler(start, end, points, writer);
+  else
+    downsampler = new LttbDownsampler(start, end, points, ratio, writer);
+
+  fprintf(output, "time;%s\n", column == POWER_COLUMN ? "power" : (column == CURRENT_COLUMN ? "current" : "voltage"));
+
+  // single pass over the capture
+  profiling::CaptureReader reader(input.getData(), input.getData() + input.getSize());
+  profiling::CaptureSample sample;
+  Point point;
+  uint64_t read = 0;
+
+  while(reader.next(sample))
+  {
+    if(!getPoint(sample, column, point))
+      continue;
+    downsampler->add(point);
+    read++;
+  }
+  downsampler->finish();
+
+  fprintf(stderr, INFO "Kept %llu of %llu samples.\n", (unsigned long long)written, (unsigned long long)read);
+
+  delete downsampler;
+  if(output != stdout)
+    fclose(output);
+  free_command_line(&cmd);
+  return 0;
+}
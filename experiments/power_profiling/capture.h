@@ -0,0 +1,206 @@
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#define CAPTURE_REQUEST_TIMEOUT_MS  2000
+
+enum CaptureCommand
+{
+  CAPTURE_START = 0,
+  CAPTURE_STOP
+};
+
+/*
+* Output files of the sampler.
+* The capture file is only written by the sampling loop. The control thread asks it
+* to start or stop and waits for the acknowledgement: a start is acknowledged once
+* the first sample has been written to the new file, so the caller knows the
+* sampler is actually recording. Marks go to a side file PATH.marks.
+*/
+class Capture
+{
+public:
+  Capture(const std::string& railName) : mRailName(railName), mPending(false), mOpen(false), mSamples(0),
+    mCommand(CAPTURE_STOP), mDone(false), mAckOnWrite(false), mMarks(0)
+  {}
+
+  ~Capture()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    closeFiles();
+  }
+
+  // sampler: start a capture right away (without control socket)
+  bool open(const std::string& path)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return openFiles(path);
+  }
+
+  // control thread: ask the sampler to start or stop a capture and wait for the reply
+  std::string request(CaptureCommand command, const std::string& path)
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCommand = command;
+    mRequestPath = path;
+    mDone = false;
+    mPending.store(true, std::memory_order_release);
+
+    if(!mCondition.wait_for(lock, std::chrono::milliseconds(CAPTURE_REQUEST_TIMEOUT_MS), [this] { return mDone; }))
+    {
+      const bool applied = !mPending.exchange(false);
+      return applied ? "ERR timeout waiting for the first sample" : "ERR timeout, the sampler is not responding";
+    }
+    return mReply;
+  }
+
+  // control thread: write a mark at the current time
+  std::string mark(const std::string& label)
+  {
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(!mMarksFile.is_open())
+      return "ERR no capture";
+
+    mMarksFile << now.tv_sec << ';' << now.tv_nsec << ';' << label << '\n';
+    mMarksFile.flush();
+    mMarks++;
+
+    char reply[64];
+    snprintf(reply, sizeof(reply), "OK marked %ld.%09ld", (long)now.tv_sec, (long)now.tv_nsec);
+    return reply;
+  }
+
+  // control thread
+  std::string status()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(!isOpen())
+      return "OK idle";
+    return "OK capturing " + mPath + " samples=" + std::to_string(getSamples()) + " marks=" + std::to_string(mMarks);
+  }
+
+  // sampler: apply the pending request, if any
+  inline void poll()
+  {
+    if(mPending.load(std::memory_order_acquire))
+      applyRequest();
+  }
+
+  // sampler: write a sample to the capture
+  inline void write(const timespec& time, const std::string& current, const std::string& voltage, const std::string& power)
+  {
+    if(!isOpen())
+      return;
+
+    mFile << time.tv_sec << ';' << time.tv_nsec << ';';
+    mFile << current << ';' << voltage << ';' << power << '\n';
+    mSamples.fetch_add(1, std::memory_order_relaxed);
+
+    if(mAckOnWrite)
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mAckOnWrite = false;
+      complete("OK capturing " + mPath);
+    }
+  }
+
+  inline bool isOpen() const { return mOpen.load(std::memory_order_relaxed); }
+  inline uint64_t getSamples() const { return mSamples.load(std::memory_order_relaxed); }
+
+private:
+  // sampler, called with the lock held
+  bool openFiles(const std::string& path)
+  {
+    closeFiles();
+
+    mFile.open(path.c_str());
+    if(!mFile.is_open())
+      return false;
+
+    mFile << "start_time_sec;" << "start_time_nsec;";
+    mFile << "curr_" << mRailName << ';' << "volt_" << mRailName << ';' << "powe_" << mRailName << '\n';
+
+    mMarksFile.open((path + ".marks").c_str());
+    mMarksFile << "time_sec;time_nsec;label\n";
+
+    mPath = path;
+    mMarks = 0;
+    mSamples.store(0, std::memory_order_relaxed);
+    mOpen.store(true, std::memory_order_relaxed);
+    return true;
+  }
+
+  // sampler, called with the lock held
+  void closeFiles()
+  {
+    mOpen.store(false, std::memory_order_relaxed);
+    if(mFile.is_open())      mFile.close();
+    if(mMarksFile.is_open()) mMarksFile.close();
+  }
+
+  // sampler
+  void applyRequest()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(!mPending.load(std::memory_order_relaxed))
+      return;  // the request timed out
+    mPending.store(false, std::memory_order_relaxed);
+
+    if(mCommand == CAPTURE_START)
+    {
+      if(openFiles(mRequestPath))
+        mAckOnWrite = true;  // acknowledged by the next write
+      else
+        complete("ERR unable to open " + mRequestPath);
+    }
+    else if(!isOpen())
+      complete("ERR no capture");
+    else
+    {
+      const std::string reply = "OK stopped " + mPath + " samples=" + std::to_string(getSamples()) + " marks=" + std::to_string(mMarks);
+      closeFiles();
+      complete(reply);
+    }
+  }
+
+  // called with the lock held
+  void complete(const std::string& reply)
+  {
+    mReply = reply;
+    mDone = true;
+    mCondition.notify_all();
+  }
+
+  std::string mRailName;
+  std::ofstream mFile;
+  std::ofstream mMarksFile;
+  std::string mPath;
+
+  std::atomic<bool> mPending;
+  std::atomic<bool> mOpen;
+  std::atomic<uint64_t> mSamples;
+
+  // request state, guarded by mMutex
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  CaptureCommand mCommand;
+  std::string mRequestPath;
+  std::string mReply;
+  bool mDone;
+  bool mAckOnWrite;
+  uint64_t mMarks;
+};
+
+#endif
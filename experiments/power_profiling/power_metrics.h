@@ -0,0 +1,96 @@
+#ifndef __POWER_METRICS_H__
+#define __POWER_METRICS_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <time.h>
+#include <profiling/metrics.h>
+
+/*
+* Sampler state aggregated for the metrics endpoint.
+* update() and drop() are only called by the sampling loop, render() by the
+* metrics server thread. Values are published through atomics so a scrape
+* never blocks the sampler.
+*/
+struct PowerMetrics
+{
+  PowerMetrics(const std::string& railName) : mRailName(railName), mCurrent(0), mVoltage(0), mPower(0), mEnergy(0),
+    mSampleRate(0), mSamples(0), mDropped(0), mWindowStart(0), mWindowSamples(0)
+  {}
+
+  // Record a sample and the energy (J) consumed since the previous one. Values are -1 when they are not watched.
+  void update(const timespec& time, int current, int voltage, int power, double energy)
+  {
+    const double now = time.tv_sec + time.tv_nsec * 1e-9;
+
+    if(current >= 0) mCurrent.store(current, std::memory_order_relaxed);
+    if(voltage >= 0) mVoltage.store(voltage, std::memory_order_relaxed);
+    if(power >= 0)   mPower.store(power, std::memory_order_relaxed);
+    mEnergy.store(mEnergy.load(std::memory_order_relaxed) + energy, std::memory_order_relaxed);
+
+    // sample rate over one second windows
+    if(mWindowStart == 0)
+      mWindowStart = now;
+    mWindowSamples++;
+    if(now - mWindowStart >= 1.0)
+    {
+      mSampleRate.store(mWindowSamples / (now - mWindowStart), std::memory_order_relaxed);
+      mWindowStart = now;
+      mWindowSamples = 0;
+    }
+
+    mSamples.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Record a sample that could not be read
+  void drop()
+  {
+    mDropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void render(std::string& out) const
+  {
+    std::string labels = "rail=\"";
+    profiling::writeLabelValue(labels, mRailName.c_str());
+    labels.append("\"");
+
+    profiling::writeMetricHeader(out, "power_profiler_rail_power_milliwatts", "Last power read on the rail.", "gauge");
+    profiling::writeMetricValue(out, "power_profiler_rail_power_milliwatts", labels.c_str(), mPower.load(std::memory_order_relaxed));
+
+    profiling::writeMetricHeader(out, "power_profiler_rail_current_milliamperes", "Last current read on the rail.", "gauge");
+    profiling::writeMetricValue(out, "power_profiler_rail_current_milliamperes", labels.c_str(), mCurrent.load(std::memory_order_relaxed));
+
+    profiling::writeMetricHeader(out, "power_profiler_rail_voltage_millivolts", "Last voltage read on the rail.", "gauge");
+    profiling::writeMetricValue(out, "power_profiler_rail_voltage_millivolts", labels.c_str(), mVoltage.load(std::memory_order_relaxed));
+
+    profiling::writeMetricHeader(out, "power_profiler_rail_energy_joules_total", "Energy consumed on the rail since the start.", "counter");
+    profiling::writeMetricValue(out, "power_profiler_rail_energy_joules_total", labels.c_str(), mEnergy.load(std::memory_order_relaxed));
+
+    profiling::writeMetricHeader(out, "power_profiler_sample_rate_hertz", "Samples read per second over the last window.", "gauge");
+    profiling::writeMetricValue(out, "power_profiler_sample_rate_hertz", NULL, mSampleRate.load(std::memory_order_relaxed));
+
+    profiling::writeMetricHeader(out, "power_profiler_samples_total", "Samples read since the start.", "counter");
+    profiling::writeMetricValue(out, "power_profiler_samples_total", NULL, (double)mSamples.load(std::memory_order_relaxed));
+
+    profiling::writeMetricHeader(out, "power_profiler_dropped_samples_total", "Samples lost because the rail files could not be read.", "counter");
+    profiling::writeMetricValue(out, "power_profiler_dropped_samples_total", NULL, (double)mDropped.load(std::memory_order_relaxed));
+  }
+
+private:
+  std::string mRailName;
+
+  std::atomic<double> mCurrent;
+  std::atomic<double> mVoltage;
+  std::atomic<double> mPower;
+  std::atomic<double> mEnergy;
+  std::atomic<double> mSampleRate;
+  std::atomic<uint64_t> mSamples;
+  std::atomic<uint64_t> mDropped;
+
+  // sampler only
+  double   mWindowStart;
+  uint64_t mWindowSamples;
+};
+
+#endif
@@ -2,26 +2,44 @@
 #include <fstream>
 #include <signal.h>
 #include <strings.h>
+#include <unistd.h>
 #include <jetson-utils/timespec.h>
 
 #include <profiling/argparse.h>
+#include <profiling/control.h>
+#include <profiling/stream.h>
+#include "capture.h"
+#include "power_metrics.h"
+#include "rollup.h"
 #include "power_profiling.h"
 
 #define POWER_USAGE_STRING  "Usage of power profiler: \n"\
-                            "./power_profiler [--output=OUTPUT] [--device=DEVICE] [--value=VALUE] [--help]\n"\
+                            "./power_profiler [--output=OUTPUT] [--device=DEVICE] [--value=VALUE] [--metrics=ADDRESS] [--stream=PATH] [--control=PATH]\n"\
+                            "                  [--rollup=PATH] [--rollup-tiers=TIERS] [--help]\n"\
                             "Arguments: \n"\
-                            "--output | -o            The path of the file in which to write the power consumption. Defaults to power_output.csv.\n"\
+                            "--output | -o            The path of the file in which to write the power consumption. Defaults to power_output.csv,\n"\
+                            "                         or no capture until a start command when --control is used.\n"\
                             "--rail   | -r            Chose the rail to monitor. Use CPU, GPU or BOARD.\n"\
                             "--value  | -v            Chose the value to watch. One of POWER, CURRENT, VOLTAGE or ALL. Defaults to ALL.\n"\
+                            "--metrics | -m           Serve Prometheus metrics on HOST:PORT, :PORT (localhost) or unix:PATH.\n"\
+                            "--stream  | -s           Stream every sample to the subscribers of the unix socket PATH.\n"\
+                            "--control | -c           Run as a daemon controlled from the unix socket PATH (see power_ctl).\n"\
+                            "--rollup  | -u           Keep min/max/mean/energy rollups of the power in the fixed size file PATH.\n"\
+                            "                         The samples are only written to --output if it is given.\n"\
+                            "--rollup-tiers | -t      Rollup tiers as WIDTH_SEC:BUCKETS,... with raw:SAMPLES for the raw samples.\n"\
+                            "                         Defaults to " ROLLUP_DEFAULT_TIERS ".\n"\
                             "--help   | -h            Show the help message.\n\n"
 
 #define usage() printf(POWER_USAGE_STRING)
 
-bool shutdownFlag = false;
+// sampling period while there is nobody to record for
+#define IDLE_PERIOD_US 10000
+
+// the signal that stopped the sampler, reported after the pending log messages
+volatile sig_atomic_t shutdownFlag = 0;
 void sigintHandler(int sig)
 {
-  printf("\nCaught SIGINT!\n");
-  shutdownFlag = true;
+  shutdownFlag = sig;
 }
 
 int getRailId(char* railType)
@@ -54,7 +72,7 @@ int getValueId(char* valueType)
 
 
 int main (int argc, char** argv) {
-  if (signal(SIGINT, sigintHandler) == SIG_ERR)
+  if (signal(SIGINT, sigintHandler) == SIG_ERR || signal(SIGTERM, sigintHandler) == SIG_ERR)
   {
     printf(ERROR " Signal SIGINT error\n");
     exit(EXIT_FAILURE);
@@ -65,9 +83,14 @@ int main (int argc, char** argv) {
     OPT_STRING ('o', "output", NULL),
     OPT_STRING ('v', "value", NULL),
     OPT_STRING ('r', "rail",   NULL),
+    OPT_STRING ('m', "metrics", NULL),
+    OPT_STRING ('s', "stream", NULL),
+    OPT_STRING ('c', "control", NULL),
+    OPT_STRING ('u', "rollup", NULL),
+    OPT_STRING ('t', "rollup-tiers", NULL),
   };
 
-  command_line cmd = { options, 4 };
+  command_line cmd = { options, 9 };
   parse_command_line(&cmd, argc, argv);
 
   void* value = get_option_value(&cmd, "help");
@@ -91,9 +114,15 @@ int main (int argc, char** argv) {
     exit(EXIT_FAILURE);
   }
 
+  char* controlPath = (char*) get_option_value(&cmd, "control");
+  char* rollupPath = (char*) get_option_value(&cmd, "rollup");
   char* outputPath = NULL;
   value = get_option_value(&cmd, "output");
-  if(!value)
+  if(!value && controlPath)
+      printf(INFO "Waiting for a start command on %s.\n", controlPath);
+  else if(!value && rollupPath)
+      printf(INFO "Raw samples are not written, only rollups.\n");
+  else if(!value)
   {
       outputPath = "power_output.csv";
       printf(WARNING COLOR_WHITE "Output file is empty. Using default %s.\n" COLOR_NONE, outputPath);
@@ -110,12 +139,72 @@ int main (int argc, char** argv) {
   RailData rail(railId, valueId);
 
   // output file
-  std::ofstream outputFile(outputPath);
-  if( !outputFile.is_open() )
-    throw std::runtime_error("Unable to open file: power_output.csv");
+  Capture capture(rail.mName);
+  if( outputPath && !capture.open(outputPath) )
+    throw std::runtime_error(std::string("Unable to open file: ") + outputPath);
+
+  // bounded size rollups
+  Rollup rollup;
+  const char* rollupTiers = (const char*) get_option_value(&cmd, "rollup-tiers");
+
+  if(rollupPath && !rollup.open(rollupPath, rollupTiers ? rollupTiers : ROLLUP_DEFAULT_TIERS, rail.mName))
+  {
+    free_command_line(&cmd);
+    throw std::runtime_error(std::string("Unable to open rollup file: ") + rollupPath);
+  }
+  if(rollupPath && valueId != ALL_VALUE && valueId != POWER_VALUE)
+    printf(WARNING "Rollups are computed on the power, which is not watched.\n");
+
+  // metrics endpoint
+  EnergyCounter energyCounter;
+  PowerMetrics powerMetrics(rail.mName);
+  profiling::MetricsServer metricsServer;
+
+  // live subscribers
+  profiling::StreamServer streamServer(profiling::STREAM_POWER_SAMPLE, sizeof(profiling::StreamPowerRecord));
+  profiling::StreamPowerRecord record;
+  record.rail = railId;
+
+  char* streamPath = (char*) get_option_value(&cmd, "stream");
+  if(streamPath && !streamServer.start(streamPath))
+    printf(WARNING "Unable to start the sample stream on %s.\n", streamPath);
+
+  char* metricsAddress = (char*) get_option_value(&cmd, "metrics");
+  if(metricsAddress)
+  {
+    metricsServer.addCollector([&powerMetrics](std::string& out) { powerMetrics.render(out); });
+    metricsServer.addCollector([&streamServer](std::string& out) {
+      if(!streamServer.isRunning())
+        return;
+      profiling::writeMetricHeader(out, "power_profiler_stream_clients", "Connected stream subscribers.", "gauge");
+      profiling::writeMetricValue(out, "power_profiler_stream_clients", NULL, streamServer.getClientCount());
+      profiling::writeMetricHeader(out, "power_profiler_stream_dropped_samples_total", "Samples dropped by the stream, by stage.", "counter");
+      profiling::writeMetricValue(out, "power_profiler_stream_dropped_samples_total", "stage=\"publish\"", (double)streamServer.getDropped());
+      profiling::writeMetricValue(out, "power_profiler_stream_dropped_samples_total", "stage=\"client\"", (double)streamServer.getClientDropped());
+    });
+    if(!metricsServer.start(metricsAddress))
+      printf(WARNING "Unable to start the metrics endpoint on %s.\n", metricsAddress);
+  }
+
+  // control socket
+  profiling::ControlServer controlServer([&capture](const std::string& command, const std::string& argument) -> std::string {
+    if(command == "start")
+      return argument.empty() ? "ERR usage: start FILE" : capture.request(CAPTURE_START, argument);
+    if(command == "stop")
+      return capture.request(CAPTURE_STOP, "");
+    if(command == "mark")
+      return capture.mark(argument);
+    if(command == "status")
+      return capture.status();
+    return "ERR unknown command " + command;
+  });
 
-  outputFile << "start_time_sec;" << "start_time_nsec;";
-  outputFile << "curr_" << rail.mName << ';' << "volt_" << rail.mName << ';' << "powe_" << rail.mName << '\n';
+  if(controlPath && !controlServer.start(controlPath))
+  {
+    free_command_line(&cmd);
+    throw std::runtime_error(std::string("Unable to open control socket: ") + controlPath);
+  }
+  profiling::notifySystemd("READY=1");
 
   timespec time_s;
   #ifdef LOG_VALUES
@@ -124,9 +213,33 @@ int main (int argc, char** argv) {
 
   while(!shutdownFlag)
   {
+    capture.poll();
+
+    // nobody is recording, keep the metrics alive at a low rate
+    if(!capture.isOpen() && !rollup.isOpen() && streamServer.getClientCount() == 0)
+      usleep(IDLE_PERIOD_US);
+
     timestamp(&time_s);
     // update values
-    rail.readValues();
+    if(!rail.readValues())
+    {
+      // a rail that keeps failing would spin the loop
+      powerMetrics.drop();
+      usleep(IDLE_PERIOD_US);
+      continue;
+    }
+    record.sec = time_s.tv_sec;
+    record.nsec = time_s.tv_nsec;
+    record.current = railValueToInt(rail.mCurrValue);
+    record.voltage = railValueToInt(rail.mVoltValue);
+    record.power = railValueToInt(rail.mPoweValue);
+
+    const double energy = energyCounter.add(time_s, record.power);
+    powerMetrics.update(time_s, record.current, record.voltage, record.power, energy);
+    if(record.power >= 0)
+      rollup.add(time_s, record.power, energy);
+    if(streamServer.isRunning())
+      streamServer.publish(&record);
 
     rail.logRail();
 
@@ -135,14 +248,21 @@ int main (int argc, char** argv) {
     // compute duration
     timestamp(&time_e);
     timeDiff(time_s, time_e, &ellapsed);
-    std::cout <<"[Time Diff] " << timeDouble(ellapsed) << '\n';
+    log("[Time Diff] %f\n", timeDouble(ellapsed));
     #endif
 
     // save values
-    outputFile << time_s.tv_sec << ';' << time_s.tv_nsec << ';';
-    outputFile << rail.mCurrValue << ';' << rail.mVoltValue << ';' << rail.mPoweValue << '\n';
+    capture.write(time_s, rail.mCurrValue, rail.mVoltValue, rail.mPoweValue);
   }
-  outputFile.close();
+  // log() is written by the logger thread, its messages go out before the direct writes
+  log_flush();
+  printf("\nCaught %s!\n", shutdownFlag == SIGTERM ? "SIGTERM" : "SIGINT");
+
+  profiling::notifySystemd("STOPPING=1");
+  controlServer.stop();
+  metricsServer.stop();
+  streamServer.stop();
+  rollup.close();
   // free dynamically allocated values
   free_command_line(&cmd);
 
@@ -52,19 +52,12 @@ struct RailData
     if ( mPoweFile.is_open() ) mPoweFile.close();
   }
 
-  void readValues()
+  // Read the watched values. Returns false if one of them couldn't be read.
+  bool readValues()
   {
-    // Read current value
-    getline(mCurrFile, mCurrValue);
-    mCurrFile.seekg(0, std::ios::beg);
-
-    // Read voltage value
-    getline(mVoltFile, mVoltValue);
-    mVoltFile.seekg(0, std::ios::beg);
-
-    // Read power value
-    getline(mPoweFile, mPoweValue);
-    mPoweFile.seekg(0, std::ios::beg);
+    return readValue(mCurrFile, mCurrValue) &&
+           readValue(mVoltFile, mVoltValue) &&
+           readValue(mPoweFile, mPoweValue);
   }
 
   void logRail()
@@ -78,6 +71,46 @@ private:
   std::ifstream mVoltFile;
   std::ifstream mPoweFile;
   void initRail(int valueId);
+
+  // Read the first line of a rail file and rewind it for the next sample
+  static bool readValue(std::ifstream& file, std::string& value)
+  {
+    if(!file.is_open())  // value not watched
+      return true;
+
+    bool status = (bool)getline(file, value);
+    file.clear();
+    file.seekg(0, std::ios::beg);
+    return status && !value.empty();
+  }
+};
+
+// Convert a rail value to an integer. Returns -1 if the value is not watched.
+inline int railValueToInt(const std::string& value)
+{
+  return value.empty() ? -1 : atoi(value.c_str());
+}
+
+// Integrates the rail power over time
+struct EnergyCounter
+{
+  EnergyCounter() : mLastTime(0), mLastPower(-1)
+  {}
+
+  // Returns the energy (J) consumed since the previous sample, using the previous power (mW)
+  double add(const timespec& time, int power)
+  {
+    const double now = time.tv_sec + time.tv_nsec * 1e-9;
+    const double energy = (mLastPower >= 0) ? mLastPower * (now - mLastTime) * 0.001 : 0.0;
+
+    mLastTime = now;
+    mLastPower = power;
+    return energy;
+  }
+
+private:
+  double mLastTime;
+  int    mLastPower;
 };
 
 void RailData::initRail(int valueId)
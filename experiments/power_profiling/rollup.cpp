@@ -0,0 +1,251 @@
+#include "rollup.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <profiling/logger.h>
+
+// order the tiers from the raw one to the coarsest
+static bool compareTiers(const RollupTierHeader& a, const RollupTierHeader& b)
+{
+  return a.width < b.width;
+}
+
+// Parse a count filling the whole of `text`, between 1 and UINT32_MAX
+static bool parseCount(const std::string& text, uint32_t& value)
+{
+  const char* begin = text.c_str();
+  char* end = NULL;
+  errno = 0;
+  const long long parsed = strtoll(begin, &end, 10);
+
+  if(end == begin || *end != '\0' || errno == ERANGE || parsed <= 0 || parsed > (long long)UINT32_MAX)
+    return false;
+
+  value = (uint32_t)parsed;
+  return true;
+}
+
+bool Rollup::parseTiers(const char* spec, std::vector<RollupTierHeader>& tiers)
+{
+  tiers.clear();
+  std::string tokens(spec ? spec : "");
+  size_t position = 0;
+
+  while(position < tokens.size())
+  {
+    size_t end = tokens.find(',', position);
+    if(end == std::string::npos)
+      end = tokens.size();
+
+    const std::string token = tokens.substr(position, end - position);
+    const size_t colon = token.find(':');
+    position = end + 1;
+
+    if(colon == std::string::npos)
+      return false;
+
+    const std::string width = token.substr(0, colon);
+    const bool raw = strcasecmp(width.c_str(), "raw") == 0;
+
+    RollupTierHeader tier;
+    memset(&tier, 0, sizeof(tier));
+    if((!raw && !parseCount(width, tier.width)) || !parseCount(token.substr(colon + 1), tier.capacity))
+      return false;
+    tiers.push_back(tier);
+  }
+
+  std::sort(tiers.begin(), tiers.end(), compareTiers);
+  for(size_t i = 1; i < tiers.size(); i++)
+  {
+    // a tier is consolidated from the previous one
+    if(tiers[i].width == tiers[i-1].width || (tiers[i-1].width > 0 && tiers[i].width % tiers[i-1].width != 0))
+      return false;
+  }
+  return !tiers.empty() && tiers.size() <= ROLLUP_MAX_TIERS;
+}
+
+
+Rollup::Rollup() : mFd(-1), mSize(0), mHeader(NULL), mData(NULL), mRawTier(-1) {}
+
+Rollup::~Rollup()
+{
+  close();
+}
+
+bool Rollup::open(const char* path, const char* spec, const std::string& railName)
+{
+  std::vector<RollupTierHeader> tiers;
+  if(!parseTiers(spec, tiers))
+  {
+    printf(ERROR "Invalid rollup tiers %s.\n", spec);
+    return false;
+  }
+
+  // layout: header, then the rings one after the other
+  RollupFileHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = ROLLUP_MAGIC;
+  header.version = ROLLUP_VERSION;
+  header.tierCount = tiers.size();
+  strncpy(header.rail, railName.c_str(), sizeof(header.rail) - 1);
+
+  uint64_t size = sizeof(RollupFileHeader);
+  for(size_t i = 0; i < tiers.size(); i++)
+  {
+    tiers[i].offset = size;
+    size += (uint64_t)tiers[i].capacity * (tiers[i].width == 0 ? sizeof(RollupSample) : sizeof(RollupBucket));
+    header.tiers[i] = tiers[i];
+  }
+
+  mFd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  struct stat info;
+  if(mFd < 0 || fstat(mFd, &info) < 0)
+  {
+    printf(ERROR "Unable to open rollup file %s.\n", path);
+    close();
+    return false;
+  }
+
+  // check if we can resume the previous rollups
+  bool resume = false;
+  if((uint64_t)info.st_size == size)
+  {
+    RollupFileHeader previous;
+    if(pread(mFd, &previous, sizeof(previous), 0) == (ssize_t)sizeof(previous) &&
+       previous.magic == ROLLUP_MAGIC && previous.version == ROLLUP_VERSION && previous.tierCount == header.tierCount)
+    {
+      resume = true;
+      for(size_t i = 0; i < tiers.size(); i++)
+        resume = resume && previous.tiers[i].width == tiers[i].width && previous.tiers[i].capacity == tiers[i].capacity;
+    }
+  }
+
+  if(!resume && (ftruncate(mFd, 0) < 0 || ftruncate(mFd, size) < 0))
+  {
+    printf(ERROR "Unable to allocate %llu bytes for rollup file %s.\n", (unsigned long long)size, path);
+    close();
+    return false;
+  }
+
+  void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+  if(mapping == MAP_FAILED)
+  {
+    printf(ERROR "Unable to map rollup file %s.\n", path);
+    close();
+    return false;
+  }
+
+  mSize = size;
+  mData = (char*)mapping;
+  mHeader = (RollupFileHeader*)mapping;
+  if(!resume)
+    *mHeader = header;
+
+  mRawTier = -1;
+  mTiers.clear();
+  for(size_t i = 0; i < tiers.size(); i++)
+  {
+    if(tiers[i].width == 0)
+      mRawTier = i;
+    else
+      mTiers.push_back(i);
+  }
+
+  printf(INFO "%s rollups in %s (%llu bytes).\n", resume ? "Resuming" : "Writing", path, (unsigned long long)size);
+  return true;
+}
+
+void Rollup::close()
+{
+  if(mHeader)
+  {
+    // the buckets being filled stay in the header for the next open
+    msync(mData, mSize, MS_SYNC);
+    munmap(mData, mSize);
+  }
+  if(mFd >= 0)
+    ::close(mFd);
+
+  mFd = -1;
+  mHeader = NULL;
+  mData = NULL;
+  mSize = 0;
+}
+
+void Rollup::add(const timespec& time, float power, double energy)
+{
+  if(!mHeader)
+    return;
+
+  if(mRawTier >= 0)
+  {
+    RollupTierHeader& tier = mHeader->tiers[mRawTier];
+    RollupSample* samples = (RollupSample*)(mData + tier.offset);
+    RollupSample& sample = samples[tier.written % tier.capacity];
+
+    sample.sec = time.tv_sec;
+    sample.nsec = time.tv_nsec;
+    sample.power = power;
+    tier.written++;
+  }
+
+  if(mTiers.empty())
+    return;
+
+  RollupBucket bucket;
+  bucket.start = time.tv_sec;
+  bucket.count = 1;
+  bucket.min = bucket.max = bucket.mean = power;
+  bucket.energy = energy;
+  merge(0, bucket);
+}
+
+void Rollup::merge(size_t tier, const RollupBucket& bucket)
+{
+  RollupBucket& current = mHeader->open[mTiers[tier]];
+  const uint32_t width = mHeader->tiers[mTiers[tier]].width;
+  const uint32_t index = bucket.start / width;
+
+  if(current.count > 0 && current.start / width != index)
+    flush(tier);
+
+  if(current.count == 0)
+  {
+    current = bucket;
+    current.start = index * width;
+    return;
+  }
+
+  const uint32_t count = current.count + bucket.count;
+  current.mean = (current.mean * current.count + bucket.mean * bucket.count) / count;
+  current.min = std::min(current.min, bucket.min);
+  current.max = std::max(current.max, bucket.max);
+  current.energy += bucket.energy;
+  current.count = count;
+}
+
+void Rollup::flush(size_t tier)
+{
+  RollupBucket& bucket = mHeader->open[mTiers[tier]];
+  if(bucket.count == 0)
+    return;
+
+  RollupTierHeader& header = mHeader->tiers[mTiers[tier]];
+  RollupBucket* buckets = (RollupBucket*)(mData + header.offset);
+  buckets[header.written % header.capacity] = bucket;
+  header.written++;
+
+  // consolidate into the next tier
+  if(tier + 1 < mTiers.size())
+    merge(tier + 1, bucket);
+
+  bucket.count = 0;
+}
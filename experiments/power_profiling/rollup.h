@@ -0,0 +1,96 @@
+#ifndef __ROLLUP_H__
+#define __ROLLUP_H__
+
+#include <stdint.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+#define ROLLUP_MAGIC      0x554c5250  // "PRLU" little endian
+#define ROLLUP_VERSION    2
+#define ROLLUP_MAX_TIERS  8
+
+// raw tier, then 1 s for an hour, 10 s for a day and 1 min for 30 days
+#define ROLLUP_DEFAULT_TIERS "raw:600000,1:3600,10:8640,60:43200"
+
+/*
+* Layout of the rollup file. The file has a fixed size computed from the tiers
+* and is mapped in memory: the tiers are ring buffers written in place by the
+* sampler, so memory and disk usage don't depend on the capture duration.
+*/
+struct RollupTierHeader
+{
+  uint32_t width;     // bucket width in seconds, 0 for the raw tier
+  uint32_t capacity;  // records in the ring
+  uint64_t offset;    // offset of the ring from the start of the file
+  uint64_t written;   // records written since the creation, the next one goes to written % capacity
+};
+
+// consolidated tiers record
+struct RollupBucket
+{
+  uint32_t start;   // epoch seconds, multiple of the tier width
+  uint32_t count;   // samples in the bucket
+  float    min;     // mW
+  float    max;     // mW
+  float    mean;    // mW
+  float    energy;  // J
+};
+
+struct RollupFileHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t tierCount;
+  uint32_t reserved;
+  char     rail[32];
+  RollupTierHeader tiers[ROLLUP_MAX_TIERS];
+  RollupBucket open[ROLLUP_MAX_TIERS];  // bucket being filled of each consolidated tier, count 0 if none
+};
+
+// raw tier record
+struct RollupSample
+{
+  uint32_t sec;
+  uint32_t nsec;
+  float    power;  // mW
+};
+
+/*
+* RRD style rollups of the rail power.
+* Every sample goes to the raw tier and to the first consolidated tier. When a bucket
+* is complete it is written to its ring and merged into the next (coarser) tier. The buckets
+* being filled live in the file header, so a resumed file carries on with them.
+*/
+class Rollup
+{
+public:
+  Rollup();
+  ~Rollup();
+
+  // Map `path` with the tiers described by `spec` (WIDTH:CAPACITY,... with raw as width 0).
+  // An existing file with the same layout is resumed, otherwise it is recreated.
+  bool open(const char* path, const char* spec, const std::string& railName);
+  void close();
+
+  // Add a power sample (mW) and the energy (J) consumed since the previous one
+  void add(const timespec& time, float power, double energy);
+
+  inline bool isOpen() const { return mHeader != NULL; }
+
+  // Parse a tier spec. Returns false if it is invalid.
+  static bool parseTiers(const char* spec, std::vector<RollupTierHeader>& tiers);
+
+private:
+  void merge(size_t tier, const RollupBucket& bucket);
+  void flush(size_t tier);
+
+  int mFd;
+  size_t mSize;
+  RollupFileHeader* mHeader;
+  char* mData;
+  int mRawTier;  // -1 without raw tier
+  std::vector<size_t> mTiers;  // consolidated tiers, from the finest
+};
+
+#endif
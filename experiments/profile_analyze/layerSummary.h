@@ -0,0 +1,151 @@
+#ifndef __LAYER_SUMMARY_H__
+#define __LAYER_SUMMARY_H__
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+
+#include <profiling/hdrHistogram.h>
+
+// highest recordable time, in ns
+#define SUMMARY_HIGHEST_NS  (60ULL * 1000000000ULL)
+
+/*
+* Statistics of the times of a layer (ms). The mean and variance are updated with Welford's
+* algorithm and the percentiles come from a histogram, so the memory doesn't depend on the
+* number of times. Summaries of different parts of a file are merged with merge.
+*/
+class LayerSummary
+{
+public:
+  LayerSummary(int significantDigits) : mCount(0), mSum(0), mMean(0), mM2(0), mMin(0), mMax(0),
+                                        mHistogram(SUMMARY_HIGHEST_NS, significantDigits)
+  {}
+
+  inline void add(double duration)
+  {
+    mCount++;
+    mSum += duration;
+
+    const double delta = duration - mMean;
+    mMean += delta / mCount;
+    mM2 += delta * (duration - mMean);
+
+    mMin = mCount == 1 ? duration : std::min(mMin, duration);
+    mMax = mCount == 1 ? duration : std::max(mMax, duration);
+    mHistogram.record(duration > 0 ? (uint64_t)(duration * 1e6 + 0.5) : 0);
+  }
+
+  // Chan's parallel update of the mean and variance
+  void merge(const LayerSummary& other)
+  {
+    if(other.mCount == 0)
+      return;
+
+    if(mCount == 0)
+    {
+      mMin = other.mMin;
+      mMax = other.mMax;
+    }
+    else
+    {
+      mMin = std::min(mMin, other.mMin);
+      mMax = std::max(mMax, other.mMax);
+    }
+
+    const double count = (double)mCount + other.mCount;
+    const double delta = other.mMean - mMean;
+    mMean += delta * other.mCount / count;
+    mM2 += other.mM2 + delta * delta * mCount * other.mCount / count;
+    mCount += other.mCount;
+    mSum += other.mSum;
+    mHistogram.add(other.mHistogram);
+  }
+
+  inline uint64_t getCount() const { return mCount; }
+  inline double getSum() const { return mSum; }
+  inline double getMean() const { return mMean; }
+  inline double getStdDev() const { return mCount > 1 ? sqrt(mM2 / (mCount - 1)) : 0.0; }
+  inline double getMin() const { return mMin; }
+  inline double getMax() const { return mMax; }
+  // ms at `percentile` (0 to 100)
+  inline double getPercentile(double percentile) const { return mHistogram.getValueAtPercentile(percentile) * 1e-6; }
+
+private:
+  uint64_t mCount;
+  double mSum;
+  double mMean;
+  double mM2;
+  double mMin;
+  double mMax;
+  profiling::HdrHistogram mHistogram;
+};
+
+// Name pointing into the mapped file, so looking a layer up doesn't copy it
+struct NameKey
+{
+  const char* data;
+  uint32_t length;
+
+  inline bool operator==(const NameKey& other) const
+  {
+    return length == other.length && memcmp(data, other.data, length) == 0;
+  }
+};
+
+struct NameKeyHash
+{
+  // FNV-1a
+  inline size_t operator()(const NameKey& key) const
+  {
+    uint64_t hash = 14695981039346656037ULL;
+    for(uint32_t i = 0; i < key.length; i++)
+      hash = (hash ^ (unsigned char)key.data[i]) * 1099511628211ULL;
+    return hash;
+  }
+};
+
+/*
+* Summaries of the layers and inferences of a part of a file, in the order they were first seen.
+*/
+class SummaryTable
+{
+public:
+  SummaryTable(int significantDigits) : mSignificantDigits(significantDigits) {}
+
+  inline LayerSummary& get(const NameKey& name, bool inference)
+  {
+    std::unordered_map<NameKey, size_t, NameKeyHash>::iterator found = mIndex.find(name);
+    if(found != mIndex.end())
+      return mSummaries[found->second];
+
+    mIndex[name] = mSummaries.size();
+    mNames.push_back(name);
+    mInferences.push_back(inference);
+    mSummaries.emplace_back(mSignificantDigits);
+    return mSummaries.back();
+  }
+
+  void merge(const SummaryTable& other)
+  {
+    for(size_t n = 0; n < other.size(); n++)
+      get(other.mNames[n], other.mInferences[n]).merge(other.mSummaries[n]);
+  }
+
+  inline size_t size() const { return mSummaries.size(); }
+  inline const NameKey& getName(size_t n) const { return mNames[n]; }
+  inline bool isInference(size_t n) const { return mInferences[n]; }
+  inline const LayerSummary& getSummary(size_t n) const { return mSummaries[n]; }
+
+private:
+  int mSignificantDigits;
+  std::unordered_map<NameKey, size_t, NameKeyHash> mIndex;
+  std::deque<NameKey> mNames;
+  std::deque<bool> mInferences;
+  std::deque<LayerSummary> mSummaries;
+};
+
+#endif
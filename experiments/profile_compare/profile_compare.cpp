@@ -0,0 +1,458 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <profiling/argparse.h>
+#include <profiling/captureParser.h>
+#include <profiling/columnStore.h>
+#include <profiling/comparison.h>
+#include <profiling/mappedFile.h>
+#include <profiling/traceParser.h>
+#include <profiling/logger.h>
+
+#define COMPARE_USAGE_STRING "Usage of profile compare: \n"\
+                             "./profile_compare --baseline=BASELINE --candidate=CANDIDATE [--baseline-power=CAPTURE]\n"\
+                             "                  [--candidate-power=CAPTURE] [--threshold=PERCENT] [--alpha=ALPHA] [--skip=RUNS]\n"\
+                             "                  [--resamples=COUNT] [--gate=GATE] [--output=OUTPUT] [--help]\n"\
+                             "Compares the layer times, inference latency and energy of two profiling runs.\n"\
+                             "Exits with 2 if a gated measure regressed.\n"\
+                             "Arguments: \n"\
+                             "--baseline        | -b   Profiler output (layer_out.csv) or column store (.pcs) of the reference run.\n"\
+                             "--candidate       | -c   Profiler output or column store of the run to check.\n"\
+                             "--baseline-power  | -p   Power capture of the baseline, for the energy of each inference.\n"\
+                             "                         Not needed if the column store has a power table.\n"\
+                             "--candidate-power | -q   Power capture of the candidate.\n"\
+                             "--threshold       | -t   Median increase, in percent, from which a significant change is a regression.\n"\
+                             "                         Defaults to 5.\n"\
+                             "--alpha           | -a   Significance level of the Mann-Whitney tests, adjusted for the number\n"\
+                             "                         of measures with Holm-Bonferroni. Defaults to 0.01.\n"\
+                             "--skip            | -s   Warmup inferences dropped at the start of each run. Defaults to 0.\n"\
+                             "--resamples       | -r   Bootstrap resamples of the confidence intervals. Defaults to 10000.\n"\
+                             "--gate            | -g   Measures that fail the comparison: total (latency and energy) or all\n"\
+                             "                         (also the layers). Defaults to total.\n"\
+                             "--output          | -o   The comparison (;-separated). Defaults to a table on stdout.\n"\
+                             "--help            | -h   Show the help message.\n\n"
+
+#define usage() printf(COMPARE_USAGE_STRING)
+
+#define REGRESSION_EXIT_CODE  2
+#define LATENCY_NAME          "latency (model_total)"
+#define ENERGY_NAME           "energy (mJ/inference)"
+
+// measures of a profiling run, in ms and mJ
+struct RunData
+{
+  std::map<std::string, std::vector<double> > layers;
+  std::vector<std::string> layerOrder;  // order of the network
+  std::vector<double> latencies;
+  std::vector<double> starts;           // ms since the epoch
+  std::vector<double> energies;
+
+  std::vector<double> powerTimes;       // s since the epoch
+  std::vector<double> powers;           // mW
+
+  void addLayer(const std::string& name, double duration)
+  {
+    std::vector<double>& durations = layers[name];
+    if(durations.empty())
+      layerOrder.push_back(name);
+    durations.push_back(duration);
+  }
+};
+
+// comparison of a measure
+struct Comparison
+{
+  std::string name;
+  bool total;       // latency or energy, gated by default
+  size_t baselineCount;
+  size_t candidateCount;
+  double baseline;  // medians
+  double candidate;
+  double low;       // interval of the difference
+  double high;
+  double p;
+  double z;
+};
+
+bool loadTrace(const char* path, uint64_t skip, RunData& run)
+{
+  profiling::MappedFile file;
+  if(!file.open(path))
+    return false;
+
+  profiling::TraceReader reader(file.getData(), file.getData() + file.getSize());
+  profiling::TraceRecord record;
+  uint64_t inference = 0;  // layers are written before the model_total of their inference
+
+  while(reader.next(record))
+  {
+    if(record.type == profiling::TRACE_LAYER)
+    {
+      if(inference >= skip)
+        run.addLayer(std::string(record.name, record.nameLength), record.values[0]);
+    }
+    else if(record.type == profiling::TRACE_MODEL_TOTAL)
+    {
+      if(inference++ >= skip)
+      {
+        run.latencies.push_back(record.values[0]);
+        run.starts.push_back(record.values[1]);
+      }
+    }
+  }
+  return true;
+}
+
+bool loadStore(const char* path, uint64_t skip, RunData& run)
+{
+  profiling::ColumnStore store;
+  if(!store.open(path))
+    return false;
+
+  std::vector<std::vector<int64_t> > columns;
+  std::vector<profiling::ColumnRange> ranges;
+
+  const profiling::TableInfo* layers = store.getTable(STORE_LAYERS_TABLE);
+  if(layers)
+  {
+    std::vector<int> projection;
+    projection.push_back(layers->getColumnIndex("layer"));
+    projection.push_back(layers->getColumnIndex("duration"));
+
+    const profiling::ColumnRange warmup = { layers->getColumnIndex("run"), (int64_t)skip, INT64_MAX };
+    ranges.assign(1, warmup);
+
+    profiling::ColumnScan scan(store, *layers, projection, ranges);
+    for(size_t count = scan.next(columns); count > 0; count = scan.next(columns))
+    {
+      for(size_t row = 0; row < count; row++)
+        run.addLayer(store.getDictionary()[columns[0][row]], columns[1][row] * 1e-6);
+    }
+  }
+
+  const profiling::TableInfo* inferences = store.getTable(STORE_INFERENCES_TABLE);
+  if(inferences)
+  {
+    std::vector<int> projection;
+    projection.push_back(inferences->getColumnIndex("start"));
+    projection.push_back(inferences->getColumnIndex("duration"));
+
+    const profiling::ColumnRange warmup = { inferences->getColumnIndex("run"), (int64_t)skip, INT64_MAX };
+    ranges.assign(1, warmup);
+
+    profiling::ColumnScan scan(store, *inferences, projection, ranges);
+    for(size_t count = scan.next(columns); count > 0; count = scan.next(columns))
+    {
+      for(size_t row = 0; row < count; row++)
+      {
+        run.starts.push_back(columns[0][row] * 1e-3);
+        run.latencies.push_back(columns[1][row] * 1e-6);
+      }
+    }
+  }
+
+  const profiling::TableInfo* power = store.getTable(STORE_POWER_TABLE);
+  if(power)
+  {
+    std::vector<int> projection;
+    projection.push_back(power->getColumnIndex("time"));
+    projection.push_back(power->getColumnIndex("power"));
+
+    const profiling::ColumnRange watched = { power->getColumnIndex("power"), 0, INT64_MAX };
+    ranges.assign(1, watched);
+
+    profiling::ColumnScan scan(store, *power, projection, ranges);
+    for(size_t count = scan.next(columns); count > 0; count = scan.next(columns))
+    {
+      for(size_t row = 0; row < count; row++)
+      {
+        run.powerTimes.push_back(columns[0][row] * 1e-9);
+        run.powers.push_back(columns[1][row]);
+      }
+    }
+  }
+  return true;
+}
+
+// Samples of a power capture, sec;nsec;current;voltage;power
+bool loadPower(const char* path, RunData& run)
+{
+  profiling::MappedFile file;
+  if(!file.open(path))
+    return false;
+
+  run.powerTimes.clear();
+  run.powers.clear();
+
+  profiling::CaptureReader reader(file.getData(), file.getData() + file.getSize());
+  profiling::CaptureSample sample;
+
+  while(reader.next(sample))
+  {
+    if(sample.power < 0)
+      continue;  // not watched
+
+    run.powerTimes.push_back(sample.time * 1e-9);
+    run.powers.push_back(sample.power);
+  }
+  return true;
+}
+
+// Energy of each inference (mJ), each power sample holds until the next one
+void computeEnergies(RunData& run)
+{
+  run.energies.clear();
+  if(run.powerTimes.size() < 2)
+    return;
+
+  size_t sample = 0;
+  for(size_t n = 0; n < run.starts.size(); n++)
+  {
+    const double start = run.starts[n] * 1e-3;
+    const double end = start + run.latencies[n] * 1e-3;
+
+    // outside the capture
+    if(start < run.powerTimes.front() || end > run.powerTimes.back())
+      continue;
+
+    // the inferences are usually in order, go back if they aren't
+    if(run.powerTimes[sample] > start)
+      sample = 0;
+    while(sample + 1 < run.powerTimes.size() && run.powerTimes[sample + 1] <= start)
+      sample++;
+
+    double energy = 0;
+    for(size_t i = sample; i + 1 < run.powerTimes.size() && run.powerTimes[i] < end; i++)
+    {
+      const double from = std::max(run.powerTimes[i], start);
+      const double to = std::min(run.powerTimes[i + 1], end);
+      if(to > from)
+        energy += run.powers[i] * (to - from);  // mW * s = mJ
+    }
+    run.energies.push_back(energy);
+  }
+}
+
+bool loadRun(const char* path, const char* powerPath, uint64_t skip, RunData& run)
+{
+  if(!(profiling::ColumnStore::isColumnStore(path) ? loadStore(path, skip, run) : loadTrace(path, skip, run)))
+    return false;
+
+  if(powerPath && !loadPower(powerPath, run))
+    return false;
+
+  computeEnergies(run);
+
+  if(run.latencies.empty() && run.layers.empty())
+  {
+    printf(ERROR "No layer or inference times in %s.\n", path);
+    return false;
+  }
+  return true;
+}
+
+Comparison compare(const std::string& name, bool total, std::vector<double>& baseline, std::vector<double>& candidate,
+                   uint32_t resamples, profiling::MedianBootstrap& bootstrap)
+{
+  std::sort(baseline.begin(), baseline.end());
+  std::sort(candidate.begin(), candidate.end());
+
+  Comparison comparison;
+  comparison.name = name;
+  comparison.total = total;
+  comparison.baselineCount = baseline.size();
+  comparison.candidateCount = candidate.size();
+  comparison.baseline = profiling::sortedMedian(baseline);
+  comparison.candidate = profiling::sortedMedian(candidate);
+  comparison.p = profiling::mannWhitneyTest(baseline, candidate, &comparison.z);
+  bootstrap.getInterval(baseline, candidate, resamples, 0.95, comparison.low, comparison.high);
+  return comparison;
+}
+
+inline double relative(double delta, double reference)
+{
+  return reference != 0 ? 100.0 * delta / reference : 0.0;
+}
+
+// regression, improvement or none
+const char* getVerdict(const Comparison& comparison, double alpha, double threshold)
+{
+  if(comparison.p >= alpha)
+    return "";
+
+  const double delta = comparison.candidate - comparison.baseline;
+  const double change = relative(delta, comparison.baseline);
+
+  if(comparison.low > 0 && change > threshold)
+    return "REGRESSION";
+  if(comparison.high < 0 && change < -threshold)
+    return "improvement";
+  return "";
+}
+
+int main(int argc, char** argv)
+{
+  arg_option options[] = {
+    OPT_BOOLEAN('h', "help",            NULL),
+    OPT_STRING ('b', "baseline",        NULL),
+    OPT_STRING ('c', "candidate",       NULL),
+    OPT_STRING ('p', "baseline-power",  NULL),
+    OPT_STRING ('q', "candidate-power", NULL),
+    OPT_FLOAT  ('t', "threshold",       NULL),
+    OPT_FLOAT  ('a', "alpha",           NULL),
+    OPT_INTEGER('s', "skip",            NULL),
+    OPT_INTEGER('r', "resamples",       NULL),
+    OPT_STRING ('g', "gate",            NULL),
+    OPT_STRING ('o', "output",          NULL),
+  };
+
+  command_line cmd = { options, 11 };
+  parse_command_line(&cmd, argc, argv);
+
+  const char* baselinePath = (const char*) get_option_value(&cmd, "baseline");
+  const char* candidatePath = (const char*) get_option_value(&cmd, "candidate");
+  if(get_option_value(&cmd, "help") || !baselinePath || !candidatePath)
+  {
+    const bool help = get_option_value(&cmd, "help") != NULL;
+    free_command_line(&cmd);
+    usage();
+    exit(help ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  float* number = (float*) get_option_value(&cmd, "threshold");
+  const double threshold = (number && *number >= 0) ? *number : 5.0;
+  number = (float*) get_option_value(&cmd, "alpha");
+  const double alpha = (number && *number > 0 && *number < 1) ? *number : 0.01;
+  int* value = (int*) get_option_value(&cmd, "skip");
+  const uint64_t skip = (value && *value > 0) ? *value : 0;
+  value = (int*) get_option_value(&cmd, "resamples");
+  const uint32_t resamples = (value && *value > 0) ? *value : 10000;
+
+  const char* gate = (const char*) get_option_value(&cmd, "gate");
+  const bool gateLayers = gate && strcmp(gate, "all") == 0;
+  if(gate && !gateLayers && strcmp(gate, "total") != 0)
+  {
+    printf(ERROR "Unexpected gate %s. Use total or all.\n", gate);
+    free_command_line(&cmd);
+    exit(EXIT_FAILURE);
+  }
+
+  RunData baseline;
+  RunData candidate;
+  if(!loadRun(baselinePath, (const char*) get_option_value(&cmd, "baseline-power"), skip, baseline) ||
+     !loadRun(candidatePath, (const char*) get_option_value(&cmd, "candidate-power"), skip, candidate))
+  {
+    free_command_line(&cmd);
+    exit(EXIT_FAILURE);
+  }
+
+  const char* outputPath = (const char*) get_option_value(&cmd, "output");
+  FILE* output = outputPath ? fopen(outputPath, "w") : NULL;
+  if(outputPath && !output)
+  {
+    printf(ERROR "Unable to open file %s.\n", outputPath);
+    free_command_line(&cmd);
+    exit(EXIT_FAILURE);
+  }
+  free_command_line(&cmd);
+
+  profiling::MedianBootstrap bootstrap;
+  std::vector<Comparison> comparisons;
+
+  if(!baseline.latencies.empty() && !candidate.latencies.empty())
+    comparisons.push_back(compare(LATENCY_NAME, true, baseline.latencies, candidate.latencies, resamples, bootstrap));
+  if(!baseline.energies.empty() && !candidate.energies.empty())
+    comparisons.push_back(compare(ENERGY_NAME, true, baseline.energies, candidate.energies, resamples, bootstrap));
+
+  std::vector<std::string> missing;
+  for(size_t n = 0; n < baseline.layerOrder.size(); n++)
+  {
+    const std::string& name = baseline.layerOrder[n];
+    std::map<std::string, std::vector<double> >::iterator found = candidate.layers.find(name);
+
+    if(found == candidate.layers.end())
+      missing.push_back("only in the baseline: " + name);
+    else
+      comparisons.push_back(compare(name, false, baseline.layers[name], found->second, resamples, bootstrap));
+  }
+
+  for(size_t n = 0; n < candidate.layerOrder.size(); n++)
+  {
+    if(baseline.layers.find(candidate.layerOrder[n]) == baseline.layers.end())
+      missing.push_back("only in the candidate: " + candidate.layerOrder[n]);
+  }
+
+  // the measures are tested together
+  std::vector<double> pValues;
+  for(size_t n = 0; n < comparisons.size(); n++)
+    pValues.push_back(comparisons[n].p);
+  profiling::holmBonferroni(pValues);
+  for(size_t n = 0; n < comparisons.size(); n++)
+    comparisons[n].p = pValues[n];
+
+  // totals first, then the layers that changed the most
+  std::stable_sort(comparisons.begin(), comparisons.end(), [](const Comparison& a, const Comparison& b) {
+    if(a.total != b.total)
+      return a.total;
+    return fabs(a.candidate - a.baseline) > fabs(b.candidate - b.baseline);
+  });
+
+  uint32_t regressions = 0;
+  uint32_t gated = 0;
+
+  if(output)
+    fprintf(output, "name;baseline_count;candidate_count;baseline_median;candidate_median;delta;delta_percent;ci_low;ci_high;p_adjusted;z;verdict\n");
+  else
+    printf("%-40s %9s %9s %11s %11s %10s %8s %23s %9s  %s\n", "measure", "n (base)", "n (cand)", "baseline", "candidate",
+           "delta", "delta %", "95% ci of delta", "p (adj)", "verdict");
+
+  for(size_t n = 0; n < comparisons.size(); n++)
+  {
+    const Comparison& comparison = comparisons[n];
+    const double delta = comparison.candidate - comparison.baseline;
+    const char* verdict = getVerdict(comparison, alpha, threshold);
+
+    if(strcmp(verdict, "REGRESSION") == 0)
+    {
+      regressions++;
+      if(comparison.total || gateLayers)
+        gated++;
+    }
+
+    if(output)
+    {
+      fprintf(output, "%s;%zu;%zu;%f;%f;%f;%f;%f;%f;%g;%f;%s\n", comparison.name.c_str(), comparison.baselineCount,
+              comparison.candidateCount, comparison.baseline, comparison.candidate, delta, relative(delta, comparison.baseline),
+              comparison.low, comparison.high, comparison.p, comparison.z, verdict);
+      continue;
+    }
+
+    std::string name = comparison.name;
+    if(name.size() > 40)
+      name = "..." + name.substr(name.size() - 37);
+
+    char interval[64];
+    snprintf(interval, sizeof(interval), "[%.4f, %.4f]", comparison.low, comparison.high);
+
+    printf("%-40s %9zu %9zu %11.4f %11.4f %+10.4f %+7.2f%% %23s %9.2g  %s\n", name.c_str(), comparison.baselineCount,
+           comparison.candidateCount, comparison.baseline, comparison.candidate, delta, relative(delta, comparison.baseline),
+           interval, comparison.p, verdict);
+  }
+
+  if(output)
+    fclose(output);
+
+  for(size_t n = 0; n < missing.size(); n++)
+    printf(WARNING "%s\n", missing[n].c_str());
+
+  printf(INFO "%zu measures compared, %u regressions above %.1f%% (alpha %.3g), %u gated.\n", comparisons.size(), regressions,
+         threshold, alpha, gated);
+
+  return gated > 0 ? REGRESSION_EXIT_CODE : EXIT_SUCCESS;
+}
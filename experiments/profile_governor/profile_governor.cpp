@@ -0,0 +1,545 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <jetson-utils/commandLine.h>
+#include <jetson-utils/loadImage.h>
+
+#include <profiling/argparse.h>
+#include <profiling/control.h>
+#include <profiling/frequency.h>
+#include <profiling/hdrHistogram.h>
+#include <profiling/thermal.h>
+#include "myImageNet.h"
+#include "multiStream.h"
+#include "pipeline.h"
+#include "energy.h"
+#include "power_command.h"
+#include <profiling/logger.h>
+
+#define GOVERNOR_USAGE_STRING "Usage of profile governor: \n"\
+                              "./profile_governor --image=IMAGE [--backend=BACKEND] [--model=MODEL] [--precision=PRECISION]\n"\
+                              "                   [--batch=SIZE] [--runs=RUNS] [--warmup=RUNS] [--domains=DOMAINS] [--steps=STEPS]\n"\
+                              "                   [--settle=SECONDS] [--sysfs=PATH] [--power=CAPTURE] [--socket=SOCKET] [--slo=MS]\n"\
+                              "                   [--output=OUTPUT] [--help]\n"\
+                              "Caps the CPU (cpufreq) and GPU (devfreq) clocks at every combination of their frequencies,\n"\
+                              "classifies an image at each operating point and writes its latency, power, energy and\n"\
+                              "energy-delay product, then prints the latency/energy Pareto front. Needs root to write\n"\
+                              "the caps, which are restored on exit, SIGINT and SIGTERM (the power capture is stopped too).\n"\
+                              "Arguments: \n"\
+                              "--image     | -i   Image classified at every operating point.\n"\
+                              "--backend   | -b   tensorrt or cpu. Defaults to tensorrt when it is built.\n"\
+                              "--model     | -m   Network name, or graph file with the cpu backend. Defaults to the backend's.\n"\
+                              "--precision | -p   fp32, fp16 or int8 engine.\n"\
+                              "--batch     | -B   Images of each classification. Defaults to 1.\n"\
+                              "--runs      | -r   Classifications measured at each operating point. Defaults to 200.\n"\
+                              "--warmup    | -w   Classifications before measuring. Defaults to 20.\n"\
+                              "--domains   | -d   Comma separated clocks to step: cpu (every cpufreq policy) and devfreq\n"\
+                              "                   device names. Defaults to all of them.\n"\
+                              "--steps     | -s   Frequencies of each domain, evenly spread over the available ones\n"\
+                              "                   and always including the highest. Defaults to 4, 0 for all.\n"\
+                              "--settle    | -S   Seconds between setting the caps and the warmup. Defaults to 2.\n"\
+                              "--sysfs     | -y   Root of the clocks, /sys by default (a fake tree to try it).\n"\
+                              "--power     | -P   Capture the power in CAPTURE with the power profiler service, for the energy.\n"\
+                              "--socket    | -c   Control socket of the power profiler.\n"\
+                              "--slo       | -l   p99 latency budget in ms of the energy-delay optimum.\n"\
+                              "--output    | -o   The operating points (;-separated). Defaults to governor_results.csv.\n"\
+                              "--help      | -h   Show the help message.\n\n"
+
+#define usage() printf(GOVERNOR_USAGE_STRING)
+
+// clocks stepped together: every cpufreq policy, or a devfreq device
+struct ClockGroup
+{
+  std::string name;
+  std::vector<profiling::FrequencyDomain> domains;
+  std::vector<std::vector<int64_t> > available;  // kHz of each domain
+  std::vector<int64_t> steps;                     // caps, from the first domain
+};
+
+// measures of an operating point
+struct OperatingPoint
+{
+  std::vector<int64_t> caps;   // kHz of each group
+  double cpuMhz;               // lowest clocks at the end of the block, -1 if unknown
+  double devfreqMhz;
+  uint64_t images;
+  double mean;                 // ms, latency of a classification
+  double p50;
+  double p99;
+  double throughput;           // images/s
+  double start;                // s since the epoch
+  double end;
+  double energy;               // J, -1 without power capture
+  double joulesPerImage;
+  double power;                // W
+  double edp;                  // J.s, energy of an image times the mean latency
+  bool pareto;
+};
+
+// power profiler of the running capture, stopped by the signal handler of the caps
+static sockaddr_un gCaptureAddress;
+
+static void stopCapture()
+{
+  // async-signal-safe calls only, the command is preformatted
+  static const char command[] = "stop\n";
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(fd < 0)
+    return;
+
+  if(connect(fd, (sockaddr*)&gCaptureAddress, sizeof(gCaptureAddress)) == 0 &&
+     send(fd, command, sizeof(command) - 1, MSG_NOSIGNAL) == (ssize_t)(sizeof(command) - 1))
+  {
+    // the capture is closed once the profiler replied
+    pollfd reply = { fd, POLLIN, 0 };
+    char buffer[64];
+    if(poll(&reply, 1, 1000) > 0)
+    {
+      const ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+      (void)size;
+    }
+  }
+  close(fd);
+}
+
+// `count` frequencies evenly spread over the available ones, with the highest
+std::vector<int64_t> pickSteps(const std::vector<int64_t>& available, uint32_t count)
+{
+  if(count == 0 || count >= available.size())
+    return available;
+
+  std::vector<int64_t> steps;
+  for(uint32_t n = 0; n < count; n++)
+  {
+    const size_t index = count > 1 ? (available.size() - 1) * n / (count - 1) : available.size() - 1;
+    steps.push_back(available[index]);
+  }
+  steps.erase(std::unique(steps.begin(), steps.end()), steps.end());
+  return steps;
+}
+
+// Highest available frequency under the cap, the lowest one if they are all above
+int64_t fitCap(const std::vector<int64_t>& available, int64_t cap)
+{
+  int64_t fit = available.front();
+  for(size_t i = 0; i < available.size(); i++)
+  {
+    if(available[i] <= cap)
+      fit = available[i];
+  }
+  return fit;
+}
+
+bool findGroups(const profiling::ThermalMonitor& monitor, const char* selection, uint32_t steps, std::vector<ClockGroup>& groups)
+{
+  const std::vector<profiling::FrequencyDomain>& domains = monitor.getDomains();
+  const std::string names = selection ? std::string(",") + selection + "," : "";
+
+  ClockGroup cpu;
+  cpu.name = "cpu";
+
+  for(size_t i = 0; i < domains.size(); i++)
+  {
+    const std::string name = domains[i].devfreq ? domains[i].name : "cpu";
+    if(!names.empty() && names.find("," + name + ",") == std::string::npos)
+      continue;
+
+    std::vector<int64_t> available;
+    if(!profiling::getAvailableFrequencies(domains[i], available, 8))
+    {
+      printf(WARNING "No available frequencies for %s, it isn't stepped.\n", domains[i].name.c_str());
+      continue;
+    }
+
+    if(!domains[i].devfreq)
+    {
+      cpu.domains.push_back(domains[i]);
+      cpu.available.push_back(available);
+      continue;
+    }
+
+    ClockGroup group;
+    group.name = domains[i].name;
+    group.domains.push_back(domains[i]);
+    group.available.push_back(available);
+    group.steps = pickSteps(available, steps);
+    groups.push_back(group);
+  }
+
+  if(!cpu.domains.empty())
+  {
+    cpu.steps = pickSteps(cpu.available[0], steps);
+    groups.insert(groups.begin(), cpu);
+  }
+
+  return !groups.empty();
+}
+
+bool setCaps(profiling::FrequencyController& controller, const std::vector<ClockGroup>& groups, const std::vector<int64_t>& caps)
+{
+  for(size_t g = 0; g < groups.size(); g++)
+  {
+    for(size_t d = 0; d < groups[g].domains.size(); d++)
+    {
+      if(!controller.setMaxFrequency(groups[g].domains[d], fitCap(groups[g].available[d], caps[g])))
+        return false;
+    }
+  }
+  return true;
+}
+
+// Mark the points no other point beats on both latency and energy
+void findParetoFront(std::vector<OperatingPoint>& points)
+{
+  for(size_t i = 0; i < points.size(); i++)
+  {
+    points[i].pareto = points[i].energy >= 0;
+
+    for(size_t j = 0; j < points.size() && points[i].pareto; j++)
+    {
+      if(j == i || points[j].energy < 0)
+        continue;
+
+      const bool noWorse = points[j].mean <= points[i].mean && points[j].joulesPerImage <= points[i].joulesPerImage;
+      const bool better = points[j].mean < points[i].mean || points[j].joulesPerImage < points[i].joulesPerImage;
+      if(noWorse && better)
+        points[i].pareto = false;
+    }
+  }
+}
+
+void printPoints(FILE* file, const std::vector<ClockGroup>& groups, const std::vector<OperatingPoint>& points)
+{
+  for(size_t g = 0; g < groups.size(); g++)
+    fprintf(file, "%s_cap_mhz;", groups[g].name.c_str());
+  fprintf(file, "cpu_mhz;devfreq_mhz;images;latency_mean_ms;latency_p50_ms;latency_p99_ms;images_per_s;power_w;energy_j;"
+                "joules_per_image;edp_js;pareto\n");
+
+  for(size_t i = 0; i < points.size(); i++)
+  {
+    const OperatingPoint& point = points[i];
+    for(size_t g = 0; g < point.caps.size(); g++)
+      fprintf(file, "%.0f;", point.caps[g] / 1000.0);
+
+    fprintf(file, "%.0f;%.0f;%llu;%.3f;%.3f;%.3f;%.2f;", point.cpuMhz, point.devfreqMhz, (unsigned long long)point.images,
+            point.mean, point.p50, point.p99, point.throughput);
+
+    if(point.energy >= 0)
+      fprintf(file, "%.3f;%.4f;%.6f;%.9f;%d\n", point.power, point.energy, point.joulesPerImage, point.edp, point.pareto ? 1 : 0);
+    else
+      fprintf(file, ";;;;\n");
+  }
+}
+
+int main(int argc, char** argv)
+{
+  arg_option options[] = {
+    OPT_BOOLEAN('h', "help",      NULL),
+    OPT_STRING ('i', "image",     NULL),
+    OPT_STRING ('b', "backend",   NULL),
+    OPT_STRING ('m', "model",     NULL),
+    OPT_STRING ('p', "precision", NULL),
+    OPT_INTEGER('B', "batch",     NULL),
+    OPT_INTEGER('r', "runs",      NULL),
+    OPT_INTEGER('w', "warmup",    NULL),
+    OPT_STRING ('d', "domains",   NULL),
+    OPT_INTEGER('s', "steps",     NULL),
+    OPT_FLOAT  ('S', "settle",    NULL),
+    OPT_STRING ('y', "sysfs",     NULL),
+    OPT_STRING ('P', "power",     NULL),
+    OPT_STRING ('c', "socket",    NULL),
+    OPT_FLOAT  ('l', "slo",       NULL),
+    OPT_STRING ('o', "output",    NULL),
+  };
+
+  command_line cmd = { options, 16 };
+  parse_command_line(&cmd, argc, argv);
+
+  const char* value = (const char*) get_option_value(&cmd, "image");
+  if(get_option_value(&cmd, "help") || !value)
+  {
+    free_command_line(&cmd);
+    usage();
+    exit(value ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  // the values are freed with the command line
+  const std::string imagePath = value;
+  value = (const char*) get_option_value(&cmd, "backend");
+  const std::string backend = value ? value : "";
+  value = (const char*) get_option_value(&cmd, "model");
+  const std::string model = value ? value : "";
+  value = (const char*) get_option_value(&cmd, "precision");
+  const std::string precision = value ? value : "";
+  value = (const char*) get_option_value(&cmd, "domains");
+  const std::string domains = value ? value : "";
+  value = (const char*) get_option_value(&cmd, "sysfs");
+  const std::string sysfs = value ? value : "/sys";
+  value = (const char*) get_option_value(&cmd, "power");
+  std::string powerPath = value ? value : "";
+  value = (const char*) get_option_value(&cmd, "socket");
+  const std::string socket = value ? value : POWER_CONTROL_SOCKET;
+  value = (const char*) get_option_value(&cmd, "output");
+  const std::string outputPath = value ? value : "governor_results.csv";
+
+  int* integer = (int*) get_option_value(&cmd, "batch");
+  const uint32_t batchSize = (integer && *integer > 0) ? *integer : 1;
+  integer = (int*) get_option_value(&cmd, "runs");
+  const uint32_t runs = (integer && *integer > 0) ? *integer : 200;
+  integer = (int*) get_option_value(&cmd, "warmup");
+  const uint32_t warmup = (integer && *integer >= 0) ? *integer : 20;
+  integer = (int*) get_option_value(&cmd, "steps");
+  const uint32_t stepCount = (integer && *integer >= 0) ? *integer : 4;
+
+  float* real = (float*) get_option_value(&cmd, "settle");
+  const double settle = (real && *real >= 0) ? *real : 2.0;
+  real = (float*) get_option_value(&cmd, "slo");
+  const double slo = real ? *real : 0.0;
+  free_command_line(&cmd);
+
+  profiling::ThermalMonitor monitor(sysfs.c_str());
+  std::vector<ClockGroup> groups;
+
+  if(!monitor.discover() || !findGroups(monitor, domains.empty() ? NULL : domains.c_str(), stepCount, groups))
+  {
+    printf(ERROR "No clocks to step under %s.\n", sysfs.c_str());
+    return EXIT_FAILURE;
+  }
+
+  size_t pointCount = 1;
+  for(size_t g = 0; g < groups.size(); g++)
+  {
+    pointCount *= groups[g].steps.size();
+    printf(INFO "%s: %zu caps from %.0f to %.0f MHz\n", groups[g].name.c_str(), groups[g].steps.size(),
+           groups[g].steps.front() / 1000.0, groups[g].steps.back() / 1000.0);
+  }
+
+  // the network, with the options of recognition
+  std::vector<std::string> args;
+  args.push_back("profile_governor");
+  if(!backend.empty())
+    args.push_back("--backend=" + backend);
+  if(!model.empty())
+    args.push_back((backend == "cpu" ? "--graph=" : "--network=") + model);
+  if(!precision.empty())
+    args.push_back("--precision=" + precision);
+
+  std::vector<char*> netArgv;
+  for(size_t i = 0; i < args.size(); i++)
+    netArgv.push_back(&args[i][0]);
+  netArgv.push_back(NULL);
+
+  commandLine cmdLine(args.size(), netArgv.data());
+  std::vector<profiling::ImageNet*> nets;
+  profiling::ImageNet* net = profiling::ImageNet::Create(cmdLine, batchSize);
+  if(!net)
+    return EXIT_FAILURE;
+  nets.push_back(net);
+
+  // the phases of each classification aren't kept
+  file_profiler_t::setFile("/dev/null");
+
+  uchar3* image = NULL;
+  int width = 0;
+  int height = 0;
+
+  if(!loadImage(imagePath.c_str(), &image, &width, &height))
+  {
+    delete net;
+    return EXIT_FAILURE;
+  }
+
+  // one capture for all the operating points, the daemon doesn't share our working directory
+  bool capturing = false;
+  if(!powerPath.empty())
+  {
+    char cwd[4096];
+    if(powerPath[0] != '/' && getcwd(cwd, sizeof(cwd)))
+      powerPath = std::string(cwd) + "/" + powerPath;
+
+    // the handlers are in place before the capture starts, a signal stops it
+    memset(&gCaptureAddress, 0, sizeof(gCaptureAddress));
+    gCaptureAddress.sun_family = AF_UNIX;
+    strncpy(gCaptureAddress.sun_path, socket.c_str(), sizeof(gCaptureAddress.sun_path) - 1);
+    profiling::FrequencyController::setSignalCleanup(stopCapture);
+
+    capturing = powerCommand(socket, "start " + powerPath);
+    if(!capturing)
+      profiling::FrequencyController::setSignalCleanup(NULL);
+  }
+
+  profiling::FrequencyController controller;
+  profiling::MultiStream multiStream(nets);
+  std::vector<OperatingPoint> points;
+  std::vector<size_t> index(groups.size(), 0);
+
+  printf(INFO "Measuring %zu operating points, %u runs each.\n", pointCount, runs);
+
+  for(size_t n = 0; n < pointCount; n++)
+  {
+    // next combination, the last group stepping fastest
+    if(n > 0)
+    {
+      for(size_t g = groups.size(); g-- > 0; )
+      {
+        if(++index[g] < groups[g].steps.size())
+          break;
+        index[g] = 0;
+      }
+    }
+
+    OperatingPoint point;
+    std::string name;
+    for(size_t g = 0; g < groups.size(); g++)
+    {
+      point.caps.push_back(groups[g].steps[index[g]]);
+      name += (g > 0 ? "/" : "") + groups[g].name + "@" + std::to_string((point.caps.back() + 500) / 1000);
+    }
+
+    if(!setCaps(controller, groups, point.caps))
+    {
+      printf(ERROR "Unable to set the caps of %s, stopping.\n", name.c_str());
+      break;
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(settle));
+
+    profiling::MultiStream::Run run;
+    if(warmup > 0)
+      multiStream.run(1, image, width, height, warmup, "warmup/stream", run, batchSize);
+
+    if(capturing)
+      powerCommand(socket, "mark " + name + "/start");
+
+    point.start = realtimeSeconds();
+    const bool success = multiStream.run(1, image, width, height, runs, (name + "/stream").c_str(), run, batchSize);
+    point.end = realtimeSeconds();
+
+    if(capturing)
+      powerCommand(socket, "mark " + name + "/end");
+
+    if(!success)
+    {
+      printf(ERROR "Nothing classified at %s.\n", name.c_str());
+      continue;
+    }
+
+    // the clocks the caps gave under load
+    profiling::ThermalState state;
+    monitor.read(state);
+    point.cpuMhz = state.getMinFrequency(monitor.getDomains(), false);
+    point.devfreqMhz = state.getMinFrequency(monitor.getDomains(), true);
+
+    profiling::HdrHistogram latency;
+    const std::vector<double>& latencies = run.streams[0].latencies;
+    for(size_t i = 0; i < latencies.size(); i++)
+      latency.record((uint64_t)(latencies[i] * 1e6));
+
+    point.images = run.getClassified() * batchSize;
+    point.mean = latency.getMean() * 1e-6;
+    point.p50 = latency.getValueAtPercentile(50.0) * 1e-6;
+    point.p99 = latency.getValueAtPercentile(99.0) * 1e-6;
+    point.throughput = run.getThroughput();
+    point.energy = -1;
+    point.joulesPerImage = -1;
+    point.power = -1;
+    point.edp = -1;
+    point.pareto = false;
+    points.push_back(point);
+
+    printf(INFO "%s: %.2f images/s, p50 %.3f ms, p99 %.3f ms\n", name.c_str(), point.throughput, point.p50, point.p99);
+  }
+
+  // back to the original clocks before anything else
+  profiling::FrequencyController::setSignalCleanup(NULL);
+  controller.restore();
+  profiling::releaseImage(image);
+  delete net;
+
+  if(capturing && powerCommand(socket, "stop"))
+  {
+    PowerTrace trace;
+    if(trace.load(powerPath) && trace.getCount() > 1)
+    {
+      for(size_t i = 0; i < points.size(); i++)
+      {
+        OperatingPoint& point = points[i];
+        point.energy = trace.getEnergy(point.start, point.end);
+        point.power = point.end > point.start ? point.energy / (point.end - point.start) : 0.0;
+        point.joulesPerImage = point.images > 0 ? point.energy / point.images : 0.0;
+        point.edp = point.joulesPerImage * point.mean * 0.001;
+      }
+    }
+    else
+      printf(WARNING "No power samples in %s.\n", powerPath.c_str());
+  }
+
+  findParetoFront(points);
+
+  FILE* output = fopen(outputPath.c_str(), "w");
+  if(!output)
+  {
+    printf(ERROR "Unable to open %s.\n", outputPath.c_str());
+    return EXIT_FAILURE;
+  }
+  printPoints(output, groups, points);
+  fclose(output);
+
+  printf(INFO "Wrote %zu operating points to %s.\n", points.size(), outputPath.c_str());
+
+  if(points.empty() || points[0].energy < 0)
+  {
+    if(!points.empty())
+      printf(WARNING "No energy without --power, the Pareto front isn't computed.\n");
+    return points.empty() ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  // the front by increasing latency, and the energy-delay optimum within the budget
+  std::vector<const OperatingPoint*> front;
+  const OperatingPoint* optimum = NULL;
+
+  for(size_t i = 0; i < points.size(); i++)
+  {
+    if(points[i].pareto)
+      front.push_back(&points[i]);
+    if((slo <= 0 || points[i].p99 <= slo) && (!optimum || points[i].edp < optimum->edp))
+      optimum = &points[i];
+  }
+
+  std::sort(front.begin(), front.end(), [](const OperatingPoint* a, const OperatingPoint* b) { return a->mean < b->mean; });
+
+  printf("\nPareto front (latency / energy):\n");
+  for(size_t g = 0; g < groups.size(); g++)
+    printf("%14s", (groups[g].name.substr(0, 9) + " MHz").c_str());
+  printf("%14s%14s%14s%14s\n", "mean (ms)", "p99 (ms)", "mJ/image", "power (W)");
+
+  for(size_t i = 0; i < front.size(); i++)
+  {
+    for(size_t g = 0; g < front[i]->caps.size(); g++)
+      printf("%14.0f", front[i]->caps[g] / 1000.0);
+    printf("%14.3f%14.3f%14.3f%14.3f\n", front[i]->mean, front[i]->p99, front[i]->joulesPerImage * 1000.0, front[i]->power);
+  }
+
+  if(optimum)
+  {
+    printf("\nLowest energy-delay product%s:", slo > 0 ? " within the p99 budget" : "");
+    for(size_t g = 0; g < groups.size(); g++)
+      printf(" %s %.0f MHz", groups[g].name.c_str(), optimum->caps[g] / 1000.0);
+    printf(", %.3f mJ/image at %.3f ms\n", optimum->joulesPerImage * 1000.0, optimum->mean);
+  }
+  else
+    printf(WARNING "No operating point meets the p99 budget of %.3f ms.\n", slo);
+
+  return EXIT_SUCCESS;
+}
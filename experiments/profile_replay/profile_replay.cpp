@@ -0,0 +1,562 @@
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <profiling/argparse.h>
+#include <profiling/hdrHistogram.h>
+#include <profiling/metrics.h>
+#include <profiling/profiler.h>
+#include <profiling/stream.h>
+#include "capture.h"
+#include "power_metrics.h"
+#include "rollup.h"
+#include "power_profiling.h"
+#include "replaySource.h"
+#include <profiling/logger.h>
+
+#define REPLAY_USAGE_STRING "Usage of profile replay: \n"\
+                            "./profile_replay [--power=CAPTURE] [--trace=TRACE] [--speed=SPEED] [--loop=COUNT] [--rebase]\n"\
+                            "                 [--delay=SECONDS] [--output=OUTPUT] [--rollup=PATH] [--rollup-tiers=TIERS]\n"\
+                            "                 [--stream=PATH] [--trace-output=OUTPUT] [--layer-stream=PATH] [--metrics=ADDRESS] [--help]\n"\
+                            "Replays a recorded power capture and profiler output through the outputs of power_profiler and\n"\
+                            "recognition, with the recorded time between the records, so dashboards and exporters can be\n"\
+                            "developed without a board. Prints the time spent in each output, to benchmark them.\n"\
+                            "Arguments: \n"\
+                            "--power        | -p      Power capture (power_output.csv) or column store with a power table (.pcs).\n"\
+                            "--trace        | -t      Profiler output (layer_out.csv). The layer lines are replayed at the START\n"\
+                            "                         of the timed line after them, the start of their inference.\n"\
+                            "--speed        | -x      Replay speed, 2 for twice as fast. 0 for as fast as possible. Defaults to 1.\n"\
+                            "--loop         | -l      Replay the recording COUNT times, one after the other. Defaults to 1.\n"\
+                            "--rebase       | -R      Shift the timestamps so the recording starts now.\n"\
+                            "--delay        | -d      Seconds to wait before the replay, for the subscribers to connect. Defaults to 0.\n"\
+                            "Outputs: \n"\
+                            "--output       | -o      Power capture written like power_profiler's.\n"\
+                            "--rollup       | -u      Rollups of the power in the fixed size file PATH.\n"\
+                            "--rollup-tiers | -T      Rollup tiers as WIDTH_SEC:BUCKETS,... Defaults to " ROLLUP_DEFAULT_TIERS ".\n"\
+                            "--stream       | -s      Stream the power samples to the subscribers of the unix socket PATH.\n"\
+                            "--trace-output | -O      Profiler output written like recognition's.\n"\
+                            "--layer-stream | -L      Stream the layer, inference and phase times to the unix socket PATH.\n"\
+                            "--metrics      | -m      Serve the power and latency metrics on HOST:PORT, :PORT or unix:PATH.\n"\
+                            "--help         | -h      Show the help message.\n\n"
+
+#define usage() printf(REPLAY_USAGE_STRING)
+
+// time the stream servers get to send their last frames
+#define STREAM_DRAIN_US 200000
+
+volatile sig_atomic_t shutdownFlag = 0;
+void sigintHandler(int sig)
+{
+  shutdownFlag = sig;
+}
+
+int64_t monotonicNs()
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Records given to an output and the time the replay spent in it
+struct SinkTimer
+{
+  SinkTimer(const char* name) : name(name), records(0), ns(0), start(0) {}
+
+  inline void begin() { start = monotonicNs(); }
+  inline void end() { ns += monotonicNs() - start; records++; }
+
+  const char* name;
+  uint64_t records;
+  int64_t ns;
+  int64_t start;
+};
+
+// Rail id of a capture, from the name the INA3221 gives it
+int getRailFromName(const std::string& name)
+{
+  if(strcasestr(name.c_str(), "gpu"))
+    return GPU_RAIL;
+  if(strcasestr(name.c_str(), "cpu"))
+    return CPU_RAIL;
+  return BOARD_RAIL;
+}
+
+std::string railValueToString(int32_t value)
+{
+  return value >= 0 ? std::to_string(value) : std::string();
+}
+
+// Phases of a `phases` line after its START: ; NAME; OFFSET; CPU; DEVICE; ...
+bool parsePhases(const char* p, const char* end, std::vector<std::string>& names, std::vector<profiling::PhaseRecord>& phases)
+{
+  names.clear();
+  phases.clear();
+
+  while(p < end && *p == ';')
+  {
+    p++;
+    while(p < end && *p == ' ')
+      p++;
+
+    const char* name = p;
+    p = (const char*)memchr(p, ';', end - p);
+    if(!p)
+      return false;
+    names.push_back(std::string(name, p));
+
+    double values[3];
+    for(int n = 0; n < 3; n++)
+    {
+      if(p >= end || *p != ';')
+        return false;
+      p++;
+      if(!profiling::parseDecimal(p, end, values[n]))
+        return false;
+    }
+
+    profiling::PhaseRecord phase = { NULL, values[0], (float)values[1], (float)values[2] };
+    phases.push_back(phase);
+  }
+
+  // the names don't move anymore
+  for(size_t i = 0; i < phases.size(); i++)
+    phases[i].name = names[i].c_str();
+  return !phases.empty();
+}
+
+/*
+* Writes a line of the profiler output through the Profiler, so it also reaches its metrics
+* and layer stream. `shift` is added to the timestamps, in ms.
+*/
+class TraceWriter
+{
+public:
+  void write(const ReplayEvent& event, double shift)
+  {
+    const profiling::TraceRecord& record = event.record;
+    const double start = event.start + shift;
+
+    // the names of the timed lines are written by the Profiler with the session prefix
+    if(record.sessionLength > 0)
+      setSession(std::string(record.name, record.sessionLength));
+    else
+      setSession(std::string());
+
+    const char* fieldsEnd = NULL;
+    double recorded;
+
+    switch(record.type)
+    {
+      case profiling::TRACE_LAYER:
+        mName.assign(record.name, record.nameLength);
+        profiling::Profiler::writeLayerTime(mName.c_str(), (float)record.values[0]);
+        break;
+
+      case profiling::TRACE_MODEL_TOTAL:
+        profiling::Profiler::writeInferenceTime(start, record.values[0]);
+        break;
+
+      case profiling::TRACE_BATCH_TOTAL:
+        profiling::Profiler::writeBatchTime((uint32_t)record.values[0], start, record.values[1]);
+        break;
+
+      case profiling::TRACE_PHASES:
+        TraceSource::getStart(record, recorded, &fieldsEnd);
+        if(parsePhases(fieldsEnd, record.end, mPhaseNames, mPhases))
+        {
+          profiling::Profiler::writePhaseTimes(start, &mPhases[0], (int)mPhases.size());
+          break;
+        }
+        writeLine(record);
+        break;
+
+      case profiling::TRACE_COUNTERS:
+      case profiling::TRACE_MEMORY:
+        // only the START is rewritten
+        TraceSource::getStart(record, recorded, &fieldsEnd);
+        fprintf(profiling::Profiler::getFile(), "%.*s; %f%.*s\n", (int)record.nameLength, record.name, start,
+                (int)(record.end - fieldsEnd), fieldsEnd);
+        break;
+
+      default:
+        writeLine(record);
+        break;
+    }
+  }
+
+private:
+  void setSession(const std::string& session)
+  {
+    if(session == mSession)
+      return;
+    mSession = session;
+    profiling::Profiler::setSession(mSession.empty() ? NULL : mSession.c_str());
+  }
+
+  void writeLine(const profiling::TraceRecord& record)
+  {
+    fprintf(profiling::Profiler::getFile(), "%.*s\n", (int)(record.end - record.name), record.name);
+  }
+
+  std::string mSession;
+  std::string mName;
+  std::vector<std::string> mPhaseNames;
+  std::vector<profiling::PhaseRecord> mPhases;
+};
+
+void printSinks(const std::vector<SinkTimer*>& sinks)
+{
+  printf("\n%-14s %12s %12s %12s %14s\n", "output", "records", "seconds", "ns/record", "records/s");
+  for(size_t i = 0; i < sinks.size(); i++)
+  {
+    const SinkTimer& sink = *sinks[i];
+    if(sink.records == 0)
+      continue;
+
+    printf("%-14s %12llu %12.3f %12.0f %14.0f\n", sink.name, (unsigned long long)sink.records, sink.ns * 1e-9,
+           (double)sink.ns / sink.records, sink.ns > 0 ? sink.records / (sink.ns * 1e-9) : 0.0);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (signal(SIGINT, sigintHandler) == SIG_ERR || signal(SIGTERM, sigintHandler) == SIG_ERR)
+  {
+    printf(ERROR " Signal SIGINT error\n");
+    exit(EXIT_FAILURE);
+  }
+
+  arg_option options[] = {
+    OPT_BOOLEAN('h', "help",         NULL),
+    OPT_STRING ('p', "power",        NULL),
+    OPT_STRING ('t', "trace",        NULL),
+    OPT_FLOAT  ('x', "speed",        NULL),
+    OPT_INTEGER('l', "loop",         NULL),
+    OPT_BOOLEAN('R', "rebase",       NULL),
+    OPT_FLOAT  ('d', "delay",        NULL),
+    OPT_STRING ('o', "output",       NULL),
+    OPT_STRING ('u', "rollup",       NULL),
+    OPT_STRING ('T', "rollup-tiers", NULL),
+    OPT_STRING ('s', "stream",       NULL),
+    OPT_STRING ('O', "trace-output", NULL),
+    OPT_STRING ('L', "layer-stream", NULL),
+    OPT_STRING ('m', "metrics",      NULL),
+  };
+
+  command_line cmd = { options, 14 };
+  parse_command_line(&cmd, argc, argv);
+
+  const char* powerOption = (const char*) get_option_value(&cmd, "power");
+  const char* traceOption = (const char*) get_option_value(&cmd, "trace");
+  if(get_option_value(&cmd, "help") || (!powerOption && !traceOption))
+  {
+    const bool help = get_option_value(&cmd, "help") != NULL;
+    free_command_line(&cmd);
+    usage();
+    exit(help ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  // copied, the command line is freed before the replay
+  const std::string powerPath = powerOption ? powerOption : "";
+  const std::string tracePath = traceOption ? traceOption : "";
+
+  float* real = (float*) get_option_value(&cmd, "speed");
+  const double speed = real ? *real : 1.0;
+  real = (float*) get_option_value(&cmd, "delay");
+  const double delay = real ? *real : 0.0;
+  int* integer = (int*) get_option_value(&cmd, "loop");
+  const int loops = integer ? *integer : 1;
+  const bool rebase = get_option_value(&cmd, "rebase") != NULL;
+
+  std::string outputPath, rollupPath, rollupTiers = ROLLUP_DEFAULT_TIERS, streamPath, traceOutputPath, layerStreamPath, metricsAddress;
+  const char* value = (const char*) get_option_value(&cmd, "output");
+  if(value) outputPath = value;
+  value = (const char*) get_option_value(&cmd, "rollup");
+  if(value) rollupPath = value;
+  value = (const char*) get_option_value(&cmd, "rollup-tiers");
+  if(value) rollupTiers = value;
+  value = (const char*) get_option_value(&cmd, "stream");
+  if(value) streamPath = value;
+  value = (const char*) get_option_value(&cmd, "trace-output");
+  if(value) traceOutputPath = value;
+  value = (const char*) get_option_value(&cmd, "layer-stream");
+  if(value) layerStreamPath = value;
+  value = (const char*) get_option_value(&cmd, "metrics");
+  if(value) metricsAddress = value;
+  free_command_line(&cmd);
+
+  if(speed < 0 || loops < 1)
+  {
+    printf(ERROR "The speed must be positive and the loop count at least 1.\n");
+    return EXIT_FAILURE;
+  }
+
+  // sources
+  PowerSource powerSource;
+  TraceSource traceSource;
+
+  if(!powerPath.empty() && !powerSource.open(powerPath.c_str()))
+  {
+    printf(ERROR "Unable to read the power capture %s.\n", powerPath.c_str());
+    return EXIT_FAILURE;
+  }
+  if(!tracePath.empty() && !traceSource.open(tracePath.c_str()))
+  {
+    printf(ERROR "Unable to read the profiler output %s.\n", tracePath.c_str());
+    return EXIT_FAILURE;
+  }
+
+  const std::string railName = powerSource.getRailName();
+
+  // power outputs, like power_profiler's
+  Capture capture(railName);
+  if(!outputPath.empty() && !capture.open(outputPath))
+  {
+    printf(ERROR "Unable to open file %s.\n", outputPath.c_str());
+    return EXIT_FAILURE;
+  }
+
+  Rollup rollup;
+  if(!rollupPath.empty() && !rollup.open(rollupPath.c_str(), rollupTiers.c_str(), railName))
+  {
+    printf(ERROR "Unable to open rollup file %s.\n", rollupPath.c_str());
+    return EXIT_FAILURE;
+  }
+
+  EnergyCounter energyCounter;
+  PowerMetrics powerMetrics(railName);
+
+  profiling::StreamServer powerStream(profiling::STREAM_POWER_SAMPLE, sizeof(profiling::StreamPowerRecord));
+  if(!streamPath.empty() && !powerStream.start(streamPath.c_str()))
+    printf(WARNING "Unable to start the sample stream on %s.\n", streamPath.c_str());
+
+  // profiler outputs, like recognition's
+  const bool traceSinks = !traceOutputPath.empty() || !layerStreamPath.empty() || !metricsAddress.empty();
+  if(!tracePath.empty() && traceSinks)
+  {
+    profiling::Profiler::setFile(traceOutputPath.empty() ? "/dev/null" : traceOutputPath.c_str());
+    if(!traceOutputPath.empty() && profiling::Profiler::getFileName() != traceOutputPath)
+      return EXIT_FAILURE;
+  }
+
+  profiling::StreamServer layerStream(profiling::STREAM_LAYER_TIME, sizeof(profiling::StreamLayerRecord));
+  if(!layerStreamPath.empty())
+  {
+    if(layerStream.start(layerStreamPath.c_str()))
+      profiling::Profiler::setStream(&layerStream);
+    else
+      printf(WARNING "Unable to start the layer stream on %s.\n", layerStreamPath.c_str());
+  }
+
+  profiling::MetricsServer metricsServer;
+  if(!metricsAddress.empty())
+  {
+    if(!powerPath.empty())
+      metricsServer.addCollector([&powerMetrics](std::string& out) { powerMetrics.render(out); });
+    if(!tracePath.empty())
+    {
+      profiling::Profiler::enableMetrics();
+      metricsServer.addCollector(profiling::Profiler::renderMetrics);
+    }
+    if(!metricsServer.start(metricsAddress.c_str()))
+      printf(WARNING "Unable to start the metrics endpoint on %s.\n", metricsAddress.c_str());
+  }
+
+  SinkTimer captureTimer("capture");
+  SinkTimer rollupTimer("rollup");
+  SinkTimer metricsTimer("power metrics");
+  SinkTimer streamTimer("power stream");
+  SinkTimer profilerTimer("profiler");
+
+  std::vector<SinkTimer*> sinks;
+  sinks.push_back(&captureTimer);
+  sinks.push_back(&rollupTimer);
+  sinks.push_back(&metricsTimer);
+  sinks.push_back(&streamTimer);
+  sinks.push_back(&profilerTimer);
+
+  if(delay > 0)
+  {
+    printf(INFO "Replay in %.1f s.\n", delay);
+    usleep((useconds_t)(delay * 1e6));
+  }
+
+  profiling::StreamPowerRecord record;
+  record.rail = getRailFromName(railName);
+
+  TraceWriter traceWriter;
+  profiling::HdrHistogram lateness;  // ns behind the recorded time between the records
+
+  profiling::CaptureSample sample;
+  ReplayEvent event;
+  uint64_t samples = 0;
+  uint64_t lines = 0;
+  int64_t first = -1;  // ns, first record of the recording
+  int64_t last = 0;
+  int64_t loopOffset = 0;
+
+  timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  const int64_t replayStart = (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+  const int64_t monotonicStart = monotonicNs();
+
+  for(int loop = 0; loop < loops && !shutdownFlag; loop++)
+  {
+    if(loop > 0)
+    {
+      powerSource.rewind();
+      traceSource.rewind();
+    }
+
+    bool hasSample = !powerPath.empty() && powerSource.next(sample);
+    bool hasEvent = !tracePath.empty() && traceSource.next(event);
+    int64_t loopFirst = -1;
+    int64_t loopLast = 0;
+    int64_t sampleFirst = -1;  // power samples of the loop, their period separates the loops
+    int64_t sampleLast = 0;
+    uint64_t loopSamples = 0;
+
+    while((hasSample || hasEvent) && !shutdownFlag)
+    {
+      const bool isSample = hasSample && (!hasEvent || sample.time <= event.time);
+      const int64_t time = isSample ? sample.time : event.time;
+
+      if(first < 0)
+        first = time;
+      if(loopFirst < 0)
+        loopFirst = time;
+      loopLast = time;
+
+      // the replayed time of the record, the loops follow each other
+      const int64_t replayed = time - loopFirst + loopOffset;
+      last = std::max(last, replayed);
+
+      if(speed > 0)
+      {
+        const int64_t due = monotonicStart + (int64_t)(replayed / speed);
+        const timespec deadline = { (time_t)(due / 1000000000LL), (long)(due % 1000000000LL) };
+
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR && !shutdownFlag);
+
+        const int64_t late = monotonicNs() - due;
+        lateness.record(late > 0 ? late : 0);
+      }
+
+      // timestamps written to the outputs
+      const int64_t shifted = (rebase ? replayStart : first) + replayed;
+
+      if(isSample)
+      {
+        const timespec stamp = { (time_t)(shifted / 1000000000LL), (long)(shifted % 1000000000LL) };
+
+        if(capture.isOpen())
+        {
+          const std::string current = railValueToString(sample.current);
+          const std::string voltage = railValueToString(sample.voltage);
+          const std::string power = railValueToString(sample.power);
+
+          captureTimer.begin();
+          capture.write(stamp, current, voltage, power);
+          captureTimer.end();
+        }
+
+        const double energy = energyCounter.add(stamp, sample.power);
+        if(metricsServer.isRunning())
+        {
+          metricsTimer.begin();
+          powerMetrics.update(stamp, sample.current, sample.voltage, sample.power, energy);
+          metricsTimer.end();
+        }
+
+        if(rollup.isOpen() && sample.power >= 0)
+        {
+          rollupTimer.begin();
+          rollup.add(stamp, sample.power, energy);
+          rollupTimer.end();
+        }
+
+        if(powerStream.isRunning())
+        {
+          record.sec = stamp.tv_sec;
+          record.nsec = stamp.tv_nsec;
+          record.current = sample.current;
+          record.voltage = sample.voltage;
+          record.power = sample.power;
+
+          streamTimer.begin();
+          powerStream.publish(&record);
+          streamTimer.end();
+        }
+
+        if(sampleFirst < 0)
+          sampleFirst = sample.time;
+        sampleLast = sample.time;
+        loopSamples++;
+
+        samples++;
+        hasSample = powerSource.next(sample);
+      }
+      else
+      {
+        if(traceSinks)
+        {
+          profilerTimer.begin();
+          traceWriter.write(event, (shifted - time) * 1e-6);
+          profilerTimer.end();
+        }
+
+        lines++;
+        hasEvent = traceSource.next(event);
+      }
+    }
+
+    // the next loop starts one power sample period after this one, right after it without samples
+    const int64_t span = loopFirst >= 0 ? loopLast - loopFirst : 0;
+    loopOffset += span + (loopSamples > 1 ? (sampleLast - sampleFirst) / (int64_t)(loopSamples - 1) : 0);
+  }
+
+  if(shutdownFlag)
+    printf("\nCaught %s!\n", shutdownFlag == SIGTERM ? "SIGTERM" : "SIGINT");
+
+  const double elapsed = (monotonicNs() - monotonicStart) * 1e-9;
+  if(traceSinks)
+    fflush(profiling::Profiler::getFile());
+
+  // let the streams send their last batch
+  if(powerStream.isRunning() || layerStream.isRunning())
+    usleep(STREAM_DRAIN_US);
+
+  const uint64_t records = samples + lines;
+  printf(INFO "Replayed %llu power samples and %llu profiler lines, %.3f s of recording in %.3f s (%.1fx), %.0f records/s.\n",
+         (unsigned long long)samples, (unsigned long long)lines, last * 1e-9, elapsed, elapsed > 0 ? last * 1e-9 / elapsed : 0.0,
+         elapsed > 0 ? records / elapsed : 0.0);
+
+  if(lateness.getCount() > 0)
+    printf(INFO "Behind the recorded time: mean %.3f ms, p99 %.3f ms, max %.3f ms.\n", lateness.getMean() * 1e-6,
+           lateness.getValueAtPercentile(99) * 1e-6, lateness.getMax() * 1e-6);
+
+  printSinks(sinks);
+
+  if(powerStream.isRunning())
+    printf(INFO "Power stream: %llu samples dropped before the server, %llu by slow clients.\n",
+           (unsigned long long)powerStream.getDropped(), (unsigned long long)powerStream.getClientDropped());
+  if(layerStream.isRunning())
+    printf(INFO "Layer stream: %llu records dropped before the server, %llu by slow clients.\n",
+           (unsigned long long)layerStream.getDropped(), (unsigned long long)layerStream.getClientDropped());
+
+  profiling::Profiler::setStream(NULL);
+  metricsServer.stop();
+  layerStream.stop();
+  powerStream.stop();
+  rollup.close();
+  return EXIT_SUCCESS;
+}
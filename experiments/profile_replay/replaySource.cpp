@@ -0,0 +1,169 @@
+#include "replaySource.h"
+
+#include <math.h>
+#include <profiling/logger.h>
+
+PowerSource::PowerSource() : mReader(NULL, NULL), mTable(NULL), mRow(0), mRows(0)
+{
+}
+
+bool PowerSource::open(const char* path)
+{
+  if(profiling::ColumnStore::isColumnStore(path))
+  {
+    if(!mStore.open(path))
+      return false;
+
+    mTable = mStore.getTable(STORE_POWER_TABLE);
+    if(!mTable)
+    {
+      printf(ERROR "%s has no %s table.\n", path, STORE_POWER_TABLE);
+      return false;
+    }
+
+    const char* names[] = { "time", "current", "voltage", "power" };
+    for(int n = 0; n < 4; n++)
+    {
+      if(mTable->getColumnIndex(names[n]) < 0)
+      {
+        printf(ERROR "%s has no %s column.\n", path, names[n]);
+        return false;
+      }
+    }
+
+    mRailName = "rail";
+    rewind();
+    return true;
+  }
+
+  if(!mFile.open(path))
+    return false;
+
+  mRailName = profiling::CaptureReader::getRailName(mFile.getData(), mFile.getData() + mFile.getSize());
+  if(mRailName.empty())
+    mRailName = "rail";
+
+  rewind();
+  return true;
+}
+
+void PowerSource::rewind()
+{
+  if(mTable)
+  {
+    std::vector<int> projection;
+    projection.push_back(mTable->getColumnIndex("time"));
+    projection.push_back(mTable->getColumnIndex("current"));
+    projection.push_back(mTable->getColumnIndex("voltage"));
+    projection.push_back(mTable->getColumnIndex("power"));
+
+    mScan.reset(new profiling::ColumnScan(mStore, *mTable, projection, std::vector<profiling::ColumnRange>()));
+    mRow = 0;
+    mRows = 0;
+  }
+  else
+    mReader = profiling::CaptureReader(mFile.getData(), mFile.getData() + mFile.getSize());
+}
+
+bool PowerSource::next(profiling::CaptureSample& sample)
+{
+  return mTable ? nextRow(sample) : mReader.next(sample);
+}
+
+bool PowerSource::nextRow(profiling::CaptureSample& sample)
+{
+  if(mRow >= mRows)
+  {
+    mRows = mScan->next(mColumns);
+    mRow = 0;
+    if(mRows == 0)
+      return false;
+  }
+
+  sample.time = mColumns[0][mRow];
+  sample.current = (int32_t)mColumns[1][mRow];
+  sample.voltage = (int32_t)mColumns[2][mRow];
+  sample.power = (int32_t)mColumns[3][mRow];
+  mRow++;
+  return true;
+}
+
+
+TraceSource::TraceSource() : mReader(NULL, NULL), mPendingTime(-1), mLastTime(0)
+{
+}
+
+bool TraceSource::open(const char* path)
+{
+  if(!mFile.open(path))
+    return false;
+
+  rewind();
+  return true;
+}
+
+void TraceSource::rewind()
+{
+  mReader = profiling::TraceReader(mFile.getData(), mFile.getData() + mFile.getSize());
+  mPending.clear();
+  mPendingTime = -1;
+  mLastTime = 0;
+}
+
+bool TraceSource::getStart(const profiling::TraceRecord& record, double& start, const char** end)
+{
+  const char* p = record.fields;
+
+  switch(record.type)
+  {
+    case profiling::TRACE_MODEL_TOTAL:
+      start = record.values[1];
+      break;
+    case profiling::TRACE_BATCH_TOTAL:
+      start = record.values[3];
+      break;
+    case profiling::TRACE_PHASES:
+    case profiling::TRACE_COUNTERS:
+    case profiling::TRACE_MEMORY:
+      if(!profiling::parseDecimal(p, record.end, start))
+        return false;
+      break;
+    default:
+      return false;
+  }
+
+  if(end)
+    *end = p;
+  return true;
+}
+
+bool TraceSource::next(ReplayEvent& event)
+{
+  // read up to the timed line ending the pending ones
+  profiling::TraceRecord record;
+  while(mPendingTime < 0 && mReader.next(record))
+  {
+    mPending.push_back(record);
+
+    double start;
+    if(getStart(record, start))
+    {
+      mPendingTime = llround(start * 1e6);
+      mLastTime = mPendingTime;
+    }
+  }
+
+  if(mPending.empty())
+    return false;
+
+  // the lines after the last timed one end at its time
+  event.time = mPendingTime >= 0 ? mPendingTime : mLastTime;
+  event.record = mPending.front();
+  if(!getStart(event.record, event.start))
+    event.start = -1;
+
+  mPending.pop_front();
+  if(mPending.empty())
+    mPendingTime = -1;
+  return true;
+}
@@ -0,0 +1,83 @@
+#ifndef __REPLAY_SOURCE_H__
+#define __REPLAY_SOURCE_H__
+
+#include <stdint.h>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <profiling/captureParser.h>
+#include <profiling/columnStore.h>
+#include <profiling/mappedFile.h>
+#include <profiling/traceParser.h>
+
+/*
+* Power samples of a power_profiler capture (sec;nsec;current;voltage;power) or of the
+* power table of a column store written by profile_store, in the order they were recorded.
+*/
+class PowerSource
+{
+public:
+  PowerSource();
+
+  bool open(const char* path);
+  // Next sample. Returns false at the end of the capture.
+  bool next(profiling::CaptureSample& sample);
+  // Start again from the first sample
+  void rewind();
+
+  // Rail of the capture header, "rail" for a store
+  inline const std::string& getRailName() const { return mRailName; }
+
+private:
+  bool nextRow(profiling::CaptureSample& sample);
+
+  profiling::MappedFile mFile;
+  profiling::CaptureReader mReader;
+  std::string mRailName;
+
+  // column store
+  profiling::ColumnStore mStore;
+  const profiling::TableInfo* mTable;
+  std::unique_ptr<profiling::ColumnScan> mScan;
+  std::vector<std::vector<int64_t> > mColumns;
+  size_t mRow;
+  size_t mRows;
+};
+
+// line of a profiler output and when it was written
+struct ReplayEvent
+{
+  int64_t time;   // ns since the epoch
+  double start;   // ms, the START field of the line, -1 if it has none
+  profiling::TraceRecord record;
+};
+
+/*
+* Lines of a profiler output in order. The layer lines have no timestamp, they are written
+* while the network runs: they are given the START of the next timed line (model_total,
+* batch_total, phases, counters or memory), the start of the inference they belong to.
+*/
+class TraceSource
+{
+public:
+  TraceSource();
+
+  bool open(const char* path);
+  // Next line. Returns false at the end of the output.
+  bool next(ReplayEvent& event);
+  void rewind();
+
+  // START of a timed line, false for the other lines
+  static bool getStart(const profiling::TraceRecord& record, double& start, const char** end=NULL);
+
+private:
+  profiling::MappedFile mFile;
+  profiling::TraceReader mReader;
+  std::deque<profiling::TraceRecord> mPending;  // lines up to the next timed one
+  int64_t mPendingTime;                         // -1 while the timed line isn't read
+  int64_t mLastTime;
+};
+
+#endif
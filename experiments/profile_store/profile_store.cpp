@@ -0,0 +1,426 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <profiling/argparse.h>
+#include <profiling/captureParser.h>
+#include <profiling/columnStore.h>
+#include <profiling/mappedFile.h>
+#include <profiling/traceParser.h>
+#include <profiling/logger.h>
+
+#define STORE_USAGE_STRING "Usage of profile store: \n"\
+                           "./profile_store --store=STORE [--import=TRACE] [--power=CAPTURE] [--info] [--table=TABLE]\n"\
+                           "                [--columns=COLUMNS] [--where=RANGES] [--output=OUTPUT] [--help]\n"\
+                           "Converts a profiler output and power capture to a columnar store, and queries it.\n"\
+                           "Arguments: \n"\
+                           "--store   | -s           The column store (.pcs).\n"\
+                           "--import  | -i           Create the store from a profiler output (layer_out.csv). The run of a layer\n"\
+                           "                         is the one of the next model_total line of its session.\n"\
+                           "--power   | -p           Also import a power_profiler capture.\n"\
+                           "--info    | -n           Show the tables, their columns and blocks.\n"\
+                           "--table   | -t           Table to query: layers (run, session, layer, duration), inferences (run, session,\n"\
+                           "                         start, duration) or power (time, current, voltage, power). Defaults to layers.\n"\
+                           "--columns | -c           Columns to read, separated by commas. Defaults to all of them.\n"\
+                           "--where   | -w           Ranges the rows must be in, separated by commas: COLUMN=MIN:MAX, COLUMN=MIN:,\n"\
+                           "                         COLUMN=:MAX or COLUMN=VALUE. Names for the layer and session columns.\n"\
+                           "                         e.g. --where=run=5000:6000,layer=conv1\n"\
+                           "--output  | -o           The rows (;-separated). Defaults to stdout.\n"\
+                           "--help    | -h           Show the help message.\n\n"
+
+#define usage() printf(STORE_USAGE_STRING)
+
+std::vector<std::string> splitList(const char* list, char separator)
+{
+  std::vector<std::string> items;
+  std::string item;
+
+  for(const char* c = list; ; c++)
+  {
+    if(*c == separator || *c == '\0')
+    {
+      if(!item.empty())
+        items.push_back(item);
+      item.clear();
+
+      if(*c == '\0')
+        break;
+    }
+    else
+      item += *c;
+  }
+  return items;
+}
+
+// Import the layers and inferences of a profiler output
+bool importTrace(profiling::ColumnStoreWriter& writer, const char* path)
+{
+  profiling::MappedFile file;
+  if(!file.open(path))
+    return false;
+
+  const profiling::ColumnSpec layerColumns[] = {
+    { "run", 1, false }, { "session", 1, true }, { "layer", 1, true }, { "duration", 1e6, false }
+  };
+  const profiling::ColumnSpec inferenceColumns[] = {
+    { "run", 1, false }, { "session", 1, true }, { "start", 1e3, false }, { "duration", 1e6, false }
+  };
+
+  const int layers = writer.addTable(STORE_LAYERS_TABLE, layerColumns, 4);
+  const int inferences = writer.addTable(STORE_INFERENCES_TABLE, inferenceColumns, 4);
+
+  profiling::TraceReader reader(file.getData(), file.getData() + file.getSize());
+  profiling::TraceRecord record;
+  std::vector<profiling::TraceRecord> pending;
+  int64_t run = 0;
+  uint64_t layerCount = 0;
+
+  while(reader.next(record))
+  {
+    if(record.type == profiling::TRACE_LAYER)
+    {
+      pending.push_back(record);
+      continue;
+    }
+
+    if(record.type != profiling::TRACE_MODEL_TOTAL)
+      continue;
+
+    // with several streams, the layers of this inference are the ones of its session,
+    // written when its model_total is so both tables stay in run order
+    const int64_t session = writer.getNameId(record.name, record.sessionLength);
+    const uint32_t prefix = record.sessionLength > 0 ? record.sessionLength + 1 : 0;  // `session/`
+    size_t kept = 0;
+    for(size_t n = 0; n < pending.size(); n++)
+    {
+      const profiling::TraceRecord& layer = pending[n];
+      const bool matches = record.sessionLength == 0 ||
+                           (layer.nameLength > record.sessionLength && layer.name[record.sessionLength] == '/' &&
+                            memcmp(layer.name, record.name, record.sessionLength) == 0);
+      if(matches)
+      {
+        // the layer name without its session, in its own column
+        const int64_t values[] = { run, session, writer.getNameId(layer.name + prefix, layer.nameLength - prefix),
+                                   llround(layer.values[0] * 1e6) };
+        writer.append(layers, values);
+        layerCount++;
+      }
+      else
+        pending[kept++] = layer;
+    }
+    pending.resize(kept);
+
+    const int64_t values[] = { run, session, llround(record.values[1] * 1e3),
+                               llround(record.values[0] * 1e6) };
+    writer.append(inferences, values);
+    run++;
+  }
+
+  if(!pending.empty())
+    printf(WARNING "%zu layer times of %s have no model_total line, not imported.\n", pending.size(), path);
+
+  printf(INFO "Imported %llu layer times and %lld inferences from %s.\n", (unsigned long long)layerCount, (long long)run, path);
+  return true;
+}
+
+// Import the samples of a power capture, sec;nsec;current;voltage;power. Values not watched are -1.
+bool importPower(profiling::ColumnStoreWriter& writer, const char* path)
+{
+  profiling::MappedFile file;
+  if(!file.open(path))
+    return false;
+
+  const profiling::ColumnSpec powerColumns[] = {
+    { "time", 1e9, false }, { "current", 1, false }, { "voltage", 1, false }, { "power", 1, false }
+  };
+  const int power = writer.addTable(STORE_POWER_TABLE, powerColumns, 4);
+
+  profiling::CaptureReader reader(file.getData(), file.getData() + file.getSize());
+  profiling::CaptureSample sample;
+  uint64_t samples = 0;
+
+  while(reader.next(sample))
+  {
+    const int64_t values[] = { sample.time, sample.current, sample.voltage, sample.power };
+    writer.append(power, values);
+    samples++;
+  }
+
+  printf(INFO "Imported %llu power samples from %s.\n", (unsigned long long)samples, path);
+  return true;
+}
+
+void printInfo(const profiling::ColumnStore& store)
+{
+  printf("%llu bytes, %zu names in the dictionary\n", (unsigned long long)store.getSize(), store.getDictionary().size());
+
+  for(size_t t = 0; t < store.getTables().size(); t++)
+  {
+    const profiling::TableInfo& table = store.getTables()[t];
+    printf("\n%s: %llu rows\n", table.name.c_str(), (unsigned long long)table.rows);
+    printf("  %-12s %8s %10s %8s %10s %20s %20s\n", "column", "blocks", "bytes", "delta", "bits/row", "min", "max");
+
+    for(size_t c = 0; c < table.columns.size(); c++)
+    {
+      const profiling::ColumnInfo& column = table.columns[c];
+      uint64_t bytes = 0;
+      uint64_t bits = 0;
+      size_t deltas = 0;
+      int64_t min = 0;
+      int64_t max = 0;
+
+      for(size_t b = 0; b < column.blocks.size(); b++)
+      {
+        const profiling::ColumnBlock& block = column.blocks[b];
+        bytes += ((uint64_t)block.rows * block.width + 63) / 64 * 8;
+        bits += (uint64_t)block.rows * block.width;
+        deltas += block.encoding == profiling::ENCODING_DELTA;
+        min = b == 0 ? block.min : std::min(min, block.min);
+        max = b == 0 ? block.max : std::max(max, block.max);
+      }
+
+      printf("  %-12s %8zu %10llu %8zu %10.2f %20lld %20lld\n", column.name.c_str(), column.blocks.size(), (unsigned long long)bytes,
+             deltas, table.rows > 0 ? (double)bits / table.rows : 0.0, (long long)min, (long long)max);
+    }
+  }
+}
+
+// Range of stored values of a --where item, false if it can't be parsed
+bool parseRange(const profiling::ColumnStore& store, const profiling::TableInfo& table, const std::string& item,
+                profiling::ColumnRange& range)
+{
+  const size_t equal = item.find('=');
+  if(equal == std::string::npos)
+  {
+    printf(ERROR "Unexpected range %s, use COLUMN=MIN:MAX.\n", item.c_str());
+    return false;
+  }
+
+  const std::string name = item.substr(0, equal);
+  const std::string bounds = item.substr(equal + 1);
+
+  range.column = table.getColumnIndex(name.c_str());
+  if(range.column < 0)
+  {
+    printf(ERROR "No column %s in %s.\n", name.c_str(), table.name.c_str());
+    return false;
+  }
+
+  const profiling::ColumnInfo& column = table.columns[range.column];
+
+  if(column.dictionary)
+  {
+    const int64_t id = store.findName(bounds.c_str());
+    range.min = id >= 0 ? id : 1;  // an empty range if the name is unknown
+    range.max = id >= 0 ? id : 0;
+    return true;
+  }
+
+  const size_t colon = bounds.find(':');
+  const std::string low = colon == std::string::npos ? bounds : bounds.substr(0, colon);
+  const std::string high = colon == std::string::npos ? bounds : bounds.substr(colon + 1);
+
+  range.min = INT64_MIN;
+  range.max = INT64_MAX;
+  char* end = NULL;
+
+  if(!low.empty())
+  {
+    const double value = strtod(low.c_str(), &end);
+    if(*end != '\0')
+    {
+      printf(ERROR "Unexpected value %s for %s.\n", low.c_str(), name.c_str());
+      return false;
+    }
+    range.min = (int64_t)ceil(value * column.scale);
+  }
+
+  if(!high.empty())
+  {
+    const double value = strtod(high.c_str(), &end);
+    if(*end != '\0')
+    {
+      printf(ERROR "Unexpected value %s for %s.\n", high.c_str(), name.c_str());
+      return false;
+    }
+    range.max = (int64_t)floor(value * column.scale);
+  }
+  return true;
+}
+
+void writeValue(FILE* file, const profiling::ColumnStore& store, const profiling::ColumnInfo& column, int64_t value)
+{
+  if(column.dictionary)
+  {
+    const std::vector<std::string>& names = store.getDictionary();
+    fprintf(file, "%s", value >= 0 && (size_t)value < names.size() ? names[value].c_str() : "");
+  }
+  else if(column.scale <= 1)
+    fprintf(file, "%lld", (long long)value);
+  else
+  {
+    // exact decimals, the scales are powers of 10
+    const uint64_t unit = (uint64_t)column.scale;
+    const uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    fprintf(file, "%s%llu.%0*llu", value < 0 ? "-" : "", (unsigned long long)(magnitude / unit), (int)lround(log10(column.scale)),
+            (unsigned long long)(magnitude % unit));
+  }
+}
+
+int query(const profiling::ColumnStore& store, const char* tableName, const char* columnList, const char* where, FILE* output)
+{
+  const profiling::TableInfo* table = store.getTable(tableName);
+  if(!table)
+  {
+    printf(ERROR "No table %s in the store.\n", tableName);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<int> projection;
+  if(columnList)
+  {
+    const std::vector<std::string> names = splitList(columnList, ',');
+    for(size_t n = 0; n < names.size(); n++)
+    {
+      const int column = table->getColumnIndex(names[n].c_str());
+      if(column < 0)
+      {
+        printf(ERROR "No column %s in %s.\n", names[n].c_str(), tableName);
+        return EXIT_FAILURE;
+      }
+      projection.push_back(column);
+    }
+  }
+  else
+  {
+    for(size_t n = 0; n < table->columns.size(); n++)
+      projection.push_back(n);
+  }
+
+  std::vector<profiling::ColumnRange> ranges;
+  if(where)
+  {
+    const std::vector<std::string> items = splitList(where, ',');
+    for(size_t n = 0; n < items.size(); n++)
+    {
+      profiling::ColumnRange range;
+      if(!parseRange(store, *table, items[n], range))
+        return EXIT_FAILURE;
+      ranges.push_back(range);
+    }
+  }
+
+  for(size_t p = 0; p < projection.size(); p++)
+    fprintf(output, "%s%s", p > 0 ? ";" : "", table->columns[projection[p]].name.c_str());
+  fprintf(output, "\n");
+
+  profiling::ColumnScan scan(store, *table, projection, ranges);
+  std::vector<std::vector<int64_t> > columns;
+  uint64_t rows = 0;
+
+  for(size_t count = scan.next(columns); count > 0; count = scan.next(columns))
+  {
+    for(size_t row = 0; row < count; row++)
+    {
+      for(size_t p = 0; p < projection.size(); p++)
+      {
+        if(p > 0)
+          fputc(';', output);
+        writeValue(output, store, table->columns[projection[p]], columns[p][row]);
+      }
+      fputc('\n', output);
+    }
+    rows += count;
+  }
+
+  // on stderr, the rows can be on stdout
+  fprintf(stderr, INFO "%llu rows, %llu blocks read, %llu skipped.\n", (unsigned long long)rows,
+          (unsigned long long)scan.getBlocksRead(), (unsigned long long)scan.getBlocksSkipped());
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+  arg_option options[] = {
+    OPT_BOOLEAN('h', "help",    NULL),
+    OPT_STRING ('s', "store",   NULL),
+    OPT_STRING ('i', "import",  NULL),
+    OPT_STRING ('p', "power",   NULL),
+    OPT_BOOLEAN('n', "info",    NULL),
+    OPT_STRING ('t', "table",   NULL),
+    OPT_STRING ('c', "columns", NULL),
+    OPT_STRING ('w', "where",   NULL),
+    OPT_STRING ('o', "output",  NULL),
+  };
+
+  command_line cmd = { options, 9 };
+  parse_command_line(&cmd, argc, argv);
+
+  const char* storeOption = (const char*) get_option_value(&cmd, "store");
+  if(get_option_value(&cmd, "help") || !storeOption)
+  {
+    free_command_line(&cmd);
+    usage();
+    exit(storeOption ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  const std::string storePath = storeOption;
+
+  const char* tracePath = (const char*) get_option_value(&cmd, "import");
+  const char* powerPath = (const char*) get_option_value(&cmd, "power");
+
+  // create the store
+  if(tracePath || powerPath)
+  {
+    profiling::ColumnStoreWriter writer;
+    bool imported = writer.open(storePath.c_str());
+
+    if(imported && tracePath)
+      imported = importTrace(writer, tracePath);
+    if(imported && powerPath)
+      imported = importPower(writer, powerPath);
+
+    imported = writer.close() && imported;
+    free_command_line(&cmd);
+
+    if(imported)
+      printf(INFO "Wrote %s.\n", storePath.c_str());
+    return imported ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  profiling::ColumnStore store;
+  if(!store.open(storePath.c_str()))
+  {
+    free_command_line(&cmd);
+    return EXIT_FAILURE;
+  }
+
+  if(get_option_value(&cmd, "info"))
+  {
+    printInfo(store);
+    free_command_line(&cmd);
+    return EXIT_SUCCESS;
+  }
+
+  const char* table = (const char*) get_option_value(&cmd, "table");
+  const char* outputPath = (const char*) get_option_value(&cmd, "output");
+  FILE* output = outputPath ? fopen(outputPath, "w") : stdout;
+  if(!output)
+  {
+    printf(ERROR "Unable to open file %s.\n", outputPath);
+    free_command_line(&cmd);
+    return EXIT_FAILURE;
+  }
+
+  const int status = query(store, table ? table : STORE_LAYERS_TABLE, (const char*) get_option_value(&cmd, "columns"),
+                           (const char*) get_option_value(&cmd, "where"), output);
+
+  if(output != stdout)
+    fclose(output);
+  free_command_line(&cmd);
+  return status;
+}
@@ -0,0 +1,65 @@
+#ifndef __ENERGY_H__
+#define __ENERGY_H__
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <profiling/captureParser.h>
+#include <profiling/mappedFile.h>
+
+/*
+* Power samples of a capture of the power profiler (sec;nsec;current;voltage;power),
+* integrated over time windows to get the energy used by a configuration.
+*/
+class PowerTrace
+{
+public:
+  // Read the samples with a power value. Returns false if the file can't be read.
+  bool load(const std::string& path)
+  {
+    profiling::MappedFile file;
+    if(!file.open(path.c_str()))
+      return false;
+
+    mTimes.clear();
+    mPowers.clear();
+
+    profiling::CaptureReader reader(file.getData(), file.getData() + file.getSize());
+    profiling::CaptureSample sample;
+
+    while(reader.next(sample))
+    {
+      if(sample.power < 0)
+        continue;  // the power is not watched
+
+      mTimes.push_back(sample.time * 1e-9);
+      mPowers.push_back(sample.power);
+    }
+    return true;
+  }
+
+  // Energy (J) between two times (s since the epoch). Each power sample holds until the next one.
+  double getEnergy(double start, double end) const
+  {
+    double energy = 0;
+
+    for(size_t i = 0; i + 1 < mTimes.size(); i++)
+    {
+      const double from = std::max(mTimes[i], start);
+      const double to = std::min(mTimes[i + 1], end);
+
+      if(to > from)
+        energy += mPowers[i] * 0.001 * (to - from);
+    }
+    return energy;
+  }
+
+  inline size_t getCount() const { return mTimes.size(); }
+
+private:
+  std::vector<double> mTimes;   // s since the epoch
+  std::vector<double> mPowers;  // mW
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef __POWER_COMMAND_H__
+#define __POWER_COMMAND_H__
+
+#include <stdio.h>
+#include <time.h>
+#include <string>
+
+#include <profiling/control.h>
+#include <profiling/logger.h>
+
+// Wall clock time in s since the epoch, the clock of the power capture timestamps
+inline double realtimeSeconds()
+{
+  timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Send a command to the power profiler, false if it failed
+inline bool powerCommand(const std::string& socket, const std::string& command)
+{
+  std::string reply;
+  if(!profiling::sendControlCommand(socket.c_str(), command, reply) || reply.compare(0, 2, "OK") != 0)
+  {
+    printf(WARNING "Power profiler command '%s' failed: %s\n", command.c_str(), reply.c_str());
+    return false;
+  }
+  return true;
+}
+
+#endif
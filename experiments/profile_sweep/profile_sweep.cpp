@@ -0,0 +1,347 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <jetson-utils/commandLine.h>
+#include <jetson-utils/loadImage.h>
+
+#include <profiling/argparse.h>
+#include <profiling/hdrHistogram.h>
+#include <profiling/thermal.h>
+#include "myImageNet.h"
+#include "multiStream.h"
+#include "pipeline.h"
+#include "energy.h"
+#include "power_command.h"
+#include "sweep_spec.h"
+#include <profiling/logger.h>
+
+#define SWEEP_USAGE_STRING "Usage of profile sweep: \n"\
+                           "./profile_sweep --spec=SPEC [--help]\n"\
+                           "Runs every combination of models, precisions, batch sizes and streams of a spec file\n"\
+                           "and writes one line of results per configuration.\n"\
+                           "Arguments: \n"\
+                           "--spec | -s              The sweep spec, one directive per line:\n"\
+                           "                         backend tensorrt|cpu, image PATH, models NAME..., precisions fp32|fp16|int8...,\n"\
+                           "                         batches SIZE..., streams COUNT..., runs COUNT, warmup COUNT,\n"\
+                           "                         power PATH (energy from the power profiler), socket PATH, profile PATH, output PATH,\n"\
+                           "                         sysfs PATH, thermal-log PATH, cooldown TEMP, stable DELTA SECONDS, gate-timeout SECONDS,\n"\
+                           "                         throttled mark|discard (thermal gate before each configuration).\n"\
+                           "--help | -h              Show the help message.\n\n"
+
+#define usage() printf(SWEEP_USAGE_STRING)
+
+// results of a configuration
+struct SweepResult
+{
+  std::string model;
+  std::string precision;
+  uint32_t batch;
+  uint32_t streams;
+  uint64_t classified;  // batches of all the streams
+  uint64_t images;
+  double elapsed;       // s
+  double throughput;    // images/s
+  double mean;          // ms, latency of a batch
+  double p50;
+  double p90;
+  double p99;
+  double max;
+  double start;         // s since the epoch, to find the energy in the power capture
+  double end;
+  double energy;        // J, -1 without power capture
+  double gateWait;      // s waiting for the thermal gate
+  double tempStart;     // °C of the hottest zone, -1 without thermal zones
+  double tempMax;
+  double cpuMhz;        // lowest clocks at the end, -1 if unknown
+  double devfreqMhz;
+  bool throttled;
+  std::string throttleReason;
+};
+
+// Networks of a model at a precision, with the backend options of recognition
+bool createNets(const SweepSpec& spec, const std::string& model, const std::string& precision, uint32_t count, uint32_t maxBatchSize,
+                std::vector<profiling::ImageNet*>& nets)
+{
+  std::vector<std::string> args;
+  args.push_back("profile_sweep");
+  args.push_back("--backend=" + spec.backend);
+
+  if(spec.backend == "cpu")
+  {
+    if(model != "builtin")
+      args.push_back("--graph=" + model);
+  }
+  else
+  {
+    args.push_back("--network=" + model);
+    args.push_back("--precision=" + precision);
+  }
+
+  if(!spec.profile.empty())
+    args.push_back("--profile");
+
+  std::vector<char*> argv;
+  for(size_t i = 0; i < args.size(); i++)
+    argv.push_back(&args[i][0]);
+  argv.push_back(NULL);
+
+  commandLine cmdLine(args.size(), argv.data());
+
+  for(uint32_t n = 0; n < count; n++)
+  {
+    profiling::ImageNet* net = profiling::ImageNet::Create(cmdLine, maxBatchSize);
+    if(!net)
+      return false;
+    nets.push_back(net);
+  }
+  return true;
+}
+
+void computeLatencies(const profiling::MultiStream::Run& run, SweepResult& result)
+{
+  profiling::HdrHistogram latency;
+  for(size_t n = 0; n < run.streams.size(); n++)
+  {
+    const std::vector<double>& latencies = run.streams[n].latencies;
+    for(size_t i = 0; i < latencies.size(); i++)
+      latency.record((uint64_t)(latencies[i] * 1e6));
+  }
+
+  result.classified = run.getClassified();
+  result.images = result.classified * run.batchSize;
+  result.elapsed = run.elapsed;
+  result.throughput = run.getThroughput();
+  result.mean = latency.getMean() * 1e-6;
+  result.p50 = latency.getValueAtPercentile(50.0) * 1e-6;
+  result.p90 = latency.getValueAtPercentile(90.0) * 1e-6;
+  result.p99 = latency.getValueAtPercentile(99.0) * 1e-6;
+  result.max = latency.getMax() * 1e-6;
+}
+
+void printResult(FILE* file, const SweepResult& result, bool header)
+{
+  if(header)
+    fprintf(file, "model;precision;batch;streams;classified;images;elapsed_s;images_per_s;latency_mean_ms;latency_p50_ms;"
+                  "latency_p90_ms;latency_p99_ms;latency_max_ms;energy_j;joules_per_image;mean_power_w;"
+                  "gate_wait_s;temp_start_c;temp_max_c;cpu_mhz;devfreq_mhz;throttled;throttle_reason\n");
+
+  const bool hasEnergy = result.energy >= 0 && result.images > 0;
+
+  fprintf(file, "%s;%s;%u;%u;%llu;%llu;%.3f;%.2f;%.3f;%.3f;%.3f;%.3f;%.3f;", result.model.c_str(), result.precision.c_str(),
+          result.batch, result.streams, (unsigned long long)result.classified, (unsigned long long)result.images,
+          result.elapsed, result.throughput, result.mean, result.p50, result.p90, result.p99, result.max);
+
+  if(hasEnergy)
+    fprintf(file, "%.4f;%.6f;%.3f;", result.energy, result.energy / result.images,
+            result.end > result.start ? result.energy / (result.end - result.start) : 0.0);
+  else
+    fprintf(file, ";;;");
+
+  fprintf(file, "%.1f;%.1f;%.1f;%.0f;%.0f;%d;%s\n", result.gateWait, result.tempStart, result.tempMax, result.cpuMhz,
+          result.devfreqMhz, result.throttled ? 1 : 0, result.throttleReason.c_str());
+}
+
+int main(int argc, char** argv)
+{
+  arg_option options[] = {
+    OPT_BOOLEAN('h', "help", NULL),
+    OPT_STRING ('s', "spec", NULL),
+  };
+
+  command_line cmd = { options, 2 };
+  parse_command_line(&cmd, argc, argv);
+
+  const char* specPath = (const char*) get_option_value(&cmd, "spec");
+  if(get_option_value(&cmd, "help") || !specPath)
+  {
+    free_command_line(&cmd);
+    usage();
+    exit(specPath ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  SweepSpec spec;
+  const bool loaded = spec.load(specPath);
+  free_command_line(&cmd);
+
+  if(!loaded)
+    return EXIT_FAILURE;
+
+  // the layer times are only kept if asked for
+  file_profiler_t::setFile(spec.profile.empty() ? "/dev/null" : spec.profile.c_str());
+
+  uchar3* image = NULL;
+  int width = 0;
+  int height = 0;
+
+  if(!loadImage(spec.image.c_str(), &image, &width, &height))
+    return EXIT_FAILURE;
+
+  // one capture for the whole sweep, the daemon doesn't share our working directory
+  bool capturing = false;
+  if(!spec.power.empty())
+  {
+    std::string powerPath = spec.power;
+    char cwd[4096];
+    if(powerPath[0] != '/' && getcwd(cwd, sizeof(cwd)))
+      powerPath = std::string(cwd) + "/" + powerPath;
+
+    capturing = powerCommand(spec.socket, "start " + powerPath);
+  }
+
+  // temperatures and clocks of each configuration
+  profiling::ThermalMonitor thermal(spec.sysfs.c_str());
+  const bool hasThermal = thermal.discover();
+  if(!hasThermal)
+    printf(WARNING "No thermal zones or clocks under %s, the configurations aren't gated.\n", spec.sysfs.c_str());
+  else if(!spec.thermalLog.empty())
+    thermal.openLog(spec.thermalLog.c_str());  // the sweep goes on without the log if it can't be opened
+
+  const uint32_t maxBatchSize = *std::max_element(spec.batches.begin(), spec.batches.end());
+  const uint32_t maxStreams = *std::max_element(spec.streams.begin(), spec.streams.end());
+  std::vector<SweepResult> results;
+
+  printf(INFO "Sweeping %zu configurations, %u runs per stream.\n", spec.getCount(), spec.runs);
+
+  for(size_t m = 0; m < spec.models.size(); m++)
+  {
+    for(size_t p = 0; p < spec.precisions.size(); p++)
+    {
+      const std::string& model = spec.models[m];
+      const std::string& precision = spec.precisions[p];
+
+      if(spec.backend == "cpu" && precision != "fp32")
+      {
+        printf(WARNING "The cpu backend only runs fp32, skipping %s %s.\n", model.c_str(), precision.c_str());
+        continue;
+      }
+
+      // loaded once for all the batch sizes and stream counts
+      std::vector<profiling::ImageNet*> nets;
+      if(!createNets(spec, model, precision, maxStreams, maxBatchSize, nets))
+      {
+        printf(ERROR "Unable to load %s %s, skipping it.\n", model.c_str(), precision.c_str());
+        for(size_t n = 0; n < nets.size(); n++)
+          delete nets[n];
+        continue;
+      }
+
+      profiling::MultiStream multiStream(nets);
+      const std::string modelName = model.substr(model.find_last_of('/') + 1);
+
+      for(size_t b = 0; b < spec.batches.size(); b++)
+      {
+        for(size_t s = 0; s < spec.streams.size(); s++)
+        {
+          SweepResult result;
+          result.model = modelName;
+          result.precision = precision;
+          result.batch = spec.batches[b];
+          result.streams = spec.streams[s];
+          result.energy = -1;
+          result.gateWait = 0;
+          result.tempStart = -1;
+          result.tempMax = -1;
+          result.cpuMhz = -1;
+          result.devfreqMhz = -1;
+          result.throttled = false;
+
+          char config[256];
+          snprintf(config, sizeof(config), "%s/%s/batch%u/streams%u", modelName.c_str(), precision.c_str(), result.batch, result.streams);
+
+          // cool down before the warmup, which brings the configuration to its own steady state
+          if(hasThermal && !thermal.waitForGate(spec.gate, result.gateWait))
+            printf(WARNING "%s starts before the thermal gate was met.\n", config);
+
+          profiling::MultiStream::Run run;
+          if(spec.warmup > 0)
+            multiStream.run(result.streams, image, width, height, spec.warmup, "warmup/stream", run, result.batch);
+
+          if(capturing)
+            powerCommand(spec.socket, std::string("mark ") + config + "/start");
+
+          const std::string session = std::string(config) + "/stream";
+          if(hasThermal)
+            thermal.beginBlock(spec.gate.interval);
+
+          result.start = realtimeSeconds();
+          const bool success = multiStream.run(result.streams, image, width, height, spec.runs, session.c_str(), run, result.batch);
+          result.end = realtimeSeconds();
+
+          if(hasThermal)
+          {
+            profiling::ThermalBlock block;
+            thermal.endBlock(block);
+
+            result.tempStart = block.start.getMaxTemperature();
+            result.tempMax = block.maxTemperature;
+            result.cpuMhz = block.end.getMinFrequency(thermal.getDomains(), false);
+            result.devfreqMhz = block.end.getMinFrequency(thermal.getDomains(), true);
+            result.throttled = block.throttled;
+            result.throttleReason = block.reason;
+          }
+
+          if(capturing)
+            powerCommand(spec.socket, std::string("mark ") + config + "/end");
+
+          if(!success)
+          {
+            printf(ERROR "Nothing classified with %s.\n", config);
+            continue;
+          }
+
+          if(result.throttled)
+          {
+            printf(WARNING "%s was throttled: %s%s\n", config, result.throttleReason.c_str(),
+                   spec.discardThrottled ? ", discarded." : ".");
+            if(spec.discardThrottled)
+              continue;
+          }
+
+          computeLatencies(run, result);
+          results.push_back(result);
+
+          printf(INFO "%s: %.2f images/s, p50 %.3f ms, p99 %.3f ms\n", config, result.throughput, result.p50, result.p99);
+        }
+      }
+
+      for(size_t n = 0; n < nets.size(); n++)
+        delete nets[n];
+    }
+  }
+
+  profiling::releaseImage(image);
+
+  // energy of each configuration from the capture
+  if(capturing && powerCommand(spec.socket, "stop"))
+  {
+    PowerTrace trace;
+    if(trace.load(spec.power) && trace.getCount() > 1)
+    {
+      for(size_t i = 0; i < results.size(); i++)
+        results[i].energy = trace.getEnergy(results[i].start, results[i].end);
+    }
+    else
+      printf(WARNING "No power samples in %s.\n", spec.power.c_str());
+  }
+
+  FILE* output = fopen(spec.output.c_str(), "w");
+  if(!output)
+  {
+    printf(ERROR "Unable to open %s.\n", spec.output.c_str());
+    return EXIT_FAILURE;
+  }
+
+  for(size_t i = 0; i < results.size(); i++)
+    printResult(output, results[i], i == 0);
+  fclose(output);
+
+  if(!spec.profile.empty())
+    fclose(file_profiler_t::getFile());
+
+  printf(INFO "Wrote %zu configurations to %s.\n", results.size(), spec.output.c_str());
+  return results.empty() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+#include "sweep_spec.h"
+
+#include <fstream>
+#include <sstream>
+#include <type_traits>
+
+#include <profiling/control.h>
+#include <profiling/logger.h>
+
+SweepSpec::SweepSpec() : backend("tensorrt"), runs(100), warmup(10), socket(POWER_CONTROL_SOCKET), output("sweep_results.csv"),
+                         sysfs("/sys"), discardThrottled(false)
+{
+  precisions.push_back("fp32");
+  batches.push_back(1);
+  streams.push_back(1);
+}
+
+// parse a token of a directive, the whole token must be a value
+template<typename T>
+static bool parseValue(const std::string& token, T& value)
+{
+  // a negative number would wrap around in an unsigned value
+  if(std::is_unsigned<T>::value && token[0] == '-')
+    return false;
+
+  std::istringstream stream(token);
+  return (bool)(stream >> value) && stream.eof();
+}
+
+// read the next token of a directive
+template<typename T>
+static bool readValue(std::istringstream& tokens, T& value)
+{
+  std::string token;
+  return (bool)(tokens >> token) && parseValue(token, value);
+}
+
+// read the remaining tokens of a directive
+template<typename T>
+static bool readValues(std::istringstream& tokens, std::vector<T>& values)
+{
+  values.clear();
+  std::string token;
+  while(tokens >> token)
+  {
+    T value;
+    if(!parseValue(token, value))
+      return false;
+    values.push_back(value);
+  }
+  return !values.empty();
+}
+
+// nothing left after the values of a directive
+static bool atEnd(std::istringstream& tokens)
+{
+  std::string extra;
+  return !(tokens >> extra);
+}
+
+bool SweepSpec::load(const char* path)
+{
+  std::ifstream file(path);
+  if(!file.is_open())
+  {
+    printf(ERROR "Unable to open the sweep spec %s.\n", path);
+    return false;
+  }
+
+  std::string line;
+  for(int number = 1; std::getline(file, line); number++)
+  {
+    const size_t comment = line.find('#');
+    if(comment != std::string::npos)
+      line.erase(comment);
+
+    std::istringstream tokens(line);
+    std::string directive;
+    if(!(tokens >> directive))
+      continue;  // empty line
+
+    bool valid = true;
+    if(directive == "backend")
+      valid = readValue(tokens, backend) && atEnd(tokens) && (backend == "tensorrt" || backend == "cpu");
+    else if(directive == "image")
+      valid = readValue(tokens, image) && atEnd(tokens);
+    else if(directive == "models")
+      valid = readValues(tokens, models);
+    else if(directive == "precisions")
+      valid = readValues(tokens, precisions);
+    else if(directive == "batches")
+      valid = readValues(tokens, batches);
+    else if(directive == "streams")
+      valid = readValues(tokens, streams);
+    else if(directive == "runs")
+      valid = readValue(tokens, runs) && atEnd(tokens) && runs > 0;
+    else if(directive == "warmup")
+      valid = readValue(tokens, warmup) && atEnd(tokens);
+    else if(directive == "power")
+      valid = readValue(tokens, power) && atEnd(tokens);
+    else if(directive == "socket")
+      valid = readValue(tokens, socket) && atEnd(tokens);
+    else if(directive == "profile")
+      valid = readValue(tokens, profile) && atEnd(tokens);
+    else if(directive == "output")
+      valid = readValue(tokens, output) && atEnd(tokens);
+    else if(directive == "sysfs")
+      valid = readValue(tokens, sysfs) && atEnd(tokens);
+    else if(directive == "thermal-log")
+      valid = readValue(tokens, thermalLog) && atEnd(tokens);
+    else if(directive == "cooldown")
+      valid = readValue(tokens, gate.cooldown) && atEnd(tokens) && gate.cooldown > 0;
+    else if(directive == "stable")
+      valid = readValue(tokens, gate.stability) && readValue(tokens, gate.window) && atEnd(tokens) && gate.stability > 0 && gate.window > 0;
+    else if(directive == "gate-timeout")
+      valid = readValue(tokens, gate.timeout) && atEnd(tokens) && gate.timeout >= 0;
+    else if(directive == "throttled")
+    {
+      std::string action;
+      valid = readValue(tokens, action) && atEnd(tokens) && (action == "mark" || action == "discard");
+      discardThrottled = action == "discard";
+    }
+    else
+      valid = false;
+
+    for(size_t i = 0; valid && i < batches.size(); i++)
+      valid = batches[i] > 0;
+    for(size_t i = 0; valid && i < streams.size(); i++)
+      valid = streams[i] > 0;
+
+    if(!valid)
+    {
+      printf(ERROR "Invalid directive at %s:%d.\n", path, number);
+      return false;
+    }
+  }
+
+  if(image.empty() || models.empty())
+  {
+    printf(ERROR "The sweep spec %s needs an image and models.\n", path);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,60 @@
+#ifndef __SWEEP_SPEC_H__
+#define __SWEEP_SPEC_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <profiling/thermal.h>
+
+/*
+* Configurations of a sweep, read from a spec file with one directive per line
+* (# starts a comment). Every combination of models, precisions, batches and streams is run.
+*
+*   backend     tensorrt | cpu
+*   image       PATH                 image classified by every configuration
+*   models      NAME...              network names, or graph files with the cpu backend (builtin for the default graph)
+*   precisions  fp32 | fp16 | int8...
+*   batches     SIZE...
+*   streams     COUNT...
+*   runs        COUNT                classifications of each stream per configuration
+*   warmup      COUNT                classifications before measuring
+*   power       PATH                 capture the power in PATH with the power profiler service
+*   socket      PATH                 control socket of the power profiler
+*   profile     PATH                 layer and phase times of the networks
+*   output      PATH                 results table
+*   sysfs       PATH                 root of the thermal zones and clocks, /sys by default (a fake tree to try the gate)
+*   thermal-log PATH                 temperatures and clocks sampled during the configurations (profile_tail --samples)
+*   cooldown    TEMP                 wait until the hottest thermal zone is under TEMP °C before each configuration
+*   stable      DELTA SECONDS        wait until the hottest zone varies by less than DELTA °C over SECONDS
+*   gate-timeout SECONDS             run the configuration anyway after SECONDS of waiting (300)
+*   throttled   mark | discard       keep the configurations throttled while measured, or leave them out
+*/
+struct SweepSpec
+{
+  SweepSpec();
+
+  bool load(const char* path);
+
+  // configurations in the file
+  inline size_t getCount() const { return models.size() * precisions.size() * batches.size() * streams.size(); }
+
+  std::string backend;
+  std::string image;
+  std::vector<std::string> models;
+  std::vector<std::string> precisions;
+  std::vector<uint32_t> batches;
+  std::vector<uint32_t> streams;
+  uint32_t runs;
+  uint32_t warmup;
+  std::string power;
+  std::string socket;
+  std::string profile;
+  std::string output;
+  std::string sysfs;
+  std::string thermalLog;
+  profiling::ThermalGate gate;
+  bool discardThrottled;
+};
+
+#endif
@@ -0,0 +1,637 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <profiling/argparse.h>
+#include <profiling/captureParser.h>
+#include <profiling/columnStore.h>
+#include <profiling/mappedFile.h>
+#include <profiling/traceParser.h>
+#include <profiling/logger.h>
+
+#define TAIL_USAGE_STRING "Usage of profile tail: \n"\
+                          "./profile_tail --input=INPUT [--power=CAPTURE] [--samples=SAMPLES] [--percentiles=PERCENTILES]\n"\
+                          "               [--top=COUNT] [--skip=RUNS] [--output=OUTPUT] [--help]\n"\
+                          "Finds the layers that make the slowest inferences slow, by comparing the inferences above a\n"\
+                          "latency percentile to the typical ones (between p25 and p75), layer by layer.\n"\
+                          "Arguments: \n"\
+                          "--input       | -i      Profiler output (layer_out.csv) or column store (.pcs). The layers of an\n"\
+                          "                        inference are the ones written before its model_total line.\n"\
+                          "--power       | -p      Power capture taken during the run, correlated with the latency.\n"\
+                          "                        Not needed if the column store has a power table.\n"\
+                          "--samples     | -m      Other samples taken during the run: a power_profiler capture of another rail\n"\
+                          "                        (current, voltage and power), or temperatures and clocks from the thermal-log of\n"\
+                          "                        profile_sweep: a header `time;NAME;...` then one line per sample, time in s\n"\
+                          "                        since the epoch.\n"\
+                          "--percentiles | -c      Latency percentiles where the tail starts, separated by commas. Defaults to 95,99.\n"\
+                          "--top         | -t      Layers shown per percentile. Defaults to 10.\n"\
+                          "--skip        | -s      Warmup inferences dropped at the start of the run. Defaults to 0.\n"\
+                          "--output      | -o      All the layers of each percentile (;-separated).\n"\
+                          "--help        | -h      Show the help message.\n\n"
+
+#define usage() printf(TAIL_USAGE_STRING)
+
+// spikes of a layer are its times above this percentile
+#define SPIKE_PERCENTILE 0.95
+
+// inferences and the times of their layers
+struct Iterations
+{
+  std::vector<std::string> layerNames;
+  std::unordered_map<std::string, uint32_t> layerIds;
+
+  std::vector<double> latencies;  // ms
+  std::vector<double> starts;     // ms since the epoch
+  std::vector<size_t> offsets;    // layers of iteration n are [offsets[n], offsets[n + 1])
+  std::vector<uint32_t> ids;
+  std::vector<float> durations;   // ms
+
+  Iterations() : offsets(1, 0) {}
+
+  uint32_t getLayerId(const std::string& name)
+  {
+    std::unordered_map<std::string, uint32_t>::const_iterator found = layerIds.find(name);
+    if(found != layerIds.end())
+      return found->second;
+
+    layerIds[name] = layerNames.size();
+    layerNames.push_back(name);
+    return layerNames.size() - 1;
+  }
+
+  inline size_t size() const { return latencies.size(); }
+};
+
+// time series sampled during the run
+struct Series
+{
+  std::string name;
+  std::vector<double> times;  // s since the epoch, sorted
+  std::vector<double> values;
+};
+
+typedef std::pair<uint32_t, float> LayerTime;
+
+bool loadTrace(const char* path, uint64_t skip, Iterations& iterations)
+{
+  profiling::MappedFile file;
+  if(!file.open(path))
+    return false;
+
+  profiling::TraceReader reader(file.getData(), file.getData() + file.getSize());
+  profiling::TraceRecord record;
+  std::vector<LayerTime> pending;
+  uint64_t inference = 0;
+
+  while(reader.next(record))
+  {
+    if(record.type == profiling::TRACE_LAYER)
+    {
+      pending.push_back(LayerTime(iterations.getLayerId(std::string(record.name, record.nameLength)), record.values[0]));
+      continue;
+    }
+
+    if(record.type != profiling::TRACE_MODEL_TOTAL)
+      continue;
+
+    // with several streams, the layers of this inference are the ones of its session
+    const std::string session = std::string(record.name, record.sessionLength) + "/";
+    const bool keep = inference++ >= skip;
+    size_t kept = 0;
+
+    for(size_t n = 0; n < pending.size(); n++)
+    {
+      const std::string& name = iterations.layerNames[pending[n].first];
+      if(record.sessionLength == 0 || name.compare(0, session.size(), session) == 0)
+      {
+        if(keep)
+        {
+          iterations.ids.push_back(pending[n].first);
+          iterations.durations.push_back(pending[n].second);
+        }
+      }
+      else
+        pending[kept++] = pending[n];
+    }
+    pending.resize(kept);
+
+    if(keep)
+    {
+      iterations.latencies.push_back(record.values[0]);
+      iterations.starts.push_back(record.values[1]);
+      iterations.offsets.push_back(iterations.ids.size());
+    }
+  }
+  return true;
+}
+
+bool loadStore(const char* path, uint64_t skip, Iterations& iterations, std::vector<Series>& series)
+{
+  profiling::ColumnStore store;
+  if(!store.open(path))
+    return false;
+
+  const profiling::TableInfo* inferences = store.getTable(STORE_INFERENCES_TABLE);
+  const profiling::TableInfo* layers = store.getTable(STORE_LAYERS_TABLE);
+  if(!inferences || !layers)
+  {
+    printf(ERROR "%s has no layer or inference table.\n", path);
+    return false;
+  }
+
+  iterations.layerNames = store.getDictionary();
+
+  std::vector<std::vector<int64_t> > columns;
+  std::vector<std::vector<int64_t> > layerColumns;
+  std::vector<int> projection(3);
+  std::vector<profiling::ColumnRange> ranges(1);
+
+  projection[0] = inferences->getColumnIndex("run");
+  projection[1] = inferences->getColumnIndex("start");
+  projection[2] = inferences->getColumnIndex("duration");
+  const profiling::ColumnRange inferenceRuns = { projection[0], (int64_t)skip, INT64_MAX };
+  ranges[0] = inferenceRuns;
+  profiling::ColumnScan inferenceScan(store, *inferences, projection, ranges);
+
+  projection[0] = layers->getColumnIndex("run");
+  projection[1] = layers->getColumnIndex("layer");
+  projection[2] = layers->getColumnIndex("duration");
+  const profiling::ColumnRange layerRuns = { projection[0], (int64_t)skip, INT64_MAX };
+  ranges[0] = layerRuns;
+  profiling::ColumnScan layerScan(store, *layers, projection, ranges);
+
+  // both tables are in run order, the layers of run r are before the model_total of run r
+  size_t layerCount = layerScan.next(layerColumns);
+  size_t layerRow = 0;
+
+  for(size_t count = inferenceScan.next(columns); count > 0; count = inferenceScan.next(columns))
+  {
+    for(size_t row = 0; row < count; row++)
+    {
+      const int64_t run = columns[0][row];
+
+      while(layerCount > 0)
+      {
+        if(layerRow == layerCount)
+        {
+          layerCount = layerScan.next(layerColumns);
+          layerRow = 0;
+          continue;
+        }
+        if(layerColumns[0][layerRow] > run)
+          break;
+
+        if(layerColumns[0][layerRow] == run)
+        {
+          iterations.ids.push_back(layerColumns[1][layerRow]);
+          iterations.durations.push_back(layerColumns[2][layerRow] * 1e-6);
+        }
+        layerRow++;
+      }
+
+      iterations.starts.push_back(columns[1][row] * 1e-3);
+      iterations.latencies.push_back(columns[2][row] * 1e-6);
+      iterations.offsets.push_back(iterations.ids.size());
+    }
+  }
+
+  const profiling::TableInfo* power = store.getTable(STORE_POWER_TABLE);
+  if(power)
+  {
+    Series samples;
+    samples.name = "power (mW)";
+
+    std::vector<int> powerProjection(2);
+    powerProjection[0] = power->getColumnIndex("time");
+    powerProjection[1] = power->getColumnIndex("power");
+    const profiling::ColumnRange watched = { powerProjection[1], 0, INT64_MAX };
+
+    profiling::ColumnScan scan(store, *power, powerProjection, std::vector<profiling::ColumnRange>(1, watched));
+    for(size_t count = scan.next(columns); count > 0; count = scan.next(columns))
+    {
+      for(size_t row = 0; row < count; row++)
+      {
+        samples.times.push_back(columns[0][row] * 1e-9);
+        samples.values.push_back(columns[1][row]);
+      }
+    }
+
+    if(!samples.times.empty())
+      series.push_back(samples);
+  }
+  return true;
+}
+
+// Capture of the power profiler, sec;nsec;current;voltage;power. The power only, or the
+// current, voltage and power of the rail for `allValues`, the values not watched are left out.
+bool loadCapture(const char* path, bool allValues, std::vector<Series>& series)
+{
+  profiling::MappedFile file;
+  if(!file.open(path))
+    return false;
+
+  const std::string rail = profiling::CaptureReader::getRailName(file.getData(), file.getData() + file.getSize());
+  Series samples[3];
+  samples[0].name = rail + " current (mA)";
+  samples[1].name = rail + " voltage (mV)";
+  samples[2].name = allValues ? rail + " power (mW)" : "power (mW)";
+
+  profiling::CaptureReader reader(file.getData(), file.getData() + file.getSize());
+  profiling::CaptureSample sample;
+
+  while(reader.next(sample))
+  {
+    const int32_t values[3] = { sample.current, sample.voltage, sample.power };
+    for(int n = allValues ? 0 : 2; n < 3; n++)
+    {
+      if(values[n] < 0)
+        continue;  // not watched
+
+      samples[n].times.push_back(sample.time * 1e-9);
+      samples[n].values.push_back(values[n]);
+    }
+  }
+
+  for(int n = 0; n < 3; n++)
+  {
+    if(!samples[n].times.empty())
+      series.push_back(samples[n]);
+  }
+  return true;
+}
+
+// Samples `time;NAME;...`, one series per column, or another capture of the power profiler
+bool loadSamples(const char* path, std::vector<Series>& series)
+{
+  FILE* file = fopen(path, "r");
+  if(!file)
+  {
+    printf(ERROR "Unable to open file %s.\n", path);
+    return false;
+  }
+
+  char line[1024];
+  if(!fgets(line, sizeof(line), file))
+  {
+    fclose(file);
+    printf(ERROR "%s is empty.\n", path);
+    return false;
+  }
+
+  if(strncmp(line, "start_time_sec;", 15) == 0)
+  {
+    fclose(file);
+    return loadCapture(path, true, series);
+  }
+
+  const size_t first = series.size();
+  for(char* name = strtok(line, ";\r\n"); name != NULL; name = strtok(NULL, ";\r\n"))
+  {
+    if(strcmp(name, "time") == 0)
+      continue;
+    series.push_back(Series());
+    series.back().name = name;
+  }
+
+  while(fgets(line, sizeof(line), file))
+  {
+    char* field = line;
+    char* end = NULL;
+    const double time = strtod(field, &end);
+    if(end == field)
+      continue;
+
+    for(size_t n = first; n < series.size() && *end == ';'; n++)
+    {
+      field = end + 1;
+      const double value = strtod(field, &end);
+      if(end == field)
+        continue;  // missing value
+      series[n].times.push_back(time);
+      series[n].values.push_back(value);
+    }
+  }
+
+  fclose(file);
+  return true;
+}
+
+// Value of a series during each iteration: the mean of its samples within the iteration,
+// or the last sample before it. NAN without a sample.
+void alignSeries(const Series& series, const Iterations& iterations, std::vector<double>& values)
+{
+  values.assign(iterations.size(), NAN);
+
+  for(size_t n = 0; n < iterations.size(); n++)
+  {
+    const double start = iterations.starts[n] * 1e-3;
+    const double end = start + iterations.latencies[n] * 1e-3;
+
+    std::vector<double>::const_iterator sample = std::lower_bound(series.times.begin(), series.times.end(), start);
+    double sum = 0;
+    size_t count = 0;
+    for(std::vector<double>::const_iterator it = sample; it != series.times.end() && *it <= end; it++, count++)
+      sum += series.values[it - series.times.begin()];
+
+    if(count > 0)
+      values[n] = sum / count;
+    else if(sample != series.times.begin())
+      values[n] = series.values[sample - series.times.begin() - 1];
+  }
+}
+
+double pearson(const std::vector<double>& x, const std::vector<double>& y)
+{
+  double count = 0, meanX = 0, meanY = 0, cxx = 0, cyy = 0, cxy = 0;
+
+  for(size_t n = 0; n < x.size(); n++)
+  {
+    if(isnan(x[n]) || isnan(y[n]))
+      continue;
+
+    // one pass update of the means and co-moments
+    count++;
+    const double dx = x[n] - meanX;
+    const double dy = y[n] - meanY;
+    meanX += dx / count;
+    meanY += dy / count;
+    cxx += dx * (x[n] - meanX);
+    cyy += dy * (y[n] - meanY);
+    cxy += dx * (y[n] - meanY);
+  }
+  return cxx > 0 && cyy > 0 ? cxy / sqrt(cxx * cyy) : 0.0;
+}
+
+// Nearest rank percentile (0 to 1) of sorted values
+double percentileOf(const std::vector<double>& sorted, double percentile)
+{
+  if(sorted.empty())
+    return 0.0;
+  const size_t rank = (size_t)ceil(percentile * sorted.size());
+  return sorted[std::min(rank > 0 ? rank - 1 : 0, sorted.size() - 1)];
+}
+
+// share of each layer in the time of a set of iterations
+struct LayerExcess
+{
+  uint32_t id;
+  double typical;  // ms per iteration
+  double tail;
+  double spiked;   // fraction of the tail iterations where the layer is above its p95
+};
+
+void attribute(const Iterations& iterations, const std::vector<float>& spikeThresholds, double percentile, uint32_t top,
+               const std::vector<Series>& series, const std::vector<std::vector<double> >& seriesValues, FILE* output)
+{
+  std::vector<double> sorted(iterations.latencies);
+  std::sort(sorted.begin(), sorted.end());
+
+  const double threshold = percentileOf(sorted, percentile * 0.01);
+  const double low = percentileOf(sorted, 0.25);
+  const double high = percentileOf(sorted, 0.75);
+
+  const size_t layers = iterations.layerNames.size();
+  std::vector<double> tailSums(layers, 0), typicalSums(layers, 0), spikes(layers, 0);
+  std::vector<bool> isTail(iterations.size(), false);
+  size_t tailCount = 0, typicalCount = 0;
+  double tailLatency = 0, typicalLatency = 0;
+
+  for(size_t n = 0; n < iterations.size(); n++)
+  {
+    const double latency = iterations.latencies[n];
+    const bool tail = latency >= threshold;
+    const bool typical = latency >= low && latency <= high;
+    if(!tail && !typical)
+      continue;
+
+    isTail[n] = tail;
+    (tail ? tailCount : typicalCount)++;
+    (tail ? tailLatency : typicalLatency) += latency;
+
+    for(size_t i = iterations.offsets[n]; i < iterations.offsets[n + 1]; i++)
+    {
+      const uint32_t id = iterations.ids[i];
+      (tail ? tailSums : typicalSums)[id] += iterations.durations[i];
+      if(tail && iterations.durations[i] > spikeThresholds[id])
+        spikes[id]++;
+    }
+  }
+
+  if(tailCount == 0 || typicalCount == 0)
+  {
+    printf(WARNING "Not enough inferences to compare the p%g tail.\n", percentile);
+    return;
+  }
+
+  tailLatency /= tailCount;
+  typicalLatency /= typicalCount;
+  const double excess = tailLatency - typicalLatency;
+
+  std::vector<LayerExcess> ranked;
+  double layersExcess = 0;
+  for(uint32_t id = 0; id < layers; id++)
+  {
+    if(tailSums[id] == 0 && typicalSums[id] == 0)
+      continue;
+
+    LayerExcess layer = { id, typicalSums[id] / typicalCount, tailSums[id] / tailCount, spikes[id] / tailCount };
+    layersExcess += layer.tail - layer.typical;
+    ranked.push_back(layer);
+  }
+
+  std::sort(ranked.begin(), ranked.end(), [](const LayerExcess& a, const LayerExcess& b) {
+    return a.tail - a.typical > b.tail - b.typical;
+  });
+
+  printf("\np%g tail: %zu inferences >= %.4f ms, mean %.4f ms. typical (p25-p75): %zu inferences, mean %.4f ms.\n", percentile,
+         tailCount, threshold, tailLatency, typicalCount, typicalLatency);
+  printf("excess of a tail inference: %.4f ms, %.4f ms (%.1f%%) in the layers, %.4f ms outside of them.\n", excess,
+         layersExcess, excess != 0 ? 100.0 * layersExcess / excess : 0.0, excess - layersExcess);
+
+  printf("%-48s %11s %11s %11s %9s %9s\n", "layer", "typical", "tail", "excess", "share", "spiked");
+  for(size_t n = 0; n < ranked.size() && n < top; n++)
+  {
+    const LayerExcess& layer = ranked[n];
+    std::string name = iterations.layerNames[layer.id];
+    if(name.size() > 48)
+      name = "..." + name.substr(name.size() - 45);
+
+    printf("%-48s %11.4f %11.4f %+11.4f %8.1f%% %8.1f%%\n", name.c_str(), layer.typical, layer.tail, layer.tail - layer.typical,
+           excess != 0 ? 100.0 * (layer.tail - layer.typical) / excess : 0.0, 100.0 * layer.spiked);
+  }
+
+  // does the tail follow the state of the device
+  for(size_t s = 0; s < series.size(); s++)
+  {
+    double tailSum = 0, typicalSum = 0;
+    size_t tailSamples = 0, typicalSamples = 0;
+    std::vector<double> indicator(iterations.size(), NAN);
+
+    for(size_t n = 0; n < iterations.size(); n++)
+    {
+      const double value = seriesValues[s][n];
+      const double latency = iterations.latencies[n];
+      if(isnan(value) || (!isTail[n] && (latency < low || latency > high)))
+        continue;
+
+      indicator[n] = isTail[n] ? 1.0 : 0.0;
+      if(isTail[n])
+      {
+        tailSum += value;
+        tailSamples++;
+      }
+      else
+      {
+        typicalSum += value;
+        typicalSamples++;
+      }
+    }
+
+    if(tailSamples == 0 || typicalSamples == 0)
+    {
+      printf("%s: no samples during the tail or typical inferences\n", series[s].name.c_str());
+      continue;
+    }
+
+    printf("%s: typical %.3f, tail %.3f, correlation with the tail %+.3f, with the latency %+.3f\n", series[s].name.c_str(),
+           typicalSum / typicalSamples, tailSum / tailSamples, pearson(indicator, seriesValues[s]),
+           pearson(iterations.latencies, seriesValues[s]));
+  }
+
+  if(output)
+  {
+    for(size_t n = 0; n < ranked.size(); n++)
+    {
+      const LayerExcess& layer = ranked[n];
+      fprintf(output, "%g;%s;%zu;%zu;%f;%f;%f;%f;%f\n", percentile, iterations.layerNames[layer.id].c_str(), tailCount,
+              typicalCount, layer.typical, layer.tail, layer.tail - layer.typical,
+              excess != 0 ? (layer.tail - layer.typical) / excess : 0.0, layer.spiked);
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  arg_option options[] = {
+    OPT_BOOLEAN('h', "help",        NULL),
+    OPT_STRING ('i', "input",       NULL),
+    OPT_STRING ('p', "power",       NULL),
+    OPT_STRING ('m', "samples",     NULL),
+    OPT_STRING ('c', "percentiles", NULL),
+    OPT_INTEGER('t', "top",         NULL),
+    OPT_INTEGER('s', "skip",        NULL),
+    OPT_STRING ('o', "output",      NULL),
+  };
+
+  command_line cmd = { options, 8 };
+  parse_command_line(&cmd, argc, argv);
+
+  const char* inputPath = (const char*) get_option_value(&cmd, "input");
+  if(get_option_value(&cmd, "help") || !inputPath)
+  {
+    free_command_line(&cmd);
+    usage();
+    exit(inputPath ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  int* value = (int*) get_option_value(&cmd, "top");
+  const uint32_t top = (value && *value > 0) ? *value : 10;
+  value = (int*) get_option_value(&cmd, "skip");
+  const uint64_t skip = (value && *value > 0) ? *value : 0;
+
+  std::vector<double> percentiles;
+  const char* list = (const char*) get_option_value(&cmd, "percentiles");
+  for(const char* c = list ? list : "95,99"; *c != '\0'; )
+  {
+    char* end = NULL;
+    const double percentile = strtod(c, &end);
+    if(end == c || percentile <= 50 || percentile >= 100)
+    {
+      printf(ERROR "Unexpected percentiles %s, use values between 50 and 100 separated by commas.\n", list);
+      free_command_line(&cmd);
+      exit(EXIT_FAILURE);
+    }
+    percentiles.push_back(percentile);
+    c = *end == ',' ? end + 1 : end;
+  }
+
+  Iterations iterations;
+  std::vector<Series> series;
+
+  const bool store = profiling::ColumnStore::isColumnStore(inputPath);
+  bool loaded = store ? loadStore(inputPath, skip, iterations, series) : loadTrace(inputPath, skip, iterations);
+
+  const char* powerPath = (const char*) get_option_value(&cmd, "power");
+  if(loaded && powerPath)
+  {
+    // the capture replaces the power table of the store
+    if(store && !series.empty())
+      series.clear();
+    loaded = loadCapture(powerPath, false, series);
+  }
+
+  const char* samplesPath = (const char*) get_option_value(&cmd, "samples");
+  if(loaded && samplesPath)
+    loaded = loadSamples(samplesPath, series);
+
+  const char* outputPath = (const char*) get_option_value(&cmd, "output");
+  FILE* output = (loaded && outputPath) ? fopen(outputPath, "w") : NULL;
+  if(loaded && outputPath && !output)
+  {
+    printf(ERROR "Unable to open file %s.\n", outputPath);
+    loaded = false;
+  }
+  if(loaded && iterations.size() < 4)
+  {
+    printf(ERROR "Only %zu inferences in %s.\n", iterations.size(), inputPath);
+    loaded = false;
+  }
+  free_command_line(&cmd);
+
+  if(!loaded)
+  {
+    if(output)
+      fclose(output);
+    exit(EXIT_FAILURE);
+  }
+
+  // spike threshold of each layer
+  std::vector<float> spikeThresholds(iterations.layerNames.size(), 0);
+  {
+    std::vector<std::vector<float> > times(iterations.layerNames.size());
+    for(size_t i = 0; i < iterations.ids.size(); i++)
+      times[iterations.ids[i]].push_back(iterations.durations[i]);
+
+    for(size_t id = 0; id < times.size(); id++)
+    {
+      if(times[id].empty())
+        continue;
+      std::vector<float>::iterator nth = times[id].begin() + (size_t)(SPIKE_PERCENTILE * (times[id].size() - 1));
+      std::nth_element(times[id].begin(), nth, times[id].end());
+      spikeThresholds[id] = *nth;
+    }
+  }
+
+  std::vector<std::vector<double> > seriesValues(series.size());
+  for(size_t s = 0; s < series.size(); s++)
+    alignSeries(series[s], iterations, seriesValues[s]);
+
+  printf(INFO "%zu inferences, %zu layers, %zu sampled series.\n", iterations.size(), iterations.layerNames.size(), series.size());
+  printf("share: part of the excess latency of a tail inference due to the layer. "
+         "spiked: tail inferences where the layer is above its own p95.\n");
+
+  if(output)
+    fprintf(output, "percentile;layer;tail_count;typical_count;typical_ms;tail_ms;excess_ms;share;spiked\n");
+
+  for(size_t n = 0; n < percentiles.size(); n++)
+    attribute(iterations, spikeThresholds, percentiles[n], top, series, seriesValues, output);
+
+  if(output)
+    fclose(output);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,235 @@
+#include "allocTracker.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace profiling;
+
+namespace
+{
+    bool gEnabled = false;
+
+    // a plain struct, thread local storage of the executable doesn't allocate
+    thread_local AllocCounts gCounts = { 0, 0, 0 };
+
+    inline void countAllocation(size_t size)
+    {
+        gCounts.allocations++;
+        gCounts.bytes += size;
+    }
+
+    inline void countFree(void* ptr)
+    {
+        if(ptr)
+            gCounts.frees++;
+    }
+}
+
+#ifdef __GLIBC__
+
+// untracked, the hooks go straight to the C library
+#define ALLOC_UNTRACKED  __builtin_expect(!gEnabled, 1)
+
+// the allocator of the C library, under the names it keeps for interposers
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void* __libc_valloc(size_t size);
+    void* __libc_pvalloc(size_t size);
+    void  __libc_free(void* ptr);
+
+    void* malloc(size_t size)
+    {
+        if(ALLOC_UNTRACKED)
+            return __libc_malloc(size);
+
+        countAllocation(size);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        if(ALLOC_UNTRACKED)
+            return __libc_calloc(count, size);
+
+        countAllocation(count * size);
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        if(ALLOC_UNTRACKED)
+            return __libc_realloc(ptr, size);
+
+        // glibc frees the block for a size of 0
+        if(ptr && size == 0)
+        {
+            countFree(ptr);
+            return __libc_realloc(ptr, size);
+        }
+
+        // a new block as far as the caller knows, the old one is freed when it moves
+        countAllocation(size);
+        void* block = __libc_realloc(ptr, size);
+        if(block && block != ptr)
+            countFree(ptr);
+        return block;
+    }
+
+    void* reallocarray(void* ptr, size_t count, size_t size)
+    {
+        // glibc's calls its realloc internally, past the hook
+        size_t bytes;
+        if(__builtin_mul_overflow(count, size, &bytes))
+        {
+            errno = ENOMEM;
+            return NULL;
+        }
+        return realloc(ptr, bytes);
+    }
+
+    void* memalign(size_t alignment, size_t size)
+    {
+        if(ALLOC_UNTRACKED)
+            return __libc_memalign(alignment, size);
+
+        countAllocation(size);
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size)
+    {
+        if(ALLOC_UNTRACKED)
+            return __libc_memalign(alignment, size);
+
+        countAllocation(size);
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** ptr, size_t alignment, size_t size)
+    {
+        if(alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+
+        if(!ALLOC_UNTRACKED)
+            countAllocation(size);
+
+        void* block = __libc_memalign(alignment, size);
+        if(!block)
+            return ENOMEM;
+
+        *ptr = block;
+        return 0;
+    }
+
+    void* valloc(size_t size)
+    {
+        if(ALLOC_UNTRACKED)
+            return __libc_valloc(size);
+
+        countAllocation(size);
+        return __libc_valloc(size);
+    }
+
+    void* pvalloc(size_t size)
+    {
+        if(ALLOC_UNTRACKED)
+            return __libc_pvalloc(size);
+
+        countAllocation(size);
+        return __libc_pvalloc(size);
+    }
+
+    void free(void* ptr)
+    {
+        if(!ALLOC_UNTRACKED)
+            countFree(ptr);
+        __libc_free(ptr);
+    }
+}
+
+bool AllocTracker::enable()
+{
+    gEnabled = true;
+    return true;
+}
+
+#else
+
+bool AllocTracker::enable()
+{
+    return false;
+}
+
+#endif
+
+bool AllocTracker::isEnabled()
+{
+    return gEnabled;
+}
+
+void AllocTracker::getCounts(AllocCounts& counts)
+{
+    counts = gCounts;
+}
+
+bool AllocTracker::readProcessMemory(ProcessMemory& memory)
+{
+    memory.rss = -1;
+    memory.minorFaults = -1;
+    memory.majorFaults = -1;
+
+    // read(), stdio would allocate its buffer
+    const int fd = open("/proc/self/stat", O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    char buffer[1024];
+    const ssize_t size = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+
+    if(size <= 0)
+        return false;
+
+    buffer[size] = '\0';
+
+    // the name of the command can hold spaces and parentheses, the fields start after the last ')'
+    const char* p = strrchr(buffer, ')');
+    if(!p)
+        return false;
+    p++;
+
+    // state is field 3, minflt 10, majflt 12 and rss 24 (pages)
+    int field = 2;
+    int64_t values[25];
+
+    while(*p && field < 24)
+    {
+        while(*p == ' ')
+            p++;
+        if(!*p)
+            break;
+
+        field++;
+        char* next = NULL;
+        values[field] = strtoll(p, &next, 10);
+        p = next != p ? next : strchr(p, ' ');
+
+        if(!p)
+            break;
+    }
+
+    if(field < 24)
+        return false;
+
+    memory.minorFaults = values[10];
+    memory.majorFaults = values[12];
+    memory.rss = values[24] * (sysconf(_SC_PAGESIZE) / 1024);
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef __ALLOC_TRACKER_H__
+#define __ALLOC_TRACKER_H__
+
+#include <stdint.h>
+
+namespace profiling
+{
+    // Heap activity of a thread since it started
+    struct AllocCounts
+    {
+        uint64_t allocations;  // malloc, calloc, realloc, the aligned ones, valloc and the operator new built on them
+        uint64_t frees;
+        uint64_t bytes;        // requested by the allocations
+    };
+
+    // Memory of the process from /proc/self/stat
+    struct ProcessMemory
+    {
+        int64_t rss;          // kB
+        int64_t minorFaults;
+        int64_t majorFaults;
+    };
+
+    /*
+    * Counts the allocations of every thread by interposing the malloc functions of the C library.
+    * Counting is off until enabled: the hooks then go straight to the C library after a single
+    * branch, so they can stay linked in. Only available with glibc, the hooks forward to its __libc_ functions.
+    */
+    class AllocTracker
+    {
+    public:
+        // Start counting, false if the allocations can't be interposed
+        static bool enable();
+        static bool isEnabled();
+
+        // Counts of the calling thread, without allocating
+        static void getCounts(AllocCounts& counts);
+
+        // RSS and faults of the process, without allocating. False if /proc/self/stat can't be read.
+        static bool readProcessMemory(ProcessMemory& memory);
+    };
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef __BACKEND_H__
+#define __BACKEND_H__
+
+#include <stdint.h>
+#include <jetson-utils/imageFormat.h>
+
+namespace profiling
+{
+    // Timed phases of a classification, in the order of the jetson-inference profiler queries
+    enum Phase
+    {
+        PHASE_PREPROCESS = 0,
+        PHASE_NETWORK,
+        PHASE_POSTPROCESS,
+        PHASE_VISUALIZE,
+        PHASE_TOTAL,
+        PHASE_COUNT
+    };
+
+    inline const char* phaseToStr(Phase phase)
+    {
+        static const char* names[] = { "Pre-Process", "Network", "Post-Process", "Visualize", "Total" };
+        return phase < PHASE_COUNT ? names[phase] : "Unknown";
+    }
+
+    struct PhaseTime
+    {
+        double start;  // ms since the epoch
+        float cpu;     // ms
+        float device;  // ms on the device running the network (the CPU for the cpu backend)
+    };
+
+    /*
+    * Receives the execution time of each layer while the network runs.
+    */
+    class LayerReporter
+    {
+    public:
+        virtual ~LayerReporter() {}
+        virtual void reportLayerTime(const char* layerName, float ms) = 0;
+    };
+
+    /*
+    * Runs the network for ImageNet. The TensorRT backend runs the jetson-inference
+    * models, the cpu backend a synthetic layer graph so the harness runs anywhere.
+    */
+    class InferenceBackend
+    {
+    public:
+        virtual ~InferenceBackend() {}
+
+        // Resize and normalize `batchSize` images of the same size into the input tensor
+        virtual bool preProcess(void* const* images, uint32_t batchSize, uint32_t width, uint32_t height, imageFormat format) = 0;
+        inline bool preProcess(void* image, uint32_t width, uint32_t height, imageFormat format)
+        {
+            return preProcess(&image, 1, width, height, format);
+        }
+        // Run the network on the batch in the input tensor
+        virtual bool process() = 0;
+
+        // Class confidences written by process(), getNumClasses() for each image of the batch
+        virtual const float* getOutput() const = 0;
+        virtual uint32_t getNumClasses() const = 0;
+        // Images the input tensor can hold
+        virtual uint32_t getMaxBatchSize() const = 0;
+        virtual const char* getClassDesc(uint32_t index) const = 0;
+
+        // Dimensions of the input tensor
+        virtual uint32_t getInputWidth() const = 0;
+        virtual uint32_t getInputHeight() const = 0;
+
+        virtual const char* getModelPath() const = 0;
+        // Backend name (tensorrt, cpu)
+        virtual const char* getName() const = 0;
+
+        // Report the layer times to `reporter` while processing. NULL to disable.
+        virtual void setLayerReporter(LayerReporter* reporter) = 0;
+
+        // Time a phase run outside of the backend (post processing)
+        virtual void beginPhase(Phase phase) = 0;
+        virtual void endPhase(Phase phase) = 0;
+        // Time of a phase during the last classification. False if it wasn't run.
+        virtual bool queryPhase(Phase phase, PhaseTime& time) = 0;
+    };
+}
+
+#endif
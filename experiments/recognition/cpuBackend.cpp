@@ -0,0 +1,348 @@
+#include "cpuBackend.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jetson-utils/logging.h>
+#include <jetson-utils/timespec.h>
+
+using namespace profiling;
+
+#define CPU_DEFAULT_GRAPH  "resnet-18 (synthetic)"
+
+// resnet-18 layers, with about 2% of its cost so an inference takes tens of milliseconds
+static const SyntheticLayer gDefaultGraph[] = {
+    { "conv1", 2.4, 3136 },
+    { "pool1", 0.1, 784 },
+    { "res2a", 4.6, 784 },
+    { "res2b", 4.6, 784 },
+    { "res3a", 3.6, 392 },
+    { "res3b", 4.6, 392 },
+    { "res4a", 3.6, 196 },
+    { "res4b", 4.6, 196 },
+    { "res5a", 3.6, 98 },
+    { "res5b", 4.6, 98 },
+    { "pool5", 0.05, 98 },
+    { "fc1000", 1.0, 2000 },
+    { "prob", 0.01, 4 }
+};
+
+// floating point operations of one iteration of the compute loop
+#define COMPUTE_FLOP  (2 * 64)
+
+
+CpuBackend::CpuBackend(uint32_t maxBatchSize)
+    : mInputWidth(224), mInputHeight(224), mNumClasses(0), mMaxBatchSize(maxBatchSize), mBatchSize(1),
+      mArena(NULL), mArenaSize(0), mReporter(NULL), mPhasesUsed(0)
+{
+    for(int i = 0; i < 64; i++)
+        mBlock[i] = 1.0f + i * 0.01f;
+}
+
+CpuBackend::~CpuBackend()
+{
+    free(mArena);
+}
+
+CpuBackend* CpuBackend::Create(const commandLine& cmdLine, uint32_t maxBatchSize)
+{
+    return Create(cmdLine.GetString("graph"), cmdLine.GetFloat("cost-scale", 1.0f), maxBatchSize);
+}
+
+CpuBackend* CpuBackend::Create(const char* graphPath, float costScale, uint32_t maxBatchSize)
+{
+    if(costScale <= 0)
+    {
+        LogError("cpuBackend -- invalid cost scale %f\n", costScale);
+        return NULL;
+    }
+
+    if(maxBatchSize == 0)
+    {
+        LogError("cpuBackend -- invalid max batch size %u\n", maxBatchSize);
+        return NULL;
+    }
+
+    CpuBackend* net = new CpuBackend(maxBatchSize);
+
+    if(!net->loadGraph(graphPath, costScale) || !net->init())
+    {
+        delete net;
+        return NULL;
+    }
+
+    LogInfo("cpuBackend -- loaded %s, %zu layers, %u classes, batches of up to %u images\n", net->mGraphPath.c_str(),
+            net->mLayers.size(), net->mNumClasses, net->mMaxBatchSize);
+    return net;
+}
+
+const char* CpuBackend::Usage()
+{
+    return "cpu backend arguments:\n"
+           "  --graph=GRAPH        synthetic layer graph, one directive per line:\n"
+           "                       'input WIDTH HEIGHT', 'classes COUNT' or 'layer NAME MFLOP KB'.\n"
+           "                       Defaults to a resnet-18 like graph.\n"
+           "  --cost-scale=SCALE   multiply the compute and memory cost of the layers. Defaults to 1.\n\n";
+}
+
+bool CpuBackend::loadGraph(const char* path, float costScale)
+{
+    uint32_t classes = 1000;
+    mLayers.clear();
+
+    if(!path)
+    {
+        mGraphPath = CPU_DEFAULT_GRAPH;
+        mLayers.assign(gDefaultGraph, gDefaultGraph + sizeof(gDefaultGraph) / sizeof(gDefaultGraph[0]));
+    }
+    else
+    {
+        std::ifstream file(path);
+        if(!file.is_open())
+        {
+            LogError("cpuBackend -- failed to open graph '%s'\n", path);
+            return false;
+        }
+        mGraphPath = path;
+
+        std::string line;
+        for(int number = 1; std::getline(file, line); number++)
+        {
+            const size_t comment = line.find('#');
+            if(comment != std::string::npos)
+                line.erase(comment);
+
+            std::istringstream tokens(line);
+            std::string directive;
+            if(!(tokens >> directive))
+                continue;  // empty line
+
+            bool valid = false;
+            if(directive == "input")
+                valid = (bool)(tokens >> mInputWidth >> mInputHeight) && mInputWidth > 0 && mInputHeight > 0;
+            else if(directive == "classes")
+                valid = (bool)(tokens >> classes) && classes > 0;
+            else if(directive == "layer")
+            {
+                SyntheticLayer layer;
+                valid = (bool)(tokens >> layer.name >> layer.mflop >> layer.kb) && layer.mflop >= 0;
+                if(valid)
+                    mLayers.push_back(layer);
+            }
+
+            if(!valid)
+            {
+                LogError("cpuBackend -- invalid directive at %s:%d\n", path, number);
+                return false;
+            }
+        }
+    }
+
+    if(mLayers.empty())
+    {
+        LogError("cpuBackend -- graph '%s' has no layers\n", mGraphPath.c_str());
+        return false;
+    }
+
+    for(size_t i = 0; i < mLayers.size(); i++)
+    {
+        mLayers[i].mflop *= costScale;
+        mLayers[i].kb = (uint32_t)(mLayers[i].kb * costScale);
+    }
+
+    mNumClasses = classes;
+    return true;
+}
+
+bool CpuBackend::init()
+{
+    for(size_t i = 0; i < mLayers.size(); i++)
+        mArenaSize = std::max(mArenaSize, (size_t)mLayers[i].kb * 1024 / sizeof(float) * mMaxBatchSize);
+
+    // touch the arena now so the page faults don't land in the first inference
+    if(mArenaSize > 0)
+    {
+        mArena = (float*)malloc(mArenaSize * sizeof(float));
+        if(!mArena)
+        {
+            LogError("cpuBackend -- failed to allocate %zu bytes of activations\n", mArenaSize * sizeof(float));
+            return false;
+        }
+        memset(mArena, 0, mArenaSize * sizeof(float));
+    }
+
+    mInput.assign((size_t)3 * mInputWidth * mInputHeight * mMaxBatchSize, 0.0f);
+    mOutput.assign((size_t)mNumClasses * mMaxBatchSize, 0.0f);
+    mClassDesc.resize(mNumClasses);
+
+    for(size_t n = 0; n < mNumClasses; n++)
+    {
+        char desc[32];
+        snprintf(desc, sizeof(desc), "class %04zu", n);
+        mClassDesc[n] = desc;
+    }
+    return true;
+}
+
+bool CpuBackend::preProcess(void* const* images, uint32_t batchSize, uint32_t width, uint32_t height, imageFormat format)
+{
+    if(batchSize == 0 || batchSize > mMaxBatchSize)
+    {
+        LogError("cpuBackend -- invalid batch size %u (max %u)\n", batchSize, mMaxBatchSize);
+        return false;
+    }
+
+    const size_t pixelSize = imageFormatSize(format);
+    const bool isFloat = (format == IMAGE_RGB32F || format == IMAGE_RGBA32F);
+
+    if(format != IMAGE_RGB8 && format != IMAGE_RGBA8 && !isFloat)
+    {
+        LogError("cpuBackend -- unsupported image format %s\n", imageFormatToStr(format));
+        return false;
+    }
+
+    beginPhase(PHASE_PREPROCESS);
+
+    // nearest neighbor resize to planar RGB with the imagenet mean and deviation
+    static const float mean[] = { 0.485f, 0.456f, 0.406f };
+    static const float stdDev[] = { 0.229f, 0.224f, 0.225f };
+    const size_t planeSize = (size_t)mInputWidth * mInputHeight;
+
+    for(uint32_t n = 0; n < batchSize; n++)
+    {
+        float* input = &mInput[n * 3 * planeSize];
+
+        for(uint32_t y = 0; y < mInputHeight; y++)
+        {
+            const uint32_t sourceY = (uint64_t)y * height / mInputHeight;
+
+            for(uint32_t x = 0; x < mInputWidth; x++)
+            {
+                const uint32_t sourceX = (uint64_t)x * width / mInputWidth;
+                const char* pixel = (const char*)images[n] + ((size_t)sourceY * width + sourceX) * pixelSize;
+
+                for(int c = 0; c < 3; c++)
+                {
+                    const float value = isFloat ? ((const float*)pixel)[c] : ((const unsigned char*)pixel)[c];
+                    input[c * planeSize + (size_t)y * mInputWidth + x] = (value / 255.0f - mean[c]) / stdDev[c];
+                }
+            }
+        }
+    }
+
+    mBatchSize = batchSize;
+    endPhase(PHASE_PREPROCESS);
+    return true;
+}
+
+void CpuBackend::runLayer(const SyntheticLayer& layer, uint32_t batchSize)
+{
+    // independent multiply-adds on a block that stays in registers or L1
+    const uint64_t iterations = (uint64_t)(layer.mflop * 1e6 / COMPUTE_FLOP) * batchSize;
+    for(uint64_t n = 0; n < iterations; n++)
+    {
+        for(int i = 0; i < 64; i++)
+            mBlock[i] = mBlock[i] * 0.999999f + 0.000001f;
+    }
+
+    // stream through the activations
+    const size_t size = (size_t)layer.kb * 1024 / sizeof(float) * batchSize;
+    for(size_t i = 0; i < size; i++)
+        mArena[i] = mArena[i] * 0.5f + mBlock[i & 63];
+}
+
+bool CpuBackend::process()
+{
+    beginPhase(PHASE_NETWORK);
+
+    for(size_t i = 0; i < mLayers.size(); i++)
+    {
+        timespec start, end, duration;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        runLayer(mLayers[i], mBatchSize);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        timeDiff(start, end, &duration);
+        if(mReporter)
+            mReporter->reportLayerTime(mLayers[i].name.c_str(), timeDouble(duration));
+    }
+
+    // deterministic confidences for the input, so an image always gets the same class
+    const size_t inputSize = (size_t)3 * mInputWidth * mInputHeight;
+
+    for(uint32_t b = 0; b < mBatchSize; b++)
+    {
+        const float* input = &mInput[b * inputSize];
+        float* output = &mOutput[(size_t)b * mNumClasses];
+
+        double sum = 0;
+        for(size_t i = 0; i < inputSize; i += 97)
+            sum += input[i];
+
+        uint32_t seed = (uint32_t)(int64_t)(sum * 1000.0) * 2654435761u;
+        float total = 0;
+
+        for(size_t n = 0; n < mNumClasses; n++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            output[n] = expf((seed >> 8) * (8.0f / (1 << 24)));
+            total += output[n];
+        }
+        for(size_t n = 0; n < mNumClasses; n++)
+            output[n] /= total;
+    }
+
+    endPhase(PHASE_NETWORK);
+    return true;
+}
+
+void CpuBackend::beginPhase(Phase phase)
+{
+    if(phase == PHASE_PREPROCESS)
+        mPhasesUsed = 0;  // new classification
+
+    timestamp(&mPhaseStart[phase]);
+}
+
+void CpuBackend::endPhase(Phase phase)
+{
+    timestamp(&mPhaseEnd[phase]);
+    mPhasesUsed |= (1 << phase);
+}
+
+bool CpuBackend::queryPhase(Phase phase, PhaseTime& time)
+{
+    if(phase == PHASE_TOTAL)
+    {
+        // sum of the phases, from the start of the first one
+        bool found = false;
+        time.cpu = 0;
+
+        for(int n = PHASE_TOTAL - 1; n >= 0; n--)
+        {
+            PhaseTime part;
+            if(!queryPhase((Phase)n, part))
+                continue;
+
+            time.start = part.start;
+            time.cpu += part.cpu;
+            found = true;
+        }
+        time.device = time.cpu;
+        return found;
+    }
+
+    if(phase >= PHASE_COUNT || !(mPhasesUsed & (1 << phase)))
+        return false;
+
+    timespec duration;
+    timeDiff(mPhaseStart[phase], mPhaseEnd[phase], &duration);
+
+    time.start = timeDouble(mPhaseStart[phase]);
+    time.cpu = timeDouble(duration);
+    time.device = time.cpu;  // the CPU is the device
+    return true;
+}
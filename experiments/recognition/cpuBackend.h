@@ -0,0 +1,94 @@
+#ifndef __CPU_BACKEND_H__
+#define __CPU_BACKEND_H__
+
+#include <string>
+#include <vector>
+#include <time.h>
+#include <jetson-utils/commandLine.h>
+#include "backend.h"
+
+namespace profiling
+{
+    struct SyntheticLayer
+    {
+        std::string name;
+        double   mflop;  // million floating point operations on cache resident data
+        uint32_t kb;     // KB of activations read and written
+    };
+
+    /*
+    * Runs a synthetic layer graph on the CPU, so the harness and the profiler can
+    * be benchmarked without a GPU. Each layer burns its compute and memory cost and
+    * reports its time like a TensorRT layer.
+    *
+    * Graph files have one directive per line, # starts a comment:
+    *   input WIDTH HEIGHT
+    *   classes COUNT
+    *   layer NAME MFLOP KB
+    */
+    class CpuBackend : public InferenceBackend
+    {
+    public:
+        // create from --graph and --cost-scale
+        static CpuBackend* Create(const commandLine& cmdLine, uint32_t maxBatchSize=1);
+        // load `graphPath`, or the builtin resnet-18 like graph if NULL
+        static CpuBackend* Create(const char* graphPath, float costScale=1.0f, uint32_t maxBatchSize=1);
+
+        virtual ~CpuBackend();
+
+        using InferenceBackend::preProcess;
+        bool preProcess(void* const* images, uint32_t batchSize, uint32_t width, uint32_t height, imageFormat format);
+        bool process();
+
+        inline const float* getOutput() const { return mOutput.data(); }
+        inline uint32_t getNumClasses() const { return mNumClasses; }
+        inline uint32_t getMaxBatchSize() const { return mMaxBatchSize; }
+        inline const char* getClassDesc(uint32_t index) const { return mClassDesc[index].c_str(); }
+        inline uint32_t getInputWidth() const { return mInputWidth; }
+        inline uint32_t getInputHeight() const { return mInputHeight; }
+        inline const char* getModelPath() const { return mGraphPath.c_str(); }
+        inline const char* getName() const { return "cpu"; }
+
+        inline void setLayerReporter(LayerReporter* reporter) { mReporter = reporter; }
+
+        void beginPhase(Phase phase);
+        void endPhase(Phase phase);
+        bool queryPhase(Phase phase, PhaseTime& time);
+
+        inline const std::vector<SyntheticLayer>& getLayers() const { return mLayers; }
+
+        static const char* Usage();
+
+    protected:
+        CpuBackend(uint32_t maxBatchSize);
+
+        bool loadGraph(const char* path, float costScale);
+        bool init();
+        // the cost of a layer grows with the batch, its activations are per image
+        void runLayer(const SyntheticLayer& layer, uint32_t batchSize);
+
+        std::string mGraphPath;
+        std::vector<SyntheticLayer> mLayers;
+        uint32_t mInputWidth;
+        uint32_t mInputHeight;
+        uint32_t mNumClasses;
+        const uint32_t mMaxBatchSize;
+        uint32_t mBatchSize;         // of the last preProcess
+
+        std::vector<float> mInput;   // planar RGB of each image
+        std::vector<float> mOutput;  // class confidences of each image
+        std::vector<std::string> mClassDesc;
+
+        float* mArena;      // activations touched by the layers
+        size_t mArenaSize;  // floats
+        float  mBlock[64];  // registers of the compute loops
+
+        LayerReporter* mReporter;
+
+        timespec mPhaseStart[PHASE_COUNT];
+        timespec mPhaseEnd[PHASE_COUNT];
+        uint32_t mPhasesUsed;
+    };
+}
+
+#endif
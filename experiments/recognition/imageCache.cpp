@@ -0,0 +1,244 @@
+#include "imageCache.h"
+#include "pipeline.h"
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <jetson-utils/loadImage.h>
+#include <jetson-utils/logging.h>
+
+using namespace profiling;
+
+static inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// write all of `data`, pwrite may write less than asked
+static bool writeAt(int fd, const void* data, size_t size, uint64_t offset)
+{
+    const char* bytes = (const char*)data;
+
+    while(size > 0)
+    {
+        ssize_t written = pwrite(fd, bytes, size, offset);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+            return false;
+
+        bytes += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+
+ImageCache::ImageCache() : mSize(0), mData(NULL), mHeader(NULL), mEntries(NULL) {}
+
+ImageCache::~ImageCache()
+{
+    close();
+}
+
+bool ImageCache::open(const char* path, const std::vector<std::string>& images, uint32_t width, uint32_t height, uint32_t threads)
+{
+    close();
+
+    if(map(path) && isValid(images, width, height))
+    {
+        LogInfo("imageCache -- reusing %u images from %s\n", mHeader->count, path);
+        return true;
+    }
+    close();
+
+    LogInfo("imageCache -- decoding %zu images into %s\n", images.size(), path);
+
+    if(!build(path, images, width, height, threads) || !map(path) || !isValid(images, width, height))
+    {
+        LogError("imageCache -- failed to build %s\n", path);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ImageCache::close()
+{
+    if(mData)
+        munmap((void*)mData, mSize);
+
+    mSize = 0;
+    mData = NULL;
+    mHeader = NULL;
+    mEntries = NULL;
+}
+
+const uint8_t* ImageCache::get(uint32_t index, int* width, int* height) const
+{
+    if(!mHeader || index >= mHeader->count || mEntries[index].length == 0)
+        return NULL;
+
+    const ImageCacheEntry& entry = mEntries[index];
+    *width = entry.width;
+    *height = entry.height;
+    return (const uint8_t*)mData + entry.offset;
+}
+
+bool ImageCache::map(const char* path)
+{
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return false;
+
+    struct stat info;
+    if(fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(ImageCacheHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if(mapping == MAP_FAILED)
+    {
+        LogError("imageCache -- failed to map %s (%s)\n", path, strerror(errno));
+        return false;
+    }
+
+    mSize = info.st_size;
+    mData = (const char*)mapping;
+    mHeader = (const ImageCacheHeader*)mapping;
+    mEntries = (const ImageCacheEntry*)(mData + sizeof(ImageCacheHeader));
+
+    if(mHeader->magic != IMAGE_CACHE_MAGIC || mHeader->version != IMAGE_CACHE_VERSION || mHeader->size != mSize ||
+       sizeof(ImageCacheHeader) + (uint64_t)mHeader->count * sizeof(ImageCacheEntry) > mSize)
+    {
+        close();
+        return false;
+    }
+
+    // the images are read in order by the pipeline
+    madvise(mapping, mSize, MADV_WILLNEED);
+    return true;
+}
+
+bool ImageCache::isValid(const std::vector<std::string>& images, uint32_t width, uint32_t height) const
+{
+    if(mHeader->count != images.size() || mHeader->width != width || mHeader->height != height)
+        return false;
+
+    for(size_t i = 0; i < images.size(); i++)
+    {
+        const ImageCacheEntry& entry = mEntries[i];
+        struct stat info;
+
+        if(images[i].compare(0, IMAGE_CACHE_MAX_PATH, entry.path, strnlen(entry.path, IMAGE_CACHE_MAX_PATH)) != 0 ||
+           stat(images[i].c_str(), &info) < 0 ||
+           entry.mtimeSec != info.st_mtim.tv_sec || entry.mtimeNsec != info.st_mtim.tv_nsec ||
+           entry.fileSize != (uint64_t)info.st_size || entry.offset + entry.length > mSize)
+            return false;
+    }
+    return true;
+}
+
+bool ImageCache::build(const char* path, const std::vector<std::string>& images, uint32_t width, uint32_t height, uint32_t threads)
+{
+    // written aside then renamed, so a concurrent run never maps a partial cache
+    const std::string temporary = std::string(path) + ".tmp";
+    const int fd = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if(fd < 0)
+    {
+        LogError("imageCache -- failed to create %s (%s)\n", temporary.c_str(), strerror(errno));
+        return false;
+    }
+
+    std::vector<ImageCacheEntry> entries(images.size());
+    memset(entries.data(), 0, entries.size() * sizeof(ImageCacheEntry));
+
+    std::atomic<size_t> next(0);
+    std::atomic<uint64_t> offset(alignUp(sizeof(ImageCacheHeader) + entries.size() * sizeof(ImageCacheEntry), IMAGE_CACHE_ALIGN));
+    std::atomic<bool> failed(false);
+
+    auto decode = [&]()
+    {
+        std::vector<uint8_t> resized((size_t)width * height * 3);
+
+        for(size_t i = next.fetch_add(1); i < images.size() && !failed; i = next.fetch_add(1))
+        {
+            ImageCacheEntry& entry = entries[i];
+            strncpy(entry.path, images[i].c_str(), IMAGE_CACHE_MAX_PATH - 1);
+
+            struct stat info;
+            if(stat(images[i].c_str(), &info) == 0)
+            {
+                entry.mtimeSec = info.st_mtim.tv_sec;
+                entry.mtimeNsec = info.st_mtim.tv_nsec;
+                entry.fileSize = info.st_size;
+            }
+
+            void* pixels = NULL;
+            int imageWidth = 0;
+            int imageHeight = 0;
+
+            if(!loadImage(images[i].c_str(), &pixels, &imageWidth, &imageHeight, IMAGE_RGB8))
+                continue;  // kept as a failed entry
+
+            const uint8_t* data = (const uint8_t*)pixels;
+            entry.width = imageWidth;
+            entry.height = imageHeight;
+
+            if(width > 0 && height > 0)
+            {
+                resizeImage(data, imageWidth, imageHeight, resized.data(), width, height);
+                data = resized.data();
+                entry.width = width;
+                entry.height = height;
+            }
+
+            entry.length = (uint64_t)entry.width * entry.height * 3;
+            entry.offset = offset.fetch_add(alignUp(entry.length, 64));
+
+            if(!writeAt(fd, data, entry.length, entry.offset))
+                failed = true;
+            releaseImage(pixels);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for(uint32_t i = 0; i < (threads > 0 ? threads : 1); i++)
+        workers.push_back(std::thread(decode));
+    for(size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    ImageCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = IMAGE_CACHE_MAGIC;
+    header.version = IMAGE_CACHE_VERSION;
+    header.count = entries.size();
+    header.width = width;
+    header.height = height;
+    header.size = offset.load();
+
+    if(failed || ftruncate(fd, header.size) < 0 ||
+       !writeAt(fd, entries.data(), entries.size() * sizeof(ImageCacheEntry), sizeof(header)) ||
+       !writeAt(fd, &header, sizeof(header), 0))
+    {
+        LogError("imageCache -- failed to write %s (%s)\n", temporary.c_str(), strerror(errno));
+        ::close(fd);
+        unlink(temporary.c_str());
+        return false;
+    }
+
+    ::close(fd);
+    return rename(temporary.c_str(), path) == 0;
+}
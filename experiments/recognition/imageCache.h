@@ -0,0 +1,77 @@
+#ifndef __IMAGE_CACHE_H__
+#define __IMAGE_CACHE_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define IMAGE_CACHE_MAGIC     0x43434950  // "PICC" little endian
+#define IMAGE_CACHE_VERSION   1
+#define IMAGE_CACHE_MAX_PATH  256
+#define IMAGE_CACHE_ALIGN     4096
+
+namespace profiling
+{
+    /*
+    * Layout of the cache file: the header, the entries, then the decoded RGB8 images
+    * one after the other from the first page boundary.
+    */
+    struct ImageCacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t count;   // entries
+        uint32_t width;   // images are resized to width x height, 0 to keep their size
+        uint32_t height;
+        uint32_t reserved;
+        uint64_t size;    // of the file
+    };
+
+    // An image is stale when its path, modification time or size changed
+    struct ImageCacheEntry
+    {
+        char     path[IMAGE_CACHE_MAX_PATH];
+        int64_t  mtimeSec;
+        int64_t  mtimeNsec;
+        uint64_t fileSize;
+        uint32_t width;   // of the decoded image
+        uint32_t height;
+        uint64_t offset;  // of the pixels from the start of the file
+        uint64_t length;  // 0 if the image couldn't be decoded
+    };
+
+    /*
+    * Decoded images of a dataset in a single memory mapped file.
+    * The images are decoded once, optionally resized to the network input, and
+    * later runs over the same images map the file instead of decoding them again.
+    */
+    class ImageCache
+    {
+    public:
+        ImageCache();
+        ~ImageCache();
+
+        // Map the cache of `images` at `path`. It is rebuilt with `threads` decoding threads if
+        // it is missing or stale. `width` x `height` is the size of the cached images, 0 to keep their size.
+        bool open(const char* path, const std::vector<std::string>& images, uint32_t width, uint32_t height, uint32_t threads=2);
+        void close();
+
+        // Pixels (RGB8) of an image, NULL if it couldn't be decoded
+        const uint8_t* get(uint32_t index, int* width, int* height) const;
+
+        inline bool isOpen() const { return mHeader != NULL; }
+        inline uint32_t getCount() const { return mHeader ? mHeader->count : 0; }
+
+    private:
+        bool isValid(const std::vector<std::string>& images, uint32_t width, uint32_t height) const;
+        bool build(const char* path, const std::vector<std::string>& images, uint32_t width, uint32_t height, uint32_t threads);
+        bool map(const char* path);
+
+        size_t mSize;
+        const char* mData;
+        const ImageCacheHeader* mHeader;
+        const ImageCacheEntry* mEntries;
+    };
+}
+
+#endif
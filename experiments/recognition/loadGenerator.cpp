@@ -0,0 +1,188 @@
+#include "loadGenerator.h"
+
+#include <algorithm>
+#include <random>
+#include <stdio.h>
+#include <strings.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <jetson-utils/logging.h>
+
+using namespace profiling;
+
+static uint64_t monotonicNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void sleepUntil(uint64_t ns)
+{
+    timespec deadline;
+    deadline.tv_sec = ns / 1000000000ULL;
+    deadline.tv_nsec = ns % 1000000000ULL;
+
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) != 0);  // EINTR
+}
+
+
+LoadGenerator::LoadGenerator(ImageNet* net, Arrivals arrivals, uint32_t queueDepth, uint64_t seed)
+    : mNet(net), mArrivals(arrivals), mSeed(seed), mRequests(nextPowerOfTwo(queueDepth), sizeof(Request)), mScheduling(false) {}
+
+LoadGenerator::Arrivals LoadGenerator::ArrivalsFromStr(const char* str)
+{
+    if(str && strcasecmp(str, "poisson") == 0)
+        return ARRIVALS_POISSON;
+    return ARRIVALS_CONSTANT;
+}
+
+const char* LoadGenerator::ArrivalsToStr(Arrivals arrivals)
+{
+    return arrivals == ARRIVALS_POISSON ? "poisson" : "constant";
+}
+
+void LoadGenerator::schedule(double rate, uint64_t start, uint64_t end, Result* result)
+{
+    std::mt19937_64 random(mSeed++);
+    std::exponential_distribution<double> interval(rate);
+    const double period = 1.0 / rate;
+
+    double offset = 0;  // s, kept in floating point so the intervals don't accumulate rounding
+
+    for(uint64_t sequence = 0; ; sequence++)
+    {
+        Request request;
+        request.sequence = sequence;
+        request.arrival = start + (uint64_t)(offset * 1e9);
+
+        if(request.arrival >= end)
+            break;
+
+        // late arrivals are released at once, their latency still runs from the intended time
+        if(monotonicNs() < request.arrival)
+            sleepUntil(request.arrival);
+
+        result->sent++;
+        if(!mRequests.push(&request))
+            result->dropped++;
+
+        offset += (mArrivals == ARRIVALS_POISSON) ? interval(random) : period;
+    }
+
+    mScheduling = false;
+}
+
+bool LoadGenerator::run(double rate, double duration, void* image, uint32_t width, uint32_t height, Result& result)
+{
+    if(rate <= 0 || duration <= 0)
+    {
+        LogError("loadGenerator -- invalid rate %f or duration %f\n", rate, duration);
+        return false;
+    }
+
+    result = Result();
+    result.offered = rate;
+
+    const uint64_t start = monotonicNs() + 1000000;  // leave the scheduler time to start
+    const uint64_t end = start + (uint64_t)(duration * 1e9);
+    const uint64_t deadline = end + (uint64_t)(LOAD_DRAIN_TIMEOUT * 1e9);
+    mScheduling = true;
+    std::thread scheduler(&LoadGenerator::schedule, this, rate, start, end, &result);
+
+    Request request;
+    uint64_t last = start;
+
+    while(monotonicNs() < deadline)
+    {
+        if(!mRequests.pop(&request))
+        {
+            if(!mScheduling.load())
+            {
+                // the scheduler may have pushed a last request before stopping
+                if(!mRequests.pop(&request))
+                    break;
+            }
+            else
+            {
+                usleep(20);
+                continue;
+            }
+        }
+
+        const uint64_t begin = monotonicNs();
+        float confidence = 0.0f;
+        const int classIndex = mNet->classify(image, width, height, IMAGE_RGB8, &confidence);
+        last = monotonicNs();
+
+        if(classIndex < 0)
+        {
+            result.failed++;
+            continue;
+        }
+
+        mNet->inferenceStat();
+
+        result.completed++;
+        result.latency.record(last - request.arrival);
+        result.service.record(last - begin);
+    }
+
+    scheduler.join();
+
+    // overloaded, what is left wasn't served in time
+    while(mRequests.pop(&request))
+        result.dropped++;
+
+    result.elapsed = std::max(duration, (last - start) * 1e-9);
+    return result.completed > 0;
+}
+
+double LoadGenerator::searchMaxRate(double sloMs, double capacity, uint32_t steps, double duration, void* image, uint32_t width, uint32_t height)
+{
+    Result result;
+    double sustained = 0;  // highest rate that held
+    double missed = 0;     // lowest rate that didn't, 0 while unknown
+    double rate = capacity;
+
+    for(uint32_t step = 0; step < steps && rate > 0; step++)
+    {
+        if(!run(rate, duration, image, width, height, result))
+            return sustained;
+
+        printResult(result, sloMs);
+
+        if(isSustained(result, sloMs))
+            sustained = rate;
+        else
+            missed = rate;
+
+        // grow until the slo is missed, then bisect
+        rate = (missed > 0) ? (sustained + missed) / 2 : rate * 2;
+    }
+    return sustained;
+}
+
+bool LoadGenerator::isSustained(const Result& result, double sloMs)
+{
+    return result.dropped == 0 && result.failed == 0 && result.latency.getValueAtPercentile(99.0) * 1e-6 <= sloMs;
+}
+
+void LoadGenerator::printHeader()
+{
+    printf("%10s  %10s  %8s  %7s  %9s  %9s  %9s  %9s  %9s  %11s  %4s\n", "offered/s", "achieved/s", "requests", "dropped",
+           "p50 (ms)", "p90 (ms)", "p99 (ms)", "p99.9 (ms)", "max (ms)", "service p99", "slo");
+}
+
+void LoadGenerator::printResult(const Result& result, double sloMs)
+{
+    const HdrHistogram& latency = result.latency;
+
+    printf("%10.2f  %10.2f  %8llu  %7llu  %9.3f  %9.3f  %9.3f  %9.3f  %9.3f  %11.3f  %4s\n", result.offered,
+           result.getThroughput(), (unsigned long long)result.sent, (unsigned long long)result.dropped,
+           latency.getValueAtPercentile(50.0) * 1e-6, latency.getValueAtPercentile(90.0) * 1e-6,
+           latency.getValueAtPercentile(99.0) * 1e-6, latency.getValueAtPercentile(99.9) * 1e-6,
+           latency.getMax() * 1e-6, result.service.getValueAtPercentile(99.0) * 1e-6,
+           sloMs > 0 ? (isSustained(result, sloMs) ? "ok" : "miss") : "-");
+}
@@ -0,0 +1,84 @@
+#ifndef __LOAD_GENERATOR_H__
+#define __LOAD_GENERATOR_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <profiling/hdrHistogram.h>
+#include <profiling/queue.h>
+#include "myImageNet.h"
+
+#define LOAD_DRAIN_TIMEOUT  1.0  // s after the duration to classify the queued requests
+
+namespace profiling
+{
+    /*
+    * Open loop load: a scheduler thread releases requests at their arrival time whatever
+    * the state of the network, and the calling thread classifies them in order.
+    * The latency of a request runs from its intended arrival, so the time spent waiting
+    * behind slower requests is counted (no coordinated omission).
+    */
+    class LoadGenerator
+    {
+    public:
+        enum Arrivals
+        {
+            ARRIVALS_CONSTANT = 0,  // fixed interval
+            ARRIVALS_POISSON        // exponential intervals
+        };
+
+        struct Result
+        {
+            Result() : offered(0), elapsed(0), sent(0), completed(0), dropped(0), failed(0) {}
+
+            double offered;      // requests/s
+            double elapsed;      // s, the duration or until the last request completed
+            uint64_t sent;
+            uint64_t completed;
+            uint64_t dropped;    // the request queue was full at arrival, or still queued after the drain timeout
+            uint64_t failed;
+            HdrHistogram latency;  // ns, from the intended arrival
+            HdrHistogram service;  // ns, classification only
+
+            inline double getThroughput() const { return elapsed > 0 ? completed / elapsed : 0.0; }
+        };
+
+        // at most `queueDepth` requests wait for the network, the next ones are dropped
+        LoadGenerator(ImageNet* net, Arrivals arrivals=ARRIVALS_CONSTANT, uint32_t queueDepth=4096, uint64_t seed=42);
+
+        // Offer `rate` requests/s of an RGB8 image for `duration` s. The requests still queued
+        // LOAD_DRAIN_TIMEOUT s after the duration are dropped, an overload doesn't stall the run.
+        bool run(double rate, double duration, void* image, uint32_t width, uint32_t height, Result& result);
+
+        // Highest rate sustained within `sloMs` by a bisection over runs of `duration` s, starting from
+        // `capacity` requests/s (the closed loop throughput). Prints each run, returns 0 if no rate was sustained.
+        double searchMaxRate(double sloMs, double capacity, uint32_t steps, double duration, void* image, uint32_t width, uint32_t height);
+
+        // Whether a run sustained its load: nothing dropped, and a p99 latency within `sloMs`
+        static bool isSustained(const Result& result, double sloMs);
+
+        // Print the header and a line of a load sweep
+        static void printHeader();
+        static void printResult(const Result& result, double sloMs);
+
+        static Arrivals ArrivalsFromStr(const char* str);
+        static const char* ArrivalsToStr(Arrivals arrivals);
+
+    private:
+        struct Request
+        {
+            uint64_t sequence;
+            uint64_t arrival;  // intended, ns on the monotonic clock
+        };
+
+        void schedule(double rate, uint64_t start, uint64_t end, Result* result);
+
+        ImageNet* mNet;
+        const Arrivals mArrivals;
+        uint64_t mSeed;
+        RecordQueue mRequests;
+        std::atomic<bool> mScheduling;
+    };
+}
+
+#endif
@@ -0,0 +1,149 @@
+#include "multiStream.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <jetson-utils/logging.h>
+
+using namespace profiling;
+
+static uint64_t monotonicNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+
+double MultiStream::StreamStats::percentile(double p) const
+{
+    if(latencies.empty())
+        return 0.0;
+
+    const size_t index = (size_t)(p * latencies.size());
+    return latencies[std::min(index, latencies.size() - 1)];
+}
+
+uint64_t MultiStream::Run::getClassified() const
+{
+    uint64_t classified = 0;
+    for(size_t i = 0; i < streams.size(); i++)
+        classified += streams[i].classified;
+    return classified;
+}
+
+
+MultiStream::MultiStream(const std::vector<ImageNet*>& nets) : mNets(nets), mReady(0), mStart(false) {}
+
+bool MultiStream::run(uint32_t streams, void* image, uint32_t width, uint32_t height, uint32_t iterations, const char* session, Run& run,
+                      uint32_t batchSize)
+{
+    streams = std::min(streams, (uint32_t)mNets.size());
+
+    run.batchSize = std::max(batchSize, 1u);
+    run.streams.assign(streams, StreamStats());
+    mReady = 0;
+    mStart = false;
+
+    std::vector<std::thread> workers;
+    for(uint32_t n = 0; n < streams; n++)
+        workers.push_back(std::thread(&MultiStream::classify, this, n, image, width, height, iterations, session,
+                                      run.batchSize, std::ref(run.streams[n])));
+
+    // start the streams together once they are all ready
+    while(mReady.load() < streams)
+        std::this_thread::yield();
+
+    const uint64_t start = monotonicNs();
+    mStart = true;
+
+    for(size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    run.elapsed = (monotonicNs() - start) * 1e-9;
+
+    for(uint32_t n = 0; n < streams; n++)
+        std::sort(run.streams[n].latencies.begin(), run.streams[n].latencies.end());
+
+    return run.getClassified() > 0;
+}
+
+void MultiStream::classify(uint32_t stream, void* image, uint32_t width, uint32_t height, uint32_t iterations, const char* session,
+                           uint32_t batchSize, StreamStats& stats)
+{
+    ImageNet* net = mNets[stream];
+
+    // copies of the image for the batches
+    std::vector<void*> images(batchSize, image);
+    std::vector<int> classes(batchSize);
+
+    const std::string name = std::string(session) + std::to_string(stream);
+    file_profiler_t::setSession(name.c_str());
+
+    stats.classified = 0;
+    stats.failed = 0;
+    stats.latencies.reserve(iterations);
+
+    mReady++;
+    while(!mStart.load())
+        std::this_thread::yield();
+
+    for(uint32_t i = 0; i < iterations; i++)
+    {
+        const uint64_t begin = monotonicNs();
+        float confidence = 0.0f;
+
+        const bool success = (batchSize > 1) ? net->classify(images.data(), batchSize, width, height, IMAGE_RGB8, classes.data())
+                                             : net->classify(image, width, height, IMAGE_RGB8, &confidence) >= 0;
+        if(!success)
+        {
+            LogError("%s -- failed to classify image\n", name.c_str());
+            stats.failed++;
+            continue;
+        }
+
+        stats.latencies.push_back((monotonicNs() - begin) * 1e-6);
+        stats.classified++;
+
+        // log inference start and duration
+        net->inferenceStat();
+    }
+
+    file_profiler_t::setSession(NULL);
+}
+
+void MultiStream::printReport(const Run& single, const Run& concurrent)
+{
+    const double singleThroughput = single.getThroughput();
+    const double throughput = concurrent.getThroughput();
+    const size_t streams = concurrent.streams.size();
+
+    printf("streams -- 1 stream: %.2f images/s, %zu streams: %.2f images/s, %.2fx, %.1f%% scaling efficiency\n",
+           singleThroughput, streams, throughput, singleThroughput > 0 ? throughput / singleThroughput : 0.0,
+           singleThroughput > 0 && streams > 0 ? 100.0 * throughput / (singleThroughput * streams) : 0.0);
+
+    printf("  %-8s  %10s  %7s  %10s  %10s  %10s  %10s  %10s\n", "stream", "classified", "failed", "images/s",
+           "p50 (ms)", "p95 (ms)", "p99 (ms)", "max (ms)");
+
+    const struct { const char* name; const Run* run; } runs[] = { { "single", &single }, { "stream", &concurrent } };
+
+    for(size_t r = 0; r < 2; r++)
+    {
+        const Run& run = *runs[r].run;
+
+        for(size_t n = 0; n < run.streams.size(); n++)
+        {
+            const StreamStats& stats = run.streams[n];
+            char name[32];
+            snprintf(name, sizeof(name), "%s%zu", runs[r].name, n);
+
+            printf("  %-8s  %10llu  %7llu  %10.2f  %10.3f  %10.3f  %10.3f  %10.3f\n", name,
+                   (unsigned long long)stats.classified, (unsigned long long)stats.failed,
+                   run.elapsed > 0 ? stats.classified * run.batchSize / run.elapsed : 0.0,
+                   stats.percentile(0.5), stats.percentile(0.95), stats.percentile(0.99), stats.percentile(1.0));
+        }
+    }
+}
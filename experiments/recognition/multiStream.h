@@ -0,0 +1,65 @@
+#ifndef __MULTI_STREAM_H__
+#define __MULTI_STREAM_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include "myImageNet.h"
+
+namespace profiling
+{
+    /*
+    * Runs several networks concurrently, one per thread, like the camera streams of a deployment.
+    * Each network has its own backend (execution context) and its profiler lines are
+    * prefixed with the name of its stream.
+    */
+    class MultiStream
+    {
+    public:
+        struct StreamStats
+        {
+            uint64_t classified;
+            uint64_t failed;
+            std::vector<double> latencies;  // ms of each classification, sorted after a run
+
+            // latency at `p` (0 to 1) of the sorted latencies
+            double percentile(double p) const;
+        };
+
+        struct Run
+        {
+            Run() : elapsed(0), batchSize(1) {}
+
+            double elapsed;      // s, from the start of the first stream to the end of the last one
+            uint32_t batchSize;  // images of each classification
+            std::vector<StreamStats> streams;
+
+            // classifications (batches) of all the streams
+            uint64_t getClassified() const;
+            // images/s of all the streams
+            inline double getThroughput() const { return elapsed > 0 ? getClassified() * batchSize / elapsed : 0.0; }
+        };
+
+        // The networks are owned by the caller
+        MultiStream(const std::vector<ImageNet*>& nets);
+
+        // Classify an RGB8 image `iterations` times on each of the first `streams` networks, all at once, in batches
+        // of `batchSize` copies. The profiler sessions are named `session` followed by the stream number.
+        // Returns false if nothing was classified.
+        bool run(uint32_t streams, void* image, uint32_t width, uint32_t height, uint32_t iterations, const char* session, Run& run,
+                 uint32_t batchSize=1);
+
+        // Print the throughput, the latency percentiles of each stream and the scaling over `single`, a run with one stream
+        static void printReport(const Run& single, const Run& concurrent);
+
+    private:
+        void classify(uint32_t stream, void* image, uint32_t width, uint32_t height, uint32_t iterations, const char* session,
+                      uint32_t batchSize, StreamStats& stats);
+
+        std::vector<ImageNet*> mNets;
+        std::atomic<uint32_t> mReady;  // threads waiting for the start
+        std::atomic<bool> mStart;
+    };
+}
+
+#endif
@@ -1,40 +1,54 @@
 #include "myImageNet.h"
+#include "cpuBackend.h"
+#include "tensorrtBackend.h"
+
+#include <profiling/topk.h>
+
+#include <algorithm>
+#include <string>
+#include <strings.h>
 
 using namespace profiling;
 
-// static ImageNet::buffer;
+#ifdef WITH_TENSORRT
+#define DEFAULT_BACKEND "tensorrt"
+#else
+#define DEFAULT_BACKEND "cpu"
+#endif
 
 // constructor
-ImageNet::ImageNet() : imageNet() {}
+ImageNet::ImageNet(InferenceBackend* backend) : mBatchSize(0), mBackend(backend), mCounters(NULL), mCounted(false),
+	mTrackAllocations(false), mAllocCounted(false), mAllocWarmup(0), mAllocIterations(0), mAllocatingIterations(0) {}
 
 // destructor
-ImageNet::~ImageNet() {}
+ImageNet::~ImageNet()
+{
+	if( mAllocatingIterations > 0 )
+		LogWarning("myImageNet -- %llu of %llu classifications allocated after the warmup\n",
+		           (unsigned long long)mAllocatingIterations, (unsigned long long)(mAllocIterations - std::min<uint64_t>(mAllocIterations, mAllocWarmup)));
+
+	delete mCounters;
+	delete mBackend;
+}
 
 // Create
-ImageNet* ImageNet::Create( const commandLine& cmdLine )
+ImageNet* ImageNet::Create( const commandLine& cmdLine, uint32_t maxBatchSize )
 {
-	ImageNet* net = NULL;
+	InferenceBackend* backend = NULL;
 
-	// obtain the network name
-	const char* modelName = cmdLine.GetString("network");
-	
-	if( !modelName )
-		modelName = cmdLine.GetString("model", "googlenet");
-	
-	// parse the network type
-	const ImageNet::NetworkType type = NetworkTypeFromStr(modelName);
+	// obtain the backend name
+	const char* backendName = cmdLine.GetString("backend", DEFAULT_BACKEND);
 
-	if( type == ImageNet::CUSTOM )
-	{
-        // Custom network not supported yet
-        LogError(LOG_TRT "myImageNet -- custom models not supperted.");
-		net = NULL;
-	}
+	if( strcasecmp(backendName, "cpu") == 0 )
+		backend = CpuBackend::Create(cmdLine, maxBatchSize);
+#ifdef WITH_TENSORRT
+	else if( strcasecmp(backendName, "tensorrt") == 0 )
+		backend = TensorRTBackend::Create(cmdLine, maxBatchSize);
+#endif
 	else
-	{
-		// create from pretrained model
-		net = ImageNet::Create(type);
-	}
+		LogError("myImageNet -- unknown backend '%s'\n", backendName);
+
+	ImageNet* net = Create(backend);
 
 	if( !net )
 		return NULL;
@@ -43,92 +57,380 @@ ImageNet* ImageNet::Create( const commandLine& cmdLine )
 	if( cmdLine.GetFlag("profile") )
 		net->enableLayerProfiler();
 
+	// read the hardware counters of each phase
+	if( cmdLine.GetFlag("counters") )
+		net->enableCounters();
+
+	// count the allocations of each phase
+	if( cmdLine.GetFlag("allocations") )
+		net->enableAllocationTracking(cmdLine.GetUnsignedInt("alloc-warmup", 2));
+
 	return net;
 }
 
+ImageNet* ImageNet::Create( InferenceBackend* backend )
+{
+	if( !backend )
+		return NULL;
+
+	return new ImageNet(backend);
+}
+
+const char* ImageNet::Usage()
+{
+	static std::string usage;
+
+	if( usage.empty() )
+	{
+		usage = "backend arguments:\n"
+		        "  --backend=BACKEND    inference backend, tensorrt or cpu. Defaults to " DEFAULT_BACKEND ".\n"
+		        "  --counters           write the cycles, instructions, cache and branch misses, task clock, context\n"
+		        "                       switches and page faults of each phase to the profiler output (counters lines).\n"
+		        "  --allocations        write the allocations of each phase, the RSS and the page faults of each\n"
+		        "                       classification to the profiler output (memory lines), and report the\n"
+		        "                       classifications that allocate after the warmup.\n"
+		        "  --alloc-warmup=N     classifications allowed to allocate, to size the buffers. Defaults to 2.\n\n";
+#ifdef WITH_TENSORRT
+		usage += TensorRTBackend::Usage();
+		usage += "  --precision=PRECISION  fp32, fp16 or int8 engine. Defaults to the fastest the device supports.\n\n";
+#endif
+		usage += CpuBackend::Usage();
+	}
+	return usage.c_str();
+}
+
 void ImageNet::enableLayerProfiler()
 {
-    mEnableProfiler = true;
+    mBackend->setLayerReporter(&gProfiler);
+}
 
-    if(mContext != NULL)
-        mContext->setProfiler(&gProfiler);
+void ImageNet::enableCounters()
+{
+	if( !mCounters )
+		mCounters = new PerfCounters();
 }
 
-ImageNet* ImageNet::Create(ImageNet::NetworkType networkType, uint32_t maxBatchSize, 
-                precisionType precision, deviceType device, bool allowGPUFallback)
+bool ImageNet::enableAllocationTracking( uint32_t warmup )
 {
-    ImageNet* net = new ImageNet();
-	
-	if( !net )
-		return NULL;
-	
-	if( !net->init(networkType, maxBatchSize, precision, device, allowGPUFallback) )
+	if( !AllocTracker::enable() )
 	{
-		LogError(LOG_TRT "myImageNet -- failed to initialize.\n");
-		return NULL;
+		LogError("myImageNet -- allocations can only be counted with glibc\n");
+		return false;
 	}
-	
-	net->mNetworkType = networkType;
-	return net;
+
+	mTrackAllocations = true;
+	mAllocWarmup = warmup;
+	return true;
 }
 
-// Classify
-int ImageNet::classify( void* image, uint32_t width, uint32_t height, imageFormat format, float* confidence )
+void ImageNet::readCounters( CounterPoint point )
 {
-	// verify parameters
-	if( !image || width == 0 || height == 0 )
+	// the perf counters are read first at the end and last at the start, so the measured
+	// window doesn't include the /proc reads and the warnings of the allocation tracking
+	if( point != COUNTERS_START )
+		readPerfCounters(point);
+
+	if( mTrackAllocations )
 	{
-		LogError(LOG_TRT "imageNet::Classify( 0x%p, %u, %u ) -> invalid parameters\n", image, width, height);
-		return -1;
+		if( point == COUNTERS_START )
+		{
+			mAllocCounted = false;
+			AllocTracker::readProcessMemory(mMemoryStart);
+		}
+
+		AllocTracker::getCounts(mAllocSamples[point]);
+
+		if( point == COUNTERS_END )
+		{
+			AllocTracker::readProcessMemory(mMemoryEnd);
+			checkAllocations();
+		}
 	}
-	
-	// downsample and convert to band-sequential BGR
-	if( !PreProcess(image, width, height, format) )
+
+	if( point == COUNTERS_START )
+		readPerfCounters(point);
+}
+
+void ImageNet::readPerfCounters( CounterPoint point )
+{
+	if( !mCounters )
+		return;
+
+	if( point == COUNTERS_START )
 	{
-		LogError(LOG_TRT "imageNet::Classify() -- tensor pre-processing failed\n");
-		return -1;
+		mCounted = false;
+
+		// the counters only count the thread that opened them
+		if( !mCounters->isOpen() || mCountersThread != std::this_thread::get_id() )
+		{
+			mCountersThread = std::this_thread::get_id();
+
+			if( !mCounters->open() )
+			{
+				// don't try again on every classification
+				delete mCounters;
+				mCounters = NULL;
+				return;
+			}
+		}
 	}
-	
-	return classify(confidence);
+
+	mCounters->read(mCounterSamples[point]);
+
+	if( point == COUNTERS_END )
+		mCounted = true;
 }
 
-// Classify
-int ImageNet::classify( float* confidence )
-{	
-	// process with TRT
-	if( !Process() )
+void ImageNet::checkAllocations()
+{
+	const AllocCounts& start = mAllocSamples[COUNTERS_START];
+	const AllocCounts& end = mAllocSamples[COUNTERS_END];
+
+	mAllocCounted = true;
+	mAllocIterations++;
+
+	if( mAllocIterations <= mAllocWarmup || end.allocations == start.allocations )
+		return;
+
+	mAllocatingIterations++;
+
+	// the phase that allocated first
+	uint32_t n = 0;
+	while( n < COUNTERS_END - 1 && mAllocSamples[n + 1].allocations == mAllocSamples[n].allocations )
+		n++;
+
+	static const Phase phases[] = { PHASE_PREPROCESS, PHASE_NETWORK, PHASE_POSTPROCESS };
+	LogWarning("myImageNet -- classification %llu allocated %llu times (%llu bytes) in a steady state, starting in %s\n",
+	           (unsigned long long)mAllocIterations, (unsigned long long)(end.allocations - start.allocations),
+	           (unsigned long long)(end.bytes - start.bytes), phaseToStr(phases[n]));
+}
+
+// inferenceStat
+void ImageNet::inferenceStat()
+{
+	PhaseTime network;
+	if( !mBackend->queryPhase(PHASE_NETWORK, network) )
 	{
-		LogError(LOG_TRT "myImageNet::Process() failed\n");
-		return -1;
+		LogInfo("Couldn't read query");
+		return;
 	}
-	
-	PROFILER_BEGIN(PROFILER_POSTPROCESS);
 
-	// determine the maximum class
-	int classIndex = -1;
-	float classMax = -1.0f;
-	
-	//const float valueScale = IsModelType(MODEL_ONNX) ? 0.01f : 1.0f;
+	file_profiler_t::writeInferenceTime(network.start, network.device);
+
+	// the offsets are relative to the start of the first phase
+	PhaseTime total;
+	if( !mBackend->queryPhase(PHASE_TOTAL, total) )
+		return;
+
+	PhaseRecord phases[PHASE_COUNT];
+	int count = 0;
+
+	for( uint32_t n=0; n < PHASE_COUNT; n++ )
+	{
+		PhaseTime time;
+		if( !mBackend->queryPhase((Phase)n, time) )
+			continue;
 
-	for( size_t n=0; n < mOutputClasses; n++ )
+		PhaseRecord& record = phases[count++];
+		record.name = phaseToStr((Phase)n);
+		record.offset = time.start - total.start;
+		record.cpu = time.cpu;
+		record.device = time.device;
+	}
+
+	file_profiler_t::writePhaseTimes(total.start, phases, count);
+
+	static const Phase counterPhases[] = { PHASE_PREPROCESS, PHASE_NETWORK, PHASE_POSTPROCESS };
+
+	if( mCounted )
 	{
-		const float value = mOutputs[0].CPU[n] /** valueScale*/;
-		
-		if( value >= 0.01f )
-			LogVerbose("class %04zu - %f  (%s)\n", n, value, mClassDesc[n].c_str());
-	
-		if( value > classMax )
+		CounterRecord records[COUNTERS_POINTS];
+
+		for( uint32_t n=0; n < COUNTERS_END; n++ )
 		{
-			classIndex = n;
-			classMax   = value;
+			records[n].name = phaseToStr(counterPhases[n]);
+			PerfCounters::difference(mCounterSamples[n], mCounterSamples[n + 1], records[n].counters);
 		}
+
+		records[COUNTERS_END].name = phaseToStr(PHASE_TOTAL);
+		PerfCounters::difference(mCounterSamples[COUNTERS_START], mCounterSamples[COUNTERS_END], records[COUNTERS_END].counters);
+
+		file_profiler_t::writeCounters(total.start, records, COUNTERS_POINTS);
 	}
-	
+
+	if( mAllocCounted )
+	{
+		AllocationRecord records[COUNTERS_POINTS];
+
+		for( uint32_t n=0; n < COUNTERS_POINTS; n++ )
+		{
+			// the last record is the whole classification
+			const AllocCounts& start = mAllocSamples[n < COUNTERS_END ? n : (uint32_t)COUNTERS_START];
+			const AllocCounts& end = mAllocSamples[n < COUNTERS_END ? n + 1 : (uint32_t)COUNTERS_END];
+
+			records[n].name = phaseToStr(n < COUNTERS_END ? counterPhases[n] : PHASE_TOTAL);
+			records[n].allocations = end.allocations - start.allocations;
+			records[n].frees = end.frees - start.frees;
+			records[n].bytes = end.bytes - start.bytes;
+		}
+
+		const bool faults = mMemoryStart.minorFaults >= 0 && mMemoryEnd.minorFaults >= 0;
+		file_profiler_t::writeMemory(total.start, mMemoryEnd.rss, faults ? mMemoryEnd.minorFaults - mMemoryStart.minorFaults : -1,
+		                             faults ? mMemoryEnd.majorFaults - mMemoryStart.majorFaults : -1, records, COUNTERS_POINTS);
+	}
+
+	if( mBatchSize > 0 )
+		file_profiler_t::writeBatchTime(mBatchSize, total.start, total.cpu);
+}
+
+// Classify
+int ImageNet::classify( void* image, uint32_t width, uint32_t height, imageFormat format, float* confidence )
+{
+	mBatchSize = 0;
+
+	if( !preProcess(image, width, height, format) )
+		return -1;
+
+	uint32_t classIndex = 0;
+	float classMax = -1.0f;
+
+	if( classify(1, &classIndex, &classMax) < 0 )
+		return -1;
+
 	if( confidence != NULL )
 		*confidence = classMax;
-	
-	//printf("\nmaximum class:  #%i  (%f) (%s)\n", classIndex, classMax, mClassDesc[classIndex].c_str());
-	PROFILER_END(PROFILER_POSTPROCESS);	
+
 	return classIndex;
 }
 
+// Classify with the top-k classes
+int ImageNet::classify( void* image, uint32_t width, uint32_t height, imageFormat format, Classifications& classifications, int topK )
+{
+	mBatchSize = 0;
+
+	if( topK <= 0 || !preProcess(image, width, height, format) )
+		return -1;
+
+	// keep the buffers across calls, so classifying doesn't allocate
+	if( mTopClasses.size() < (size_t)topK )
+	{
+		mTopClasses.resize(topK);
+		mTopConfidences.resize(topK);
+	}
+
+	const int count = classify(topK, mTopClasses.data(), mTopConfidences.data());
+	if( count < 0 )
+		return -1;
+
+	classifications.resize(count);
+	for( int n=0; n < count; n++ )
+		classifications[n] = std::make_pair(mTopClasses[n], mTopConfidences[n]);
+
+	return count > 0 ? (int)mTopClasses[0] : -1;
+}
+
+// Classify a batch
+bool ImageNet::classify( void* const* images, uint32_t batchSize, uint32_t width, uint32_t height, imageFormat format,
+                         int* classes, float* confidences )
+{
+	mBatchSize = 0;
+
+	// verify parameters
+	if( !images || !classes || batchSize == 0 || width == 0 || height == 0 )
+	{
+		LogError("imageNet::Classify( 0x%p, %u, %u, %u ) -> invalid parameters\n", images, batchSize, width, height);
+		return false;
+	}
+
+	readCounters(COUNTERS_START);
+
+	if( !mBackend->preProcess(images, batchSize, width, height, format) )
+	{
+		LogError("imageNet::Classify() -- tensor pre-processing failed\n");
+		return false;
+	}
+
+	readCounters(COUNTERS_PREPROCESSED);
+
+	if( !mBackend->process() )
+	{
+		LogError("myImageNet::Process() failed\n");
+		return false;
+	}
+
+	readCounters(COUNTERS_PROCESSED);
+	mBackend->beginPhase(PHASE_POSTPROCESS);
+
+	const float* output = mBackend->getOutput();
+	const uint32_t numClasses = mBackend->getNumClasses();
+
+	for( uint32_t n=0; n < batchSize; n++ )
+	{
+		uint32_t classIndex = 0;
+		float classMax = -1.0f;
+
+		if( topK(output + (size_t)n * numClasses, numClasses, 1, &classIndex, &classMax) == 0 )
+			classes[n] = -1;
+		else
+			classes[n] = classIndex;
+
+		if( confidences != NULL )
+			confidences[n] = classMax;
+	}
+
+	mBackend->endPhase(PHASE_POSTPROCESS);
+	readCounters(COUNTERS_END);
+
+	mBatchSize = batchSize;
+	return true;
+}
+
+bool ImageNet::preProcess( void* image, uint32_t width, uint32_t height, imageFormat format )
+{
+	// verify parameters
+	if( !image || width == 0 || height == 0 )
+	{
+		LogError("imageNet::Classify( 0x%p, %u, %u ) -> invalid parameters\n", image, width, height);
+		return false;
+	}
+
+	readCounters(COUNTERS_START);
+
+	// downsample and convert to band-sequential BGR
+	if( !mBackend->preProcess(image, width, height, format) )
+	{
+		LogError("imageNet::Classify() -- tensor pre-processing failed\n");
+		return false;
+	}
+
+	readCounters(COUNTERS_PREPROCESSED);
+	return true;
+}
+
+// Run the network and select the k best classes. Returns their number or -1 on error.
+int ImageNet::classify( uint32_t k, uint32_t* classes, float* confidences )
+{
+	// run the network
+	if( !mBackend->process() )
+	{
+		LogError("myImageNet::Process() failed\n");
+		return -1;
+	}
+
+	readCounters(COUNTERS_PROCESSED);
+	mBackend->beginPhase(PHASE_POSTPROCESS);
+
+	// determine the maximum classes
+	const uint32_t count = topK(mBackend->getOutput(), mBackend->getNumClasses(), k, classes, confidences);
+
+	mBackend->endPhase(PHASE_POSTPROCESS);
+	readCounters(COUNTERS_END);
+
+	if( Log::GetLevel() >= Log::VERBOSE )
+	{
+		for( uint32_t n=0; n < count; n++ )
+			LogVerbose("class %04u - %f  (%s)\n", classes[n], confidences[n], mBackend->getClassDesc(classes[n]));
+	}
+
+	return count;
+}
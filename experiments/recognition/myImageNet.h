@@ -1,112 +1,179 @@
 #ifndef __MY_IMAGE_NET_H__
 #define __MY_IMAGE_NET_H__
 
-#include <jetson-inference/imageNet.h>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <jetson-utils/commandLine.h>
+#include <jetson-utils/logging.h>
+#include <profiling/perfCounters.h>
 #include <profiling/profiler.h>
+#include "allocTracker.h"
+#include "backend.h"
 
 using file_profiler_t = profiling::Profiler;
 
-namespace profiling 
+namespace profiling
 {
-    class ImageNet : private imageNet
+    class ImageNet
     {
         public:
-            // load network instance
-            static ImageNet* Create( NetworkType networkType=GOOGLENET, uint32_t maxBatchSize=DEFAULT_MAX_BATCH_SIZE, 
-                precisionType precision=TYPE_FASTEST,
-                deviceType device=DEVICE_GPU, bool allowGPUFallback=true );
+            // best classes and their confidence, by decreasing confidence
+            typedef std::vector<std::pair<uint32_t, float>> Classifications;
 
-            // create network from commandline
-            static ImageNet* Create(const commandLine& cmdLine);
+            // create network from commandline, --backend selects tensorrt or cpu
+            static ImageNet* Create(const commandLine& cmdLine, uint32_t maxBatchSize=1);
+
+            // wrap a backend, the network takes its ownership
+            static ImageNet* Create(InferenceBackend* backend);
 
             // enable layer time profiling
             void enableLayerProfiler();
 
-            template<typename T> 
+            // read the hardware counters around the pre-processing, network and post-processing of
+            // each classification, inferenceStat then writes them
+            void enableCounters();
+
+            // count the allocations of each phase and sample the page faults of each classification.
+            // The classifications after the first `warmup` ones are expected not to allocate and are reported if they do.
+            bool enableAllocationTracking(uint32_t warmup=2);
+
+            template<typename T>
             int classify( T* image, uint32_t width, uint32_t height, float* confidence=NULL )
             {
-                return classify((void*)image, width, height, imageFormatFromType<T>(), confidence); 
+                return classify((void*)image, width, height, imageFormatFromType<T>(), confidence);
             }
 
             int classify( void* image, uint32_t width, uint32_t height, imageFormat format, float* confidence=NULL );
 
+            // classify and keep the `topK` best classes. Returns the best class or -1 on error.
+            template<typename T>
+            int classify( T* image, uint32_t width, uint32_t height, Classifications& classifications, int topK )
+            {
+                return classify((void*)image, width, height, imageFormatFromType<T>(), classifications, topK);
+            }
+
+            int classify( void* image, uint32_t width, uint32_t height, imageFormat format, Classifications& classifications, int topK );
+
+            // classify a batch of images of the same size in one network execution, writes the best class
+            // and its confidence for each image. Returns false on error.
+            bool classify( void* const* images, uint32_t batchSize, uint32_t width, uint32_t height, imageFormat format,
+                           int* classes, float* confidences=NULL );
+
             // destructor
             virtual ~ImageNet();
 
-            // write inference start and duration
-            void inferenceStat()
-            {
-                profilerQuery query = PROFILER_NETWORK;
-                if( PROFILER_QUERY(query) )
-                {
-                    timespec start = mEventsCPU[query*2];
-                    float duration = mProfilerTimes[query].y;
-                    file_profiler_t::writeInferenceTime(timeDouble(start), duration);
-                }
-                else{
-                    LogInfo("Couldn't read query");
-                }
-            }
+            // write inference start and duration, then the times of every phase of the iteration,
+            // their counters and allocations if enabled and the size of the batch if it was a batch
+            void inferenceStat();
 
             // Retrieve the description of a particular class.
-            inline const char* GetClassDesc( uint32_t index ) const 
-            { 
-                return mClassDesc[index].c_str(); 
+            inline const char* GetClassDesc( uint32_t index ) const
+            {
+                return mBackend->getClassDesc(index);
             }
 
+            // Dimensions of the network input
+            inline uint32_t GetInputWidth() const { return mBackend->getInputWidth(); }
+            inline uint32_t GetInputHeight() const { return mBackend->getInputHeight(); }
+            inline uint32_t GetMaxBatchSize() const { return mBackend->getMaxBatchSize(); }
+
+            inline InferenceBackend* getBackend() const { return mBackend; }
+
             // Print the profiler times (in millseconds).
             inline void printProfilerTimes()
             {
                 LogInfo("\n");
-                LogInfo(LOG_TRT "------------------------------------------------\n");
-                LogInfo(LOG_TRT "Timing Report %s\n", GetModelPath());
-                LogInfo(LOG_TRT "------------------------------------------------\n");
+                LogInfo("------------------------------------------------\n");
+                LogInfo("Timing Report %s (%s)\n", mBackend->getModelPath(), mBackend->getName());
+                LogInfo("------------------------------------------------\n");
 
-                for( uint32_t n=0; n <= PROFILER_TOTAL; n++ )
+                for( uint32_t n=0; n <= PHASE_TOTAL; n++ )
                 {
-                    const profilerQuery query = (profilerQuery)n;
+                    const Phase phase = (Phase)n;
+                    PhaseTime time;
 
-                    if( PROFILER_QUERY(query) )
-                        LogInfo(LOG_TRT "%-12s  CPU %9.5fms  CUDA %9.5fms\n", profilerQueryToStr(query), mProfilerTimes[n].x, mProfilerTimes[n].y);
+                    if( mBackend->queryPhase(phase, time) )
+                        LogInfo("%-12s  CPU %9.5fms  CUDA %9.5fms\n", phaseToStr(phase), time.cpu, time.device);
                 }
 
-                LogInfo(LOG_TRT "------------------------------------------------\n\n");
+                LogInfo("------------------------------------------------\n\n");
 
                 static bool first_run=true;
 
                 if( first_run )
                 {
-                    LogWarning(LOG_TRT "note -- when processing a single image, run 'sudo jetson_clocks' before\n"
+                    LogWarning("note -- when processing a single image, run 'sudo jetson_clocks' before\n"
                             "                to disable DVFS for more accurate profiling/timing measurements\n\n");
-                    
+
                     first_run = false;
                 }
             }
-        
-        protected:
-            ImageNet();
 
-            // static char buffer[20];
+            // backend selection and options
+            static const char* Usage();
 
-            int classify(float* confidence);
+        protected:
+            ImageNet(InferenceBackend* backend);
+
+            // post-process the output into the k best classes
+            int classify(uint32_t k, uint32_t* classes, float* confidences);
+            bool preProcess(void* image, uint32_t width, uint32_t height, imageFormat format);
 
-            class Profiler : public nvinfer1::IProfiler
+            // boundaries of the phases where the counters are read
+            enum CounterPoint
+            {
+                COUNTERS_START = 0,
+                COUNTERS_PREPROCESSED,
+                COUNTERS_PROCESSED,
+                COUNTERS_END,
+                COUNTERS_POINTS
+            };
+
+            // read the counters and the allocations at a boundary of the current classification
+            void readCounters(CounterPoint point);
+            void readPerfCounters(CounterPoint point);
+            void checkAllocations();
+
+            uint32_t mBatchSize;  // images of the last classification, 0 if it wasn't a batch
+            std::vector<uint32_t> mTopClasses;
+            std::vector<float> mTopConfidences;
+
+            class Profiler : public LayerReporter
             {
             public:
                 Profiler() : timingAccumulator(0.0f)	{ }
-                
-                virtual void reportLayerTime(const char* layerName, float ms) NOEXCEPT
+
+                virtual void reportLayerTime(const char* layerName, float ms)
                 {
                     file_profiler_t::writeLayerTime(layerName, ms);
                     // printf(LOG_TRT "-- layer %s - %f ms\n", layerName, ms);
                     timingAccumulator += ms;
                 }
-                
+
                 float timingAccumulator;
             } gProfiler;
+
+            InferenceBackend* mBackend;
+
+            // counters of the thread classifying, reopened when another thread classifies (streams, pipeline)
+            PerfCounters* mCounters;
+            std::thread::id mCountersThread;
+            PerfSample mCounterSamples[COUNTERS_POINTS];
+            bool mCounted;  // the last classification read every boundary
+
+            // allocations of the thread classifying and faults of the process
+            bool mTrackAllocations;
+            bool mAllocCounted;
+            uint32_t mAllocWarmup;
+            uint64_t mAllocIterations;     // classifications tracked
+            uint64_t mAllocatingIterations;  // after the warmup
+            AllocCounts mAllocSamples[COUNTERS_POINTS];
+            ProcessMemory mMemoryStart;
+            ProcessMemory mMemoryEnd;
     };
 
     // TODO create custom layer profiler
 }
 
-#endif
\ No newline at end of file
+#endif
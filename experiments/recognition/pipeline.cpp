@@ -0,0 +1,329 @@
+#include "pipeline.h"
+#include "imageCache.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <jetson-utils/loadImage.h>
+#include <jetson-utils/logging.h>
+
+#ifdef WITH_TENSORRT
+#include <jetson-utils/cudaMappedMemory.h>
+#endif
+
+using namespace profiling;
+
+static uint64_t monotonicNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// wait for a queue, yield first then sleep so an idle stage doesn't burn a core
+static void backoff(uint32_t& spins)
+{
+    if(spins++ < 64)
+        std::this_thread::yield();
+    else
+        usleep(50);
+}
+
+
+void* profiling::allocImage(size_t size)
+{
+#ifdef WITH_TENSORRT
+    void* image = NULL;
+    return cudaAllocMapped(&image, size) ? image : NULL;
+#else
+    return malloc(size);
+#endif
+}
+
+void profiling::releaseImage(void* image)
+{
+    if(!image)
+        return;
+#ifdef WITH_TENSORRT
+    CUDA(cudaFreeHost(image));
+#else
+    free(image);
+#endif
+}
+
+
+void profiling::resizeImage(const uint8_t* input, uint32_t width, uint32_t height, uint8_t* output, uint32_t outputWidth, uint32_t outputHeight)
+{
+    // bilinear, in 8 bit fixed point
+    const uint32_t scaleX = ((uint64_t)(width - 1) << 8) / std::max(outputWidth - 1, 1u);
+    const uint32_t scaleY = ((uint64_t)(height - 1) << 8) / std::max(outputHeight - 1, 1u);
+
+    for(uint32_t y = 0; y < outputHeight; y++)
+    {
+        const uint32_t sourceY = y * scaleY;
+        const uint32_t y0 = sourceY >> 8;
+        const uint32_t y1 = std::min(y0 + 1, height - 1);
+        const uint32_t fy = sourceY & 0xff;
+
+        for(uint32_t x = 0; x < outputWidth; x++)
+        {
+            const uint32_t sourceX = x * scaleX;
+            const uint32_t x0 = sourceX >> 8;
+            const uint32_t x1 = std::min(x0 + 1, width - 1);
+            const uint32_t fx = sourceX & 0xff;
+
+            const uint8_t* p00 = input + ((size_t)y0 * width + x0) * 3;
+            const uint8_t* p01 = input + ((size_t)y0 * width + x1) * 3;
+            const uint8_t* p10 = input + ((size_t)y1 * width + x0) * 3;
+            const uint8_t* p11 = input + ((size_t)y1 * width + x1) * 3;
+
+            for(int c = 0; c < 3; c++)
+            {
+                const uint32_t top = p00[c] * (256 - fx) + p01[c] * fx;
+                const uint32_t bottom = p10[c] * (256 - fx) + p11[c] * fx;
+                output[((size_t)y * outputWidth + x) * 3 + c] = (top * (256 - fy) + bottom * fy) >> 16;
+            }
+        }
+    }
+}
+
+
+void Pipeline::QueueStats::sample(const RecordQueue& queue)
+{
+    const size_t size = queue.size();
+    samples++;
+    total += size;
+    max = std::max(max, size);
+}
+
+Pipeline::Pipeline(ImageNet* net, uint32_t decodeThreads, uint32_t queueDepth)
+    : mNet(net), mDecodeThreads(decodeThreads > 0 ? decodeThreads : 1),
+      mInputWidth(net->GetInputWidth()), mInputHeight(net->GetInputHeight()),
+      mCache(NULL), mImages(NULL), mTotal(0), mNext(0),
+      mDecoded(nextPowerOfTwo(queueDepth), sizeof(DecodedImage)),
+      mReady(nextPowerOfTwo(queueDepth), sizeof(ReadyImage)),
+      mFree(nextPowerOfTwo(queueDepth + 2), sizeof(void*)),
+      mFailed(0), mElapsed(0)
+{
+    // one buffer per slot of the ready queue, plus the ones held by preprocessing and inference
+    const size_t bufferSize = (size_t)mInputWidth * mInputHeight * 3;
+
+    for(size_t i = 0; i < mReady.capacity() + 2; i++)
+    {
+        void* buffer = allocImage(bufferSize);
+        if(!buffer)
+            break;
+        mBuffers.push_back(buffer);
+        mFree.push(&buffer);
+    }
+}
+
+Pipeline::~Pipeline()
+{
+    for(size_t i = 0; i < mBuffers.size(); i++)
+        releaseImage(mBuffers[i]);
+}
+
+bool Pipeline::listImages(const char* path, std::vector<std::string>& images)
+{
+    static const char* extensions[] = { ".jpg", ".jpeg", ".png", ".bmp", ".tga", ".ppm" };
+
+    DIR* dir = opendir(path);
+    if(!dir)
+    {
+        LogError("pipeline -- failed to open dataset '%s'\n", path);
+        return false;
+    }
+
+    images.clear();
+    while(dirent* entry = readdir(dir))
+    {
+        const char* extension = strrchr(entry->d_name, '.');
+        if(!extension)
+            continue;
+
+        for(size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++)
+        {
+            if(strcasecmp(extension, extensions[i]) == 0)
+            {
+                images.push_back(std::string(path) + "/" + entry->d_name);
+                break;
+            }
+        }
+    }
+    closedir(dir);
+
+    std::sort(images.begin(), images.end());
+    return true;
+}
+
+bool Pipeline::run(const std::vector<std::string>& images, uint32_t epochs)
+{
+    if(images.empty() || mBuffers.empty())
+    {
+        LogError("pipeline -- nothing to classify\n");
+        return false;
+    }
+
+    mImages = &images;
+    mTotal = (uint64_t)images.size() * epochs;
+    mNext.store(0);
+    mFailed = 0;
+
+    StageStats* stages[] = { &mDecodeStats, &mPreprocessStats, &mInferStats };
+    for(size_t i = 0; i < 3; i++)
+    {
+        stages[i]->items.store(0);
+        stages[i]->busyNs.store(0);
+    }
+    mDecodedStats = QueueStats();
+    mReadyStats = QueueStats();
+
+    const uint64_t start = monotonicNs();
+
+    std::vector<std::thread> decoders;
+    for(uint32_t i = 0; i < mDecodeThreads; i++)
+        decoders.push_back(std::thread(&Pipeline::decode, this));
+    std::thread preprocessor(&Pipeline::preprocess, this);
+
+    // inference stage
+    for(uint64_t n = 0; n < mTotal; n++)
+    {
+        ReadyImage image;
+        uint32_t spins = 0;
+        while(!mReady.pop(&image))
+            backoff(spins);
+
+        mDecodedStats.sample(mDecoded);
+        mReadyStats.sample(mReady);
+
+        if(!image.pixels)
+        {
+            mFailed++;
+            continue;
+        }
+
+        const uint64_t begin = monotonicNs();
+        float confidence = 0.0f;
+        const int classIndex = mNet->classify(image.pixels, mInputWidth, mInputHeight, IMAGE_RGB8, &confidence);
+
+        if(classIndex >= 0)
+            mNet->inferenceStat();
+        else
+        {
+            LogError("failed to classify image '%s'\n", (*mImages)[image.index].c_str());
+            mFailed++;
+        }
+        mInferStats.busyNs += monotonicNs() - begin;
+        mInferStats.items++;
+
+        mFree.push(&image.pixels);
+    }
+
+    for(size_t i = 0; i < decoders.size(); i++)
+        decoders[i].join();
+    preprocessor.join();
+
+    mElapsed = (monotonicNs() - start) * 1e-9;
+    return mFailed < mTotal;
+}
+
+void Pipeline::decode()
+{
+    while(true)
+    {
+        const uint64_t n = mNext.fetch_add(1);
+        if(n >= mTotal)
+            return;
+
+        DecodedImage image;
+        image.index = n % mImages->size();
+        image.pixels = NULL;
+        image.cached = (mCache != NULL);
+
+        const uint64_t begin = monotonicNs();
+        if(mCache)
+            image.pixels = (void*)mCache->get(image.index, &image.width, &image.height);
+        else if(!loadImage((*mImages)[image.index].c_str(), &image.pixels, &image.width, &image.height, IMAGE_RGB8))
+            image.pixels = NULL;
+        mDecodeStats.busyNs += monotonicNs() - begin;
+        mDecodeStats.items++;
+
+        uint32_t spins = 0;
+        while(!mDecoded.push(&image))
+            backoff(spins);
+    }
+}
+
+void Pipeline::preprocess()
+{
+    for(uint64_t n = 0; n < mTotal; n++)
+    {
+        DecodedImage image;
+        uint32_t spins = 0;
+        while(!mDecoded.pop(&image))
+            backoff(spins);
+
+        ReadyImage ready = { image.index, NULL };
+
+        if(image.pixels)
+        {
+            spins = 0;
+            while(!mFree.pop(&ready.pixels))
+                backoff(spins);
+
+            const uint64_t begin = monotonicNs();
+            if((uint32_t)image.width == mInputWidth && (uint32_t)image.height == mInputHeight)
+                memcpy(ready.pixels, image.pixels, (size_t)mInputWidth * mInputHeight * 3);  // resized by the cache
+            else
+                resizeImage((const uint8_t*)image.pixels, image.width, image.height, (uint8_t*)ready.pixels, mInputWidth, mInputHeight);
+
+            if(!image.cached)
+                releaseImage(image.pixels);
+            mPreprocessStats.busyNs += monotonicNs() - begin;
+            mPreprocessStats.items++;
+        }
+
+        spins = 0;
+        while(!mReady.push(&ready))
+            backoff(spins);
+    }
+}
+
+void Pipeline::printReport() const
+{
+    const uint64_t classified = mTotal - mFailed;
+
+    printf("pipeline -- %llu images in %.3f s, %.2f images/s (%llu failed)\n",
+           (unsigned long long)mTotal, mElapsed, mElapsed > 0 ? classified / mElapsed : 0.0, (unsigned long long)mFailed);
+
+    printf("  %-12s  %7s  %7s  %9s  %11s\n", "stage", "threads", "images", "busy (s)", "utilisation");
+    const struct { const char* name; uint32_t threads; const StageStats* stats; } stages[] = {
+        { "decode", mDecodeThreads, &mDecodeStats },
+        { "preprocess", 1, &mPreprocessStats },
+        { "infer", 1, &mInferStats }
+    };
+    for(size_t i = 0; i < 3; i++)
+    {
+        const double busy = stages[i].stats->busyNs.load() * 1e-9;
+        printf("  %-12s  %7u  %7llu  %9.3f  %10.1f%%\n", stages[i].name, stages[i].threads,
+               (unsigned long long)stages[i].stats->items.load(), busy,
+               mElapsed > 0 ? 100.0 * busy / (mElapsed * stages[i].threads) : 0.0);
+    }
+
+    printf("  %-12s  %8s  %14s  %3s\n", "queue", "capacity", "mean occupancy", "max");
+    const struct { const char* name; const RecordQueue* queue; const QueueStats* stats; } queues[] = {
+        { "decoded", &mDecoded, &mDecodedStats },
+        { "ready", &mReady, &mReadyStats }
+    };
+    for(size_t i = 0; i < 2; i++)
+    {
+        const QueueStats& stats = *queues[i].stats;
+        printf("  %-12s  %8zu  %14.2f  %3zu\n", queues[i].name, queues[i].queue->capacity(),
+               stats.samples > 0 ? (double)stats.total / stats.samples : 0.0, stats.max);
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <profiling/queue.h>
+#include "myImageNet.h"
+
+namespace profiling
+{
+    // Allocate an image the backend can read (mapped memory with TensorRT)
+    void* allocImage(size_t size);
+    // Release an image allocated by allocImage or loadImage
+    void releaseImage(void* image);
+    // Bilinear resize of an RGB8 image
+    void resizeImage(const uint8_t* input, uint32_t width, uint32_t height, uint8_t* output, uint32_t outputWidth, uint32_t outputHeight);
+
+    class ImageCache;
+
+    /*
+    * Classifies a set of images through three stages connected by bounded lock free queues:
+    * a pool of decode threads, a preprocessing thread resizing the images to the network
+    * input, and the inference on the calling thread. A full queue blocks the stage
+    * feeding it, so at most `queueDepth` images wait between two stages.
+    */
+    class Pipeline
+    {
+    public:
+        Pipeline(ImageNet* net, uint32_t decodeThreads=2, uint32_t queueDepth=8);
+        ~Pipeline();
+
+        // Read the images from a cache instead of decoding them. NULL to disable.
+        inline void setCache(const ImageCache* cache) { mCache = cache; }
+
+        // Classify every image `epochs` times. Returns false if no image could be classified.
+        bool run(const std::vector<std::string>& images, uint32_t epochs=1);
+
+        // Print the stage utilisation, queue occupancy and throughput of the last run
+        void printReport() const;
+
+        // List the images of a directory, sorted by name
+        static bool listImages(const char* path, std::vector<std::string>& images);
+
+    private:
+        struct DecodedImage
+        {
+            uint32_t index;  // in the image list
+            int width;
+            int height;
+            void* pixels;    // RGB8, NULL if the image couldn't be decoded
+            bool cached;     // pixels are owned by the cache
+        };
+
+        struct ReadyImage
+        {
+            uint32_t index;
+            void* pixels;    // RGB8 at the network input size, NULL if the image couldn't be decoded
+        };
+
+        struct StageStats
+        {
+            StageStats() : items(0), busyNs(0) {}
+            std::atomic<uint64_t> items;
+            std::atomic<uint64_t> busyNs;
+        };
+
+        struct QueueStats
+        {
+            QueueStats() : samples(0), total(0), max(0) {}
+            void sample(const RecordQueue& queue);
+
+            uint64_t samples;
+            uint64_t total;
+            size_t max;
+        };
+
+        void decode();
+        void preprocess();
+
+        ImageNet* mNet;
+        const uint32_t mDecodeThreads;
+        const uint32_t mInputWidth;
+        const uint32_t mInputHeight;
+
+        const ImageCache* mCache;
+        const std::vector<std::string>* mImages;
+        uint64_t mTotal;                 // images to classify in the run
+        std::atomic<uint64_t> mNext;     // next image to decode
+
+        RecordQueue mDecoded;            // DecodedImage
+        RecordQueue mReady;              // ReadyImage
+        RecordQueue mFree;               // preprocessing buffers
+        std::vector<void*> mBuffers;
+
+        StageStats mDecodeStats;
+        StageStats mPreprocessStats;
+        StageStats mInferStats;
+        QueueStats mDecodedStats;
+        QueueStats mReadyStats;
+        uint64_t mFailed;
+        double mElapsed;  // s
+    };
+}
+
+#endif
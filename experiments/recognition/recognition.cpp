@@ -1,8 +1,20 @@
+#include <algorithm>
 #include <cstdio>
-#include <jetson-inference/imageNet.h>
+#include <stdlib.h>
+#include <vector>
+#include <jetson-utils/commandLine.h>
 #include <jetson-utils/loadImage.h>
+#include <jetson-utils/timespec.h>
+
+#include <profiling/convergence.h>
+#include <profiling/metrics.h>
+#include <profiling/stream.h>
 
 #include "myImageNet.h"
+#include "imageCache.h"
+#include "loadGenerator.h"
+#include "multiStream.h"
+#include "pipeline.h"
 
 // use jetson libs in headless mode
 #define IS_HEADLESS() "headless"  // run without display
@@ -11,48 +23,53 @@
 // print command line options
 int usage()
 {
-	printf("usage: imagenet input_IMAGE [--help] [--network=NETWORK] ...\n");
-	printf("                [--nb-runs=TOTAL_RUNS] [--profile-out=PROFILE_OUT]\n\n");
+	printf("usage: imagenet input_IMAGE [--help] [--backend=BACKEND] [--network=NETWORK] ...\n");
+	printf("                [--nb-runs=TOTAL_RUNS] [--profile-out=PROFILE_OUT] [--metrics=ADDRESS]\n");
+	printf("                [--stream=STREAM_PATH] [--dataset=DIR [--decode-threads=THREADS] [--queue-depth=DEPTH] [--epochs=EPOCHS]\n");
+	printf("                [--cache=CACHE_PATH [--cache-resize]]] [--batch-size=BATCH_SIZES] [--streams=STREAMS]\n");
+	printf("                [--rate=RATES] [--slo=SLO [--search-steps=STEPS]] [--arrivals=ARRIVALS] [--duration=DURATION]\n");
+	printf("                [--until-ci=PCT [--ci-stat=STAT] [--min-runs=MIN_RUNS] [--max-runs=MAX_RUNS]]\n\n");
 	printf("Runs inference on image multiple times with an image recognition DNN.\n");
 	printf("See below for additional arguments that may not be shown above.\n\n");	
 	printf("positional arguments:\n");
 	printf("    input_IMAGE     path to image on which we whant to make our prediction.\n");
 	printf("    PROFILE_OUT     output method for the profiler values (out.txt, stdout, etc). Defaults to stdout.\n");
-    printf("    TOTAL_RUNS      total inferences to run. Defaults to 10.\n\n");
-    printf("%s", imageNet::Usage());
+    printf("    TOTAL_RUNS      total inferences to run. Defaults to 10.\n");
+    printf("    ADDRESS         serve the layer latency histograms in Prometheus format on HOST:PORT or unix:PATH.\n");
+    printf("    STREAM_PATH     stream the layer and inference times to the subscribers of a unix socket.\n");
+    printf("    DIR             classify every image of a directory through a decode, preprocess and inference pipeline\n");
+    printf("                    instead of input_IMAGE, then print the throughput and the stage utilisation.\n");
+    printf("    THREADS         decoding threads of the dataset pipeline. Defaults to 2.\n");
+    printf("    DEPTH           images waiting between two stages of the pipeline. Defaults to 8.\n");
+    printf("    EPOCHS          passes over the dataset. Defaults to 1.\n");
+    printf("    CACHE_PATH      decoded images of the dataset, built on the first run and mapped by the next ones.\n");
+    printf("                    --cache-resize stores them at the network input size.\n");
+    printf("    BATCH_SIZES     classify input_IMAGE in batches of N copies, TOTAL_RUNS batches for each size of a\n");
+    printf("                    comma separated list (1,2,4,8), then print the latency and throughput of each size.\n");
+    printf("    STREAMS         classify input_IMAGE TOTAL_RUNS times on one network, then on STREAMS networks from\n");
+    printf("                    as many threads at once, and print the throughput, latency percentiles and scaling.\n");
+    printf("    RATES           open loop load: offer input_IMAGE at each rate of a comma separated list (requests/s)\n");
+    printf("                    whatever the network keeps up with, and print the latency from the intended arrival.\n");
+    printf("    SLO             p99 latency objective in ms. Without RATES, search the highest rate meeting it.\n");
+    printf("    STEPS           runs of the search. Defaults to 8.\n");
+    printf("    ARRIVALS        constant or poisson intervals between requests. Defaults to constant.\n");
+    printf("    DURATION        seconds of each open loop run. Defaults to 10.\n");
+    printf("    PCT             instead of TOTAL_RUNS, classify until the 95%% confidence interval of the latency is\n");
+    printf("                    within PCT%% of its estimate, the warmup being detected and left out. The stop reason,\n");
+    printf("                    warmup length and estimate are written to PROFILE_OUT.\n");
+    printf("    STAT            mean or median latency. Defaults to mean.\n");
+    printf("    MIN_RUNS        runs before the interval is checked. Defaults to 30.\n");
+    printf("    MAX_RUNS        runs after which it stops anyway. Defaults to 10000.\n\n");
+    printf("%s", profiling::ImageNet::Usage());
 	printf("%s", Log::Usage());
 
 	return 0;
 }
 
 
-int main(int argc, char** argv)
+// classify a single image multiple times, or until the latency converges if `convergence` is set
+int runImage(profiling::ImageNet* net, char** argv, int maxInfer, profiling::Convergence* convergence)
 {
-    // parse command line
-    commandLine cmdLine(argc, argv, IS_HEADLESS());
-
-    if(cmdLine.GetFlag("help"))
-        return usage();
-    
-    
-    // cmdLine.AddArg("--log-level=silent");  // force silent logging
-    // cmdLine.AddFlag("profile");  // force profiling
-    // Log::ParseCmdLine(cmdLine);  // update logger
-
-    int maxInfer = cmdLine.GetInt("nb-runs", 10);
-    if(cmdLine.GetFlag("profile"))
-    {
-        file_profiler_t::setFile(cmdLine.GetString("profile-out", "stdout"));
-    }
-
-    
-    // a command line argument containing the filename is expected
-    if(argc < 2)
-    {
-        printf("recognition: expected image filename as argument\n");
-        printf("example usage: ./recognition my_image.jpg\n");
-    }
-
     // retrieve the filename from command line array
     const char*  imgFilename = argv[1];
 
@@ -70,17 +87,6 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    // loadimage recognition network with TensorRT
-    // imageNet* net = imageNet::Create(imageNet::GOOGLENET);
-    profiling::ImageNet* net = profiling::ImageNet::Create(cmdLine);
-
-    // check to make sure that the network model loaded properly
-    if(!net)
-    {
-        printf("failed to load image recognition network\n");
-        return 1;
-    }
-
     // net->EnableDebug();
     // net->EnableLayerProfiler();
     // net->enableLayerProfiler();
@@ -92,7 +98,7 @@ int main(int argc, char** argv)
     // inference multiple times
     int i{0};
 
-    while(i < maxInfer)
+    while(convergence ? !convergence->isDone() : i < maxInfer)
     {
         printf("\t--Iteration %d of %d\n", i+1, maxInfer);
         // classify the image, return the object class index (or -1 on error)
@@ -103,6 +109,11 @@ int main(int argc, char** argv)
         {
             // log inference start and duration
             net->inferenceStat();
+
+            profiling::PhaseTime time;
+            if(convergence && net->getBackend()->queryPhase(profiling::PHASE_TOTAL, time))
+                convergence->add(time.cpu);
+
             // retrieve the name/description of the object class index
             // const char* classDescription = net->GetClassDesc(classIndex);
 
@@ -119,14 +130,381 @@ int main(int argc, char** argv)
         // net->printProfilerTimes();
     }
 
+    if(convergence)
+    {
+        const char* reason = profiling::Convergence::ReasonToStr(convergence->getReason());
+        const char* statistic = profiling::Convergence::StatisticToStr(convergence->getStatistic());
+
+        file_profiler_t::writeStopReason(reason, convergence->getCount(), convergence->getWarmup(), statistic,
+                                         convergence->getEstimate(), convergence->getHalfWidth());
+
+        LogInfo("stopped (%s) after %llu runs, %llu warmup runs left out, %s latency %.3f ms +- %.3f ms\n", reason,
+                (unsigned long long)convergence->getCount(), (unsigned long long)convergence->getWarmup(), statistic,
+                convergence->getEstimate(), convergence->getHalfWidth());
+    }
+
+    return 0;
+}
+
+
+// parse a comma separated list of batch sizes
+bool parseBatchSizes(const char* str, std::vector<uint32_t>& sizes)
+{
+    sizes.clear();
+
+    while(str && *str != '\0')
+    {
+        char* end = NULL;
+        const long size = strtol(str, &end, 10);
+
+        if(end == str || size <= 0 || (*end != ',' && *end != '\0'))
+        {
+            LogError("invalid batch sizes '%s'\n", str);
+            return false;
+        }
+
+        sizes.push_back(size);
+        str = (*end == ',') ? end + 1 : end;
+    }
+    return !sizes.empty();
+}
+
+
+// classify copies of a single image in batches of each size, and compare their latency and throughput
+int runBatches(profiling::ImageNet* net, const char* imgFilename, const std::vector<uint32_t>& sizes, int maxInfer)
+{
+    uchar3* imgPtr  = NULL;
+    int imgWidth    = 0;
+    int imgHeight   = 0;
+
+    LogInfo("Loading image: %s\n", imgFilename);
+    if(!loadImage(imgFilename, &imgPtr, &imgWidth, &imgHeight))
+        return 1;
+
+    const uint32_t maxBatchSize = *std::max_element(sizes.begin(), sizes.end());
+    std::vector<void*> images(maxBatchSize, imgPtr);
+    std::vector<int> classes(maxBatchSize);
+    std::vector<double> latencies;
+
+    printf("%6s  %10s  %10s  %10s  %10s  %12s  %10s\n", "batch", "batches", "mean (ms)", "p99 (ms)", "image (ms)", "images/s", "net (ms)");
+
+    for(size_t s = 0; s < sizes.size(); s++)
+    {
+        const uint32_t batchSize = sizes[s];
+        double network = 0;
+        latencies.clear();
+
+        for(int i = 0; i < maxInfer; i++)
+        {
+            if(!net->classify(images.data(), batchSize, imgWidth, imgHeight, IMAGE_RGB8, classes.data()))
+            {
+                LogError("failed to classify a batch of %u images\n", batchSize);
+                continue;
+            }
+
+            // log the phases and the batch
+            net->inferenceStat();
+
+            profiling::PhaseTime time;
+            if(net->getBackend()->queryPhase(profiling::PHASE_TOTAL, time))
+                latencies.push_back(time.cpu);
+            if(net->getBackend()->queryPhase(profiling::PHASE_NETWORK, time))
+                network += time.device;
+        }
+
+        if(latencies.empty())
+            continue;
+
+        std::sort(latencies.begin(), latencies.end());
+        double mean = 0;
+        for(size_t i = 0; i < latencies.size(); i++)
+            mean += latencies[i];
+        mean /= latencies.size();
+
+        const double p99 = latencies[std::min(latencies.size() - 1, (size_t)(latencies.size() * 0.99))];
+
+        printf("%6u  %10zu  %10.3f  %10.3f  %10.3f  %12.2f  %10.3f\n", batchSize, latencies.size(), mean, p99,
+               mean / batchSize, mean > 0 ? batchSize * 1000.0 / mean : 0.0, network / latencies.size());
+    }
+
+    profiling::releaseImage(imgPtr);
+    return 0;
+}
+
+
+// classify a single image on one network, then on `streams` networks concurrently
+int runStreams(profiling::ImageNet* net, const char* imgFilename, uint32_t streams, int maxInfer, const commandLine& cmdLine)
+{
+    uchar3* imgPtr  = NULL;
+    int imgWidth    = 0;
+    int imgHeight   = 0;
+
+    LogInfo("Loading image: %s\n", imgFilename);
+    if(!loadImage(imgFilename, &imgPtr, &imgWidth, &imgHeight))
+        return 1;
+
+    // each stream has its own network and backend
+    std::vector<profiling::ImageNet*> nets(1, net);
+    int status = 0;
+
+    for(uint32_t n = 1; n < streams; n++)
+    {
+        profiling::ImageNet* streamNet = profiling::ImageNet::Create(cmdLine);
+        if(!streamNet)
+        {
+            printf("failed to load the network of stream %u\n", n);
+            status = 1;
+            break;
+        }
+        nets.push_back(streamNet);
+    }
+
+    if(status == 0)
+    {
+        profiling::MultiStream multiStream(nets);
+        profiling::MultiStream::Run single, concurrent;
+
+        LogInfo("Classifying on 1 stream, then on %u streams\n", streams);
+
+        if(multiStream.run(1, imgPtr, imgWidth, imgHeight, maxInfer, "single", single) &&
+           multiStream.run(streams, imgPtr, imgWidth, imgHeight, maxInfer, "stream", concurrent))
+            profiling::MultiStream::printReport(single, concurrent);
+        else
+            status = 1;
+    }
+
+    for(size_t n = 1; n < nets.size(); n++)
+        delete nets[n];
+
+    profiling::releaseImage(imgPtr);
+    return status;
+}
+
+
+// parse a comma separated list of request rates
+bool parseRates(const char* str, std::vector<double>& rates)
+{
+    rates.clear();
+
+    while(str && *str != '\0')
+    {
+        char* end = NULL;
+        const double rate = strtod(str, &end);
+
+        if(end == str || rate <= 0 || (*end != ',' && *end != '\0'))
+        {
+            LogError("invalid rates '%s'\n", str);
+            return false;
+        }
+
+        rates.push_back(rate);
+        str = (*end == ',') ? end + 1 : end;
+    }
+    return !rates.empty();
+}
+
+
+// offer a single image at fixed rates, or search the highest rate meeting the p99 slo
+int runOpenLoop(profiling::ImageNet* net, const char* imgFilename, const commandLine& cmdLine)
+{
+    std::vector<double> rates;
+    const char* ratesStr = cmdLine.GetString("rate");
+
+    if(ratesStr && !parseRates(ratesStr, rates))
+        return 1;
+
+    const double slo = cmdLine.GetFloat("slo", 0.0f);
+    const double duration = cmdLine.GetFloat("duration", 10.0f);
+    const profiling::LoadGenerator::Arrivals arrivals = profiling::LoadGenerator::ArrivalsFromStr(cmdLine.GetString("arrivals"));
+
+    uchar3* imgPtr  = NULL;
+    int imgWidth    = 0;
+    int imgHeight   = 0;
+
+    LogInfo("Loading image: %s\n", imgFilename);
+    if(!loadImage(imgFilename, &imgPtr, &imgWidth, &imgHeight))
+        return 1;
+
+    profiling::LoadGenerator generator(net, arrivals);
+    profiling::LoadGenerator::Result result;
+    double sustained = 0;
+
+    printf("open loop -- %s arrivals, %.1f s per load\n", profiling::LoadGenerator::ArrivalsToStr(arrivals), duration);
+
+    if(!rates.empty())
+    {
+        profiling::LoadGenerator::printHeader();
+
+        for(size_t i = 0; i < rates.size(); i++)
+        {
+            if(!generator.run(rates[i], duration, imgPtr, imgWidth, imgHeight, result))
+                continue;
+
+            profiling::LoadGenerator::printResult(result, slo);
+            if(slo > 0 && profiling::LoadGenerator::isSustained(result, slo))
+                sustained = std::max(sustained, rates[i]);
+        }
+    }
+    else
+    {
+        // the closed loop throughput is where the search starts
+        const int warmup = 10;
+        timespec start, end, elapsed;
+        timestamp(&start);
+
+        for(int i = 0; i < warmup; i++)
+            net->classify(imgPtr, imgWidth, imgHeight);
+
+        timestamp(&end);
+        timeDiff(start, end, &elapsed);
+        const double capacity = warmup * 1000.0 / timeDouble(elapsed);
+        printf("open loop -- closed loop throughput %.2f images/s, searching the highest rate with p99 <= %.3f ms\n", capacity, slo);
+
+        profiling::LoadGenerator::printHeader();
+        sustained = generator.searchMaxRate(slo, capacity, cmdLine.GetInt("search-steps", 8), duration, imgPtr, imgWidth, imgHeight);
+    }
+
+    if(slo > 0)
+        printf("open loop -- highest sustained rate %.2f requests/s (p99 <= %.3f ms)\n", sustained, slo);
+
+    profiling::releaseImage(imgPtr);
+    return 0;
+}
+
+
+// classify the images of a directory through the decode, preprocess and inference pipeline
+int runDataset(profiling::ImageNet* net, const char* datasetPath, const commandLine& cmdLine)
+{
+    std::vector<std::string> images;
+    if(!profiling::Pipeline::listImages(datasetPath, images))
+        return 1;
+
+    LogInfo("Classifying %zu images from %s\n", images.size(), datasetPath);
+
+    const int decodeThreads = cmdLine.GetInt("decode-threads", 2);
+    profiling::Pipeline pipeline(net, decodeThreads, cmdLine.GetInt("queue-depth", 8));
+
+    // decode the images once, later runs map the cache
+    profiling::ImageCache cache;
+    const char* cachePath = cmdLine.GetString("cache");
+
+    if(cachePath)
+    {
+        const bool resize = cmdLine.GetFlag("cache-resize");
+        if(!cache.open(cachePath, images, resize ? net->GetInputWidth() : 0, resize ? net->GetInputHeight() : 0, decodeThreads))
+            return 1;
+        pipeline.setCache(&cache);
+    }
+
+    const bool success = pipeline.run(images, cmdLine.GetInt("epochs", 1));
+
+    pipeline.printReport();
+    return success ? 0 : 1;
+}
+
+
+int main(int argc, char** argv)
+{
+    // parse command line
+    commandLine cmdLine(argc, argv, IS_HEADLESS());
+
+    if(cmdLine.GetFlag("help"))
+        return usage();
+    
+    
+    // cmdLine.AddArg("--log-level=silent");  // force silent logging
+    // cmdLine.AddFlag("profile");  // force profiling
+    // Log::ParseCmdLine(cmdLine);  // update logger
+
+    int maxInfer = cmdLine.GetInt("nb-runs", 10);
+    if(cmdLine.GetFlag("profile"))
+    {
+        file_profiler_t::setFile(cmdLine.GetString("profile-out", "stdout"));
+    }
+
+    // expose the aggregated layer times
+    profiling::MetricsServer metricsServer;
+    const char* metricsAddress = cmdLine.GetString("metrics");
+
+    if(metricsAddress)
+    {
+        file_profiler_t::enableMetrics();
+        metricsServer.addCollector(file_profiler_t::renderMetrics);
+        metricsServer.start(metricsAddress);
+    }
+
+    // live layer times subscribers
+    profiling::StreamServer streamServer(profiling::STREAM_LAYER_TIME, sizeof(profiling::StreamLayerRecord));
+    const char* streamPath = cmdLine.GetString("stream");
+
+    if(streamPath && streamServer.start(streamPath))
+        file_profiler_t::setStream(&streamServer);
+
+    
+    // a command line argument containing the filename is expected
+    const char* datasetPath = cmdLine.GetString("dataset");
+
+    if(!datasetPath && argc < 2)
+    {
+        printf("recognition: expected image filename as argument\n");
+        printf("example usage: ./recognition my_image.jpg\n");
+        return 1;
+    }
+
+    // batch sizes to sweep
+    std::vector<uint32_t> batchSizes;
+    const char* batchSizesStr = cmdLine.GetString("batch-size");
+
+    if(batchSizesStr && !parseBatchSizes(batchSizesStr, batchSizes))
+        return 1;
+
+    const uint32_t maxBatchSize = batchSizes.empty() ? 1 : *std::max_element(batchSizes.begin(), batchSizes.end());
+
+    // load the recognition network with TensorRT or the cpu backend
+    // imageNet* net = imageNet::Create(imageNet::GOOGLENET);
+    profiling::ImageNet* net = profiling::ImageNet::Create(cmdLine, maxBatchSize);
+
+    // check to make sure that the network model loaded properly
+    if(!net)
+    {
+        printf("failed to load image recognition network\n");
+        return 1;
+    }
+
+    int status = 0;
+
+    if(datasetPath)
+        status = runDataset(net, datasetPath, cmdLine);
+    else if(cmdLine.GetString("rate") || cmdLine.GetFloat("slo", 0.0f) > 0)
+        status = runOpenLoop(net, argv[1], cmdLine);
+    else if(cmdLine.GetInt("streams", 0) > 0)
+        status = runStreams(net, argv[1], cmdLine.GetInt("streams", 0), maxInfer, cmdLine);
+    else if(!batchSizes.empty())
+        status = runBatches(net, argv[1], batchSizes, maxInfer);
+    else
+    {
+        // stop on the latency interval instead of a fixed number of runs
+        const float untilCI = cmdLine.GetFloat("until-ci", 0.0f);
+        profiling::Convergence convergence(untilCI / 100.0, profiling::Convergence::StatisticFromStr(cmdLine.GetString("ci-stat")),
+                                           cmdLine.GetInt("min-runs", 30), cmdLine.GetInt("max-runs", 10000));
+
+        if(untilCI > 0)
+            maxInfer = cmdLine.GetInt("max-runs", 10000);
+
+        status = runImage(net, argv, maxInfer, untilCI > 0 ? &convergence : NULL);
+    }
+
     // print profiler times
     // net->printProfilerTimes();
 
     // free the network's resources before shutting down
+    metricsServer.stop();
+    file_profiler_t::setStream(NULL);
+    streamServer.stop();
     delete net;
     fclose(file_profiler_t::getFile());
 
-    return 0;
+    return status;
 }
 
 // ./recognition $HOME/experiments/profiling/data/images/black_bear.jpg --network=resnet-18 --profile
\ No newline at end of file
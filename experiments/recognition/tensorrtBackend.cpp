@@ -0,0 +1,164 @@
+#include "tensorrtBackend.h"
+
+#ifdef WITH_TENSORRT
+
+#include <utility>
+
+using namespace profiling;
+
+static_assert((int)PHASE_TOTAL == (int)PROFILER_TOTAL, "phases must match the profiler queries");
+
+// constructor
+TensorRTBackend::TensorRTBackend() : imageNet(), mBatchSize(1), mBatchStartEvent(NULL) {}
+
+// destructor
+TensorRTBackend::~TensorRTBackend()
+{
+	if( mBatchStartEvent != NULL )
+		cudaEventDestroy(mBatchStartEvent);
+}
+
+// Create
+TensorRTBackend* TensorRTBackend::Create( const commandLine& cmdLine, uint32_t maxBatchSize )
+{
+	// obtain the network name
+	const char* modelName = cmdLine.GetString("network");
+
+	if( !modelName )
+		modelName = cmdLine.GetString("model", "googlenet");
+
+	// parse the network type
+	const NetworkType type = NetworkTypeFromStr(modelName);
+
+	if( type == CUSTOM )
+	{
+        // Custom network not supported yet
+        LogError(LOG_TRT "myImageNet -- custom models not supperted.");
+		return NULL;
+	}
+
+	// fp32, fp16 or int8, the fastest the device supports by default
+	const char* precisionName = cmdLine.GetString("precision");
+	const precisionType precision = precisionName ? precisionTypeFromStr(precisionName) : TYPE_FASTEST;
+
+	if( precision == TYPE_DISABLED )
+	{
+		LogError(LOG_TRT "myImageNet -- invalid precision '%s'\n", precisionName);
+		return NULL;
+	}
+
+	// create from pretrained model
+	return TensorRTBackend::Create(type, maxBatchSize, precision);
+}
+
+TensorRTBackend* TensorRTBackend::Create(NetworkType networkType, uint32_t maxBatchSize,
+                precisionType precision, deviceType device, bool allowGPUFallback)
+{
+    TensorRTBackend* net = new TensorRTBackend();
+
+	if( !net )
+		return NULL;
+
+	if( !net->init(networkType, maxBatchSize, precision, device, allowGPUFallback) )
+	{
+		LogError(LOG_TRT "myImageNet -- failed to initialize.\n");
+		delete net;
+		return NULL;
+	}
+
+	if( CUDA_FAILED(cudaEventCreate(&net->mBatchStartEvent)) )
+	{
+		LogError(LOG_TRT "myImageNet -- failed to create the batch event.\n");
+		delete net;
+		return NULL;
+	}
+
+	net->mNetworkType = networkType;
+	return net;
+}
+
+bool TensorRTBackend::preProcess( void* const* images, uint32_t batchSize, uint32_t width, uint32_t height, imageFormat format )
+{
+	if( batchSize == 0 || batchSize > mMaxBatchSize )
+	{
+		LogError(LOG_TRT "myImageNet -- invalid batch size %u (max %u)\n", batchSize, mMaxBatchSize);
+		return false;
+	}
+
+	mBatchSize = batchSize;
+
+	// downsample and convert to band-sequential BGR
+	if( batchSize == 1 )
+		return PreProcess(images[0], width, height, format);
+
+	// imageNet fills the start of the input tensor, point it to each image in turn
+	float* input = mInputs[0].CUDA;
+	const size_t imageSize = mInputs[0].size / mMaxBatchSize / sizeof(float);
+	const uint32_t startEvent = PROFILER_PREPROCESS * 2;
+	timespec batchStart;
+	bool success = true;
+
+	for( uint32_t n=0; n < batchSize && success; n++ )
+	{
+		mInputs[0].CUDA = input + n * imageSize;
+		success = PreProcess(images[n], width, height, format);
+
+		// keep the start events of the first image, so the phase spans the batch
+		if( n == 0 )
+		{
+			batchStart = mEventsCPU[startEvent];
+			std::swap(mEventsGPU[startEvent], mBatchStartEvent);
+		}
+	}
+
+	mInputs[0].CUDA = input;
+	mEventsCPU[startEvent] = batchStart;
+	std::swap(mEventsGPU[startEvent], mBatchStartEvent);
+	return success;
+}
+
+bool TensorRTBackend::process()
+{
+	// process with TRT
+	if( mBatchSize == 1 )
+		return Process();
+
+	// tensorNet always executes a single image
+	PROFILER_BEGIN(PROFILER_NETWORK);
+
+	if( !mContext->execute(mBatchSize, mBindings) )
+	{
+		LogError(LOG_TRT "myImageNet -- failed to execute a batch of %u images\n", mBatchSize);
+		return false;
+	}
+
+	PROFILER_END(PROFILER_NETWORK);
+	return true;
+}
+
+void TensorRTBackend::setLayerReporter(LayerReporter* reporter)
+{
+    gProfiler.reporter = reporter;
+    mEnableProfiler = (reporter != NULL);
+
+    if(mContext != NULL)
+        mContext->setProfiler(reporter ? &gProfiler : NULL);
+}
+
+bool TensorRTBackend::queryPhase(Phase phase, PhaseTime& time)
+{
+    const profilerQuery query = (profilerQuery)phase;
+
+    if( !PROFILER_QUERY(query) )
+        return false;
+
+    // the total starts with the pre-processing
+    const timespec start = mEventsCPU[(phase == PHASE_TOTAL ? PROFILER_PREPROCESS : query) * 2];
+
+    time.start = timeDouble(start);
+    time.cpu = mProfilerTimes[query].x;
+    time.device = mProfilerTimes[query].y;
+    return true;
+}
+
+#endif
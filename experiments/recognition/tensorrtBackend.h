@@ -0,0 +1,74 @@
+#ifndef __TENSORRT_BACKEND_H__
+#define __TENSORRT_BACKEND_H__
+
+#include <profiling/config.h>
+
+#ifdef WITH_TENSORRT
+
+#include <jetson-inference/imageNet.h>
+#include "backend.h"
+
+namespace profiling
+{
+    /*
+    * Runs the jetson-inference image recognition models with TensorRT.
+    */
+    class TensorRTBackend : public InferenceBackend, private imageNet
+    {
+        public:
+            // load network instance
+            static TensorRTBackend* Create( NetworkType networkType=GOOGLENET, uint32_t maxBatchSize=DEFAULT_MAX_BATCH_SIZE,
+                precisionType precision=TYPE_FASTEST,
+                deviceType device=DEVICE_GPU, bool allowGPUFallback=true );
+
+            // create network from commandline
+            static TensorRTBackend* Create(const commandLine& cmdLine, uint32_t maxBatchSize=DEFAULT_MAX_BATCH_SIZE);
+
+            virtual ~TensorRTBackend();
+
+            using InferenceBackend::preProcess;
+            bool preProcess(void* const* images, uint32_t batchSize, uint32_t width, uint32_t height, imageFormat format);
+            bool process();
+
+            inline const float* getOutput() const { return mOutputs[0].CPU; }
+            inline uint32_t getNumClasses() const { return mOutputClasses; }
+            inline uint32_t getMaxBatchSize() const { return mMaxBatchSize; }
+            inline const char* getClassDesc(uint32_t index) const { return mClassDesc[index].c_str(); }
+            inline uint32_t getInputWidth() const { return GetInputWidth(); }
+            inline uint32_t getInputHeight() const { return GetInputHeight(); }
+            inline const char* getModelPath() const { return GetModelPath(); }
+            inline const char* getName() const { return "tensorrt"; }
+
+            void setLayerReporter(LayerReporter* reporter);
+
+            inline void beginPhase(Phase phase) { PROFILER_BEGIN((profilerQuery)phase); }
+            inline void endPhase(Phase phase) { PROFILER_END((profilerQuery)phase); }
+            bool queryPhase(Phase phase, PhaseTime& time);
+
+            static inline const char* Usage() { return imageNet::Usage(); }
+
+        protected:
+            TensorRTBackend();
+
+            uint32_t mBatchSize;            // of the last preProcess
+            cudaEvent_t mBatchStartEvent;   // start of the first image while pre-processing a batch
+
+            // forward the TensorRT layer times to the reporter
+            class Profiler : public nvinfer1::IProfiler
+            {
+            public:
+                Profiler() : reporter(NULL) { }
+
+                virtual void reportLayerTime(const char* layerName, float ms) NOEXCEPT
+                {
+                    if(reporter)
+                        reporter->reportLayerTime(layerName, ms);
+                }
+
+                LayerReporter* reporter;
+            } gProfiler;
+    };
+}
+
+#endif
+#endif
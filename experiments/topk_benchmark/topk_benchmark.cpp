@@ -0,0 +1,151 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <random>
+#include <vector>
+
+#include <profiling/argparse.h>
+#include <profiling/topk.h>
+#include <profiling/logger.h>
+
+#define BENCHMARK_USAGE_STRING "Usage of topk benchmark: \n"\
+                               "./topk_benchmark [--iterations=ITERATIONS] [--k=K] [--help]\n"\
+                               "Times the top-k selection of the classifier output on 1000 and 21841 classes.\n"\
+                               "Arguments: \n"\
+                               "--iterations | -i        Selections timed per output size. Defaults to 20000.\n"\
+                               "--k          | -k        Classes to select. Defaults to 5.\n"\
+                               "--help       | -h        Show the help message.\n\n"
+
+#define usage() printf(BENCHMARK_USAGE_STRING)
+
+// previous post-processing of ImageNet::classify, without the logging. Only the best class
+// whatever k, the parameter is there for the Selector signature.
+uint32_t argmaxLoop(const float* values, uint32_t count, uint32_t /*k*/, uint32_t* indices, float* scores)
+{
+  int classIndex = -1;
+  float classMax = -1.0f;
+
+  for(uint32_t n = 0; n < count; n++)
+  {
+    const float value = values[n];
+    if(value > classMax)
+    {
+      classIndex = n;
+      classMax = value;
+    }
+  }
+
+  indices[0] = classIndex;
+  scores[0] = classMax;
+  return 1;
+}
+
+typedef uint32_t (*Selector)(const float*, uint32_t, uint32_t, uint32_t*, float*);
+
+double monotonicNs()
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// Softmax of random logits, like the output of a classifier
+void fillOutputs(std::vector<float>& outputs, uint32_t classes, uint32_t variants, std::mt19937& random)
+{
+  std::normal_distribution<float> logit(0.0f, 2.0f);
+  outputs.resize((size_t)classes * variants);
+
+  for(uint32_t v = 0; v < variants; v++)
+  {
+    float* output = &outputs[(size_t)v * classes];
+    double sum = 0;
+    for(uint32_t n = 0; n < classes; n++)
+    {
+      output[n] = expf(logit(random));
+      sum += output[n];
+    }
+    for(uint32_t n = 0; n < classes; n++)
+      output[n] /= sum;
+  }
+}
+
+// Mean time of a selection in ns. `checksum` keeps the calls from being optimized out.
+double timeSelector(Selector selector, const std::vector<float>& outputs, uint32_t classes, uint32_t variants,
+                    uint32_t iterations, uint32_t k, uint64_t& checksum)
+{
+  std::vector<uint32_t> indices(k);
+  std::vector<float> scores(k);
+
+  const double start = monotonicNs();
+  for(uint32_t i = 0; i < iterations; i++)
+  {
+    const float* output = &outputs[(size_t)(i % variants) * classes];
+    selector(output, classes, k, indices.data(), scores.data());
+    checksum += indices[0];
+  }
+  return (monotonicNs() - start) / iterations;
+}
+
+int main(int argc, char** argv)
+{
+  arg_option options[] = {
+    OPT_BOOLEAN('h', "help",       NULL),
+    OPT_INTEGER('i', "iterations", NULL),
+    OPT_INTEGER('k', "k",          NULL),
+  };
+
+  command_line cmd = { options, 3 };
+  parse_command_line(&cmd, argc, argv);
+
+  if(get_option_value(&cmd, "help"))
+  {
+    free_command_line(&cmd);
+    usage();
+    exit(EXIT_SUCCESS);
+  }
+
+  int* value = (int*) get_option_value(&cmd, "iterations");
+  const uint32_t iterations = (value && *value > 0) ? *value : 20000;
+  value = (int*) get_option_value(&cmd, "k");
+  const uint32_t k = (value && *value > 0) ? *value : 5;
+  free_command_line(&cmd);
+
+  static const uint32_t sizes[] = { 1000, 21841 };
+  const uint32_t variants = 64;
+  std::mt19937 random(42);
+  uint64_t checksum = 0;
+
+  printf("top-%u selection, %s instructions, %u iterations\n", k, profiling::topKInstructionSet(), iterations);
+  printf("%8s  %12s  %12s  %12s  %12s\n", "classes", "argmax (ns)", "scalar (ns)", "simd (ns)", "speedup");
+
+  for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+  {
+    const uint32_t classes = sizes[s];
+    std::vector<float> outputs;
+    fillOutputs(outputs, classes, variants, random);
+
+    // the simd selection must match the reference
+    std::vector<uint32_t> expected(k), found(k);
+    std::vector<float> expectedScores(k), foundScores(k);
+    for(uint32_t v = 0; v < variants; v++)
+    {
+      const float* output = &outputs[(size_t)v * classes];
+      const uint32_t count = profiling::topKScalar(output, classes, k, expected.data(), expectedScores.data());
+      if(profiling::topK(output, classes, k, found.data(), foundScores.data()) != count || expected != found)
+      {
+        printf(ERROR "Selections differ on %u classes.\n", classes);
+        return EXIT_FAILURE;
+      }
+    }
+
+    const double argmax = timeSelector(argmaxLoop, outputs, classes, variants, iterations, 1, checksum);
+    const double scalar = timeSelector(profiling::topKScalar, outputs, classes, variants, iterations, k, checksum);
+    const double simd = timeSelector(profiling::topK, outputs, classes, variants, iterations, k, checksum);
+
+    printf("%8u  %12.1f  %12.1f  %12.1f  %11.2fx\n", classes, argmax, scalar, simd, scalar / simd);
+  }
+
+  log("checksum %llu\n", (unsigned long long)checksum);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,34 @@
+#!/bin/bash
+# Build a fake sysfs tree to try the thermal gate of profile_sweep or the caps of profile_governor without a Jetson:
+#   scripts/fake-sysfs.sh /tmp/sysfs
+#   echo "sysfs /tmp/sysfs" >> my.spec      or      profile_governor --sysfs=/tmp/sysfs ...
+# then change the files while the sweep runs, for example:
+#   echo 90000 > /tmp/sysfs/class/thermal/thermal_zone0/temp                           (over the passive trip)
+#   echo 1000000 > /tmp/sysfs/devices/system/cpu/cpufreq/policy0/scaling_max_freq      (clocks capped)
+
+ROOT=${1:?usage: fake-sysfs.sh DIR}
+
+ZONE=${ROOT}/class/thermal/thermal_zone0
+COOLING=${ROOT}/class/thermal/cooling_device0
+POLICY=${ROOT}/devices/system/cpu/cpufreq/policy0
+GPU=${ROOT}/class/devfreq/17000000.gv11b
+
+mkdir -p ${ZONE} ${COOLING} ${POLICY} ${GPU} || exit 1
+
+echo cpu-thermal > ${ZONE}/type
+echo 45000 > ${ZONE}/temp             # m°C
+echo passive > ${ZONE}/trip_point_0_type
+echo 85000 > ${ZONE}/trip_point_0_temp
+
+echo cpu-balanced > ${COOLING}/type
+echo 0 > ${COOLING}/cur_state
+
+echo 1420000 > ${POLICY}/scaling_cur_freq  # kHz
+echo 1420000 > ${POLICY}/scaling_max_freq
+echo 710400 > ${POLICY}/scaling_min_freq
+echo "102000 710400 1036800 1420000" > ${POLICY}/scaling_available_frequencies
+
+echo 921600000 > ${GPU}/cur_freq  # Hz
+echo 921600000 > ${GPU}/max_freq
+echo 76800000 > ${GPU}/min_freq
+echo "76800000 460800000 921600000" > ${GPU}/available_frequencies
@@ -0,0 +1,23 @@
+# Sweep of the image recognition models, run with:
+#   profile_sweep --spec=scripts/profile-sweep.spec   (from the repository root)
+# Every combination of models, precisions, batches and streams is run on the same image.
+
+backend     tensorrt
+image       data/images/black_bear.jpg
+models      googlenet resnet-18 resnet-50
+precisions  fp32 fp16 int8
+batches     1 2 4 8
+streams     1 2
+
+runs        200     # classifications of each stream
+warmup      20
+
+# energy of each configuration, the power profiler service must be running
+power       sweep_power.csv
+profile     sweep_layers.csv
+output      sweep_results.csv
+
+# start each configuration cool and steady, leave out the ones throttled while measured
+cooldown    50      # °C
+stable      1 30    # within 1 °C over 30 s
+throttled   discard
@@ -1,24 +1,18 @@
 #!/bin/bash
 
 PROGRAM=${HOME}/experiments/profiling/build/aarch64/bin/recognition
+CONTROL=${HOME}/experiments/profiling/build/aarch64/bin/power_ctl
 DATA_PATH=${HOME}/experiments/profiling/data/images
 OUT_PATH=${HOME}/experiments/profiling
 
-# start service
-systemctl start my-profiler.service
+# the profiler runs as a daemon, start it if needed (returns once it is ready)
+systemctl is-active --quiet my-profiler.service || systemctl start my-profiler.service
 
-echo "Waiting for service to start"
-sleep 3 
-echo "Service started"
-echo ""
+# returns once the first sample is written
+${CONTROL} start ${OUT_PATH}/power_output.csv || exit 1
+${CONTROL} mark recognition_start
 
 ${PROGRAM} ${DATA_PATH}/black_bear.jpg --network=resnet-50 --log-level=silent --nb-runs=10000  --profile-out=${OUT_PATH}/layer_out.csv --profile
 
-# wait before closing service
-echo ""
-echo "Stopping service"
-sleep 5
-
-stop service
-systemctl stop my-profiler.service
-echo "Service stopped"
+${CONTROL} mark recognition_end
+${CONTROL} stop
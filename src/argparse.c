@@ -100,7 +100,7 @@ static int split_arg(const char* arg, char** arg_name, char** arg_value)
     free(*arg_name); 
     *arg_name = NULL;
     // assign arg value
-    *arg_value = (char *) calloc(strlen(arg), sizeof(char)); 
+    *arg_value = (char *) calloc(strlen(arg) + 1, sizeof(char));  // with the terminating null
     strncpy(*arg_value, arg, strlen(arg));
     return 0;
   }
@@ -124,7 +124,7 @@ static int split_arg(const char* arg, char** arg_name, char** arg_value)
     // if we have characters to copy
     if(buff_size > 0)
     {
-      *arg_value = (char *) calloc(buff_size, sizeof(char));  
+      *arg_value = (char *) calloc(buff_size + 1, sizeof(char));  // with the terminating null
       strncpy(*arg_value, buff+(index), buff_size);
     }
     else
@@ -285,7 +285,7 @@ static int parse_float(arg_option* option, float value)
 static int parse_string(arg_option* option, char* value)
 {
   int size = strlen(value);
-  option->value = (char *) calloc(size, sizeof(char));
+  option->value = (char *) calloc(size + 1, sizeof(char));  // with the terminating null
   strncpy((char*)option->value, value, size);
   return 0;
 }
@@ -0,0 +1,65 @@
+#include "captureParser.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "traceParser.h"
+
+using namespace profiling;
+
+bool profiling::parseCaptureLine(const char* line, const char* end, CaptureSample& sample)
+{
+    double fields[5];
+    bool valid[5];
+    const char* field = line;
+
+    for(int n = 0; n < 5; n++)
+    {
+        const char* separator = field ? (const char*)memchr(field, ';', end - field) : NULL;
+        const char* fieldEnd = separator ? separator : end;
+        const char* c = field;
+
+        valid[n] = field && parseDecimal(c, fieldEnd, fields[n]) && c == fieldEnd;
+        field = separator ? separator + 1 : NULL;
+    }
+
+    if(!valid[0] || !valid[1])
+        return false;
+
+    sample.time = (int64_t)fields[0] * 1000000000LL + (int64_t)fields[1];
+    sample.current = valid[2] ? (int32_t)lround(fields[2]) : -1;
+    sample.voltage = valid[3] ? (int32_t)lround(fields[3]) : -1;
+    sample.power = valid[4] ? (int32_t)lround(fields[4]) : -1;
+    return true;
+}
+
+bool CaptureReader::next(CaptureSample& sample)
+{
+    while(mPosition < mEnd)
+    {
+        const char* line = mPosition;
+        const char* newLine = (const char*)memchr(line, '\n', mEnd - line);
+        const char* end = newLine ? newLine : mEnd;
+        mPosition = newLine ? newLine + 1 : mEnd;
+
+        if(end > line && end[-1] == '\r')
+            end--;
+
+        if(parseCaptureLine(line, end, sample))
+            return true;
+    }
+    return false;
+}
+
+std::string CaptureReader::getRailName(const char* begin, const char* end)
+{
+    const char* newLine = (const char*)memchr(begin, '\n', end - begin);
+    const std::string header(begin, newLine ? newLine : end);
+
+    const size_t name = header.find("curr_");
+    if(name == std::string::npos)
+        return std::string();
+
+    const size_t separator = header.find_first_of(";\r", name);
+    return header.substr(name + 5, separator == std::string::npos ? std::string::npos : separator - name - 5);
+}
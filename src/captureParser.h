@@ -0,0 +1,45 @@
+#ifndef __CAPTURE_PARSER_H__
+#define __CAPTURE_PARSER_H__
+
+#include <stdint.h>
+#include <string>
+
+namespace profiling
+{
+    // Sample of a power_profiler capture, the values not watched are -1
+    struct CaptureSample
+    {
+        int64_t time;     // ns since the epoch
+        int32_t current;  // mA
+        int32_t voltage;  // mV
+        int32_t power;    // mW
+    };
+
+    /*
+    * Reads the samples of a power_profiler capture from a buffer, usually a MappedFile.
+    * Lines are `sec;nsec;current;voltage;power`, after a header
+    * `start_time_sec;start_time_nsec;curr_RAIL;volt_RAIL;powe_RAIL`.
+    */
+    class CaptureReader
+    {
+    public:
+        CaptureReader(const char* begin, const char* end) : mPosition(begin), mEnd(end) {}
+
+        // Next sample, the header and the lines without a timestamp are skipped.
+        // Returns false at the end of the buffer.
+        bool next(CaptureSample& sample);
+
+        // Rail of the header of a capture, empty if it has none
+        static std::string getRailName(const char* begin, const char* end);
+
+    private:
+        const char* mPosition;
+        const char* mEnd;
+    };
+
+    // Parse a capture line, `end` is the end of the line without the new line.
+    // Returns false if it has no timestamp (header). Empty fields are values not watched.
+    bool parseCaptureLine(const char* line, const char* end, CaptureSample& sample);
+}
+
+#endif
@@ -0,0 +1,536 @@
+#include "columnStore.h"
+
+#include <string.h>
+#include <algorithm>
+#include <jetson-utils/logging.h>
+
+#define STORE_MAGIC         "PRFSTOR1"
+#define STORE_MAGIC_SIZE    8
+#define STORE_HEADER_SIZE   16
+#define STORE_TRAILER_SIZE  (8 + STORE_MAGIC_SIZE)
+
+using namespace profiling;
+
+// bits to store values from 0 to `range`
+static inline uint8_t bitWidth(uint64_t range)
+{
+    return range == 0 ? 0 : 64 - __builtin_clzll(range);
+}
+
+// Pack `count` values of `width` bits in 64 bit words, lowest bits first
+static void pack(const uint64_t* values, size_t count, uint8_t width, std::vector<uint64_t>& words)
+{
+    words.assign((count * width + 63) / 64, 0);
+    if(width == 0)
+        return;  // constant block, only the base is stored
+
+    for(size_t i = 0; i < count; i++)
+    {
+        const size_t bit = i * width;
+        const size_t word = bit / 64;
+        const uint32_t shift = bit % 64;
+
+        words[word] |= values[i] << shift;
+        if(shift + width > 64)
+            words[word + 1] |= values[i] >> (64 - shift);
+    }
+}
+
+static inline uint64_t unpack(const uint64_t* words, size_t index, uint8_t width)
+{
+    const size_t bit = index * width;
+    const size_t word = bit / 64;
+    const uint32_t shift = bit % 64;
+
+    uint64_t value = words[word] >> shift;
+    if(shift + width > 64)
+        value |= words[word + 1] << (64 - shift);
+
+    return width == 64 ? value : value & ((1ULL << width) - 1);
+}
+
+
+int TableInfo::getColumnIndex(const char* name) const
+{
+    for(size_t n = 0; n < columns.size(); n++)
+    {
+        if(columns[n].name == name)
+            return n;
+    }
+    return -1;
+}
+
+
+ColumnStoreWriter::ColumnStoreWriter() : mFile(NULL), mOffset(0)
+{
+}
+
+ColumnStoreWriter::~ColumnStoreWriter()
+{
+    if(mFile)
+        close();
+}
+
+bool ColumnStoreWriter::open(const char* path)
+{
+    mFile = fopen(path, "wb");
+    if(!mFile)
+    {
+        LogError("column store -- failed to create '%s'\n", path);
+        return false;
+    }
+
+    char header[STORE_HEADER_SIZE] = { 0 };
+    memcpy(header, STORE_MAGIC, STORE_MAGIC_SIZE);
+    fwrite(header, 1, sizeof(header), mFile);
+    mOffset = sizeof(header);
+    return true;
+}
+
+int ColumnStoreWriter::addTable(const char* name, const ColumnSpec* columns, int count)
+{
+    mTables.push_back(TableBuffer());
+    TableBuffer& table = mTables.back();
+
+    table.info.name = name;
+    table.info.rows = 0;
+    table.info.columns.resize(count);
+    table.values.resize(count);
+
+    for(int n = 0; n < count; n++)
+    {
+        table.info.columns[n].name = columns[n].name;
+        table.info.columns[n].scale = columns[n].scale;
+        table.info.columns[n].dictionary = columns[n].dictionary;
+        table.values[n].reserve(COLUMN_BLOCK_ROWS);
+    }
+    return mTables.size() - 1;
+}
+
+void ColumnStoreWriter::append(int id, const int64_t* values)
+{
+    TableBuffer& table = mTables[id];
+
+    for(size_t n = 0; n < table.values.size(); n++)
+        table.values[n].push_back(values[n]);
+
+    table.info.rows++;
+    if(table.values[0].size() == COLUMN_BLOCK_ROWS)
+        flush(table);
+}
+
+int64_t ColumnStoreWriter::getNameId(const char* name, size_t length)
+{
+    const std::string key(name, length);
+    std::unordered_map<std::string, int64_t>::const_iterator found = mNameIds.find(key);
+    if(found != mNameIds.end())
+        return found->second;
+
+    const int64_t id = mNames.size();
+    mNames.push_back(key);
+    mNameIds[key] = id;
+    return id;
+}
+
+void ColumnStoreWriter::flush(TableBuffer& table)
+{
+    if(table.values.empty() || table.values[0].empty())
+        return;
+
+    for(size_t n = 0; n < table.values.size(); n++)
+    {
+        writeBlock(table.info.columns[n], table.values[n]);
+        table.values[n].clear();
+    }
+}
+
+void ColumnStoreWriter::writeBlock(ColumnInfo& column, const std::vector<int64_t>& values)
+{
+    const size_t count = values.size();
+
+    ColumnBlock block;
+    block.offset = mOffset;
+    block.rows = count;
+    block.min = *std::min_element(values.begin(), values.end());
+    block.max = *std::max_element(values.begin(), values.end());
+
+    // deltas pay off on sorted columns (runs, timestamps)
+    int64_t minDelta = 0;
+    int64_t maxDelta = 0;
+    for(size_t i = 1; i < count; i++)
+    {
+        const int64_t delta = (int64_t)((uint64_t)values[i] - (uint64_t)values[i - 1]);
+        minDelta = i == 1 ? delta : std::min(minDelta, delta);
+        maxDelta = i == 1 ? delta : std::max(maxDelta, delta);
+    }
+
+    const uint8_t frameWidth = bitWidth((uint64_t)block.max - (uint64_t)block.min);
+    const uint8_t deltaWidth = count > 1 ? bitWidth((uint64_t)maxDelta - (uint64_t)minDelta) : 0;
+
+    std::vector<uint64_t> offsets(count);
+
+    if(count > 1 && deltaWidth < frameWidth)
+    {
+        block.encoding = ENCODING_DELTA;
+        block.width = deltaWidth;
+        block.base = values[0];
+        block.step = minDelta;
+
+        offsets[0] = 0;
+        for(size_t i = 1; i < count; i++)
+            offsets[i] = (uint64_t)values[i] - (uint64_t)values[i - 1] - (uint64_t)minDelta;
+    }
+    else
+    {
+        block.encoding = ENCODING_FRAME;
+        block.width = frameWidth;
+        block.base = block.min;
+        block.step = 0;
+
+        for(size_t i = 0; i < count; i++)
+            offsets[i] = (uint64_t)values[i] - (uint64_t)block.min;
+    }
+
+    pack(offsets.data(), count, block.width, mPacked);
+    fwrite(mPacked.data(), sizeof(uint64_t), mPacked.size(), mFile);
+    mOffset += mPacked.size() * sizeof(uint64_t);
+
+    column.blocks.push_back(block);
+}
+
+template<typename T>
+static void appendValue(std::string& out, const T& value)
+{
+    out.append((const char*)&value, sizeof(value));
+}
+
+static void appendString(std::string& out, const std::string& value)
+{
+    appendValue(out, (uint32_t)value.size());
+    out.append(value);
+}
+
+bool ColumnStoreWriter::close()
+{
+    if(!mFile)
+        return false;
+
+    for(size_t t = 0; t < mTables.size(); t++)
+        flush(mTables[t]);
+
+    std::string footer;
+    appendValue(footer, (uint32_t)mNames.size());
+    for(size_t n = 0; n < mNames.size(); n++)
+        appendString(footer, mNames[n]);
+
+    appendValue(footer, (uint32_t)mTables.size());
+    for(size_t t = 0; t < mTables.size(); t++)
+    {
+        const TableInfo& table = mTables[t].info;
+        appendString(footer, table.name);
+        appendValue(footer, table.rows);
+        appendValue(footer, (uint32_t)table.columns.size());
+
+        for(size_t c = 0; c < table.columns.size(); c++)
+        {
+            const ColumnInfo& column = table.columns[c];
+            appendString(footer, column.name);
+            appendValue(footer, column.scale);
+            appendValue(footer, (uint8_t)column.dictionary);
+            appendValue(footer, (uint32_t)column.blocks.size());
+
+            for(size_t b = 0; b < column.blocks.size(); b++)
+            {
+                const ColumnBlock& block = column.blocks[b];
+                appendValue(footer, block.offset);
+                appendValue(footer, block.rows);
+                appendValue(footer, block.encoding);
+                appendValue(footer, block.width);
+                appendValue(footer, block.min);
+                appendValue(footer, block.max);
+                appendValue(footer, block.base);
+                appendValue(footer, block.step);
+            }
+        }
+    }
+
+    appendValue(footer, mOffset);
+    footer.append(STORE_MAGIC, STORE_MAGIC_SIZE);
+
+    const bool written = fwrite(footer.data(), 1, footer.size(), mFile) == footer.size();
+    const bool closed = fclose(mFile) == 0;
+    mFile = NULL;
+
+    if(!written || !closed)
+        LogError("column store -- failed to write the footer\n");
+    return written && closed;
+}
+
+
+namespace
+{
+    // Bounds checked reads of the footer
+    struct FooterReader
+    {
+        const char* position;
+        const char* end;
+        bool valid;
+
+        template<typename T>
+        T read()
+        {
+            T value = T();
+            if(end - position < (ptrdiff_t)sizeof(T))
+            {
+                valid = false;
+                return value;
+            }
+            memcpy(&value, position, sizeof(T));
+            position += sizeof(T);
+            return value;
+        }
+
+        std::string readString()
+        {
+            const uint32_t size = read<uint32_t>();
+            if(!valid || end - position < (ptrdiff_t)size)
+            {
+                valid = false;
+                return std::string();
+            }
+            position += size;
+            return std::string(position - size, size);
+        }
+    };
+}
+
+bool ColumnStore::open(const char* path)
+{
+    mTables.clear();
+    mNames.clear();
+
+    if(!mFile.open(path))
+        return false;
+
+    const char* data = mFile.getData();
+    const size_t size = mFile.getSize();
+
+    if(size < STORE_HEADER_SIZE + STORE_TRAILER_SIZE || memcmp(data, STORE_MAGIC, STORE_MAGIC_SIZE) != 0 ||
+       memcmp(data + size - STORE_MAGIC_SIZE, STORE_MAGIC, STORE_MAGIC_SIZE) != 0)
+    {
+        LogError("column store -- '%s' is not a column store\n", path);
+        return false;
+    }
+
+    uint64_t footerOffset = 0;
+    memcpy(&footerOffset, data + size - STORE_TRAILER_SIZE, sizeof(footerOffset));
+    if(footerOffset < STORE_HEADER_SIZE || footerOffset > size - STORE_TRAILER_SIZE)
+    {
+        LogError("column store -- invalid footer in '%s'\n", path);
+        return false;
+    }
+
+    FooterReader footer = { data + footerOffset, data + size - STORE_TRAILER_SIZE, true };
+
+    const uint32_t names = footer.read<uint32_t>();
+    for(uint32_t n = 0; n < names && footer.valid; n++)
+        mNames.push_back(footer.readString());
+
+    const uint32_t tables = footer.read<uint32_t>();
+    for(uint32_t t = 0; t < tables && footer.valid; t++)
+    {
+        mTables.push_back(TableInfo());
+        TableInfo& table = mTables.back();
+
+        table.name = footer.readString();
+        table.rows = footer.read<uint64_t>();
+        table.columns.resize(footer.valid ? footer.read<uint32_t>() : 0);
+
+        for(size_t c = 0; c < table.columns.size() && footer.valid; c++)
+        {
+            ColumnInfo& column = table.columns[c];
+            column.name = footer.readString();
+            column.scale = footer.read<double>();
+            column.dictionary = footer.read<uint8_t>() != 0;
+            column.blocks.resize(footer.valid ? footer.read<uint32_t>() : 0);
+
+            for(size_t b = 0; b < column.blocks.size() && footer.valid; b++)
+            {
+                ColumnBlock& block = column.blocks[b];
+                block.offset = footer.read<uint64_t>();
+                block.rows = footer.read<uint32_t>();
+                block.encoding = footer.read<uint8_t>();
+                block.width = footer.read<uint8_t>();
+                block.min = footer.read<int64_t>();
+                block.max = footer.read<int64_t>();
+                block.base = footer.read<int64_t>();
+                block.step = footer.read<int64_t>();
+
+                // the packed values must be in the file
+                const uint64_t bytes = ((uint64_t)block.rows * block.width + 63) / 64 * 8;
+                if(block.width > 64 || block.rows > COLUMN_BLOCK_ROWS || block.offset % 8 != 0 ||
+                   block.offset + bytes > footerOffset)
+                    footer.valid = false;
+            }
+        }
+    }
+
+    if(!footer.valid)
+    {
+        LogError("column store -- truncated footer in '%s'\n", path);
+        mTables.clear();
+        mNames.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ColumnStore::isColumnStore(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if(!file)
+        return false;
+
+    char magic[STORE_MAGIC_SIZE];
+    const bool store = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, STORE_MAGIC, sizeof(magic)) == 0;
+    fclose(file);
+    return store;
+}
+
+const TableInfo* ColumnStore::getTable(const char* name) const
+{
+    for(size_t t = 0; t < mTables.size(); t++)
+    {
+        if(mTables[t].name == name)
+            return &mTables[t];
+    }
+    return NULL;
+}
+
+int64_t ColumnStore::findName(const char* name) const
+{
+    std::vector<std::string>::const_iterator found = std::find(mNames.begin(), mNames.end(), name);
+    return found == mNames.end() ? -1 : found - mNames.begin();
+}
+
+void ColumnStore::readBlock(const ColumnBlock& block, int64_t* values) const
+{
+    // blocks are 8 bytes aligned in the mapping
+    const uint64_t* words = (const uint64_t*)(mFile.getData() + block.offset);
+
+    if(block.width == 0)
+    {
+        // constant block, or constant delta
+        for(uint32_t i = 0; i < block.rows; i++)
+            values[i] = block.encoding == ENCODING_DELTA ? (int64_t)((uint64_t)block.base + (uint64_t)block.step * i) : block.base;
+        return;
+    }
+
+    if(block.encoding == ENCODING_DELTA)
+    {
+        uint64_t value = block.base;
+        values[0] = block.base;
+        for(uint32_t i = 1; i < block.rows; i++)
+        {
+            value += unpack(words, i, block.width) + (uint64_t)block.step;
+            values[i] = (int64_t)value;
+        }
+    }
+    else
+    {
+        for(uint32_t i = 0; i < block.rows; i++)
+            values[i] = (int64_t)((uint64_t)block.base + unpack(words, i, block.width));
+    }
+}
+
+
+ColumnScan::ColumnScan(const ColumnStore& store, const TableInfo& table, const std::vector<int>& projection,
+                       const std::vector<ColumnRange>& ranges)
+    : mStore(store), mTable(table), mProjection(projection), mRanges(ranges), mBlock(0), mBlocksRead(0), mBlocksSkipped(0)
+{
+    mValues.resize(COLUMN_BLOCK_ROWS);
+    mSelection.reserve(COLUMN_BLOCK_ROWS);
+}
+
+bool ColumnScan::mayMatch(size_t block, bool& covered) const
+{
+    covered = true;
+
+    for(size_t r = 0; r < mRanges.size(); r++)
+    {
+        const ColumnBlock& zone = mTable.columns[mRanges[r].column].blocks[block];
+        if(zone.max < mRanges[r].min || zone.min > mRanges[r].max)
+            return false;
+
+        if(zone.min < mRanges[r].min || zone.max > mRanges[r].max)
+            covered = false;
+    }
+    return true;
+}
+
+size_t ColumnScan::next(std::vector<std::vector<int64_t> >& columns)
+{
+    columns.resize(mProjection.size());
+    for(size_t p = 0; p < columns.size(); p++)
+        columns[p].clear();
+
+    if(mTable.columns.empty())
+        return 0;
+
+    const size_t blocks = mTable.columns[0].blocks.size();
+
+    for(; mBlock < blocks; mBlock++)
+    {
+        bool covered = false;
+        if(!mayMatch(mBlock, covered))
+        {
+            mBlocksSkipped++;
+            continue;
+        }
+
+        const uint32_t rows = mTable.columns[0].blocks[mBlock].rows;
+        mSelection.clear();
+
+        if(covered)
+        {
+            for(uint32_t i = 0; i < rows; i++)
+                mSelection.push_back(i);
+        }
+        else
+        {
+            // rows matching all the ranges, narrowed column by column
+            for(uint32_t i = 0; i < rows; i++)
+                mSelection.push_back(i);
+
+            for(size_t r = 0; r < mRanges.size() && !mSelection.empty(); r++)
+            {
+                mStore.readBlock(mTable.columns[mRanges[r].column].blocks[mBlock], mValues.data());
+
+                size_t kept = 0;
+                for(size_t s = 0; s < mSelection.size(); s++)
+                {
+                    const int64_t value = mValues[mSelection[s]];
+                    if(value >= mRanges[r].min && value <= mRanges[r].max)
+                        mSelection[kept++] = mSelection[s];
+                }
+                mSelection.resize(kept);
+            }
+        }
+
+        mBlocksRead++;
+        if(mSelection.empty())
+            continue;
+
+        for(size_t p = 0; p < mProjection.size(); p++)
+        {
+            mStore.readBlock(mTable.columns[mProjection[p]].blocks[mBlock], mValues.data());
+            columns[p].reserve(mSelection.size());
+            for(size_t s = 0; s < mSelection.size(); s++)
+                columns[p].push_back(mValues[mSelection[s]]);
+        }
+
+        mBlock++;
+        return mSelection.size();
+    }
+    return 0;
+}
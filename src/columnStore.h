@@ -0,0 +1,188 @@
+#ifndef __COLUMN_STORE_H__
+#define __COLUMN_STORE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mappedFile.h"
+
+#define COLUMN_BLOCK_ROWS 4096
+
+// tables of the profiler output and power captures imported by profile_store
+#define STORE_LAYERS_TABLE      "layers"      // run, layer, duration (ns)
+#define STORE_INFERENCES_TABLE  "inferences"  // run, session, start (us), duration (ns)
+#define STORE_POWER_TABLE       "power"       // time (ns), current, voltage, power
+
+namespace profiling
+{
+    /*
+    * Columnar file of profiling results (.pcs).
+    * Each table is split in blocks of COLUMN_BLOCK_ROWS rows. Each column of a block is stored
+    * on its own, bit packed from its minimum (frame of reference) or from the previous value
+    * (delta), whichever is smaller. The footer keeps the min and max of every column block
+    * (zone maps), so a query only reads the blocks that can match. Values are integers,
+    * divided by the scale of their column to be shown. Names are stored once in a dictionary.
+    *
+    * Layout: header, column blocks, footer (dictionary, tables), footer offset, magic.
+    */
+
+    enum ColumnEncoding
+    {
+        ENCODING_FRAME = 0,  // value - min
+        ENCODING_DELTA       // value - previous - min delta, from the first value
+    };
+
+    // Where a block of a column is and its zone map
+    struct ColumnBlock
+    {
+        uint64_t offset;     // from the start of the file
+        uint32_t rows;
+        uint8_t encoding;
+        uint8_t width;       // bits per packed value
+        int64_t min;
+        int64_t max;
+        int64_t base;        // min or first value
+        int64_t step;        // min delta
+    };
+
+    struct ColumnInfo
+    {
+        std::string name;
+        double scale;        // stored value / scale is the value shown, a power of 10
+        bool dictionary;     // values are ids of the dictionary
+        std::vector<ColumnBlock> blocks;
+    };
+
+    struct TableInfo
+    {
+        std::string name;
+        uint64_t rows;
+        std::vector<ColumnInfo> columns;
+
+        // Index of a column, -1 if the table doesn't have it
+        int getColumnIndex(const char* name) const;
+    };
+
+    // Column of a new table, the scale is a power of 10
+    struct ColumnSpec
+    {
+        const char* name;
+        double scale;
+        bool dictionary;
+    };
+
+    /*
+    * Writes the rows of the tables block by block, keeping a single block per column in memory.
+    */
+    class ColumnStoreWriter
+    {
+    public:
+        ColumnStoreWriter();
+        ~ColumnStoreWriter();
+
+        bool open(const char* path);
+        // Write the remaining blocks and the footer
+        bool close();
+
+        // Tables are added before their rows. Returns the id of the table.
+        int addTable(const char* name, const ColumnSpec* columns, int count);
+        // Append a row, one value per column of the table
+        void append(int table, const int64_t* values);
+
+        // Id of a name in the dictionary, added if it is new
+        int64_t getNameId(const char* name, size_t length);
+
+    private:
+        struct TableBuffer
+        {
+            TableInfo info;
+            std::vector<std::vector<int64_t> > values;  // rows of the current block, per column
+        };
+
+        void flush(TableBuffer& table);
+        void writeBlock(ColumnInfo& column, const std::vector<int64_t>& values);
+
+        FILE* mFile;
+        uint64_t mOffset;
+        std::vector<TableBuffer> mTables;
+        std::vector<std::string> mNames;
+        std::unordered_map<std::string, int64_t> mNameIds;
+        std::vector<uint64_t> mPacked;
+    };
+
+    /*
+    * Reads a column store through a memory mapping, only the blocks read are loaded from the disk.
+    */
+    class ColumnStore
+    {
+    public:
+        bool open(const char* path);
+
+        // Whether a file starts like a column store
+        static bool isColumnStore(const char* path);
+
+        const TableInfo* getTable(const char* name) const;
+        inline const std::vector<TableInfo>& getTables() const { return mTables; }
+
+        // Names of the dictionary columns
+        inline const std::vector<std::string>& getDictionary() const { return mNames; }
+        // Id of a name, -1 if it isn't in the store
+        int64_t findName(const char* name) const;
+
+        // Decode a block of a column in `values`, which must hold block.rows values
+        void readBlock(const ColumnBlock& block, int64_t* values) const;
+
+        inline uint64_t getSize() const { return mFile.getSize(); }
+
+    private:
+        MappedFile mFile;
+        std::vector<TableInfo> mTables;
+        std::vector<std::string> mNames;
+    };
+
+    // Rows where min <= column value <= max
+    struct ColumnRange
+    {
+        int column;
+        int64_t min;
+        int64_t max;
+    };
+
+    /*
+    * Reads the projected columns of the rows matching all the ranges, a block at a time.
+    * Blocks whose zone maps are outside a range are skipped without being read.
+    */
+    class ColumnScan
+    {
+    public:
+        ColumnScan(const ColumnStore& store, const TableInfo& table, const std::vector<int>& projection,
+                   const std::vector<ColumnRange>& ranges);
+
+        // Matching rows of the next blocks: columns[p][row] is the value of the projected column p.
+        // Returns the number of rows, 0 at the end of the table.
+        size_t next(std::vector<std::vector<int64_t> >& columns);
+
+        inline uint64_t getBlocksRead() const { return mBlocksRead; }
+        inline uint64_t getBlocksSkipped() const { return mBlocksSkipped; }
+
+    private:
+        // whether the zone maps of a block may match the ranges, `covered` if all its rows do
+        bool mayMatch(size_t block, bool& covered) const;
+
+        const ColumnStore& mStore;
+        const TableInfo& mTable;
+        std::vector<int> mProjection;
+        std::vector<ColumnRange> mRanges;
+        size_t mBlock;
+        std::vector<int64_t> mValues;
+        std::vector<uint32_t> mSelection;
+        uint64_t mBlocksRead;
+        uint64_t mBlocksSkipped;
+    };
+}
+
+#endif
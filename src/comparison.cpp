@@ -0,0 +1,135 @@
+#include "comparison.h"
+
+#include <math.h>
+#include <algorithm>
+
+using namespace profiling;
+
+double profiling::sortedMedian(const std::vector<double>& sorted)
+{
+    const size_t count = sorted.size();
+    if(count == 0)
+        return 0.0;
+    return count % 2 ? sorted[count / 2] : 0.5 * (sorted[count / 2 - 1] + sorted[count / 2]);
+}
+
+double profiling::mannWhitneyTest(const std::vector<double>& a, const std::vector<double>& b, double* z)
+{
+    const double countA = a.size();
+    const double countB = b.size();
+    const double count = countA + countB;
+
+    if(z)
+        *z = 0;
+    if(a.empty() || b.empty())
+        return 1.0;
+
+    // rank sum of `a` by merging the sorted samples, ties get their mean rank
+    double rankSumA = 0;
+    double ties = 0;  // sum of t^3 - t over the groups of ties
+    size_t i = 0;
+    size_t j = 0;
+
+    while(i < a.size() || j < b.size())
+    {
+        const double value = (j >= b.size() || (i < a.size() && a[i] <= b[j])) ? a[i] : b[j];
+        const double rank = i + j + 1;
+
+        size_t tiedA = 0;
+        size_t tiedB = 0;
+        while(i < a.size() && a[i] == value)
+        {
+            i++;
+            tiedA++;
+        }
+        while(j < b.size() && b[j] == value)
+        {
+            j++;
+            tiedB++;
+        }
+
+        const double tied = tiedA + tiedB;
+        rankSumA += tiedA * (rank + (tied - 1) * 0.5);
+        ties += tied * tied * tied - tied;
+    }
+
+    const double u = rankSumA - countA * (countA + 1) * 0.5;
+    const double mean = countA * countB * 0.5;
+    const double variance = countA * countB / 12.0 * ((count + 1) - ties / (count * (count - 1)));
+    if(variance <= 0)
+        return 1.0;  // all the values are equal
+
+    // U of `a` is small when `b` is larger
+    const double difference = mean - u;
+    const double corrected = difference > 0 ? std::max(difference - 0.5, 0.0) : std::min(difference + 0.5, 0.0);
+    const double score = corrected / sqrt(variance);
+
+    if(z)
+        *z = score;
+    return erfc(fabs(score) / sqrt(2.0));
+}
+
+double MedianBootstrap::beta(double alpha, double beta)
+{
+    std::gamma_distribution<double> x(alpha, 1.0);
+    std::gamma_distribution<double> y(beta, 1.0);
+    const double first = x(mRandom);
+    return first / (first + y(mRandom));
+}
+
+double MedianBootstrap::resampleMedian(const std::vector<double>& sorted)
+{
+    const size_t count = sorted.size();
+    if(count == 1)
+        return sorted[0];
+
+    // the k-th smallest of n uniform indices is floor(n * U(k)), U(k) ~ Beta(k, n - k + 1)
+    const size_t k = (count + 1) / 2;
+    const double u = beta(k, count - k + 1);
+    const size_t low = std::min((size_t)(u * count), count - 1);
+
+    if(count % 2)
+        return sorted[low];
+
+    // next order statistic given the k-th: U(k+1) = U(k) + (1 - U(k)) * Beta(1, n - k)
+    const double next = u + (1.0 - u) * beta(1, count - k);
+    const size_t high = std::min((size_t)(next * count), count - 1);
+    return 0.5 * (sorted[low] + sorted[high]);
+}
+
+void MedianBootstrap::getInterval(const std::vector<double>& a, const std::vector<double>& b, uint32_t resamples,
+                                  double confidence, double& low, double& high)
+{
+    low = high = 0;
+    if(a.empty() || b.empty() || resamples == 0)
+        return;
+
+    mDeltas.resize(resamples);
+    for(uint32_t n = 0; n < resamples; n++)
+        mDeltas[n] = resampleMedian(b) - resampleMedian(a);
+
+    std::sort(mDeltas.begin(), mDeltas.end());
+
+    const double tail = (1.0 - confidence) * 0.5;
+    low = mDeltas[std::min((size_t)(tail * resamples), mDeltas.size() - 1)];
+    high = mDeltas[std::min((size_t)((1.0 - tail) * resamples), mDeltas.size() - 1)];
+}
+
+void profiling::holmBonferroni(std::vector<double>& pValues)
+{
+    const size_t count = pValues.size();
+    std::vector<size_t> order(count);
+    for(size_t n = 0; n < count; n++)
+        order[n] = n;
+
+    std::sort(order.begin(), order.end(), [&pValues](size_t a, size_t b) { return pValues[a] < pValues[b]; });
+
+    // the smallest p-value is multiplied by m, the next by m - 1, ..., and kept increasing
+    double previous = 0;
+    for(size_t n = 0; n < count; n++)
+    {
+        const double adjusted = std::min(1.0, std::max(previous, pValues[order[n]] * (count - n)));
+        pValues[order[n]] = adjusted;
+        previous = adjusted;
+    }
+}
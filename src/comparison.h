@@ -0,0 +1,46 @@
+#ifndef __COMPARISON_H__
+#define __COMPARISON_H__
+
+#include <stdint.h>
+#include <random>
+#include <vector>
+
+namespace profiling
+{
+    // Median of sorted values, 0 if empty
+    double sortedMedian(const std::vector<double>& sorted);
+
+    // Two sided p-value of the Mann-Whitney U test that `a` and `b` (sorted) come from the same
+    // distribution. Normal approximation with tie and continuity corrections.
+    // `z` (optional) is positive when the values of `b` tend to be larger.
+    double mannWhitneyTest(const std::vector<double>& a, const std::vector<double>& b, double* z=NULL);
+
+    /*
+    * Bootstrap of the difference of the medians of two samples (sorted): median(b) - median(a).
+    * The median of a resample is an order statistic of the resampled indices, whose distribution
+    * is known (a beta distribution), so a resample costs a few random draws instead of a copy
+    * and a selection. This is the exact bootstrap distribution, fast on millions of values.
+    */
+    class MedianBootstrap
+    {
+    public:
+        MedianBootstrap(uint64_t seed=42) : mRandom(seed) {}
+
+        // Percentile interval of the difference at `confidence` (0.95) from `resamples` resamples
+        void getInterval(const std::vector<double>& a, const std::vector<double>& b, uint32_t resamples,
+                         double confidence, double& low, double& high);
+
+    private:
+        double resampleMedian(const std::vector<double>& sorted);
+        // sample of Beta(alpha, beta)
+        double beta(double alpha, double beta);
+
+        std::mt19937_64 mRandom;
+        std::vector<double> mDeltas;
+    };
+
+    // Holm-Bonferroni adjustment of p-values tested together, in place
+    void holmBonferroni(std::vector<double>& pValues);
+}
+
+#endif
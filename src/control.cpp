@@ -0,0 +1,283 @@
+#include "control.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <jetson-utils/logging.h>
+
+#define CONTROL_MAX_EVENTS  16
+#define CONTROL_MAX_LINE    4096
+
+using namespace profiling;
+
+
+ControlServer::ControlServer(const Handler& handler) : mHandler(handler), mListenFd(-1), mEpollFd(-1), mWakeFd(-1) {}
+
+ControlServer::~ControlServer()
+{
+    stop();
+}
+
+bool ControlServer::start(const char* path)
+{
+    if(!path || isRunning())
+        return false;
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if(strlen(path) == 0 || strlen(path) >= sizeof(addr.sun_path))
+    {
+        LogError("control -- invalid unix socket path '%s'\n", path);
+        return false;
+    }
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);  // stale socket from a previous run
+    mPath = path;
+
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    mListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if(mEpollFd < 0 || mWakeFd < 0 || mListenFd < 0 ||
+       bind(mListenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(mListenFd, SOMAXCONN) < 0)
+    {
+        LogError("control -- failed to listen on '%s' (%s)\n", path, strerror(errno));
+        stop();
+        return false;
+    }
+
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+
+    event.data.fd = mListenFd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mListenFd, &event);
+    event.data.fd = mWakeFd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &event);
+
+    mThread = std::thread(&ControlServer::run, this);
+    LogInfo("control -- listening on %s\n", path);
+    return true;
+}
+
+void ControlServer::stop()
+{
+    if(mThread.joinable())
+    {
+        uint64_t one = 1;
+        if(write(mWakeFd, &one, sizeof(one)) < 0)
+            LogError("control -- failed to wake the server thread\n");
+        mThread.join();
+    }
+
+    for(std::map<int, std::string>::iterator it = mClients.begin(); it != mClients.end(); ++it)
+        close(it->first);
+    mClients.clear();
+
+    if(mListenFd >= 0) close(mListenFd);
+    if(mEpollFd >= 0)  close(mEpollFd);
+    if(mWakeFd >= 0)   close(mWakeFd);
+    mListenFd = mEpollFd = mWakeFd = -1;
+
+    if(!mPath.empty())
+    {
+        unlink(mPath.c_str());
+        mPath.clear();
+    }
+}
+
+void ControlServer::run()
+{
+    epoll_event events[CONTROL_MAX_EVENTS];
+
+    while(true)
+    {
+        int count = epoll_wait(mEpollFd, events, CONTROL_MAX_EVENTS, -1);
+        if(count < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            LogError("control -- epoll_wait failed (%s)\n", strerror(errno));
+            return;
+        }
+
+        for(int i = 0; i < count; i++)
+        {
+            const int fd = events[i].data.fd;
+
+            if(fd == mWakeFd)
+                return;  // stop() was called
+            else if(fd == mListenFd)
+                acceptClients();
+            else if(events[i].events & EPOLLIN)
+                onReadable(fd);
+            else
+                closeClient(fd);
+        }
+    }
+}
+
+void ControlServer::acceptClients()
+{
+    while(true)
+    {
+        int fd = accept4(mListenFd, NULL, NULL, SOCK_CLOEXEC);
+        if(fd < 0)
+            return;
+
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+
+        if(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) < 0)
+        {
+            close(fd);
+            continue;
+        }
+        mClients[fd].clear();
+    }
+}
+
+void ControlServer::onReadable(int fd)
+{
+    char buffer[512];
+    ssize_t size = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+    if(size <= 0)
+    {
+        if(size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        closeClient(fd);
+        return;
+    }
+
+    std::string& input = mClients[fd];
+    input.append(buffer, size);
+
+    size_t end;
+    while((end = input.find('\n')) != std::string::npos)
+    {
+        std::string line = input.substr(0, end);
+        input.erase(0, end + 1);
+
+        if(!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+        if(line.empty())
+            continue;
+
+        // split COMMAND [ARGUMENT]
+        const size_t space = line.find(' ');
+        const std::string command = line.substr(0, space);
+        const std::string argument = (space == std::string::npos) ? std::string() : line.substr(space + 1);
+
+        std::string reply = mHandler(command, argument);
+        reply.push_back('\n');
+
+        // replies are small, the client is waiting for them
+        if(send(fd, reply.data(), reply.size(), MSG_NOSIGNAL) != (ssize_t)reply.size())
+        {
+            closeClient(fd);
+            return;
+        }
+    }
+
+    if(input.size() > CONTROL_MAX_LINE)
+        closeClient(fd);
+}
+
+void ControlServer::closeClient(int fd)
+{
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    mClients.erase(fd);
+}
+
+
+bool profiling::sendControlCommand(const char* path, const std::string& command, std::string& reply, int timeoutMs)
+{
+    reply.clear();
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        LogError("control -- failed to connect to '%s' (%s)\n", path, strerror(errno));
+        if(fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    const std::string line = command + "\n";
+    if(send(fd, line.data(), line.size(), MSG_NOSIGNAL) != (ssize_t)line.size())
+    {
+        close(fd);
+        return false;
+    }
+
+    pollfd request = { fd, POLLIN, 0 };
+    char buffer[512];
+
+    while(reply.find('\n') == std::string::npos)
+    {
+        if(poll(&request, 1, timeoutMs) <= 0)
+        {
+            LogError("control -- no reply from '%s'\n", path);
+            close(fd);
+            return false;
+        }
+
+        ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+        if(size <= 0)
+            break;
+        reply.append(buffer, size);
+    }
+    close(fd);
+
+    const size_t end = reply.find('\n');
+    if(end == std::string::npos)
+        return false;
+
+    reply.erase(end);
+    return true;
+}
+
+void profiling::notifySystemd(const char* state)
+{
+    const char* path = getenv("NOTIFY_SOCKET");
+    if(!path || (path[0] != '/' && path[0] != '@'))
+        return;  // not started by systemd
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    socklen_t size = sizeof(addr);
+    if(path[0] == '@')
+    {
+        addr.sun_path[0] = '\0';  // abstract namespace
+        size = offsetof(sockaddr_un, sun_path) + strlen(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+        return;
+
+    if(sendto(fd, state, strlen(state), MSG_NOSIGNAL, (sockaddr*)&addr, size) < 0)
+        LogWarning("control -- failed to notify systemd (%s)\n", strerror(errno));
+    close(fd);
+}
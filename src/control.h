@@ -0,0 +1,55 @@
+#ifndef __CONTROL_H__
+#define __CONTROL_H__
+
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+
+// default control socket of the power profiler service
+#define POWER_CONTROL_SOCKET "/run/power-profiler.sock"
+
+namespace profiling
+{
+    /*
+    * Line based command server on a unix socket.
+    * Each request is one line `COMMAND [ARGUMENT]`, each reply is one line starting
+    * with `OK` or `ERR`. Commands are handled one at a time by the server thread.
+    */
+    class ControlServer
+    {
+    public:
+        // Handle a command and return the reply (without the new line)
+        typedef std::function<std::string(const std::string& command, const std::string& argument)> Handler;
+
+        ControlServer(const Handler& handler);
+        ~ControlServer();
+
+        bool start(const char* path);
+        void stop();
+
+        inline bool isRunning() const { return mThread.joinable(); }
+
+    private:
+        void run();
+        void acceptClients();
+        void onReadable(int fd);
+        void closeClient(int fd);
+
+        Handler mHandler;
+        int mListenFd;
+        int mEpollFd;
+        int mWakeFd;
+        std::string mPath;
+        std::map<int, std::string> mClients;  // pending input of each client
+        std::thread mThread;
+    };
+
+    // Send one command to a control server and wait for the reply. Returns false on connection errors.
+    bool sendControlCommand(const char* path, const std::string& command, std::string& reply, int timeoutMs=5000);
+
+    // Notify systemd of a state change (READY=1, STOPPING=1) when running as a Type=notify service.
+    void notifySystemd(const char* state);
+}
+
+#endif
@@ -0,0 +1,149 @@
+#include "convergence.h"
+
+#include <algorithm>
+#include <math.h>
+#include <strings.h>
+
+#define MSER_BATCH  5
+#define Z_95        1.959964
+
+using namespace profiling;
+
+Convergence::Convergence(double target, Statistic statistic, uint64_t minRuns, uint64_t maxRuns, uint32_t checkInterval)
+    : mTarget(target), mStatistic(statistic), mMinRuns(std::max(minRuns, (uint64_t)2 * MSER_BATCH)),
+      mMaxRuns(std::max(maxRuns, mMinRuns)), mCheckInterval(checkInterval > 0 ? checkInterval : 1),
+      mReason(REASON_RUNNING), mWarmup(0), mEstimate(0), mHalfWidth(0) {}
+
+const char* Convergence::ReasonToStr(Reason reason)
+{
+    switch(reason)
+    {
+        case REASON_CONVERGED: return "converged";
+        case REASON_MAX_RUNS:  return "max-runs";
+        default:               return "running";
+    }
+}
+
+Convergence::Statistic Convergence::StatisticFromStr(const char* str)
+{
+    if(str && strcasecmp(str, "median") == 0)
+        return STAT_MEDIAN;
+    return STAT_MEAN;
+}
+
+const char* Convergence::StatisticToStr(Statistic statistic)
+{
+    return statistic == STAT_MEDIAN ? "median" : "mean";
+}
+
+void Convergence::add(double value)
+{
+    mValues.push_back(value);
+}
+
+bool Convergence::isDone()
+{
+    if(mReason != REASON_RUNNING)
+        return true;
+
+    const uint64_t count = mValues.size();
+
+    if(count >= mMaxRuns)
+    {
+        update();
+        mReason = REASON_MAX_RUNS;
+        return true;
+    }
+
+    if(count < mMinRuns || count % mCheckInterval != 0)
+        return false;
+
+    update();
+
+    if(mEstimate > 0 && mHalfWidth <= mTarget * mEstimate && count - mWarmup >= mMinRuns)
+        mReason = REASON_CONVERGED;
+
+    return mReason != REASON_RUNNING;
+}
+
+void Convergence::update()
+{
+    mWarmup = findWarmup(mValues);
+
+    const double* values = mValues.data() + mWarmup;
+    const size_t count = mValues.size() - mWarmup;
+
+    if(mStatistic == STAT_MEAN)
+    {
+        double sum = 0;
+        for(size_t i = 0; i < count; i++)
+            sum += values[i];
+        mEstimate = sum / count;
+
+        double variance = 0;
+        for(size_t i = 0; i < count; i++)
+            variance += (values[i] - mEstimate) * (values[i] - mEstimate);
+        variance /= (count - 1);
+
+        mHalfWidth = Z_95 * sqrt(variance / count);
+        return;
+    }
+
+    // distribution free interval of the median: the order statistics around n/2 +- z sqrt(n)/2
+    mSorted.assign(values, values + count);
+
+    const double spread = Z_95 * sqrt((double)count) / 2.0;
+    const size_t lower = (size_t)std::max(floor(count / 2.0 - spread), 0.0);
+    const size_t upper = std::min((size_t)ceil(count / 2.0 + spread), count - 1);
+
+    std::nth_element(mSorted.begin(), mSorted.begin() + count / 2, mSorted.end());
+    mEstimate = mSorted[count / 2];
+
+    std::nth_element(mSorted.begin(), mSorted.begin() + lower, mSorted.begin() + count / 2);
+    const double low = mSorted[lower];
+    std::nth_element(mSorted.begin() + count / 2, mSorted.begin() + upper, mSorted.end());
+    const double high = mSorted[upper];
+
+    mHalfWidth = std::max(mEstimate - low, high - mEstimate);
+}
+
+size_t Convergence::findWarmup(const std::vector<double>& values)
+{
+    const size_t batches = values.size() / MSER_BATCH;
+    if(batches < 2)
+        return 0;
+
+    std::vector<double> means(batches);
+    for(size_t b = 0; b < batches; b++)
+    {
+        double sum = 0;
+        for(size_t i = 0; i < MSER_BATCH; i++)
+            sum += values[b * MSER_BATCH + i];
+        means[b] = sum / MSER_BATCH;
+    }
+
+    // sums of the batch means from the end, so each truncation is O(1)
+    double sum = 0;
+    double squares = 0;
+    double best = INFINITY;
+    size_t truncation = 0;
+
+    for(size_t d = batches; d-- > 0; )
+    {
+        sum += means[d];
+        squares += means[d] * means[d];
+
+        const size_t remaining = batches - d;
+        if(d > batches / 2)
+            continue;
+
+        // sum of the squared deviations over remaining^2
+        const double statistic = (squares - sum * sum / remaining) / ((double)remaining * remaining);
+        if(statistic <= best)
+        {
+            best = statistic;
+            truncation = d;
+        }
+    }
+    return truncation * MSER_BATCH;
+}
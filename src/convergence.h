@@ -0,0 +1,73 @@
+#ifndef __CONVERGENCE_H__
+#define __CONVERGENCE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace profiling
+{
+    /*
+    * Stopping rule for repeated measurements: stop once the 95% confidence interval of
+    * the mean or median is within a fraction of its estimate, after dropping the initial
+    * transient (warmup) found by the MSER-5 truncation rule.
+    */
+    class Convergence
+    {
+    public:
+        enum Statistic
+        {
+            STAT_MEAN = 0,
+            STAT_MEDIAN
+        };
+
+        enum Reason
+        {
+            REASON_RUNNING = 0,
+            REASON_CONVERGED,
+            REASON_MAX_RUNS
+        };
+
+        // `target` is the half width of the interval relative to the estimate, 0.01 for 1%
+        Convergence(double target, Statistic statistic=STAT_MEAN, uint64_t minRuns=30, uint64_t maxRuns=10000, uint32_t checkInterval=10);
+
+        void add(double value);
+        // Whether the measurements can stop, see getReason()
+        bool isDone();
+
+        inline Reason getReason() const { return mReason; }
+        inline uint64_t getCount() const { return mValues.size(); }
+        inline Statistic getStatistic() const { return mStatistic; }
+        // Values dropped as warmup at the last check
+        inline uint64_t getWarmup() const { return mWarmup; }
+        // Estimate and half width of its interval at the last check
+        inline double getEstimate() const { return mEstimate; }
+        inline double getHalfWidth() const { return mHalfWidth; }
+
+        static const char* ReasonToStr(Reason reason);
+        static Statistic StatisticFromStr(const char* str);
+        static const char* StatisticToStr(Statistic statistic);
+
+        // Length of the initial transient of a series by MSER-5: the truncation minimizing the
+        // standard error of the mean of the rest, over batches of 5 values. At most half the series.
+        static size_t findWarmup(const std::vector<double>& values);
+
+    private:
+        void update();
+
+        const double mTarget;
+        const Statistic mStatistic;
+        const uint64_t mMinRuns;
+        const uint64_t mMaxRuns;
+        const uint32_t mCheckInterval;
+
+        std::vector<double> mValues;
+        std::vector<double> mSorted;  // reused by the median interval
+        Reason mReason;
+        uint64_t mWarmup;
+        double mEstimate;
+        double mHalfWidth;
+    };
+}
+
+#endif
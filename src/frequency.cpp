@@ -0,0 +1,210 @@
+#include "frequency.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sstream>
+#include <jetson-utils/logging.h>
+
+using namespace profiling;
+
+namespace
+{
+    // original value of a file, restored as text
+    struct SavedFile
+    {
+        char path[256];
+        char value[64];
+        size_t length;
+        bool minimum;  // restored after the caps
+    };
+
+    SavedFile gSaved[FREQUENCY_MAX_SAVED];
+    volatile sig_atomic_t gSavedCount = 0;
+    bool gHandlersInstalled = false;
+    void (* volatile gSignalCleanup)() = NULL;
+
+    const int gSignals[] = { SIGINT, SIGTERM, SIGHUP };
+}
+
+bool profiling::getAvailableFrequencies(const FrequencyDomain& domain, std::vector<int64_t>& frequencies, uint32_t steps)
+{
+    frequencies.clear();
+
+    std::string list;
+    if(readSysfsString(domain.path + (domain.devfreq ? "/available_frequencies" : "/scaling_available_frequencies"), list))
+    {
+        std::istringstream values(list);
+        int64_t value;
+        while(values >> value)
+            frequencies.push_back(domain.devfreq ? value / 1000 : value);
+    }
+
+    // intel_pstate and some devfreq drivers don't list them
+    int64_t lowest = -1;
+    int64_t highest = -1;
+    if(frequencies.empty() && !domain.devfreq && steps > 1 &&
+       readSysfsValue(domain.path + "/cpuinfo_min_freq", lowest) && readSysfsValue(domain.path + "/cpuinfo_max_freq", highest) &&
+       highest > lowest)
+    {
+        for(uint32_t n = 0; n < steps; n++)
+            frequencies.push_back(lowest + (highest - lowest) * n / (steps - 1));
+    }
+
+    std::sort(frequencies.begin(), frequencies.end());
+    frequencies.erase(std::unique(frequencies.begin(), frequencies.end()), frequencies.end());
+    return !frequencies.empty();
+}
+
+
+FrequencyController::FrequencyController()
+{
+}
+
+FrequencyController::~FrequencyController()
+{
+    restore();
+}
+
+bool FrequencyController::setMaxFrequency(const FrequencyDomain& domain, int64_t frequency)
+{
+    const std::string maxPath = domain.path + "/" + domain.getMaxFile();
+    const std::string minPath = domain.path + (domain.devfreq ? "/min_freq" : "/scaling_min_freq");
+    const int64_t value = domain.devfreq ? frequency * 1000 : frequency;
+
+    // the cap can't go under the minimum
+    int64_t minimum = -1;
+    if(readSysfsValue(minPath, minimum) && minimum > value)
+    {
+        if(!save(minPath) || !write(minPath, value))
+            return false;
+    }
+
+    // raising the cap over the original minimum again is fine, it was lowered with the cap
+    return save(maxPath) && write(maxPath, value);
+}
+
+void FrequencyController::restore()
+{
+    const int count = gSavedCount;
+
+    // the caps first, so the minimums fit under them
+    for(int pass = 0; pass < 2; pass++)
+    {
+        for(int n = count - 1; n >= 0; n--)
+        {
+            const SavedFile& saved = gSaved[n];
+            if(saved.minimum != (pass == 1))
+                continue;
+
+            const int fd = ::open(saved.path, O_WRONLY | O_TRUNC);
+            if(fd < 0)
+                continue;
+
+            // nothing more can be done about a failure from a signal handler
+            const ssize_t written = ::write(fd, saved.value, saved.length);
+            (void)written;
+            ::close(fd);
+        }
+    }
+
+    gSavedCount = 0;
+}
+
+void FrequencyController::setSignalCleanup(void (*cleanup)())
+{
+    gSignalCleanup = cleanup;
+
+    // before the first cap, a signal must run the cleanup too
+    if(cleanup)
+        installHandlers();
+}
+
+bool FrequencyController::save(const std::string& path)
+{
+    for(int n = 0; n < gSavedCount; n++)
+    {
+        if(path == gSaved[n].path)
+            return true;  // the original is already saved
+    }
+
+    if(gSavedCount >= FREQUENCY_MAX_SAVED || path.size() >= sizeof(gSaved[0].path))
+    {
+        LogError("frequency -- too many files to restore, not changing '%s'\n", path.c_str());
+        return false;
+    }
+
+    std::string value;
+    if(!readSysfsString(path, value) || value.empty() || value.size() >= sizeof(gSaved[0].value))
+    {
+        LogError("frequency -- failed to read '%s' (%s)\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    SavedFile& saved = gSaved[gSavedCount];
+    strcpy(saved.path, path.c_str());
+    memcpy(saved.value, value.c_str(), value.size());
+    saved.length = value.size();
+    saved.minimum = path.find("min_freq") != std::string::npos;
+
+    // the entry is complete before it is counted, the handler can run at any time
+    gSavedCount = gSavedCount + 1;
+
+    installHandlers();
+    return true;
+}
+
+void FrequencyController::installHandlers()
+{
+    if(gHandlersInstalled)
+        return;
+
+    atexit(restore);
+
+    for(size_t i = 0; i < sizeof(gSignals) / sizeof(gSignals[0]); i++)
+    {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = handleSignal;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESETHAND;  // the second signal kills right away
+        sigaction(gSignals[i], &action, NULL);
+    }
+    gHandlersInstalled = true;
+}
+
+bool FrequencyController::write(const std::string& path, int64_t value)
+{
+    char text[32];
+    const int length = snprintf(text, sizeof(text), "%lld", (long long)value);
+
+    // truncated for the regular files of a fake tree, sysfs ignores it
+    const int fd = ::open(path.c_str(), O_WRONLY | O_TRUNC);
+    if(fd < 0 || ::write(fd, text, length) != length)
+    {
+        LogError("frequency -- failed to write %s to '%s' (%s)\n", text, path.c_str(), strerror(errno));
+        if(fd >= 0)
+            ::close(fd);
+        return false;
+    }
+
+    ::close(fd);
+    return true;
+}
+
+void FrequencyController::handleSignal(int signal)
+{
+    restore();
+
+    void (*cleanup)() = gSignalCleanup;
+    if(cleanup)
+        cleanup();
+
+    // die of the signal as if it wasn't handled
+    raise(signal);
+}
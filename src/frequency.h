@@ -0,0 +1,50 @@
+#ifndef __FREQUENCY_H__
+#define __FREQUENCY_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "thermal.h"
+
+#define FREQUENCY_MAX_SAVED  128  // files restored on exit
+
+namespace profiling
+{
+    // Frequencies of a domain in kHz, ascending: its available_frequencies, or `steps` values
+    // between its hardware min and max when the driver doesn't list them (intel_pstate)
+    bool getAvailableFrequencies(const FrequencyDomain& domain, std::vector<int64_t>& frequencies, uint32_t steps=8);
+
+    /*
+    * Caps the clocks of cpufreq policies and devfreq devices by writing their scaling_max_freq
+    * or max_freq (and the min when it is above the cap). The original values are saved before
+    * the first write and restored by restore(), at exit, or on SIGINT, SIGTERM and SIGHUP:
+    * the saved files are kept in static buffers so the signal handler only calls open(), write()
+    * and close(), then the signal cleanup if one is set.
+    */
+    class FrequencyController
+    {
+    public:
+        FrequencyController();
+        ~FrequencyController();
+
+        // Cap the domain at `frequency` kHz. Returns false if the files can't be written (root is needed).
+        bool setMaxFrequency(const FrequencyDomain& domain, int64_t frequency);
+
+        // Write back the original values, in the reverse order they were saved
+        static void restore();
+
+        // Called on SIGINT, SIGTERM and SIGHUP after the restore, before dying of the signal
+        // (to stop a power capture...). It runs in the signal handler, only async-signal-safe
+        // calls are allowed. Installs the handlers if no cap was set yet. NULL to remove it.
+        static void setSignalCleanup(void (*cleanup)());
+
+    private:
+        static bool save(const std::string& path);
+        static bool write(const std::string& path, int64_t value);
+        static void installHandlers();
+        static void handleSignal(int signal);
+    };
+}
+
+#endif
@@ -0,0 +1,108 @@
+#include "hdrHistogram.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace profiling;
+
+// index of the highest set bit, value must not be 0
+static inline uint32_t highestBit(uint64_t value)
+{
+    return 63 - __builtin_clzll(value);
+}
+
+
+HdrHistogram::HdrHistogram(uint64_t highest, int significantDigits) : mHighest(std::max(highest, (uint64_t)2))
+{
+    significantDigits = std::min(std::max(significantDigits, 1), 4);
+
+    // enough sub-buckets to tell apart 2 * 10^digits values in a bucket
+    const uint64_t largestSingleUnit = 2 * (uint64_t)pow(10, significantDigits);
+    const uint32_t subBucketCountMagnitude = highestBit(largestSingleUnit - 1) + 1;
+
+    mSubBucketHalfCountMagnitude = subBucketCountMagnitude - 1;
+    mSubBucketHalfCount = 1u << mSubBucketHalfCountMagnitude;
+    mSubBucketMask = (1ULL << subBucketCountMagnitude) - 1;
+
+    mCounts.assign(getIndex(mHighest) + 1, 0);
+    reset();
+}
+
+uint32_t HdrHistogram::getIndex(uint64_t value) const
+{
+    // bucket 0 holds the values below the sub-bucket count linearly,
+    // each next bucket holds the upper half of its range at twice the step
+    const uint32_t bucket = highestBit(value | mSubBucketMask) - mSubBucketHalfCountMagnitude;
+    const uint32_t subBucket = (uint32_t)(value >> bucket);
+    return ((bucket + 1) << mSubBucketHalfCountMagnitude) + subBucket - mSubBucketHalfCount;
+}
+
+uint64_t HdrHistogram::getValue(uint32_t index) const
+{
+    int32_t bucket = (int32_t)(index >> mSubBucketHalfCountMagnitude) - 1;
+    uint64_t subBucket = (index & (mSubBucketHalfCount - 1)) + mSubBucketHalfCount;
+
+    if(bucket < 0)
+    {
+        subBucket -= mSubBucketHalfCount;
+        bucket = 0;
+    }
+    return subBucket << bucket;
+}
+
+uint64_t HdrHistogram::getHighestEquivalent(uint32_t index) const
+{
+    const uint64_t value = getValue(index);
+    const uint32_t bucket = highestBit(value | mSubBucketMask) - mSubBucketHalfCountMagnitude;
+    return value + (1ULL << bucket) - 1;
+}
+
+void HdrHistogram::record(uint64_t value, uint64_t count)
+{
+    value = std::min(value, mHighest);
+
+    mCounts[getIndex(value)] += count;
+    mCount += count;
+    mMin = std::min(mMin, value);
+    mMax = std::max(mMax, value);
+    mSum += (double)value * count;
+}
+
+void HdrHistogram::add(const HdrHistogram& other)
+{
+    const size_t size = std::min(mCounts.size(), other.mCounts.size());
+    for(size_t i = 0; i < size; i++)
+        mCounts[i] += other.mCounts[i];
+
+    mCount += other.mCount;
+    mMin = std::min(mMin, other.mMin);
+    mMax = std::max(mMax, other.mMax);
+    mSum += other.mSum;
+}
+
+void HdrHistogram::reset()
+{
+    std::fill(mCounts.begin(), mCounts.end(), 0);
+    mCount = 0;
+    mMin = UINT64_MAX;
+    mMax = 0;
+    mSum = 0;
+}
+
+uint64_t HdrHistogram::getValueAtPercentile(double percentile) const
+{
+    if(mCount == 0)
+        return 0;
+
+    percentile = std::min(std::max(percentile, 0.0), 100.0);
+    const uint64_t target = std::max((uint64_t)ceil(percentile / 100.0 * mCount), (uint64_t)1);
+    uint64_t total = 0;
+
+    for(size_t i = 0; i < mCounts.size(); i++)
+    {
+        total += mCounts[i];
+        if(total >= target)
+            return std::min(getHighestEquivalent(i), mMax);
+    }
+    return mMax;
+}
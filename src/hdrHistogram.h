@@ -0,0 +1,53 @@
+#ifndef __HDR_HISTOGRAM_H__
+#define __HDR_HISTOGRAM_H__
+
+#include <stdint.h>
+#include <vector>
+
+namespace profiling
+{
+    /*
+    * High dynamic range histogram of integer values (HdrHistogram layout).
+    * Values are grouped in power of 2 buckets split into linear sub-buckets, so every
+    * recorded value is kept with `significantDigits` decimal digits of precision
+    * from 1 to `highest`, in constant memory. Not thread safe.
+    */
+    class HdrHistogram
+    {
+    public:
+        // `significantDigits` from 1 to 4, larger values are clamped to `highest`
+        HdrHistogram(uint64_t highest=3600ULL * 1000000000ULL, int significantDigits=3);
+
+        void record(uint64_t value, uint64_t count=1);
+        // Add the values of a histogram with the same layout
+        void add(const HdrHistogram& other);
+        void reset();
+
+        // Value below or equal to `percentile` (0 to 100) of the recorded values,
+        // as the highest value equivalent to its bucket. 0 if empty.
+        uint64_t getValueAtPercentile(double percentile) const;
+
+        inline uint64_t getCount() const { return mCount; }
+        inline uint64_t getMin() const { return mCount > 0 ? mMin : 0; }
+        inline uint64_t getMax() const { return mMax; }
+        inline double getMean() const { return mCount > 0 ? mSum / mCount : 0.0; }
+
+    private:
+        uint32_t getIndex(uint64_t value) const;
+        uint64_t getValue(uint32_t index) const;
+        uint64_t getHighestEquivalent(uint32_t index) const;
+
+        uint64_t mHighest;
+        uint32_t mSubBucketHalfCountMagnitude;  // log2 of half the sub-buckets
+        uint32_t mSubBucketHalfCount;
+        uint64_t mSubBucketMask;
+        std::vector<uint64_t> mCounts;
+
+        uint64_t mCount;
+        uint64_t mMin;
+        uint64_t mMax;
+        double mSum;
+    };
+}
+
+#endif
@@ -0,0 +1,603 @@
+#include <profiling/logger.h>  // the copy next to the generated config.h
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define LOG_SLOT_SIZE   256   // bytes of a message, site and arguments
+#define LOG_SLOT_COUNT  4096  // must be a power of 2
+
+namespace
+{
+    // Arguments of a message as written in the slot: 8 bytes per value, strings as their
+    // length (2 bytes) then their characters and a null
+    struct Record
+    {
+        log_site* site;
+        uint32_t suppressed;  // messages of the site dropped by its rate limit before this one
+        uint16_t size;        // bytes of arguments
+        uint8_t truncated;    // the arguments didn't fit
+        uint8_t reserved;
+        uint8_t arguments[LOG_SLOT_SIZE - 24];
+    };
+
+    // Bounded multi-producer queue (Vyukov): a slot is free for the producer of position p
+    // when its sequence is p, and ready for the consumer when it is p + 1
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    struct Ring
+    {
+        Ring() : enqueue(0), dequeue(0), written(0), dropped(0), reported(0), sleeping(false), running(false), thread(NULL)
+        {
+            for(size_t i = 0; i < LOG_SLOT_COUNT; i++)
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        Slot slots[LOG_SLOT_COUNT];
+        std::atomic<size_t> enqueue;
+        size_t dequeue;                  // consumer only
+        std::atomic<size_t> written;     // messages written out
+        std::atomic<uint64_t> dropped;
+        uint64_t reported;               // drops already reported, consumer only
+        std::atomic<bool> sleeping;
+        std::atomic<bool> running;
+
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::thread* thread;             // never destroyed, joined at exit
+    };
+
+    std::atomic<int> gLevel(-1);  // read from the environment on first use
+    std::atomic<Ring*> gRing(NULL);
+    std::mutex gStartMutex;
+
+    // A conversion of a format: %[flags][width][.precision][length]type
+    struct Conversion
+    {
+        const char* start;  // '%'
+        const char* end;    // after the type
+        int stars;          // * of the width and precision, each takes an int
+        char length[3];     // hh, h, l, ll, L, j, z, t or q
+        char type;          // 0 at the end of the format, '%' for a literal %
+    };
+
+    const char* nextConversion(const char* p, Conversion& conversion)
+    {
+        while(*p && *p != '%')
+            p++;
+
+        conversion.start = p;
+        conversion.stars = 0;
+        conversion.length[0] = '\0';
+        conversion.type = 0;
+
+        if(!*p)
+        {
+            conversion.end = p;
+            return p;
+        }
+
+        p++;
+        while(*p && strchr("-+ #0'", *p))
+            p++;
+
+        if(*p == '*')
+        {
+            conversion.stars++;
+            p++;
+        }
+        while(*p >= '0' && *p <= '9')
+            p++;
+
+        if(*p == '.')
+        {
+            p++;
+            if(*p == '*')
+            {
+                conversion.stars++;
+                p++;
+            }
+            while(*p >= '0' && *p <= '9')
+                p++;
+        }
+
+        size_t length = 0;
+        while(*p && strchr("hlLjztq", *p) && length < 2)
+            conversion.length[length++] = *p++;
+        conversion.length[length] = '\0';
+
+        conversion.type = *p;
+        conversion.end = *p ? p + 1 : p;
+        return conversion.end;
+    }
+
+    inline bool isInteger(char type) { return type && strchr("diouxXc", type); }
+    inline bool isFloat(char type) { return type && strchr("fFeEgGaA", type); }
+
+    // Appends the arguments of a record
+    struct Writer
+    {
+        Writer(Record& record) : record(record), size(0) {}
+
+        bool putValue(const void* value)
+        {
+            if(size + 8 > sizeof(record.arguments))
+                return false;
+            memcpy(record.arguments + size, value, 8);
+            size += 8;
+            return true;
+        }
+
+        bool putString(const char* string)
+        {
+            if(!string)
+                string = "(null)";
+
+            if(size + 3 > sizeof(record.arguments))
+                return false;
+
+            // cut the string to what's left of the slot
+            size_t length = strlen(string);
+            length = std::min(length, sizeof(record.arguments) - size - 3);
+
+            const uint16_t stored = (uint16_t)length;
+            memcpy(record.arguments + size, &stored, 2);
+            memcpy(record.arguments + size + 2, string, length);
+            record.arguments[size + 2 + length] = '\0';
+            size += 3 + length;
+            return true;
+        }
+
+        Record& record;
+        size_t size;
+    };
+
+    // Reads the arguments of a record back
+    struct Reader
+    {
+        Reader(const Record& record) : record(record), offset(0) {}
+
+        bool getValue(void* value)
+        {
+            if(offset + 8 > record.size)
+                return false;
+            memcpy(value, record.arguments + offset, 8);
+            offset += 8;
+            return true;
+        }
+
+        const char* getString()
+        {
+            if(offset + 3 > record.size)
+                return NULL;
+            uint16_t length;
+            memcpy(&length, record.arguments + offset, 2);
+            const char* string = (const char*)record.arguments + offset + 2;
+            offset += 3 + length;
+            return string;
+        }
+
+        const Record& record;
+        size_t offset;
+    };
+
+    // Copy the arguments of the conversions of `format`. Returns false if they didn't all fit.
+    bool captureArguments(const char* format, va_list args, Writer& writer)
+    {
+        Conversion conversion;
+        const char* p = format;
+
+        while(true)
+        {
+            p = nextConversion(p, conversion);
+            if(!conversion.type)
+                break;
+            if(conversion.type == '%')
+                continue;
+
+            for(int n = 0; n < conversion.stars; n++)
+            {
+                const int64_t star = va_arg(args, int);
+                if(!writer.putValue(&star))
+                    return false;
+            }
+
+            const char* length = conversion.length;
+            const char type = conversion.type;
+
+            if(isInteger(type))
+            {
+                // truncated like printf would, then printed as a long long
+                const bool isSigned = type == 'd' || type == 'i';
+                int64_t value;
+
+                if(type == 'c')
+                    value = va_arg(args, int);
+                else if(strcmp(length, "hh") == 0)
+                    value = isSigned ? (int64_t)(signed char)va_arg(args, int) : (int64_t)(unsigned char)va_arg(args, int);
+                else if(strcmp(length, "h") == 0)
+                    value = isSigned ? (int64_t)(short)va_arg(args, int) : (int64_t)(unsigned short)va_arg(args, int);
+                else if(strcmp(length, "l") == 0)
+                    value = isSigned ? (int64_t)va_arg(args, long) : (int64_t)va_arg(args, unsigned long);
+                else if(strcmp(length, "ll") == 0 || strcmp(length, "q") == 0 || strcmp(length, "j") == 0)
+                    value = isSigned ? (int64_t)va_arg(args, long long) : (int64_t)va_arg(args, unsigned long long);
+                else if(strcmp(length, "z") == 0)
+                    value = isSigned ? (int64_t)va_arg(args, ptrdiff_t) : (int64_t)va_arg(args, size_t);
+                else if(strcmp(length, "t") == 0)
+                    value = (int64_t)va_arg(args, ptrdiff_t);
+                else
+                    value = isSigned ? (int64_t)va_arg(args, int) : (int64_t)va_arg(args, unsigned int);
+
+                if(!writer.putValue(&value))
+                    return false;
+            }
+            else if(isFloat(type))
+            {
+                const double value = strcmp(length, "L") == 0 ? (double)va_arg(args, long double) : va_arg(args, double);
+                if(!writer.putValue(&value))
+                    return false;
+            }
+            else if(type == 's')
+            {
+                if(!writer.putString(va_arg(args, const char*)))
+                    return false;
+            }
+            else if(type == 'p')
+            {
+                const uint64_t value = (uint64_t)(uintptr_t)va_arg(args, void*);
+                if(!writer.putValue(&value))
+                    return false;
+            }
+            else
+                va_arg(args, void*);  // %n and unknown types aren't printed
+        }
+        return true;
+    }
+
+    // Append to a message, cut at its capacity
+    struct Message
+    {
+        Message() : size(0) { text[0] = '\0'; }
+
+        void append(const char* data, size_t length)
+        {
+            length = std::min(length, sizeof(text) - 1 - size);
+            memcpy(text + size, data, length);
+            size += length;
+            text[size] = '\0';
+        }
+
+        template<typename T>
+        void format(const char* spec, const int64_t* stars, int starCount, T value)
+        {
+            char buffer[LOG_MAX_MESSAGE];
+            int length;
+
+            if(starCount == 2)
+                length = snprintf(buffer, sizeof(buffer), spec, (int)stars[0], (int)stars[1], value);
+            else if(starCount == 1)
+                length = snprintf(buffer, sizeof(buffer), spec, (int)stars[0], value);
+            else
+                length = snprintf(buffer, sizeof(buffer), spec, value);
+
+            if(length > 0)
+                append(buffer, std::min((size_t)length, sizeof(buffer) - 1));
+        }
+
+        char text[LOG_MAX_MESSAGE];
+        size_t size;
+    };
+
+    // Format a record like printf would have
+    void formatRecord(const Record& record, Message& message)
+    {
+        static const char* prefixes[] = { "", DEBUG, INFO, WARNING, ERROR };
+
+        const log_site* site = record.site;
+        if(site->level > LOG_LEVEL_VALUES && site->level <= LOG_LEVEL_ERROR)
+            message.append(prefixes[site->level], strlen(prefixes[site->level]));
+
+        Reader reader(record);
+        Conversion conversion;
+        const char* p = site->format;
+
+        while(true)
+        {
+            const char* next = nextConversion(p, conversion);
+            message.append(p, conversion.start - p);
+            p = next;
+
+            if(!conversion.type)
+                break;
+
+            if(conversion.type == '%')
+            {
+                message.append("%", 1);
+                continue;
+            }
+
+            int64_t stars[2];
+            bool complete = true;
+            for(int n = 0; n < conversion.stars; n++)
+                complete = complete && reader.getValue(&stars[n]);
+
+            // the spec without its length, a long long or double is passed
+            char spec[64];
+            const size_t prefix = std::min((size_t)(conversion.end - conversion.start - 1 - strlen(conversion.length)), sizeof(spec) - 4);
+            memcpy(spec, conversion.start, prefix);
+            size_t specLength = prefix;
+
+            const char type = conversion.type;
+            if(isInteger(type) && type != 'c')
+            {
+                spec[specLength++] = 'l';
+                spec[specLength++] = 'l';
+            }
+            spec[specLength++] = type;
+            spec[specLength] = '\0';
+
+            if(isInteger(type))
+            {
+                int64_t value;
+                if(!(complete = complete && reader.getValue(&value)))
+                    break;
+                if(type == 'c')
+                    message.format(spec, stars, conversion.stars, (int)value);
+                else if(type == 'd' || type == 'i')
+                    message.format(spec, stars, conversion.stars, (long long)value);
+                else
+                    message.format(spec, stars, conversion.stars, (unsigned long long)value);
+            }
+            else if(isFloat(type))
+            {
+                double value;
+                if(!(complete = complete && reader.getValue(&value)))
+                    break;
+                message.format(spec, stars, conversion.stars, value);
+            }
+            else if(type == 's')
+            {
+                const char* value = complete ? reader.getString() : NULL;
+                if(!value)
+                    break;
+                message.format(spec, stars, conversion.stars, value);
+            }
+            else if(type == 'p')
+            {
+                uint64_t value;
+                if(!(complete = complete && reader.getValue(&value)))
+                    break;
+                message.format(spec, stars, conversion.stars, (void*)(uintptr_t)value);
+            }
+        }
+
+        if(record.truncated)
+            message.append("...\n", 4);
+
+        // tell how many messages the rate limit dropped, before the newline
+        if(record.suppressed > 0)
+        {
+            const bool newline = message.size > 0 && message.text[message.size - 1] == '\n';
+            if(newline)
+                message.size--;
+
+            char note[64];
+            const int length = snprintf(note, sizeof(note), " [%u similar suppressed]%s", record.suppressed, newline ? "\n" : "");
+            message.append(note, length);
+        }
+    }
+
+    void consume(Ring* ring)
+    {
+        while(true)
+        {
+            Slot& slot = ring->slots[ring->dequeue & (LOG_SLOT_COUNT - 1)];
+
+            if(slot.sequence.load(std::memory_order_acquire) == ring->dequeue + 1)
+            {
+                Message message;
+                formatRecord(slot.record, message);
+
+                // the slot is free again for the producer one lap later
+                slot.sequence.store(ring->dequeue + LOG_SLOT_COUNT, std::memory_order_release);
+                ring->dequeue++;
+
+                fwrite(message.text, 1, message.size, stdout);
+                ring->written.fetch_add(1, std::memory_order_release);
+                continue;
+            }
+
+            // nothing to write
+            fflush(stdout);
+
+            const uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+            if(dropped > ring->reported)
+            {
+                fprintf(stdout, WARNING "%llu log messages dropped, the buffer was full\n", (unsigned long long)(dropped - ring->reported));
+                fflush(stdout);
+                ring->reported = dropped;
+            }
+
+            if(!ring->running.load(std::memory_order_acquire) && ring->enqueue.load(std::memory_order_acquire) == ring->dequeue)
+                break;
+
+            std::unique_lock<std::mutex> lock(ring->mutex);
+            ring->sleeping.store(true);
+
+            // a producer may have published before seeing the flag, the timeout bounds the delay
+            if(slot.sequence.load(std::memory_order_acquire) != ring->dequeue + 1)
+                ring->wakeup.wait_for(lock, std::chrono::milliseconds(20));
+            ring->sleeping.store(false);
+        }
+    }
+
+    void stopLogger()
+    {
+        Ring* ring = gRing.load();
+        if(!ring)
+            return;
+
+        ring->running.store(false, std::memory_order_release);
+        ring->wakeup.notify_one();
+        ring->thread->join();
+    }
+
+    Ring* getRing()
+    {
+        Ring* ring = gRing.load(std::memory_order_acquire);
+        if(ring)
+            return ring;
+
+        std::lock_guard<std::mutex> lock(gStartMutex);
+        ring = gRing.load();
+        if(!ring)
+        {
+            ring = new Ring();
+            ring->running = true;
+            ring->thread = new std::thread(consume, ring);
+            gRing.store(ring, std::memory_order_release);
+
+            // write the pending messages before the program ends
+            atexit(stopLogger);
+        }
+        return ring;
+    }
+
+    uint64_t monotonicNs()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    }
+
+    // Whether the rate limit of the site lets a message through
+    bool acceptRate(log_site* site)
+    {
+        const uint64_t now = monotonicNs();
+        uint64_t window = __atomic_load_n(&site->window, __ATOMIC_RELAXED);
+
+        // a new second, the thread that moves the window resets the count
+        if(now - window >= 1000000000ULL && __atomic_compare_exchange_n(&site->window, &window, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            __atomic_store_n(&site->count, 0, __ATOMIC_RELAXED);
+
+        if(__atomic_add_fetch(&site->count, 1, __ATOMIC_RELAXED) <= site->rate)
+            return true;
+
+        __atomic_add_fetch(&site->suppressed, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    int levelFromEnvironment()
+    {
+        static const char* names[] = { "values", "debug", "info", "warning", "error", "none" };
+
+        const char* value = getenv("PROFILING_LOG_LEVEL");
+        for(int level = LOG_LEVEL_VALUES; value && level <= LOG_LEVEL_NONE; level++)
+        {
+            if(strcasecmp(value, names[level]) == 0)
+                return level;
+        }
+        return LOG_LEVEL_VALUES;
+    }
+}
+
+extern "C" void log_write(log_site* site, ...)
+{
+    if(site->level < log_get_level())
+        return;
+
+    if(site->rate > 0 && !acceptRate(site))
+        return;
+
+    Ring* ring = getRing();
+
+    // claim a slot, or drop the message if the consumer is a lap behind
+    size_t position = ring->enqueue.load(std::memory_order_relaxed);
+    Slot* slot;
+
+    while(true)
+    {
+        slot = &ring->slots[position & (LOG_SLOT_COUNT - 1)];
+        const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+
+        if(sequence == position)
+        {
+            if(ring->enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if(sequence < position)
+        {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+            position = ring->enqueue.load(std::memory_order_relaxed);
+    }
+
+    Record& record = slot->record;
+    record.site = site;
+    record.suppressed = site->rate > 0 ? __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED) : 0;
+
+    Writer writer(record);
+    va_list args;
+    va_start(args, site);
+    record.truncated = !captureArguments(site->format, args, writer);
+    va_end(args);
+    record.size = (uint16_t)writer.size;
+
+    slot->sequence.store(position + 1, std::memory_order_release);
+
+    if(ring->sleeping.load(std::memory_order_relaxed))
+        ring->wakeup.notify_one();
+}
+
+extern "C" void log_set_level(int level)
+{
+    gLevel.store(level, std::memory_order_relaxed);
+}
+
+extern "C" int log_get_level(void)
+{
+    int level = gLevel.load(std::memory_order_relaxed);
+    if(level < 0)
+    {
+        level = levelFromEnvironment();
+        gLevel.store(level, std::memory_order_relaxed);
+    }
+    return level;
+}
+
+extern "C" void log_flush(void)
+{
+    Ring* ring = gRing.load(std::memory_order_acquire);
+    if(!ring)
+        return;
+
+    // every message claimed so far, the dropped ones never got a slot
+    const size_t target = ring->enqueue.load(std::memory_order_acquire);
+    ring->wakeup.notify_one();
+
+    while(ring->written.load(std::memory_order_acquire) < target && ring->running.load())
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+    fflush(stdout);
+}
+
+extern "C" uint64_t log_get_dropped(void)
+{
+    Ring* ring = gRing.load(std::memory_order_acquire);
+    return ring ? ring->dropped.load() : 0;
+}
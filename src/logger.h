@@ -1,14 +1,15 @@
 #ifndef __LOGGER_H__
 #define __LOGGER_H__
 
+#include <stdint.h>
+#include <stdio.h>
+#include "config.h"
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
-#include <cstdio>
-#include "config.h"
-
 #define COLOR_BLUE      "\033[0;34m"
 #define COLOR_GREEN     "\033[0;32m"
 #define COLOR_WHITE     "\033[1;37m"
@@ -21,14 +22,79 @@ extern "C"
 #define INFO        COLOR_BLUE "[Info] " COLOR_NONE
 #define DEBUG       COLOR_WHITE "[Debug] " COLOR_NONE
 
-#ifdef LOG_VALUES
-    #define log(format, args...) printf(format, ##args)
-#else
-    #define log(format, args...)
+// Levels of the messages, from the most verbose
+#define LOG_LEVEL_VALUES   0  // measured values, printed by log()
+#define LOG_LEVEL_DEBUG    1
+#define LOG_LEVEL_INFO     2
+#define LOG_LEVEL_WARNING  3
+#define LOG_LEVEL_ERROR    4
+#define LOG_LEVEL_NONE     5
+
+// Messages under the minimum level are compiled out. The values are only kept with the LOG_VALUES
+// option, a file can define LOG_MIN_LEVEL before including the logger to keep or drop more.
+#ifndef LOG_MIN_LEVEL
+    #ifdef LOG_VALUES
+        #define LOG_MIN_LEVEL LOG_LEVEL_VALUES
+    #else
+        #define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+    #endif
 #endif
 
+#define LOG_MAX_MESSAGE  4096  // formatted length, longer messages are cut
+
+/*
+* Call site of a message, one static per call of the macros. Its counters are
+* updated atomically by the logger for the rate limit.
+*/
+typedef struct log_site
+{
+    const char* format;
+    int level;
+    uint32_t rate;        // messages per second, 0 for no limit
+    uint64_t window;      // ns, start of the second being counted
+    uint32_t count;       // messages in the window
+    uint32_t suppressed;  // by the rate limit since the last message written
+} log_site;
+
+/*
+* The arguments are copied with the site into a lock-free ring buffer (strings included)
+* and formatted and written to stdout by a background thread, so logging from a sampling
+* loop costs a copy instead of a console write. The messages are dropped, and counted,
+* when the buffer is full. Pending messages are written at exit or by log_flush(): a binary
+* that also writes to stdout directly flushes the log first, or the lines come out of order.
+*/
+void log_write(log_site* site, ...);
+
+// Messages under `level` are skipped at runtime. Defaults to LOG_LEVEL_VALUES, everything compiled in,
+// or the PROFILING_LOG_LEVEL environment variable (values, debug, info, warning, error or none).
+void log_set_level(int level);
+int  log_get_level(void);
+
+// Wait until the pending messages are written
+void log_flush(void);
+// Messages dropped because the buffer was full
+uint64_t log_get_dropped(void);
+
+// `format` must be a string literal, its arguments are checked like printf's
+#define log_at(level, rate, format, args...) do { \
+        if((level) >= LOG_MIN_LEVEL) { \
+            static log_site log_site_ = { format, level, rate, 0, 0, 0 }; \
+            (void)sizeof(printf(format, ##args)); \
+            log_write(&log_site_, ##args); \
+        } \
+    } while(0)
+
+#define log(format, args...)          log_at(LOG_LEVEL_VALUES, 0, format, ##args)
+#define log_debug(format, args...)    log_at(LOG_LEVEL_DEBUG, 0, format, ##args)
+#define log_info(format, args...)     log_at(LOG_LEVEL_INFO, 0, format, ##args)
+#define log_warning(format, args...)  log_at(LOG_LEVEL_WARNING, 0, format, ##args)
+#define log_error(format, args...)    log_at(LOG_LEVEL_ERROR, 0, format, ##args)
+
+// At most `rate` messages per second from this call, the next one tells how many were suppressed
+#define log_rate(level, rate, format, args...)  log_at(level, rate, format, ##args)
+
 #ifdef __cplusplus
 }
 #endif
 
-#endif
\ No newline at end of file
+#endif
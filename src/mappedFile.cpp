@@ -0,0 +1,71 @@
+#include "mappedFile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <jetson-utils/logging.h>
+
+using namespace profiling;
+
+MappedFile::MappedFile() : mData(NULL), mSize(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char* path)
+{
+    close();
+
+    const int fd = ::open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        LogError("mapped file -- failed to open '%s' (%s)\n", path, strerror(errno));
+        return false;
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0)
+    {
+        LogError("mapped file -- failed to read the size of '%s' (%s)\n", path, strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    mSize = info.st_size;
+    if(mSize == 0)  // nothing to map, an empty file is still valid
+    {
+        ::close(fd);
+        return true;
+    }
+
+    void* data = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED)
+    {
+        LogError("mapped file -- failed to map '%s' (%s)\n", path, strerror(errno));
+        ::close(fd);
+        mSize = 0;
+        return false;
+    }
+    ::close(fd);  // the mapping keeps the file
+
+    // read once from start to end, the kernel can read ahead and drop the pages behind
+    madvise(data, mSize, MADV_SEQUENTIAL);
+    mData = (const char*)data;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if(mData)
+        munmap((void*)mData, mSize);
+
+    mData = NULL;
+    mSize = 0;
+}
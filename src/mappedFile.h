@@ -0,0 +1,34 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <stddef.h>
+
+namespace profiling
+{
+    /*
+    * Read only memory mapping of a whole file, so large profiler outputs can be
+    * parsed in place by several threads without copying them.
+    */
+    class MappedFile
+    {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        // Map `path`, the previous mapping is released. Returns false if the file can't be mapped.
+        bool open(const char* path);
+        void close();
+
+        inline const char* getData() const { return mData; }
+        inline size_t getSize() const { return mSize; }
+
+    private:
+        MappedFile(const MappedFile&);
+        MappedFile& operator=(const MappedFile&);
+
+        const char* mData;
+        size_t mSize;
+    };
+}
+
+#endif
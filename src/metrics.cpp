@@ -0,0 +1,405 @@
+#include "metrics.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <jetson-utils/logging.h>
+
+#define METRICS_MAX_EVENTS   32
+#define METRICS_MAX_REQUEST  8192
+#define METRICS_READ_SIZE    1024
+
+using namespace profiling;
+
+
+Histogram::Histogram(const double* bounds, int size) : mSize(size < MAX_BOUNDS ? size : MAX_BOUNDS), mCount(0), mSum(0.0)
+{
+    for(int i = 0; i < mSize; i++)
+        mBounds[i] = bounds[i];
+
+    for(int i = 0; i <= MAX_BOUNDS; i++)
+        mBuckets[i].store(0, std::memory_order_relaxed);
+}
+
+void Histogram::observe(double value)
+{
+    int bucket = 0;
+
+    while(bucket < mSize && value > mBounds[bucket])
+        bucket++;
+
+    mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    mCount.fetch_add(1, std::memory_order_relaxed);
+
+    double sum = mSum.load(std::memory_order_relaxed);
+    while(!mSum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed));
+}
+
+void Histogram::render(std::string& out, const char* name, const char* labels) const
+{
+    std::string series = std::string(name) + "_bucket";
+    std::string bucketLabels;
+    char bound[32];
+    uint64_t cumulative = 0;
+
+    for(int i = 0; i <= mSize; i++)
+    {
+        cumulative += mBuckets[i].load(std::memory_order_relaxed);
+
+        if(i < mSize)
+            snprintf(bound, sizeof(bound), "%g", mBounds[i]);
+        else
+            snprintf(bound, sizeof(bound), "+Inf");
+
+        bucketLabels.clear();
+        if(labels)
+            bucketLabels.append(labels).append(",");
+        bucketLabels.append("le=\"").append(bound).append("\"");
+
+        writeMetricValue(out, series.c_str(), bucketLabels.c_str(), (double)cumulative);
+    }
+
+    writeMetricValue(out, (std::string(name) + "_sum").c_str(), labels, mSum.load(std::memory_order_relaxed));
+    writeMetricValue(out, (std::string(name) + "_count").c_str(), labels, (double)cumulative);
+}
+
+void profiling::writeMetricHeader(std::string& out, const char* name, const char* help, const char* type)
+{
+    out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+void profiling::writeMetricValue(std::string& out, const char* name, const char* labels, double value)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), " %.17g\n", value);
+
+    out.append(name);
+    if(labels && labels[0] != '\0')
+        out.append("{").append(labels).append("}");
+    out.append(buffer);
+}
+
+void profiling::writeLabelValue(std::string& out, const char* value)
+{
+    for(const char* c = value; *c != '\0'; c++)
+    {
+        if(*c == '\\')
+            out.append("\\\\");
+        else if(*c == '"')
+            out.append("\\\"");
+        else if(*c == '\n')
+            out.append("\\n");
+        else
+            out.push_back(*c);
+    }
+}
+
+
+MetricsServer::MetricsServer() : mListenFd(-1), mEpollFd(-1), mWakeFd(-1) {}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+void MetricsServer::addCollector(const Collector& collector)
+{
+    if(isRunning())
+    {
+        LogError("metrics -- collectors must be added before the server is started\n");
+        return;
+    }
+    mCollectors.push_back(collector);
+}
+
+bool MetricsServer::openListener(const char* address)
+{
+    if(strncmp(address, "unix:", 5) == 0)
+    {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+
+        mUnixPath = address + 5;
+        if(mUnixPath.empty() || mUnixPath.size() >= sizeof(addr.sun_path))
+        {
+            LogError("metrics -- invalid unix socket path '%s'\n", mUnixPath.c_str());
+            return false;
+        }
+        strncpy(addr.sun_path, mUnixPath.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(mUnixPath.c_str());  // stale socket from a previous run
+
+        mListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(mListenFd < 0 || bind(mListenFd, (sockaddr*)&addr, sizeof(addr)) < 0)
+        {
+            LogError("metrics -- failed to bind '%s' (%s)\n", address, strerror(errno));
+            return false;
+        }
+    }
+    else
+    {
+        // split HOST:PORT, the host defaults to localhost
+        std::string host = "127.0.0.1";
+        const char* port = strrchr(address, ':');
+
+        if(port)
+        {
+            if(port != address)
+                host.assign(address, port - address);
+            port++;
+        }
+        else
+            port = address;
+
+        if(host == "localhost")
+            host = "127.0.0.1";
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)atoi(port));
+
+        if(addr.sin_port == 0 || inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1)
+        {
+            LogError("metrics -- invalid address '%s'\n", address);
+            return false;
+        }
+
+        mListenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int reuse = 1;
+        if(mListenFd >= 0)
+            setsockopt(mListenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        if(mListenFd < 0 || bind(mListenFd, (sockaddr*)&addr, sizeof(addr)) < 0)
+        {
+            LogError("metrics -- failed to bind '%s' (%s)\n", address, strerror(errno));
+            return false;
+        }
+    }
+
+    if(listen(mListenFd, SOMAXCONN) < 0)
+    {
+        LogError("metrics -- failed to listen on '%s' (%s)\n", address, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool MetricsServer::start(const char* address)
+{
+    if(!address || isRunning())
+        return false;
+
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if(mEpollFd < 0 || mWakeFd < 0 || !openListener(address))
+    {
+        stop();
+        return false;
+    }
+
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+
+    event.data.fd = mListenFd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mListenFd, &event);
+    event.data.fd = mWakeFd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &event);
+
+    mThread = std::thread(&MetricsServer::run, this);
+    LogInfo("metrics -- serving /metrics on %s\n", address);
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    if(mThread.joinable())
+    {
+        uint64_t one = 1;
+        if(write(mWakeFd, &one, sizeof(one)) < 0)
+            LogError("metrics -- failed to wake the server thread\n");
+        mThread.join();
+    }
+
+    for(std::map<int, Connection>::iterator it = mConnections.begin(); it != mConnections.end(); ++it)
+        close(it->first);
+    mConnections.clear();
+
+    if(mListenFd >= 0) close(mListenFd);
+    if(mEpollFd >= 0)  close(mEpollFd);
+    if(mWakeFd >= 0)   close(mWakeFd);
+    mListenFd = mEpollFd = mWakeFd = -1;
+
+    if(!mUnixPath.empty())
+    {
+        unlink(mUnixPath.c_str());
+        mUnixPath.clear();
+    }
+}
+
+void MetricsServer::run()
+{
+    epoll_event events[METRICS_MAX_EVENTS];
+
+    while(true)
+    {
+        int count = epoll_wait(mEpollFd, events, METRICS_MAX_EVENTS, -1);
+        if(count < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            LogError("metrics -- epoll_wait failed (%s)\n", strerror(errno));
+            return;
+        }
+
+        for(int i = 0; i < count; i++)
+        {
+            const int fd = events[i].data.fd;
+
+            if(fd == mWakeFd)
+                return;  // stop() was called
+            else if(fd == mListenFd)
+                acceptConnections();
+            else if(events[i].events & (EPOLLERR | EPOLLHUP))
+                closeConnection(fd);
+            else if(events[i].events & EPOLLIN)
+                onReadable(fd);
+            else if(events[i].events & EPOLLOUT)
+                onWritable(fd);
+        }
+    }
+}
+
+void MetricsServer::acceptConnections()
+{
+    while(true)
+    {
+        int fd = accept4(mListenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0)
+            return;  // EAGAIN, or an error we can't do anything about
+
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+
+        if(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) < 0)
+        {
+            close(fd);
+            continue;
+        }
+        mConnections[fd].sent = 0;
+    }
+}
+
+void MetricsServer::onReadable(int fd)
+{
+    Connection& connection = mConnections[fd];
+    char buffer[METRICS_READ_SIZE];
+
+    while(true)
+    {
+        ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+        if(size > 0)
+        {
+            connection.request.append(buffer, size);
+            if(connection.request.size() > METRICS_MAX_REQUEST)
+            {
+                closeConnection(fd);
+                return;
+            }
+            continue;
+        }
+        if(size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+
+        closeConnection(fd);  // peer closed or error
+        return;
+    }
+
+    // wait for the end of the headers
+    if(connection.request.find("\r\n\r\n") == std::string::npos)
+        return;
+
+    buildResponse(connection);
+
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLOUT;
+    event.data.fd = fd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, &event);
+
+    onWritable(fd);
+}
+
+void MetricsServer::onWritable(int fd)
+{
+    Connection& connection = mConnections[fd];
+
+    while(connection.sent < connection.response.size())
+    {
+        ssize_t size = send(fd, connection.response.data() + connection.sent,
+                            connection.response.size() - connection.sent, MSG_NOSIGNAL);
+        if(size < 0)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                return;  // wait for EPOLLOUT
+            break;
+        }
+        connection.sent += size;
+    }
+    closeConnection(fd);
+}
+
+void MetricsServer::closeConnection(int fd)
+{
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    mConnections.erase(fd);
+}
+
+void MetricsServer::buildResponse(Connection& connection)
+{
+    const std::string& request = connection.request;
+    const char* status = "200 OK";
+    std::string body;
+
+    if(request.compare(0, 4, "GET ") != 0)
+    {
+        status = "405 Method Not Allowed";
+        body = "only GET is supported\n";
+    }
+    else if(request.compare(4, 9, "/metrics ") != 0 && request.compare(4, 9, "/metrics?") != 0)
+    {
+        status = "404 Not Found";
+        body = "see /metrics\n";
+    }
+    else
+    {
+        for(size_t i = 0; i < mCollectors.size(); i++)
+            mCollectors[i](body);
+    }
+
+    char header[256];
+    snprintf(header, sizeof(header),
+             "HTTP/1.1 %s\r\n"
+             "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+             "Content-Length: %zu\r\n"
+             "Connection: close\r\n\r\n", status, body.size());
+
+    connection.response = header;
+    connection.response.append(body);
+    connection.sent = 0;
+}
@@ -0,0 +1,99 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace profiling
+{
+    /*
+    * Cumulative histogram with fixed upper bounds.
+    * Observations are lock free so it can be updated from a sampling loop
+    * while the metrics server renders it.
+    */
+    class Histogram
+    {
+    public:
+        static const int MAX_BOUNDS = 16;
+
+        // bounds must be sorted in increasing order, +Inf is implicit
+        Histogram(const double* bounds, int size);
+
+        void observe(double value);
+
+        // Append the _bucket, _sum and _count series of `name`. `labels` can be NULL or `key="value"`.
+        void render(std::string& out, const char* name, const char* labels) const;
+
+        inline uint64_t getCount() const { return mCount.load(std::memory_order_relaxed); }
+
+    private:
+        double mBounds[MAX_BOUNDS];
+        int mSize;
+        std::atomic<uint64_t> mBuckets[MAX_BOUNDS + 1];
+        std::atomic<uint64_t> mCount;
+        std::atomic<double>   mSum;
+    };
+
+    // Append the `# HELP` and `# TYPE` lines of a metric.
+    void writeMetricHeader(std::string& out, const char* name, const char* help, const char* type);
+    // Append one sample line of a metric. `labels` can be NULL or `key="value"`.
+    void writeMetricValue(std::string& out, const char* name, const char* labels, double value);
+    // Append a label value escaped as required by the text format.
+    void writeLabelValue(std::string& out, const char* value);
+
+    /*
+    * Minimal HTTP listener serving GET /metrics in the Prometheus text format.
+    * Runs a single epoll thread. The body is built by the collectors at scrape time,
+    * collectors should only read pre-aggregated (atomic) state.
+    */
+    class MetricsServer
+    {
+    public:
+        // Append metrics to the scrape body. Called from the server thread.
+        typedef std::function<void(std::string&)> Collector;
+
+        MetricsServer();
+        ~MetricsServer();
+
+        // Register a collector. Must be called before start().
+        void addCollector(const Collector& collector);
+
+        // Listen on "HOST:PORT", ":PORT" (localhost) or "unix:PATH" and start serving.
+        bool start(const char* address);
+        // Stop the server thread and close all the connections.
+        void stop();
+
+        inline bool isRunning() const { return mThread.joinable(); }
+
+    private:
+        struct Connection
+        {
+            std::string request;
+            std::string response;
+            size_t sent;
+        };
+
+        bool openListener(const char* address);
+        void run();
+        void acceptConnections();
+        void onReadable(int fd);
+        void onWritable(int fd);
+        void closeConnection(int fd);
+        void buildResponse(Connection& connection);
+
+        int mListenFd;
+        int mEpollFd;
+        int mWakeFd;
+        std::string mUnixPath;
+        std::vector<Collector> mCollectors;
+        std::map<int, Connection> mConnections;
+        std::thread mThread;
+    };
+}
+
+#endif
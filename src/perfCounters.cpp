@@ -0,0 +1,172 @@
+#include "perfCounters.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <jetson-utils/logging.h>
+
+using namespace profiling;
+
+namespace
+{
+    struct CounterType
+    {
+        uint32_t type;
+        uint64_t config;
+        const char* name;
+        bool kernel;  // only happens in kernel context, meaningless without it
+    };
+
+    const CounterType gCounterTypes[COUNTER_COUNT] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,        "cycles",           false },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,      "instructions",     false },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,      "cache_misses",     false },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,     "branch_misses",    false },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK,        "task_clock",       false },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES,  "context_switches", true },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,       "page_faults",      false }
+    };
+
+    long perfEventOpen(perf_event_attr* attr, pid_t pid, int cpu, int groupFd, unsigned long flags)
+    {
+        return syscall(__NR_perf_event_open, attr, pid, cpu, groupFd, flags);
+    }
+}
+
+const char* profiling::perfCounterToStr(PerfCounter counter)
+{
+    return counter < COUNTER_COUNT ? gCounterTypes[counter].name : "unknown";
+}
+
+PerfCounters::PerfCounters() : mLeader(-1), mOpened(0)
+{
+    for(int n = 0; n < COUNTER_COUNT; n++)
+    {
+        mFds[n] = -1;
+        mSlots[n] = -1;
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+bool PerfCounters::open()
+{
+    close();
+
+    for(int n = 0; n < COUNTER_COUNT; n++)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = gCounterTypes[n].type;
+        attr.config = gCounterTypes[n].config;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = mLeader < 0;  // the group starts when the leader is enabled
+        attr.exclude_hv = 1;
+
+        // user space only for the hardware counters, allowed with perf_event_paranoid 2. The software
+        // events are counted by the kernel in kernel context, they would stay at 0.
+        attr.exclude_kernel = gCounterTypes[n].type == PERF_TYPE_HARDWARE;
+
+        // this thread, on any cpu
+        int fd = perfEventOpen(&attr, 0, -1, mLeader, 0);
+
+        // perf_event_paranoid 2 refuses the kernel part to a non-root user: count the software
+        // events of user space then, except the ones only seen in kernel context (left at -1)
+        if(fd < 0 && (errno == EACCES || errno == EPERM) && !attr.exclude_kernel && !gCounterTypes[n].kernel)
+        {
+            attr.exclude_kernel = 1;
+            fd = perfEventOpen(&attr, 0, -1, mLeader, 0);
+            if(fd >= 0)
+                LogVerbose("perf counters -- %s counted without its kernel part\n", gCounterTypes[n].name);
+        }
+
+        if(fd < 0)
+        {
+            LogVerbose("perf counters -- %s not available (%s)\n", gCounterTypes[n].name, strerror(errno));
+            continue;
+        }
+
+        if(mLeader < 0)
+            mLeader = fd;
+
+        mFds[n] = fd;
+        mSlots[n] = mOpened++;
+    }
+
+    if(mLeader < 0)
+    {
+        LogWarning("perf counters -- no counter could be opened, check /proc/sys/kernel/perf_event_paranoid\n");
+        return false;
+    }
+
+    if(!isAvailable(COUNTER_CYCLES))
+        LogWarning("perf counters -- no hardware counters, only the software ones are read\n");
+
+    ioctl(mLeader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(mLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+void PerfCounters::close()
+{
+    // the leader last, the group is closed with it
+    for(int n = COUNTER_COUNT - 1; n >= 0; n--)
+    {
+        if(mFds[n] >= 0 && mFds[n] != mLeader)
+            ::close(mFds[n]);
+        mFds[n] = -1;
+        mSlots[n] = -1;
+    }
+
+    if(mLeader >= 0)
+        ::close(mLeader);
+
+    mLeader = -1;
+    mOpened = 0;
+}
+
+bool PerfCounters::read(PerfSample& sample) const
+{
+    for(int n = 0; n < COUNTER_COUNT; n++)
+        sample.values[n] = -1;
+
+    if(mLeader < 0)
+        return false;
+
+    // nr, time enabled, time running, then a value per counter
+    uint64_t buffer[3 + COUNTER_COUNT];
+    const ssize_t size = ::read(mLeader, buffer, sizeof(buffer));
+    if(size < (ssize_t)(3 * sizeof(uint64_t)) || buffer[0] != (uint64_t)mOpened)
+        return false;
+
+    const uint64_t enabled = buffer[1];
+    const uint64_t running = buffer[2];
+
+    for(int n = 0; n < COUNTER_COUNT; n++)
+    {
+        if(mSlots[n] < 0)
+            continue;
+
+        uint64_t value = buffer[3 + mSlots[n]];
+
+        // the group only counted part of the time it was enabled
+        if(running > 0 && running < enabled)
+            value = (uint64_t)((double)value * enabled / running);
+
+        sample.values[n] = (int64_t)value;
+    }
+    return true;
+}
+
+void PerfCounters::difference(const PerfSample& start, const PerfSample& end, PerfSample& delta)
+{
+    for(int n = 0; n < COUNTER_COUNT; n++)
+        delta.values[n] = (start.values[n] < 0 || end.values[n] < 0) ? -1 : end.values[n] - start.values[n];
+}
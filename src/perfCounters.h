@@ -0,0 +1,67 @@
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <stdint.h>
+
+namespace profiling
+{
+    // Counters of a group, in the order of the profiler output
+    enum PerfCounter
+    {
+        COUNTER_CYCLES = 0,
+        COUNTER_INSTRUCTIONS,
+        COUNTER_CACHE_MISSES,
+        COUNTER_BRANCH_MISSES,
+        COUNTER_TASK_CLOCK,        // ns on the CPU, software
+        COUNTER_CONTEXT_SWITCHES,  // software
+        COUNTER_PAGE_FAULTS,       // software
+        COUNTER_COUNT
+    };
+
+    const char* perfCounterToStr(PerfCounter counter);
+
+    // Values of the counters, -1 for the counters that couldn't be opened
+    struct PerfSample
+    {
+        int64_t values[COUNTER_COUNT];
+    };
+
+    /*
+    * Group of hardware and software counters of the calling thread, opened with perf_event_open
+    * and read all at once with a single read(). The hardware counters that can't be opened
+    * (no PMU access in a VM or container, perf_event_paranoid) are left out and the software
+    * ones still count. Without the right to count in the kernel, the software events count
+    * user space only and the context switches, only seen by the kernel, stay at -1.
+    * Counts are scaled if the kernel multiplexed the group.
+    */
+    class PerfCounters
+    {
+    public:
+        PerfCounters();
+        ~PerfCounters();
+
+        // Open the counters for the calling thread. False if none could be opened.
+        bool open();
+        void close();
+
+        inline bool isOpen() const { return mLeader >= 0; }
+        inline bool isAvailable(PerfCounter counter) const { return mFds[counter] >= 0; }
+
+        // Current values of the counters
+        bool read(PerfSample& sample) const;
+
+        // end - start, -1 where a counter isn't available
+        static void difference(const PerfSample& start, const PerfSample& end, PerfSample& delta);
+
+    private:
+        PerfCounters(const PerfCounters&);
+        PerfCounters& operator=(const PerfCounters&);
+
+        int mLeader;
+        int mFds[COUNTER_COUNT];
+        int mSlots[COUNTER_COUNT];  // position of each counter in the group read, -1 if not opened
+        int mOpened;
+    };
+}
+
+#endif
@@ -1,12 +1,123 @@
 #include "profiler.h"
+#include "metrics.h"
+#include "stream.h"
+#include <string.h>
 #include <strings.h>
+#include <time.h>
 #include <jetson-utils/logging.h>
 
+#define METRICS_MAX_LAYERS  1024  // must be a power of 2
+#define METRICS_MAX_NAME    128
+
 using namespace profiling;
 
+// histogram bounds in seconds
+static const double gLayerBounds[] = { 0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1 };
+static const double gInferenceBounds[] = { 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5 };
+
+#define BOUNDS_SIZE(bounds) (int)(sizeof(bounds) / sizeof(bounds[0]))
+
+namespace profiling
+{
+    /*
+    * Fixed size open addressing table of per layer histograms.
+    * Slots are claimed with a CAS so reporting a layer time never takes a lock.
+    */
+    struct LayerMetrics
+    {
+        struct Slot
+        {
+            std::atomic<uint64_t> hash;  // 0 while the slot is free
+            std::atomic<bool> ready;     // the name has been written
+            char name[METRICS_MAX_NAME];
+            Histogram histogram;
+
+            Slot() : hash(0), ready(false), histogram(gLayerBounds, BOUNDS_SIZE(gLayerBounds)) { name[0] = '\0'; }
+        };
+
+        Slot slots[METRICS_MAX_LAYERS];
+        Histogram inference;
+        std::atomic<uint64_t> dropped;  // layer times that didn't fit in the table
+
+        LayerMetrics() : inference(gInferenceBounds, BOUNDS_SIZE(gInferenceBounds)), dropped(0) {}
+
+        Histogram* find(const char* name);
+    };
+}
+
+Histogram* LayerMetrics::find(const char* name)
+{
+    // FNV-1a, forced to be non zero
+    uint64_t hash = 14695981039346656037ULL;
+    for(const char* c = name; *c != '\0'; c++)
+        hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+    hash |= 1;
+
+    size_t index = hash & (METRICS_MAX_LAYERS - 1);
+
+    for(int probe = 0; probe < METRICS_MAX_LAYERS; probe++, index = (index + 1) & (METRICS_MAX_LAYERS - 1))
+    {
+        Slot& slot = slots[index];
+        uint64_t current = slot.hash.load(std::memory_order_acquire);
+
+        if(current == 0)
+        {
+            if(slot.hash.compare_exchange_strong(current, hash, std::memory_order_acq_rel))
+            {
+                strncpy(slot.name, name, METRICS_MAX_NAME - 1);
+                slot.name[METRICS_MAX_NAME - 1] = '\0';
+                slot.ready.store(true, std::memory_order_release);
+                return &slot.histogram;
+            }
+            // another thread claimed the slot, current holds its hash
+        }
+
+        if(current == hash)
+        {
+            while(!slot.ready.load(std::memory_order_acquire));  // the name is being written
+            
+            if(strncmp(slot.name, name, METRICS_MAX_NAME - 1) == 0)
+                return &slot.histogram;
+        }
+    }
+
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return NULL;
+}
+
 // set default profiling options
 FILE* Profiler::mFile = stdout;
 std::string Profiler::mFilename = "stdout";
+LayerMetrics* Profiler::mMetrics = NULL;
+StreamServer* Profiler::mStream = NULL;
+thread_local std::string Profiler::mSession;
+
+// `name` prefixed with the session of the calling thread
+static const char* sessionName(const std::string& session, const char* name)
+{
+    static thread_local std::string prefixed;
+
+    if(session.empty())
+        return name;
+
+    prefixed = session;
+    prefixed.append("/");
+    prefixed.append(name);
+    return prefixed.c_str();
+}
+
+// Publish a layer or inference time to the layer stream
+static void publishLayerRecord(StreamServer* stream, StreamLayerKind kind, const char* name, double timestamp, float duration)
+{
+    StreamLayerRecord record;
+    record.timestamp = timestamp;
+    record.duration = duration;
+    record.kind = kind;
+    strncpy(record.name, name, sizeof(record.name) - 1);
+    record.name[sizeof(record.name) - 1] = '\0';
+
+    stream->publish(&record);
+}
 
 
 void Profiler::setFile(const char* filename)
@@ -55,11 +166,138 @@ void Profiler::setFile(FILE* file)
 
 void Profiler::writeInferenceTime(double startTimestamp, double duration)
 {
-    fprintf(getFile(), "model_total; %f; %f\n", duration, startTimestamp);
+    const char* name = sessionName(mSession, "model_total");
+    fprintf(getFile(), "%s; %f; %f\n", name, duration, startTimestamp);
+
+    if(mMetrics)
+        mMetrics->inference.observe(duration * 0.001);
+
+    if(mStream)
+        publishLayerRecord(mStream, STREAM_INFERENCE, name, startTimestamp, duration);
 }
 
 void Profiler::writeLayerTime(const char* layerName, float duration)
 {
-    fprintf(getFile(), "%s; %f;\n", layerName, duration);
+    const char* name = sessionName(mSession, layerName);
+    fprintf(getFile(), "%s; %f;\n", name, duration);
+
+    if(mMetrics)
+    {
+        Histogram* histogram = mMetrics->find(layerName);
+        if(histogram)
+            histogram->observe(duration * 0.001);
+    }
+
+    if(mStream)
+    {
+        timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        publishLayerRecord(mStream, STREAM_LAYER, name, now.tv_sec * 1000.0 + now.tv_nsec * 0.000001, duration);
+    }
+}
+
+void Profiler::writePhaseTimes(double startTimestamp, const PhaseRecord* phases, int count)
+{
+    FILE* file = getFile();
+
+    // a single line even if other threads are writing
+    flockfile(file);
+    fprintf(file, "%s; %f", sessionName(mSession, "phases"), startTimestamp);
+    for(int n = 0; n < count; n++)
+        fprintf(file, "; %s; %f; %f; %f", phases[n].name, phases[n].offset, phases[n].cpu, phases[n].device);
+    fprintf(file, "\n");
+    funlockfile(file);
+
+    if(mStream)
+    {
+        for(int n = 0; n < count; n++)
+        {
+            const double timestamp = startTimestamp + phases[n].offset;
+            const char* name = sessionName(mSession, phases[n].name);
+            publishLayerRecord(mStream, STREAM_PHASE_CPU, name, timestamp, phases[n].cpu);
+            publishLayerRecord(mStream, STREAM_PHASE_DEVICE, name, timestamp, phases[n].device);
+        }
+    }
+}
+
+void Profiler::writeCounters(double startTimestamp, const CounterRecord* records, int count)
+{
+    FILE* file = getFile();
+
+    flockfile(file);
+    fprintf(file, "%s; %f", sessionName(mSession, "counters"), startTimestamp);
+    for(int n = 0; n < count; n++)
+    {
+        fprintf(file, "; %s", records[n].name);
+        for(int c = 0; c < COUNTER_COUNT; c++)
+            fprintf(file, "; %lld", (long long)records[n].counters.values[c]);
+    }
+    fprintf(file, "\n");
+    funlockfile(file);
+}
+
+void Profiler::writeMemory(double startTimestamp, int64_t rss, int64_t minorFaults, int64_t majorFaults,
+                           const AllocationRecord* records, int count)
+{
+    FILE* file = getFile();
+
+    flockfile(file);
+    fprintf(file, "%s; %f; %lld; %lld; %lld", sessionName(mSession, "memory"), startTimestamp, (long long)rss,
+            (long long)minorFaults, (long long)majorFaults);
+    for(int n = 0; n < count; n++)
+        fprintf(file, "; %s; %llu; %llu; %llu", records[n].name, (unsigned long long)records[n].allocations,
+                (unsigned long long)records[n].frees, (unsigned long long)records[n].bytes);
+    fprintf(file, "\n");
+    funlockfile(file);
+}
+
+void Profiler::writeBatchTime(uint32_t batchSize, double startTimestamp, double duration)
+{
+    fprintf(getFile(), "%s; %u; %f; %f; %f\n", sessionName(mSession, "batch_total"), batchSize, duration, duration / batchSize, startTimestamp);
+}
+
+void Profiler::writeStopReason(const char* reason, uint64_t runs, uint64_t warmup, const char* statistic,
+                               double estimate, double halfWidth)
+{
+    fprintf(getFile(), "%s; %s; %llu; %llu; %s; %f; %f\n", sessionName(mSession, "stop"), reason, (unsigned long long)runs,
+            (unsigned long long)warmup, statistic, estimate, halfWidth);
+}
+
+void Profiler::setSession(const char* session)
+{
+    mSession = session ? session : "";
+}
+
+void Profiler::enableMetrics()
+{
+    if(!mMetrics)
+        mMetrics = new LayerMetrics();
+}
+
+void Profiler::renderMetrics(std::string& out)
+{
+    if(!mMetrics)
+        return;
+
+    writeMetricHeader(out, "profiler_inference_duration_seconds", "Network inference time.", "histogram");
+    mMetrics->inference.render(out, "profiler_inference_duration_seconds", NULL);
+
+    writeMetricHeader(out, "profiler_layer_duration_seconds", "Layer execution time reported by TensorRT.", "histogram");
+    std::string labels;
+
+    for(int i = 0; i < METRICS_MAX_LAYERS; i++)
+    {
+        const LayerMetrics::Slot& slot = mMetrics->slots[i];
+        if(!slot.ready.load(std::memory_order_acquire))
+            continue;
+
+        labels = "layer=\"";
+        writeLabelValue(labels, slot.name);
+        labels.append("\"");
+        slot.histogram.render(out, "profiler_layer_duration_seconds", labels.c_str());
+    }
+
+    writeMetricHeader(out, "profiler_dropped_layer_samples_total", "Layer times not aggregated because the layer table is full.", "counter");
+    writeMetricValue(out, "profiler_dropped_layer_samples_total", NULL, (double)mMetrics->dropped.load(std::memory_order_relaxed));
 }
 
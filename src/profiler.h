@@ -1,11 +1,41 @@
 #ifndef ___PROFILER_H__
 #define ___PROFILER_H__
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string>
+#include "perfCounters.h"
 
 namespace profiling
 {
+    struct LayerMetrics;
+    class StreamServer;
+
+    // Time of one phase of an iteration (pre-processing, network, ...)
+    struct PhaseRecord
+    {
+        const char* name;
+        double offset;  // ms from the start of the iteration
+        float cpu;      // ms
+        float device;   // ms
+    };
+
+    // Hardware and software counters of one phase of an iteration
+    struct CounterRecord
+    {
+        const char* name;
+        PerfSample counters;  // -1 for the counters that aren't available
+    };
+
+    // Heap activity of one phase of an iteration
+    struct AllocationRecord
+    {
+        const char* name;
+        uint64_t allocations;
+        uint64_t frees;
+        uint64_t bytes;
+    };
+
     /*
     * Writes the layer times to an output stream.
     */
@@ -14,6 +44,9 @@ namespace profiling
     private:
         static FILE* mFile;
         static std::string mFilename;
+        static LayerMetrics* mMetrics;
+        static StreamServer* mStream;
+        static thread_local std::string mSession;
     
     public:
         // Get the current profiler output
@@ -26,6 +59,34 @@ namespace profiling
         static void setFile(FILE* file);
         static void writeInferenceTime(double startTimestamp, double duration);
         static void writeLayerTime(const char* layerName, float duration);
+        // Write the phases of an iteration as a single line: phases; START; NAME; OFFSET; CPU; DEVICE; NAME; ...
+        static void writePhaseTimes(double startTimestamp, const PhaseRecord* phases, int count);
+        // Write the counters of the phases of an iteration as a single line:
+        // counters; START; NAME; CYCLES; INSTRUCTIONS; CACHE_MISSES; BRANCH_MISSES; TASK_CLOCK; CONTEXT_SWITCHES; PAGE_FAULTS; NAME; ...
+        static void writeCounters(double startTimestamp, const CounterRecord* records, int count);
+        // Write the memory of the process after an iteration, its page faults and the allocations of its phases as a single line:
+        // memory; START; RSS_KB; MINOR_FAULTS; MAJOR_FAULTS; NAME; ALLOCATIONS; FREES; BYTES; NAME; ...
+        static void writeMemory(double startTimestamp, int64_t rss, int64_t minorFaults, int64_t majorFaults,
+                                const AllocationRecord* records, int count);
+        // Write why the measurements stopped: stop; REASON; RUNS; WARMUP; STATISTIC; ESTIMATE; HALF_WIDTH
+        static void writeStopReason(const char* reason, uint64_t runs, uint64_t warmup, const char* statistic,
+                                    double estimate, double halfWidth);
+        // Write the size and latency of a batch: batch_total; SIZE; DURATION; PER_IMAGE; START
+        static void writeBatchTime(uint32_t batchSize, double startTimestamp, double duration);
+
+        // Aggregate the layer and inference times into latency histograms.
+        static void enableMetrics();
+        static inline bool isMetricsEnabled() { return mMetrics != NULL; }
+        // Append the latency histograms in Prometheus text format. Safe to call while profiling.
+        static void renderMetrics(std::string& out);
+
+        // Prefix the names written from the calling thread with `session/`, so the lines of
+        // networks running concurrently can be told apart. NULL to disable.
+        static void setSession(const char* session);
+        static inline const char* getSession() { return mSession.c_str(); }
+
+        // Also publish the layer, inference and phase times to the subscribers of a layer stream. NULL to disable.
+        static inline void setStream(StreamServer* stream) { mStream = stream; }
     };
 }
 
@@ -0,0 +1,103 @@
+#ifndef __QUEUE_H__
+#define __QUEUE_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+namespace profiling
+{
+    /*
+    * Bounded multi producer queue of fixed size records (Vyukov's algorithm).
+    * Each slot carries a sequence number telling whether it is free or filled.
+    * The capacity must be a power of 2.
+    */
+    class RecordQueue
+    {
+    public:
+        RecordQueue(size_t capacity, uint32_t recordSize) : mMask(capacity - 1), mRecordSize(recordSize),
+            mSequences(new std::atomic<size_t>[capacity]), mRecords(new char[capacity * recordSize]), mHead(0), mTail(0)
+        {
+            for(size_t i = 0; i < capacity; i++)
+                mSequences[i].store(i, std::memory_order_relaxed);
+        }
+
+        ~RecordQueue()
+        {
+            delete[] mSequences;
+            delete[] mRecords;
+        }
+
+        bool push(const void* record)
+        {
+            size_t position = mTail.load(std::memory_order_relaxed);
+
+            while(true)
+            {
+                std::atomic<size_t>& sequence = mSequences[position & mMask];
+                intptr_t diff = (intptr_t)sequence.load(std::memory_order_acquire) - (intptr_t)position;
+
+                if(diff == 0)
+                {
+                    if(mTail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        memcpy(mRecords + (position & mMask) * mRecordSize, record, mRecordSize);
+                        sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if(diff < 0)
+                    return false;  // full
+                else
+                    position = mTail.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Single consumer
+        bool pop(void* record)
+        {
+            size_t position = mHead.load(std::memory_order_relaxed);
+            std::atomic<size_t>& sequence = mSequences[position & mMask];
+
+            if((intptr_t)sequence.load(std::memory_order_acquire) - (intptr_t)(position + 1) < 0)
+                return false;  // empty
+
+            memcpy(record, mRecords + (position & mMask) * mRecordSize, mRecordSize);
+            sequence.store(position + mMask + 1, std::memory_order_release);
+            mHead.store(position + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Records in the queue, approximate while it is used
+        inline size_t size() const
+        {
+            const size_t head = mHead.load(std::memory_order_relaxed);
+            const size_t tail = mTail.load(std::memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+
+        inline size_t capacity() const { return mMask + 1; }
+
+    private:
+        const size_t mMask;
+        const uint32_t mRecordSize;
+        std::atomic<size_t>* mSequences;
+        char* mRecords;
+        // keep the consumer and producer indices on separate cache lines
+        char mPadding0[64];
+        std::atomic<size_t> mHead;
+        char mPadding1[64];
+        std::atomic<size_t> mTail;
+    };
+
+    // Smallest power of 2 >= value
+    inline size_t nextPowerOfTwo(size_t value)
+    {
+        size_t power = 1;
+        while(power < value)
+            power <<= 1;
+        return power;
+    }
+}
+
+#endif
@@ -0,0 +1,284 @@
+#include "stream.h"
+#include "queue.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <jetson-utils/logging.h>
+
+#define STREAM_MAX_EVENTS  32
+#define STREAM_TICK_MS     10
+
+using namespace profiling;
+
+static double monotonicMs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec * 0.000001;
+}
+
+
+StreamServer::StreamServer(StreamRecordType type, uint32_t recordSize, uint32_t batchRecords, int batchMs,
+                           size_t clientFrames, size_t queueRecords)
+    : mType(type), mRecordSize(recordSize), mBatchRecords(batchRecords > 0 ? batchRecords : 1), mBatchMs(batchMs),
+      mClientFrames(clientFrames > 1 ? clientFrames : 2), mQueue(new RecordQueue(nextPowerOfTwo(queueRecords), recordSize)),
+      mBatchCount(0), mBatchStart(0), mSequence(0), mListenFd(-1), mEpollFd(-1), mWakeFd(-1),
+      mDropped(0), mClientDropped(0), mClientCount(0)
+{
+    mBatch.reserve(mBatchRecords * mRecordSize);
+}
+
+StreamServer::~StreamServer()
+{
+    stop();
+    delete mQueue;
+}
+
+bool StreamServer::publish(const void* record)
+{
+    if(mQueue->push(record))
+        return true;
+
+    mDropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool StreamServer::start(const char* path)
+{
+    if(!path || isRunning())
+        return false;
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if(strlen(path) == 0 || strlen(path) >= sizeof(addr.sun_path))
+    {
+        LogError("stream -- invalid unix socket path '%s'\n", path);
+        return false;
+    }
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);  // stale socket from a previous run
+    mPath = path;
+
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    mWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    mListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if(mEpollFd < 0 || mWakeFd < 0 || mListenFd < 0 ||
+       bind(mListenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(mListenFd, SOMAXCONN) < 0)
+    {
+        LogError("stream -- failed to listen on '%s' (%s)\n", path, strerror(errno));
+        stop();
+        return false;
+    }
+
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+
+    event.data.fd = mListenFd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mListenFd, &event);
+    event.data.fd = mWakeFd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &event);
+
+    mThread = std::thread(&StreamServer::run, this);
+    LogInfo("stream -- streaming records on %s\n", path);
+    return true;
+}
+
+void StreamServer::stop()
+{
+    if(mThread.joinable())
+    {
+        uint64_t one = 1;
+        if(write(mWakeFd, &one, sizeof(one)) < 0)
+            LogError("stream -- failed to wake the server thread\n");
+        mThread.join();
+    }
+
+    for(std::map<int, Client>::iterator it = mClients.begin(); it != mClients.end(); ++it)
+        close(it->first);
+    mClients.clear();
+    mClientCount.store(0, std::memory_order_relaxed);
+
+    if(mListenFd >= 0) close(mListenFd);
+    if(mEpollFd >= 0)  close(mEpollFd);
+    if(mWakeFd >= 0)   close(mWakeFd);
+    mListenFd = mEpollFd = mWakeFd = -1;
+
+    if(!mPath.empty())
+    {
+        unlink(mPath.c_str());
+        mPath.clear();
+    }
+}
+
+StreamServer::Frame StreamServer::makeFrame(const char* records, uint32_t count, uint64_t firstSequence) const
+{
+    StreamFrameHeader header;
+    header.magic = STREAM_MAGIC;
+    header.version = STREAM_VERSION;
+    header.type = (uint16_t)mType;
+    header.recordSize = mRecordSize;
+    header.count = count;
+    header.firstSequence = firstSequence;
+    header.dropped = getDropped();
+
+    std::string* frame = new std::string((const char*)&header, sizeof(header));
+    frame->append(records, (size_t)count * mRecordSize);
+    return Frame(frame);
+}
+
+void StreamServer::run()
+{
+    epoll_event events[STREAM_MAX_EVENTS];
+    std::string record(mRecordSize, '\0');
+
+    while(true)
+    {
+        int count = epoll_wait(mEpollFd, events, STREAM_MAX_EVENTS, mBatchMs < STREAM_TICK_MS ? mBatchMs : STREAM_TICK_MS);
+        if(count < 0 && errno != EINTR)
+        {
+            LogError("stream -- epoll_wait failed (%s)\n", strerror(errno));
+            return;
+        }
+
+        for(int i = 0; i < count; i++)
+        {
+            const int fd = events[i].data.fd;
+
+            if(fd == mWakeFd)
+                return;  // stop() was called
+            else if(fd == mListenFd)
+                acceptClients();
+            else if(events[i].events & (EPOLLERR | EPOLLHUP | EPOLLIN))
+                closeClient(fd);  // clients don't send anything, input means they are leaving
+            else if(events[i].events & EPOLLOUT)
+                sendFrames(fd);
+        }
+
+        // drain the publisher queue into the current batch
+        while(mQueue->pop(&record[0]))
+        {
+            if(mBatchCount == 0)
+                mBatchStart = monotonicMs();
+
+            mBatch.append(record);
+            if(++mBatchCount >= mBatchRecords)
+                flushBatch();
+        }
+
+        if(mBatchCount > 0 && monotonicMs() - mBatchStart >= mBatchMs)
+            flushBatch();
+    }
+}
+
+void StreamServer::flushBatch()
+{
+    const uint64_t firstSequence = mSequence;
+    mSequence += mBatchCount;
+
+    if(!mClients.empty())
+    {
+        Frame frame = makeFrame(mBatch.data(), mBatchCount, firstSequence);
+
+        for(std::map<int, Client>::iterator it = mClients.begin(); it != mClients.end(); )
+        {
+            const int fd = it->first;
+            Client& client = it->second;
+            ++it;  // sendFrames may close the client
+
+            if(client.frames.size() >= mClientFrames)
+            {
+                // drop the oldest data frame that is not being sent, the client needs the announce one
+                std::deque<Frame>::iterator oldest = client.frames.begin();
+                if(client.sent > 0)
+                    ++oldest;
+                while(oldest != client.frames.end() && ((const StreamFrameHeader*)(*oldest)->data())->count == 0)
+                    ++oldest;
+
+                mClientDropped.fetch_add(((const StreamFrameHeader*)(*oldest)->data())->count, std::memory_order_relaxed);
+                client.frames.erase(oldest);
+            }
+
+            client.frames.push_back(frame);
+            if(client.frames.size() == 1)
+                sendFrames(fd);
+        }
+    }
+
+    mBatch.clear();
+    mBatchCount = 0;
+}
+
+void StreamServer::acceptClients()
+{
+    while(true)
+    {
+        int fd = accept4(mListenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0)
+            return;
+
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        event.data.fd = fd;
+
+        if(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) < 0)
+        {
+            close(fd);
+            continue;
+        }
+
+        Client& client = mClients[fd];
+        client.sent = 0;
+        client.frames.push_back(makeFrame(NULL, 0, mSequence));  // announce the record type
+        mClientCount.store((uint32_t)mClients.size(), std::memory_order_relaxed);
+
+        sendFrames(fd);
+    }
+}
+
+void StreamServer::sendFrames(int fd)
+{
+    std::map<int, Client>::iterator it = mClients.find(fd);
+    if(it == mClients.end())
+        return;
+
+    Client& client = it->second;
+
+    while(!client.frames.empty())
+    {
+        const std::string& frame = *client.frames.front();
+        ssize_t size = send(fd, frame.data() + client.sent, frame.size() - client.sent, MSG_NOSIGNAL);
+
+        if(size < 0)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+                closeClient(fd);
+            return;  // edge triggered EPOLLOUT will call us again
+        }
+
+        client.sent += size;
+        if(client.sent == frame.size())
+        {
+            client.frames.pop_front();
+            client.sent = 0;
+        }
+    }
+}
+
+void StreamServer::closeClient(int fd)
+{
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    mClients.erase(fd);
+    mClientCount.store((uint32_t)mClients.size(), std::memory_order_relaxed);
+}
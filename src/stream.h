@@ -0,0 +1,145 @@
+#ifndef __STREAM_H__
+#define __STREAM_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+
+#define STREAM_MAGIC    0x53524650  // "PFRS" little endian
+#define STREAM_VERSION  1
+
+namespace profiling
+{
+    /*
+    * Wire format of the subscriber stream.
+    *
+    * On connection the client receives a frame with count=0 announcing the record type,
+    * then frames of `count` fixed size records. Records are numbered by the server,
+    * a gap in firstSequence means the client was too slow and its oldest frames were dropped.
+    * `dropped` counts the records lost before reaching the server (publisher faster than the server thread).
+    * All the fields are little endian.
+    */
+    enum StreamRecordType
+    {
+        STREAM_POWER_SAMPLE = 1,
+        STREAM_LAYER_TIME
+    };
+
+    struct StreamFrameHeader
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t type;
+        uint32_t recordSize;
+        uint32_t count;
+        uint64_t firstSequence;
+        uint64_t dropped;
+    };
+
+    struct StreamPowerRecord
+    {
+        int64_t sec;
+        int64_t nsec;
+        int32_t current;  // mA, -1 when not watched
+        int32_t voltage;  // mV, -1 when not watched
+        int32_t power;    // mW, -1 when not watched
+        int32_t rail;
+    };
+
+    enum StreamLayerKind
+    {
+        STREAM_LAYER = 0,
+        STREAM_INFERENCE,
+        STREAM_PHASE_CPU,    // timestamp is the start of the phase
+        STREAM_PHASE_DEVICE
+    };
+
+    struct StreamLayerRecord
+    {
+        double   timestamp;  // ms, realtime clock
+        float    duration;   // ms
+        uint32_t kind;
+        char     name[48];   // truncated, null terminated
+    };
+
+    static_assert(sizeof(StreamFrameHeader) == 32, "unexpected stream header size");
+    static_assert(sizeof(StreamPowerRecord) == 32, "unexpected power record size");
+    static_assert(sizeof(StreamLayerRecord) == 64, "unexpected layer record size");
+
+    class RecordQueue;
+
+    /*
+    * Streams fixed size records to the clients of a unix socket.
+    *
+    * publish() is lock free and never blocks: records go through a bounded queue
+    * to the server thread which batches them by size or time into frames shared
+    * by all the clients. Each client has a bounded queue of frames, when it is full
+    * the oldest data frame is dropped so a slow client never stalls the publisher (the
+    * announce frame is always delivered).
+    */
+    class StreamServer
+    {
+    public:
+        StreamServer(StreamRecordType type, uint32_t recordSize, uint32_t batchRecords=256, int batchMs=50,
+                     size_t clientFrames=64, size_t queueRecords=16384);
+        ~StreamServer();
+
+        bool start(const char* path);
+        void stop();
+
+        // Queue a record of recordSize bytes. Returns false if it was dropped.
+        bool publish(const void* record);
+
+        inline bool isRunning() const { return mThread.joinable(); }
+        // Records dropped before reaching the server thread
+        inline uint64_t getDropped() const { return mDropped.load(std::memory_order_relaxed); }
+        // Records dropped from the clients queues
+        inline uint64_t getClientDropped() const { return mClientDropped.load(std::memory_order_relaxed); }
+        inline uint32_t getClientCount() const { return mClientCount.load(std::memory_order_relaxed); }
+
+    private:
+        typedef std::shared_ptr<const std::string> Frame;
+
+        struct Client
+        {
+            std::deque<Frame> frames;
+            size_t sent;  // bytes of the front frame already sent
+        };
+
+        void run();
+        void acceptClients();
+        void flushBatch();
+        void sendFrames(int fd);
+        void closeClient(int fd);
+        Frame makeFrame(const char* records, uint32_t count, uint64_t firstSequence) const;
+
+        const StreamRecordType mType;
+        const uint32_t mRecordSize;
+        const uint32_t mBatchRecords;
+        const int      mBatchMs;
+        const size_t   mClientFrames;
+
+        RecordQueue* mQueue;
+        std::string  mBatch;
+        uint32_t     mBatchCount;
+        double       mBatchStart;
+        uint64_t     mSequence;
+
+        int mListenFd;
+        int mEpollFd;
+        int mWakeFd;
+        std::string mPath;
+        std::map<int, Client> mClients;
+        std::thread mThread;
+
+        std::atomic<uint64_t> mDropped;
+        std::atomic<uint64_t> mClientDropped;
+        std::atomic<uint32_t> mClientCount;
+    };
+}
+
+#endif
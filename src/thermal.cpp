@@ -0,0 +1,461 @@
+#include "thermal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <utility>
+#include <jetson-utils/logging.h>
+
+using namespace profiling;
+
+static double realtimeSeconds()
+{
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static double monotonicSeconds()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Paths matching a pattern, sorted
+static std::vector<std::string> globPaths(const std::string& pattern)
+{
+    std::vector<std::string> paths;
+    glob_t matches;
+
+    if(glob(pattern.c_str(), 0, NULL, &matches) == 0)
+    {
+        for(size_t i = 0; i < matches.gl_pathc; i++)
+            paths.push_back(matches.gl_pathv[i]);
+    }
+    globfree(&matches);
+    return paths;
+}
+
+static std::string baseName(const std::string& path)
+{
+    return path.substr(path.find_last_of('/') + 1);
+}
+
+bool profiling::readSysfsString(const std::string& path, std::string& value)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    char buffer[1024];  // long enough for the lists of available frequencies
+    const ssize_t size = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+
+    // a sensor that can't be read fails the read, not the open
+    if(size < 0)
+        return false;
+
+    value.assign(buffer, size);
+    while(!value.empty() && (value.back() == '\n' || value.back() == ' '))
+        value.pop_back();
+    return true;
+}
+
+bool profiling::readSysfsValue(const std::string& path, int64_t& value)
+{
+    std::string text;
+    if(!readSysfsString(path, text) || text.empty())
+        return false;
+
+    char* end = NULL;
+    value = strtoll(text.c_str(), &end, 10);
+    return end != text.c_str();
+}
+
+static int64_t readValue(const std::string& path)
+{
+    int64_t value = -1;
+    return readSysfsValue(path, value) ? value : -1;
+}
+
+
+double ThermalState::getMaxTemperature() const
+{
+    int64_t hottest = -1;
+    for(size_t i = 0; i < temperatures.size(); i++)
+        hottest = std::max(hottest, temperatures[i]);
+    return hottest >= 0 ? hottest / 1000.0 : -1;
+}
+
+double ThermalState::getMinFrequency(const std::vector<FrequencyDomain>& domains, bool devfreq) const
+{
+    int64_t lowest = -1;
+    for(size_t i = 0; i < domains.size() && i < frequencies.size(); i++)
+    {
+        if(domains[i].devfreq == devfreq && frequencies[i] >= 0 && (lowest < 0 || frequencies[i] < lowest))
+            lowest = frequencies[i];
+    }
+    return lowest >= 0 ? lowest / 1000.0 : -1;
+}
+
+
+ThermalMonitor::ThermalMonitor(const char* root) : mRoot(root ? root : "/sys"), mSampling(false), mLog(NULL)
+{
+    while(mRoot.size() > 1 && mRoot.back() == '/')
+        mRoot.pop_back();
+}
+
+ThermalMonitor::~ThermalMonitor()
+{
+    if(mSampler.joinable())
+    {
+        mSampling = false;
+        mSampler.join();
+    }
+
+    if(mLog)
+        fclose(mLog);
+}
+
+bool ThermalMonitor::discover()
+{
+    mZones.clear();
+    mDomains.clear();
+    mCoolingDevices.clear();
+    mThrottleCounters.clear();
+
+    const std::vector<std::string> zones = globPaths(mRoot + "/class/thermal/thermal_zone*");
+    for(size_t i = 0; i < zones.size(); i++)
+    {
+        ThermalZone zone;
+        zone.path = zones[i];
+        zone.passiveTrip = -1;
+
+        if(!readSysfsString(zone.path + "/type", zone.name))
+            zone.name = baseName(zone.path);
+
+        const std::vector<std::string> trips = globPaths(zone.path + "/trip_point_*_type");
+        for(size_t t = 0; t < trips.size(); t++)
+        {
+            std::string type;
+            if(!readSysfsString(trips[t], type) || type != "passive")
+                continue;
+
+            // trip_point_N_type -> trip_point_N_temp
+            const int64_t temperature = readValue(trips[t].substr(0, trips[t].size() - 4) + "temp");
+            if(temperature > 0 && (zone.passiveTrip < 0 || temperature < zone.passiveTrip))
+                zone.passiveTrip = temperature;
+        }
+
+        mZones.push_back(zone);
+    }
+
+    // a policy per cluster, or a cpufreq directory per cpu on older kernels
+    std::vector<std::string> policies = globPaths(mRoot + "/devices/system/cpu/cpufreq/policy*");
+    if(policies.empty())
+        policies = globPaths(mRoot + "/devices/system/cpu/cpu[0-9]*/cpufreq");
+
+    for(size_t i = 0; i < policies.size(); i++)
+    {
+        FrequencyDomain domain;
+        domain.path = policies[i];
+        domain.name = baseName(policies[i]) == "cpufreq" ? baseName(policies[i].substr(0, policies[i].size() - 8)) : baseName(policies[i]);
+        domain.devfreq = false;
+        mDomains.push_back(domain);
+    }
+
+    const std::vector<std::string> devices = globPaths(mRoot + "/class/devfreq/*");
+    for(size_t i = 0; i < devices.size(); i++)
+    {
+        FrequencyDomain domain;
+        domain.path = devices[i];
+        domain.name = baseName(devices[i]);
+        domain.devfreq = true;
+        mDomains.push_back(domain);
+    }
+
+    // fans cool without slowing the clocks down
+    const std::vector<std::string> cooling = globPaths(mRoot + "/class/thermal/cooling_device*");
+    for(size_t i = 0; i < cooling.size(); i++)
+    {
+        std::string type;
+        readSysfsString(cooling[i] + "/type", type);
+        if(type.find("fan") == std::string::npos && type.find("Fan") == std::string::npos)
+            mCoolingDevices.push_back(cooling[i] + "/cur_state");
+    }
+
+    const std::vector<std::string> counters = globPaths(mRoot + "/devices/system/cpu/cpu[0-9]*/thermal_throttle/*_throttle_count");
+    mThrottleCounters.insert(mThrottleCounters.end(), counters.begin(), counters.end());
+
+    LogVerbose("thermal -- %zu zones, %zu frequency domains, %zu cooling devices under %s\n", mZones.size(), mDomains.size(),
+               mCoolingDevices.size(), mRoot.c_str());
+
+    return !mZones.empty() || !mDomains.empty();
+}
+
+void ThermalMonitor::read(ThermalState& state) const
+{
+    state.time = realtimeSeconds();
+    state.temperatures.resize(mZones.size());
+    state.frequencies.resize(mDomains.size());
+    state.maxFrequencies.resize(mDomains.size());
+    state.coolingStates.resize(mCoolingDevices.size());
+    state.throttleCounts.resize(mThrottleCounters.size());
+
+    for(size_t i = 0; i < mZones.size(); i++)
+        state.temperatures[i] = readValue(mZones[i].path + "/temp");
+
+    for(size_t i = 0; i < mDomains.size(); i++)
+    {
+        const FrequencyDomain& domain = mDomains[i];
+        int64_t current = readValue(domain.path + "/" + domain.getCurrentFile());
+        int64_t cap = readValue(domain.path + "/" + domain.getMaxFile());
+
+        // devfreq counts in Hz
+        if(domain.devfreq)
+        {
+            current = current >= 0 ? current / 1000 : -1;
+            cap = cap >= 0 ? cap / 1000 : -1;
+        }
+
+        state.frequencies[i] = current;
+        state.maxFrequencies[i] = cap;
+    }
+
+    for(size_t i = 0; i < mCoolingDevices.size(); i++)
+        state.coolingStates[i] = readValue(mCoolingDevices[i]);
+
+    for(size_t i = 0; i < mThrottleCounters.size(); i++)
+        state.throttleCounts[i] = readValue(mThrottleCounters[i]);
+}
+
+bool ThermalMonitor::isThrottled(const ThermalState& start, const ThermalState& state, std::string& reason) const
+{
+    char buffer[256];
+
+    for(size_t i = 0; i < mZones.size() && i < state.temperatures.size(); i++)
+    {
+        if(mZones[i].passiveTrip > 0 && state.temperatures[i] >= mZones[i].passiveTrip)
+        {
+            snprintf(buffer, sizeof(buffer), "%s at %.1f C over its passive trip %.1f C", mZones[i].name.c_str(),
+                     state.temperatures[i] / 1000.0, mZones[i].passiveTrip / 1000.0);
+            reason = buffer;
+            return true;
+        }
+    }
+
+    for(size_t i = 0; i < mDomains.size() && i < state.maxFrequencies.size() && i < start.maxFrequencies.size(); i++)
+    {
+        if(start.maxFrequencies[i] > 0 && state.maxFrequencies[i] >= 0 && state.maxFrequencies[i] < start.maxFrequencies[i])
+        {
+            snprintf(buffer, sizeof(buffer), "%s capped from %lld to %lld kHz", mDomains[i].name.c_str(),
+                     (long long)start.maxFrequencies[i], (long long)state.maxFrequencies[i]);
+            reason = buffer;
+            return true;
+        }
+    }
+
+    for(size_t i = 0; i < mCoolingDevices.size() && i < state.coolingStates.size() && i < start.coolingStates.size(); i++)
+    {
+        if(start.coolingStates[i] >= 0 && state.coolingStates[i] > start.coolingStates[i])
+        {
+            snprintf(buffer, sizeof(buffer), "%s stepped up from %lld to %lld",
+                     baseName(mCoolingDevices[i].substr(0, mCoolingDevices[i].size() - 10)).c_str(),
+                     (long long)start.coolingStates[i], (long long)state.coolingStates[i]);
+            reason = buffer;
+            return true;
+        }
+    }
+
+    for(size_t i = 0; i < mThrottleCounters.size() && i < state.throttleCounts.size() && i < start.throttleCounts.size(); i++)
+    {
+        if(start.throttleCounts[i] >= 0 && state.throttleCounts[i] > start.throttleCounts[i])
+        {
+            snprintf(buffer, sizeof(buffer), "%lld throttle events on %s", (long long)(state.throttleCounts[i] - start.throttleCounts[i]),
+                     mThrottleCounters[i].c_str() + mRoot.size());
+            reason = buffer;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ThermalMonitor::waitForGate(const ThermalGate& gate, double& waited) const
+{
+    const double start = monotonicSeconds();
+    std::deque<std::pair<double, double>> history;  // time and hottest zone over the window
+    waited = 0;
+
+    if(mZones.empty() || (gate.cooldown <= 0 && gate.stability <= 0))
+        return true;
+
+    while(true)
+    {
+        ThermalState state;
+        read(state);
+
+        const double now = monotonicSeconds();
+        const double temperature = state.getMaxTemperature();
+        waited = now - start;
+
+        history.push_back(std::make_pair(now, temperature));
+        while(history.size() > 1 && now - history[1].first >= gate.window)
+            history.pop_front();
+
+        bool ready = temperature >= 0;
+
+        if(ready && gate.cooldown > 0)
+            ready = temperature <= gate.cooldown;
+
+        if(ready && gate.stability > 0)
+        {
+            double lowest = temperature;
+            double highest = temperature;
+            for(size_t i = 0; i < history.size(); i++)
+            {
+                lowest = std::min(lowest, history[i].second);
+                highest = std::max(highest, history[i].second);
+            }
+            ready = now - history.front().first >= gate.window && highest - lowest <= gate.stability;
+        }
+
+        if(ready)
+            return true;
+
+        if(waited >= gate.timeout)
+        {
+            LogWarning("thermal -- still at %.1f C after %.0f s, running anyway\n", temperature, waited);
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(gate.interval));
+    }
+}
+
+void ThermalMonitor::beginBlock(double interval)
+{
+    if(mSampler.joinable())
+    {
+        mSampling = false;
+        mSampler.join();
+    }
+
+    mBlock.throttled = false;
+    mBlock.reason.clear();
+    read(mBlock.start);
+    writeLog(mBlock.start);
+    mBlock.end = mBlock.start;
+    mBlock.maxTemperature = mBlock.start.getMaxTemperature();
+
+    mSampling = true;
+    mSampler = std::thread(&ThermalMonitor::sample, this, interval);
+}
+
+void ThermalMonitor::endBlock(ThermalBlock& block)
+{
+    if(mSampler.joinable())
+    {
+        mSampling = false;
+        mSampler.join();
+    }
+
+    // the last read covers the end of the block
+    ThermalState state;
+    read(state);
+    writeLog(state);
+
+    std::string reason;
+    if(!mBlock.throttled && isThrottled(mBlock.start, state, reason))
+    {
+        mBlock.throttled = true;
+        mBlock.reason = reason;
+    }
+
+    mBlock.maxTemperature = std::max(mBlock.maxTemperature, state.getMaxTemperature());
+    mBlock.end = state;
+    block = mBlock;
+}
+
+void ThermalMonitor::sample(double interval)
+{
+    const double step = std::min(interval, 0.05);
+
+    while(mSampling)
+    {
+        // sleep in steps so the block can end right away
+        for(double slept = 0; slept < interval && mSampling; slept += step)
+            std::this_thread::sleep_for(std::chrono::duration<double>(step));
+
+        if(!mSampling)
+            break;
+
+        ThermalState state;
+        read(state);
+        writeLog(state);
+
+        std::string reason;
+        const bool throttled = isThrottled(mBlock.start, state, reason);
+
+        mBlock.maxTemperature = std::max(mBlock.maxTemperature, state.getMaxTemperature());
+        if(throttled && !mBlock.throttled)
+        {
+            mBlock.throttled = true;
+            mBlock.reason = reason;
+        }
+    }
+}
+
+bool ThermalMonitor::openLog(const char* path)
+{
+    if(mLog)
+        fclose(mLog);
+
+    mLog = fopen(path, "w");
+    if(!mLog)
+    {
+        LogError("thermal -- failed to open '%s' (%s)\n", path, strerror(errno));
+        return false;
+    }
+
+    fprintf(mLog, "time");
+    for(size_t n = 0; n < mZones.size(); n++)
+        fprintf(mLog, ";%s (C)", mZones[n].name.c_str());
+    for(size_t n = 0; n < mDomains.size(); n++)
+        fprintf(mLog, ";%s (MHz)", mDomains[n].name.c_str());
+    fprintf(mLog, "\n");
+    return true;
+}
+
+void ThermalMonitor::writeLog(const ThermalState& state)
+{
+    if(!mLog)
+        return;
+
+    // the values that couldn't be read are left empty
+    fprintf(mLog, "%.6f", state.time);
+    for(size_t n = 0; n < state.temperatures.size(); n++)
+    {
+        if(state.temperatures[n] >= 0)
+            fprintf(mLog, ";%.3f", state.temperatures[n] * 0.001);
+        else
+            fprintf(mLog, ";");
+    }
+    for(size_t n = 0; n < state.frequencies.size(); n++)
+    {
+        if(state.frequencies[n] >= 0)
+            fprintf(mLog, ";%.3f", state.frequencies[n] * 0.001);
+        else
+            fprintf(mLog, ";");
+    }
+    fprintf(mLog, "\n");
+}
@@ -0,0 +1,131 @@
+#ifndef __THERMAL_H__
+#define __THERMAL_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace profiling
+{
+    // Thermal zone of /sys/class/thermal
+    struct ThermalZone
+    {
+        std::string name;     // its type: cpu-thermal, gpu-thermal, x86_pkg_temp...
+        std::string path;
+        int64_t passiveTrip;  // m°C, lowest passive trip point where the clocks are throttled, -1 if none
+    };
+
+    // cpufreq policy or devfreq device, frequencies in kHz
+    struct FrequencyDomain
+    {
+        std::string name;  // cpufreq policy (policy0, cpu0) or devfreq device (17000000.gv11b)
+        std::string path;
+        bool devfreq;
+
+        // files of the current frequency and of its cap
+        inline const char* getCurrentFile() const { return devfreq ? "cur_freq" : "scaling_cur_freq"; }
+        inline const char* getMaxFile() const { return devfreq ? "max_freq" : "scaling_max_freq"; }
+    };
+
+    // Temperatures and clocks at a point in time, -1 where a file couldn't be read
+    struct ThermalState
+    {
+        double time;  // s since the epoch
+        std::vector<int64_t> temperatures;    // m°C of each zone
+        std::vector<int64_t> frequencies;     // kHz of each domain
+        std::vector<int64_t> maxFrequencies;  // kHz, cap of each domain
+        std::vector<int64_t> coolingStates;   // of each cooling device
+        std::vector<int64_t> throttleCounts;  // x86 thermal_throttle events of each cpu
+
+        // hottest zone in °C, -1 without zones
+        double getMaxTemperature() const;
+        // lowest current frequency in MHz of the cpufreq or devfreq domains, -1 without any
+        double getMinFrequency(const std::vector<FrequencyDomain>& domains, bool devfreq) const;
+    };
+
+    // Conditions to meet before a measured block, the checks at 0 are off
+    struct ThermalGate
+    {
+        ThermalGate() : cooldown(0), stability(0), window(10), timeout(300), interval(1) {}
+
+        double cooldown;   // °C the hottest zone must be under
+        double stability;  // °C the hottest zone can vary over the window
+        double window;     // s
+        double timeout;    // s after which the block runs anyway
+        double interval;   // s between two reads
+    };
+
+    // Thermal state over a measured block
+    struct ThermalBlock
+    {
+        ThermalState start;
+        ThermalState end;
+        double maxTemperature;  // °C over the block
+        bool throttled;
+        std::string reason;     // of the first throttling seen
+    };
+
+    /*
+    * Reads the thermal zones, the cpufreq and devfreq clocks and the cooling devices under
+    * a sysfs root, "/sys" or a fake tree with the same layout. Gates measured blocks on a
+    * cooldown or a steady temperature, then samples them in a thread to catch throttling:
+    * a zone over its passive trip point, a cooling device stepping up, a frequency cap
+    * lowered or an x86 thermal_throttle event.
+    */
+    class ThermalMonitor
+    {
+    public:
+        ThermalMonitor(const char* root="/sys");
+        ~ThermalMonitor();
+
+        // Find the zones, domains and cooling devices. Returns false if none was found.
+        bool discover();
+
+        inline const std::vector<ThermalZone>& getZones() const { return mZones; }
+        inline const std::vector<FrequencyDomain>& getDomains() const { return mDomains; }
+        inline const std::string& getRoot() const { return mRoot; }
+
+        void read(ThermalState& state) const;
+
+        // Why the clocks were throttled at `state`, a block that started at `start`. False if they weren't.
+        bool isThrottled(const ThermalState& start, const ThermalState& state, std::string& reason) const;
+
+        // Wait for the conditions of the gate, returns false on timeout. `waited` in s.
+        bool waitForGate(const ThermalGate& gate, double& waited) const;
+
+        // Sample the state every `interval` s until endBlock()
+        void beginBlock(double interval);
+        void endBlock(ThermalBlock& block);
+
+        // Log the states read over the blocks in `path`, a header `time;ZONE (C);...;DOMAIN (MHz);...`
+        // then a line per state, time in s since the epoch (the samples of profile_tail).
+        // Call after discover(). Returns false if the file can't be opened.
+        bool openLog(const char* path);
+
+    private:
+        void sample(double interval);
+        void writeLog(const ThermalState& state);
+
+        std::string mRoot;
+        std::vector<ThermalZone> mZones;
+        std::vector<FrequencyDomain> mDomains;
+        std::vector<std::string> mCoolingDevices;  // state files, fans left out
+        std::vector<std::string> mThrottleCounters;
+
+        // block being sampled
+        std::thread mSampler;
+        std::atomic<bool> mSampling;
+        ThermalBlock mBlock;  // only written by the sampler until it is joined
+        FILE* mLog;           // NULL if the states aren't logged
+    };
+
+    // Integer in a sysfs file, false if it couldn't be read
+    bool readSysfsValue(const std::string& path, int64_t& value);
+    // String in a sysfs file without its newline
+    bool readSysfsString(const std::string& path, std::string& value);
+}
+
+#endif
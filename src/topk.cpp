@@ -0,0 +1,151 @@
+#include "topk.h"
+
+#if defined(__AVX__)
+    #include <immintrin.h>
+    #define TOPK_AVX
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+    #define TOPK_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define TOPK_NEON
+#endif
+
+using namespace profiling;
+
+namespace
+{
+    /*
+    * The k best values seen so far, sorted by decreasing value.
+    * The selection only takes the slow path for values above the current k-th best,
+    * which quickly becomes rare on a classifier output.
+    */
+    struct Selection
+    {
+        Selection(uint32_t k, uint32_t* indices, float* scores) : k(k), size(0), indices(indices), scores(scores) {}
+
+        // Whether the value enters the selection
+        inline bool accepts(float value) const
+        {
+            return size < k ? value == value : value > scores[size - 1];  // value == value is false for NaN
+        }
+
+        inline void insert(uint32_t index, float value)
+        {
+            uint32_t position = size < k ? size++ : k - 1;
+
+            // strictly greater, so the first index wins on ties
+            while(position > 0 && value > scores[position - 1])
+            {
+                scores[position] = scores[position - 1];
+                indices[position] = indices[position - 1];
+                position--;
+            }
+            scores[position] = value;
+            indices[position] = index;
+        }
+
+        inline void add(uint32_t index, float value)
+        {
+            if(accepts(value))
+                insert(index, value);
+        }
+
+        // Threshold for the SIMD comparisons
+        inline float threshold() const
+        {
+            return scores[size - 1];
+        }
+
+        const uint32_t k;
+        uint32_t size;
+        uint32_t* indices;
+        float* scores;
+    };
+}
+
+uint32_t profiling::topKScalar(const float* values, uint32_t count, uint32_t k, uint32_t* indices, float* scores)
+{
+    if(k == 0)
+        return 0;
+
+    Selection selection(k, indices, scores);
+    for(uint32_t i = 0; i < count; i++)
+        selection.add(i, values[i]);
+    return selection.size;
+}
+
+uint32_t profiling::topK(const float* values, uint32_t count, uint32_t k, uint32_t* indices, float* scores)
+{
+    if(k == 0)
+        return 0;
+
+    Selection selection(k, indices, scores);
+    uint32_t i = 0;
+
+    // fill the selection, a threshold exists from there
+    for(; i < count && selection.size < k; i++)
+        selection.add(i, values[i]);
+
+    if(selection.size < k)
+        return selection.size;
+
+#if defined(TOPK_AVX)
+    __m256 threshold = _mm256_set1_ps(selection.threshold());
+
+    for(; i + 8 <= count; i += 8)
+    {
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values + i), threshold, _CMP_GT_OQ));
+        if(mask == 0)
+            continue;
+
+        for(uint32_t lane = 0; lane < 8; lane++)
+            selection.add(i + lane, values[i + lane]);
+        threshold = _mm256_set1_ps(selection.threshold());
+    }
+#elif defined(TOPK_SSE)
+    __m128 threshold = _mm_set1_ps(selection.threshold());
+
+    for(; i + 4 <= count; i += 4)
+    {
+        int mask = _mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(values + i), threshold));
+        if(mask == 0)
+            continue;
+
+        for(uint32_t lane = 0; lane < 4; lane++)
+            selection.add(i + lane, values[i + lane]);
+        threshold = _mm_set1_ps(selection.threshold());
+    }
+#elif defined(TOPK_NEON)
+    float32x4_t threshold = vdupq_n_f32(selection.threshold());
+
+    for(; i + 4 <= count; i += 4)
+    {
+        uint32x4_t mask = vcgtq_f32(vld1q_f32(values + i), threshold);
+        if(vmaxvq_u32(mask) == 0)
+            continue;
+
+        for(uint32_t lane = 0; lane < 4; lane++)
+            selection.add(i + lane, values[i + lane]);
+        threshold = vdupq_n_f32(selection.threshold());
+    }
+#endif
+
+    for(; i < count; i++)
+        selection.add(i, values[i]);
+
+    return selection.size;
+}
+
+const char* profiling::topKInstructionSet()
+{
+#if defined(TOPK_AVX)
+    return "avx";
+#elif defined(TOPK_SSE)
+    return "sse";
+#elif defined(TOPK_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
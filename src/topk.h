@@ -0,0 +1,19 @@
+#ifndef __TOPK_H__
+#define __TOPK_H__
+
+#include <stdint.h>
+
+namespace profiling
+{
+    // Select the k largest values, sorted by decreasing value (the lowest index first on ties).
+    // Writes min(k, count) indices and scores and returns their number. NaNs are ignored.
+    uint32_t topK(const float* values, uint32_t count, uint32_t k, uint32_t* indices, float* scores);
+
+    // Same selection without SIMD, the reference of topK
+    uint32_t topKScalar(const float* values, uint32_t count, uint32_t k, uint32_t* indices, float* scores);
+
+    // Instruction set used by topK: avx, sse, neon or scalar
+    const char* topKInstructionSet();
+}
+
+#endif
@@ -0,0 +1,256 @@
+#include "traceParser.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace profiling;
+
+#define MAX_EXACT_MANTISSA  (1ULL << 53)
+#define MAX_EXACT_SCALE     22
+#define FALLBACK_SIZE       64
+
+static const double gPowersOf10[MAX_EXACT_SCALE + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const uint64_t gPowersOf10Int[9] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    #define SWAR_DIGITS
+#endif
+
+#ifdef SWAR_DIGITS
+// Number of leading digits of 8 characters loaded in a word
+static inline uint32_t countDigits(uint64_t chars)
+{
+    // the high nibble of a digit is 3, and adding 6 keeps it there
+    const uint64_t high = 0xF0F0F0F0F0F0F0F0ULL;
+    const uint64_t nonDigits = ((chars & high) ^ 0x3030303030303030ULL) |
+                               (((chars + 0x0606060606060606ULL) & high) ^ 0x3030303030303030ULL);
+    // a carry of the addition only changes the bytes after the first non digit
+    return nonDigits ? __builtin_ctzll(nonDigits) / 8 : 8;
+}
+
+// Value of 8 digits loaded in a word, the first one is the most significant
+static inline uint64_t parseEightDigits(uint64_t chars)
+{
+    chars = ((chars & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;
+    chars = ((chars & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+    return ((chars & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+}
+#endif
+
+// Accumulate the digits from `c` in `mantissa`, 8 at a time when the buffer allows it
+static inline const char* parseDigits(const char* c, const char* end, uint64_t& mantissa)
+{
+#ifdef SWAR_DIGITS
+    while(end - c >= 8)
+    {
+        uint64_t chars;
+        memcpy(&chars, c, sizeof(chars));
+
+        const uint32_t count = countDigits(chars);
+        if(count == 0)
+            return c;
+
+        // the digits end up in the last bytes, the first ones are zeros
+        if(count < 8)
+            chars <<= 8 * (8 - count);
+
+        mantissa = mantissa * gPowersOf10Int[count] + parseEightDigits(chars);
+        c += count;
+
+        if(count < 8)
+            return c;
+    }
+#endif
+    while(c < end && *c >= '0' && *c <= '9')
+        mantissa = mantissa * 10 + (*c++ - '0');
+    return c;
+}
+
+// Numbers with an exponent, too many digits, nan or inf
+static bool parseFallback(const char*& p, const char* end, double& value)
+{
+    char buffer[FALLBACK_SIZE];
+    const size_t size = (end - p) < FALLBACK_SIZE - 1 ? end - p : FALLBACK_SIZE - 1;
+    memcpy(buffer, p, size);
+    buffer[size] = '\0';
+
+    char* last = NULL;
+    value = strtod(buffer, &last);
+    if(last == buffer)
+        return false;
+
+    p += last - buffer;
+    return true;
+}
+
+bool profiling::parseDecimal(const char*& p, const char* end, double& value)
+{
+    while(p < end && (*p == ' ' || *p == '\t'))
+        p++;
+
+    const char* c = p;
+    const bool negative = c < end && *c == '-';
+    if(c < end && (*c == '-' || *c == '+'))
+        c++;
+
+    uint64_t mantissa = 0;
+    const char* integer = c;
+    c = parseDigits(c, end, mantissa);
+    int digits = c - integer;
+    int scale = 0;
+
+    if(c < end && *c == '.')
+    {
+        const char* fraction = ++c;
+        c = parseDigits(c, end, mantissa);
+        scale = c - fraction;
+        digits += scale;
+    }
+
+    // exact only if the mantissa and the power of 10 are exact doubles, strtod otherwise
+    if(digits == 0 || digits > 19 || mantissa > MAX_EXACT_MANTISSA || scale > MAX_EXACT_SCALE ||
+       (c < end && (*c == 'e' || *c == 'E')))
+        return parseFallback(p, end, value);
+
+    value = (double)mantissa / gPowersOf10[scale];
+    if(negative)
+        value = -value;
+
+    p = c;
+    return true;
+}
+
+// Match `keyword` at the end of the name, alone or after a session
+static bool matchName(TraceRecord& record, const char* keyword, size_t length)
+{
+    if(record.nameLength < length || memcmp(record.name + record.nameLength - length, keyword, length) != 0)
+        return false;
+
+    if(record.nameLength == length)
+    {
+        record.sessionLength = 0;
+        return true;
+    }
+
+    if(record.name[record.nameLength - length - 1] != '/')
+        return false;
+
+    record.sessionLength = record.nameLength - length - 1;
+    return true;
+}
+
+#define MATCH_NAME(record, keyword) matchName(record, keyword, sizeof(keyword) - 1)
+
+// Parse `count` numbers separated by `;`
+static bool parseValues(TraceRecord& record, int count, const char* limit)
+{
+    const char* c = record.fields;
+
+    for(int n = 0; n < count; n++)
+    {
+        if(n > 0)
+        {
+            while(c < record.end && *c == ' ')
+                c++;
+            if(c >= record.end || *c != ';')
+                return false;
+            c++;
+        }
+
+        if(!parseDecimal(c, limit, record.values[n]) || c > record.end)
+            return false;
+    }
+
+    record.valueCount = count;
+    return true;
+}
+
+void profiling::parseTraceLine(const char* line, const char* end, TraceRecord& record, const char* limit)
+{
+    const char* separator = (const char*)memchr(line, ';', end - line);
+
+    record.type = TRACE_UNKNOWN;
+    record.name = line;
+    record.nameLength = (separator ? separator : end) - line;
+    record.sessionLength = 0;
+    record.fields = separator ? separator + 1 : end;
+    record.end = end;
+    record.valueCount = 0;
+
+    if(!separator)
+        return;
+
+    if(!limit || limit < end)
+        limit = end;
+
+    if(MATCH_NAME(record, "model_total"))
+    {
+        if(parseValues(record, 2, limit))
+            record.type = TRACE_MODEL_TOTAL;
+    }
+    else if(MATCH_NAME(record, "batch_total"))
+    {
+        if(parseValues(record, 4, limit))
+            record.type = TRACE_BATCH_TOTAL;
+    }
+    else if(MATCH_NAME(record, "phases"))
+        record.type = TRACE_PHASES;
+    else if(MATCH_NAME(record, "counters"))
+        record.type = TRACE_COUNTERS;
+    else if(MATCH_NAME(record, "memory"))
+        record.type = TRACE_MEMORY;
+    else if(MATCH_NAME(record, "stop"))
+        record.type = TRACE_STOP;
+    else
+    {
+        record.sessionLength = 0;  // a layer name can have slashes
+        if(parseValues(record, 1, limit))
+            record.type = TRACE_LAYER;
+    }
+}
+
+bool TraceReader::next(TraceRecord& record)
+{
+    while(mPosition < mEnd)
+    {
+        const char* line = mPosition;
+        const char* newLine = (const char*)memchr(line, '\n', mEnd - line);
+        const char* end = newLine ? newLine : mEnd;
+        mPosition = newLine ? newLine + 1 : mEnd;
+
+        if(end > line && end[-1] == '\r')
+            end--;
+        if(end == line)
+            continue;
+
+        parseTraceLine(line, end, record, mEnd);
+        return true;
+    }
+    return false;
+}
+
+void TraceReader::split(const char* data, size_t size, uint32_t parts, const char** bounds)
+{
+    const char* end = data + size;
+    bounds[0] = data;
+
+    for(uint32_t n = 1; n < parts; n++)
+    {
+        const char* bound = data + size / parts * n;
+        if(bound < bounds[n - 1])
+            bound = bounds[n - 1];
+
+        // move to the start of the next line
+        if(bound > data && bound < end && bound[-1] != '\n')
+        {
+            const char* newLine = (const char*)memchr(bound, '\n', end - bound);
+            bound = newLine ? newLine + 1 : end;
+        }
+        bounds[n] = bound;
+    }
+    bounds[parts] = end;
+}
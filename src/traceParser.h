@@ -0,0 +1,71 @@
+#ifndef __TRACE_PARSER_H__
+#define __TRACE_PARSER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace profiling
+{
+    // Kind of a line written by the Profiler
+    enum TraceRecordType
+    {
+        TRACE_LAYER = 0,     // name; DURATION;
+        TRACE_MODEL_TOTAL,   // model_total; DURATION; START
+        TRACE_BATCH_TOTAL,   // batch_total; SIZE; DURATION; PER_IMAGE; START
+        TRACE_PHASES,        // phases; START; NAME; OFFSET; CPU; DEVICE; ...
+        TRACE_STOP,          // stop; REASON; RUNS; WARMUP; STATISTIC; ESTIMATE; HALF_WIDTH
+        TRACE_COUNTERS,      // counters; START; NAME; CYCLES; INSTRUCTIONS; ...
+        TRACE_MEMORY,        // memory; START; RSS_KB; MINOR_FAULTS; MAJOR_FAULTS; NAME; ALLOCATIONS; FREES; BYTES; ...
+        TRACE_UNKNOWN
+    };
+
+    #define TRACE_MAX_VALUES 4
+
+    /*
+    * A line of the profiler output, pointing into the parsed buffer.
+    * The numbers of the layer, model_total and batch_total lines are parsed, the fields
+    * of the other lines are left to the caller from `fields`.
+    */
+    struct TraceRecord
+    {
+        TraceRecordType type;
+        const char* name;         // first field, with the session prefix
+        uint32_t nameLength;
+        uint32_t sessionLength;   // length of the session before the `/` of a model_total, batch_total, phases, counters, memory or stop line
+        const char* fields;       // after the `;` of the name
+        const char* end;          // end of the line, without the new line
+        double values[TRACE_MAX_VALUES];
+        int valueCount;
+    };
+
+    /*
+    * Reads the lines of a profiler output from a buffer, usually a MappedFile.
+    * The buffer isn't copied and must outlive the records.
+    */
+    class TraceReader
+    {
+    public:
+        TraceReader(const char* begin, const char* end) : mPosition(begin), mEnd(end) {}
+
+        // Next non empty line. Returns false at the end of the buffer.
+        bool next(TraceRecord& record);
+
+        // Split a buffer in `parts` ranges of whole lines, writes parts + 1 bounds.
+        // Parts can be empty when the lines are longer than the parts.
+        static void split(const char* data, size_t size, uint32_t parts, const char** bounds);
+
+    private:
+        const char* mPosition;
+        const char* mEnd;
+    };
+
+    // Parse a decimal number like 0.123456 or -12.5e-3 from `p`, reading up to `end`.
+    // Leading spaces are skipped and `p` is moved after the number. Returns false if there is no number.
+    bool parseDecimal(const char*& p, const char* end, double& value);
+
+    // Parse a line, `end` is the end of the line without the new line. `limit`, the end of the buffer,
+    // lets the numbers close to the end of the line be read 8 digits at a time.
+    void parseTraceLine(const char* line, const char* end, TraceRecord& record, const char* limit=NULL);
+}
+
+#endif